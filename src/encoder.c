@@ -8,7 +8,6 @@
 #include <unistd.h>
 #include <string.h>
 #include <sys/types.h>
-#include <sys/socket.h>
 #include <gst/gst.h>
 #include <gst/app/gstappsrc.h>
 #include <gst/app/gstappsink.h>
@@ -158,66 +157,166 @@ static EncoderStream * encoder_get_stream (Encoder *encoder, gchar *name)
 /*
  * free memory size between tail and head.
  */
-static gint cache_free (Encoder *encoder)
+static guint64 cache_free (EncoderOutput *output)
 {
-    if (*(encoder->output->head_addr) >= *(encoder->output->tail_addr)) {
-        return *(encoder->output->head_addr) - *(encoder->output->tail_addr);
+    if (*(output->head_addr) >= *(output->tail_addr)) {
+        return *(output->head_addr) - *(output->tail_addr);
 
     } else {
-        return *(encoder->output->head_addr) + encoder->output->cache_size - *(encoder->output->tail_addr);
+        return *(output->head_addr) + output->cache_size - *(output->tail_addr);
     }
 }
 
 /*
  * move head_addr to next gop.
  */
-static void move_head (Encoder *encoder)
+static void move_head (EncoderOutput *output)
 {
-    gint gop_size;
+    guint64 gop_size;
 
-    gop_size = encoder_output_gop_size (encoder->output, *(encoder->output->head_addr));
+    gop_size = encoder_output_gop_size (output, *(output->head_addr));
     /* move head. */
-    if (*(encoder->output->head_addr) + gop_size + 12 < encoder->output->cache_size) {
-        *(encoder->output->head_addr) += gop_size + 12;
+    if (*(output->head_addr) + gop_size + ENCODER_GOP_HEADER_SIZE < output->cache_size) {
+        *(output->head_addr) += gop_size + ENCODER_GOP_HEADER_SIZE;
 
     } else {
-        *(encoder->output->head_addr) = *(encoder->output->head_addr) + gop_size - encoder->output->cache_size + 12;
+        *(output->head_addr) = *(output->head_addr) + gop_size - output->cache_size + ENCODER_GOP_HEADER_SIZE;
     }
+    output->stats->gops_evicted++;
+    output->stats->head_timestamp = encoder_output_rap_timestamp (output, *(output->head_addr));
 }
 
 /*
- * move last random access point address.
+ * write size of gop at rap_addr, gop header may wrap around.
  */
-static void move_last_rap (Encoder *encoder, GstBuffer *buffer)
+static void set_gop_size (EncoderOutput *output, guint64 rap_addr, gint32 size)
 {
-    gchar buf[12];
+    gint32 n;
+
+    if (rap_addr + ENCODER_GOP_SIZE_OFFSET + 4 < output->cache_size) {
+        memcpy (output->cache_addr + rap_addr + ENCODER_GOP_SIZE_OFFSET, &size, 4);
+
+    } else if (rap_addr + ENCODER_GOP_SIZE_OFFSET < output->cache_size) {
+        n = output->cache_size - rap_addr - ENCODER_GOP_SIZE_OFFSET;
+        memcpy (output->cache_addr + rap_addr + ENCODER_GOP_SIZE_OFFSET, &size, n);
+        memcpy (output->cache_addr, (gchar *)&size + n, 4 - n);
+
+    } else {
+        n = rap_addr + ENCODER_GOP_SIZE_OFFSET - output->cache_size;
+        memcpy (output->cache_addr + n, &size, 4);
+    }
+}
+
+/*
+ * open a new gop at tail, 4bytes reservation for gop size, followed by latency trace stamps.
+ */
+static void open_gop (EncoderOutput *output, GstClockTime timestamp, gint64 ingest_time)
+{
+    gchar buf[ENCODER_GOP_HEADER_SIZE];
     gint32 size, n;
-    GstClockTime buffer_time, now;
+    gint64 open_time;
 
-    /* calculate and write gop size. */
-    if (*(encoder->output->tail_addr) >= *(encoder->output->last_rap_addr)) {
-        size = *(encoder->output->tail_addr) - *(encoder->output->last_rap_addr);
+    *(output->last_rap_addr) = *(output->tail_addr);
+    output->stats->gops++;
+    if (*(output->head_addr) == *(output->last_rap_addr)) {
+        /* the only gop in cache */
+        output->stats->head_timestamp = timestamp;
+    }
+    open_time = g_get_real_time ();
+    if (ingest_time != 0) {
+        metrics_histogram_observe (&(output->stats->encode_latency), open_time > ingest_time ? open_time - ingest_time : 0);
+    }
+    memcpy (buf + ENCODER_GOP_TIMESTAMP_OFFSET, &timestamp, 8);
+    size = 0;
+    memcpy (buf + ENCODER_GOP_SIZE_OFFSET, &size, 4);
+    memcpy (buf + ENCODER_GOP_INGEST_TIME_OFFSET, &ingest_time, 8);
+    memcpy (buf + ENCODER_GOP_OPEN_TIME_OFFSET, &open_time, 8);
+    if (*(output->tail_addr) + ENCODER_GOP_HEADER_SIZE < output->cache_size) {
+        memcpy (output->cache_addr + *(output->tail_addr), buf, ENCODER_GOP_HEADER_SIZE);
+        *(output->tail_addr) += ENCODER_GOP_HEADER_SIZE;
+
+    } else {
+        n = output->cache_size - *(output->tail_addr);
+        memcpy (output->cache_addr + *(output->tail_addr), buf, n);
+        memcpy (output->cache_addr, buf + n, ENCODER_GOP_HEADER_SIZE - n);
+        *(output->tail_addr) = ENCODER_GOP_HEADER_SIZE - n;
+    }
+}
+
+/*
+ * size of gop being written at last rap.
+ */
+static gint64 open_gop_size (EncoderOutput *output)
+{
+    if (*(output->tail_addr) >= *(output->last_rap_addr)) {
+        return *(output->tail_addr) - *(output->last_rap_addr) - ENCODER_GOP_HEADER_SIZE;
 
     } else {
-        size = encoder->output->cache_size - *(encoder->output->last_rap_addr) + *(encoder->output->tail_addr);
+        return output->cache_size - *(output->last_rap_addr) + *(output->tail_addr) - ENCODER_GOP_HEADER_SIZE;
+    }
+}
+
+/*
+ * ingest wall clock of the newest segment reference buffer not later than pts, 0 if unknown.
+ * stamps are written by another streaming thread, a stamp being overwritten is read at worst.
+ */
+static gint64 ingest_lookup (Encoder *encoder, GstClockTime pts)
+{
+    guint64 count, i;
+    EncoderIngestStamp *stamp;
+
+    if (!GST_CLOCK_TIME_IS_VALID (pts)) {
+        return 0;
+    }
+    count = __atomic_load_n (&(encoder->ingest_stamps_count), __ATOMIC_ACQUIRE);
+    for (i = count; (i > 0) && (count - i < ENCODER_INGEST_STAMPS); i--) {
+        stamp = &(encoder->ingest_stamps[(i - 1) & (ENCODER_INGEST_STAMPS - 1)]);
+        if (stamp->pts <= pts) {
+            return stamp->ingest_time;
+        }
     }
-    size -= 12;
 
-    if (*(encoder->output->last_rap_addr) + 12 < encoder->output->cache_size) {
-        memcpy (encoder->output->cache_addr + *(encoder->output->last_rap_addr) + 8, &size, 4);
+    return 0;
+}
 
-    } else if (*(encoder->output->last_rap_addr) + 8 < encoder->output->cache_size) {
-        n = encoder->output->cache_size - *(encoder->output->last_rap_addr) - 8;
-        memcpy (encoder->output->cache_addr + *(encoder->output->last_rap_addr) + 8, &size, n);
-        memcpy (encoder->output->cache_addr, &size + n, 4 - n);
+/*
+ * remember when the buffer pushed to encoder left source appsink, looked up by pts of encoder output.
+ */
+static void ingest_record (EncoderStream *stream, RingBuffer *ring_buffer, GstBuffer *buffer)
+{
+    Encoder *encoder = stream->encoder;
+    EncoderIngestStamp *stamp;
+
+    if (!stream->is_segment_reference || !GST_BUFFER_PTS_IS_VALID (buffer)) {
+        return;
+    }
+    stamp = &(encoder->ingest_stamps[encoder->ingest_stamps_count & (ENCODER_INGEST_STAMPS - 1)]);
+    stamp->pts = GST_BUFFER_PTS (buffer);
+    stamp->ingest_time = ring_buffer->ingest_time;
+    __atomic_store_n (&(encoder->ingest_stamps_count), encoder->ingest_stamps_count + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * move last random access point address.
+ */
+static void move_last_rap (Encoder *encoder, GstBuffer *buffer)
+{
+    gint32 size;
+    GstClockTime buffer_time, now;
+
+    size = open_gop_size (encoder->output);
+    if (size == 0) {
+        /*
+         * gop at last rap is empty, fresh ring or ring continued after a worker restart,
+         * reuse its header.
+         */
+        *(encoder->output->tail_addr) = *(encoder->output->last_rap_addr);
 
     } else {
-        n = *(encoder->output->last_rap_addr) + 8 - encoder->output->cache_size;
-        memcpy (encoder->output->cache_addr + n, &size, 4);
+        set_gop_size (encoder->output, *(encoder->output->last_rap_addr), size);
     }
 
-    /* new gop timestamp, 4bytes reservation for gop size. */
-    *(encoder->output->last_rap_addr) = *(encoder->output->tail_addr);
+    /* new gop timestamp. */
     now = gst_clock_get_time (encoder->system_clock);
     if ((encoder->segment_timestamp + encoder->segment_duration < now) ||
         (now + encoder->segment_duration < encoder->segment_timestamp)) {
@@ -225,24 +324,12 @@ static void move_last_rap (Encoder *encoder, GstBuffer *buffer)
     }
     buffer_time = encoder->segment_timestamp / 1000;
     GST_INFO ("new segment, timestamp is %ld", buffer_time);
-    memcpy (buf, &buffer_time, 8);
-    size = 0;
-    memcpy (buf + 8, &size, 4);
-    if (*(encoder->output->tail_addr) + 12 < encoder->output->cache_size) {
-        memcpy (encoder->output->cache_addr + *(encoder->output->tail_addr), buf, 12);
-        *(encoder->output->tail_addr) += 12;
-
-    } else {
-        n = encoder->output->cache_size - *(encoder->output->tail_addr);
-        memcpy (encoder->output->cache_addr + *(encoder->output->tail_addr), buf, n);
-        memcpy (encoder->output->cache_addr, buf + n, 12 - n);
-        *(encoder->output->tail_addr) = 12 - n;
-    }
+    open_gop (encoder->output, buffer_time, ingest_lookup (encoder, GST_BUFFER_PTS (buffer)));
 }
 
 static void copy_buffer (Encoder *encoder, GstBuffer *buffer)
 {
-    gint size;
+    gsize size;
     GstMapInfo info;
 
     gst_buffer_map (buffer, &info, GST_MAP_READ);
@@ -306,66 +393,91 @@ static void udp_streaming (Encoder *encoder, GstBuffer *buffer)
 
 static void send_msg (Encoder *encoder)
 {
-    gchar *msg;
-    struct sockaddr *addr;
-    gsize len, ret;
-
-    msg = g_strdup_printf ("/%s/encoder/%d:%lu", encoder->job_name, encoder->id, encoder->last_segment_duration);
-    addr = (struct sockaddr *)&(encoder->msg_sock_addr);
-    len = strlen (msg);
-    while (1) {
-        ret = sendto (encoder->msg_sock, msg, len, 0, addr, sizeof (struct sockaddr));
-        if (ret == -1) {
-            if (errno == EINTR) {
-                GST_WARNING ("sendto segment msg error: EINTR: %s", g_strerror (errno));
-                continue;
+    encoder_output_post_event (encoder->output, ENCODER_EVENT_SEGMENT, encoder->last_segment_duration);
+    encoder->last_running_time = GST_CLOCK_TIME_NONE;
+}
 
-            } else if (errno == EAGAIN) {
-                GST_WARNING ("sendto segment msg error: EAGAIN: %s", g_strerror (errno));
-                g_usleep (50000);
-                continue;
-            }
+/**
+ * encoder_output_write:
+ * @encoder: (in): the encoder, its output is locked by caller.
+ * @buffer: (in): buffer to be written at tail.
+ * @rap: (in): buffer is a random access point, a new gop of segment timestamp is opened for it.
+ *
+ * write buffer into cache, head moves over the gops the buffer overwrites.
+ */
+void encoder_output_write (Encoder *encoder, GstBuffer *buffer, gboolean rap)
+{
+    (*(encoder->output->total_count)) += gst_buffer_get_size (buffer);
+    encoder->output->stats->samples++;
+    encoder->output->stats->bytes += gst_buffer_get_size (buffer);
 
-        } else if (ret != len) {
-            GST_WARNING ("FATAL sendto segment msg return : %ld, but length: %ld", ret, len);
-        }
-        break;
+    /* update head_addr, free enough memory for current buffer. */
+    while (cache_free (encoder->output) <= gst_buffer_get_size (buffer) + ENCODER_GOP_HEADER_SIZE) {
+        move_head (encoder->output);
     }
-    g_free (msg);
 
-    encoder->last_running_time = GST_CLOCK_TIME_NONE;
+    if (rap) {
+        move_last_rap (encoder, buffer);
+    }
+
+    /*
+     * copy buffer to cache.
+     * update tail_addr
+     */
+    copy_buffer (encoder, buffer);
+    encoder->output->stats->cache_fill = encoder->output->cache_size - cache_free (encoder->output);
 }
 
-static GstFlowReturn new_sample_callback (GstAppSink * sink, gpointer user_data)
+/*
+ * lock encoder output, wait 2s at most, wait time goes to semaphore wait histogram.
+ */
+static gboolean output_lock (EncoderOutput *output)
 {
-    GstBuffer *buffer;
-    GstSample *sample;
-    Encoder *encoder = (Encoder *)user_data;
-    struct timespec ts;
-    gboolean segment_found = FALSE;
-    GstClockTime now;
+    struct timespec start, ts;
+    gint64 wait;
+    guint i;
 
-    *(encoder->output->heartbeat) = gst_clock_get_time (encoder->system_clock);
-    sample = gst_app_sink_pull_sample (GST_APP_SINK (sink));
-    buffer = gst_sample_get_buffer (sample);
-    if (clock_gettime (CLOCK_REALTIME, &ts) == -1) {
-        GST_ERROR ("new_sample_callback clock_gettime error: %s", g_strerror (errno));
-        return GST_FLOW_OK;
+    if (clock_gettime (CLOCK_REALTIME, &start) == -1) {
+        GST_ERROR ("%s clock_gettime error: %s", output->name, g_strerror (errno));
+        return FALSE;
     }
+    ts = start;
     ts.tv_sec += 2;
-    while (sem_timedwait (encoder->output->semaphore, &ts) == -1) {
+    while (sem_timedwait (output->semaphore, &ts) == -1) {
         if (errno == EINTR) {
             continue;
         }
-        GST_ERROR ("new_sample_callback sem_timedwait failure: %s", g_strerror (errno));
-        return GST_FLOW_OK;
+        GST_ERROR ("%s sem_timedwait failure: %s", output->name, g_strerror (errno));
+        return FALSE;
     }
 
-    (*(encoder->output->total_count)) += gst_buffer_get_size (buffer);
+    clock_gettime (CLOCK_REALTIME, &ts);
+    wait = ((ts.tv_sec - start.tv_sec) * 1000000000 + ts.tv_nsec - start.tv_nsec) / 1000;
+    i = wait <= 0 ? 0 : g_bit_storage (wait);
+    if (i >= ENCODER_SEM_WAIT_BUCKETS) {
+        i = ENCODER_SEM_WAIT_BUCKETS - 1;
+    }
+    output->stats->sem_wait[i]++;
 
-    /* update head_addr, free enough memory for current buffer. */
-    while (cache_free (encoder) <= gst_buffer_get_size (buffer) + 12) { /* timestamp + gop size = 12 */
-        move_head (encoder);
+    return TRUE;
+}
+
+/* encoder output buffer into cache, find segment */
+static void output_buffer (Encoder *encoder, GstBuffer *buffer)
+{
+    gboolean segment_found = FALSE;
+    GstClockTime now;
+    gboolean rap = FALSE;
+
+    *(encoder->output->heartbeat) = gst_clock_get_time (encoder->system_clock);
+    if (!output_lock (encoder->output)) {
+        __atomic_add_fetch (&(encoder->output->stats->dropped), 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    /* udpstreaming? */
+    if (encoder->udpstreaming) {
+        udp_streaming (encoder, buffer);
     }
 
     /* 
@@ -379,56 +491,86 @@ static GstFlowReturn new_sample_callback (GstAppSink * sink, gpointer user_data)
             (encoder->has_tssegment && (GST_BUFFER_PTS (buffer) >= encoder->last_running_time))) {
         if (encoder->has_m3u8_output == FALSE) {
             /* no m3u8 output */
-            move_last_rap (encoder, buffer);
+            rap = TRUE;
 
         } else if (encoder->last_running_time != GST_CLOCK_TIME_NONE) {
             if (G_UNLIKELY (encoder->is_first_key)) {
-                /* move_last_rap if its first key even if has m3u8 output */
+                /* new gop if its first key even if has m3u8 output */
                 now = gst_clock_get_time (encoder->system_clock);
                 encoder->segment_timestamp = now - (now % encoder->segment_duration);
-                move_last_rap (encoder, buffer);
-                segment_found = TRUE;
                 encoder->is_first_key = FALSE;
 
             } else {
                 encoder->segment_timestamp += encoder->segment_duration;
-                move_last_rap (encoder, buffer);
-                segment_found = TRUE;
             }
+            rap = TRUE;
+            segment_found = TRUE;
         }
     }
-
-    /* udpstreaming? */
-    if (encoder->udpstreaming) {
-        udp_streaming (encoder, buffer);
-    }
-
-    /*
-     * copy buffer to cache.
-     * update tail_addr
-     */
-    copy_buffer (encoder, buffer);
+    encoder_output_write (encoder, buffer, rap);
 
     sem_post (encoder->output->semaphore);
 
     if (segment_found) {
         send_msg (encoder);
     }
+}
+
+static GstFlowReturn new_sample_callback (GstAppSink * sink, gpointer user_data)
+{
+    GstSample *sample;
+    Encoder *encoder = (Encoder *)user_data;
 
+    sample = gst_app_sink_pull_sample (GST_APP_SINK (sink));
+    output_buffer (encoder, gst_sample_get_buffer (sample));
     gst_sample_unref (sample);
 
     return GST_FLOW_OK;
 }
 
+/* segment of source found in reference stream, force key unit of video encoder */
+static void segment_reference (EncoderStream *stream, RingBuffer *ring_buffer, GstBuffer *buffer, GstAppSrc *src)
+{
+    Encoder *encoder = stream->encoder;
+    GstClockTime running_time;
+    GstPad *pad;
+    GstEvent *event;
+
+    if (GST_BUFFER_PTS_IS_VALID (buffer)) {
+        running_time = GST_BUFFER_PTS (buffer);
+
+    } else {
+        running_time = ring_buffer->timestamp;
+    }
+    if (!ring_buffer->is_rap) {
+        return;
+    }
+    encoder->last_segment_duration = ring_buffer->duration;
+    /* force key unit? native passthrough has no appsrc, its frames are from source already */
+    if (encoder->has_video && (src != NULL)) {
+        pad = gst_element_get_static_pad ((GstElement *)src, "src");
+        event = gst_video_event_new_downstream_force_key_unit (running_time,
+                running_time,
+                running_time,
+                TRUE,
+                encoder->force_key_count);
+        if (G_LIKELY (gst_pad_push_event (pad, event))) {
+            GST_INFO ("push force key, running time: %ld", running_time);
+            encoder->last_video_buffer_pts = running_time;
+
+        } else {
+            GST_ERROR ("push key event failure, running time: %ld", running_time);
+        }
+    }
+    encoder->last_running_time = running_time;
+    encoder->force_key_count++;
+}
+
 static void need_data_callback (GstAppSrc *src, guint length, gpointer user_data)
 {
     EncoderStream *stream = (EncoderStream *)user_data;
     gint current_position;
     GstBuffer *buffer;
-    GstPad *pad;
-    GstEvent *event;
-    Encoder *encoder;
-    GstClockTime running_time;
 
     current_position = (stream->current_position + 1) % SOURCE_RING_SIZE;
     for (;;) {
@@ -467,39 +609,10 @@ static void need_data_callback (GstAppSrc *src, guint length, gpointer user_data
                 GST_TIME_ARGS (GST_BUFFER_PTS (buffer)),
                 stream->source->current_position);
 
-        encoder = stream->encoder;
         if (stream->is_segment_reference) {
-            if (GST_BUFFER_PTS_IS_VALID (buffer)) {
-                running_time = GST_BUFFER_PTS (buffer);
-
-            } else {
-                running_time = stream->source->ring[current_position]->timestamp;
-            }
-            if (stream->source->ring[current_position]->is_rap) {
-                encoder->last_segment_duration = stream->source->ring[current_position]->duration;
-                /* force key unit? */
-                if (encoder->has_video) {
-                    pad = gst_element_get_static_pad ((GstElement *)src, "src");
-                    event = gst_video_event_new_downstream_force_key_unit (running_time,
-                            running_time,
-                            running_time,
-                            TRUE,
-                            encoder->force_key_count);
-                    if (G_LIKELY (gst_pad_push_event (pad, event))) {
-                        GST_INFO ("push force key, running time: %ld", running_time);
-                        encoder->last_video_buffer_pts = running_time;
-
-                    } else {
-                        GST_ERROR ("push key event failure, running time: %ld", running_time);
-                    }
-                    encoder->last_running_time = running_time;
-
-                } else {
-                    encoder->last_running_time = running_time;
-                }
-                encoder->force_key_count++;
-            }
+            segment_reference (stream, stream->source->ring[current_position], buffer, src);
         }
+        ingest_record (stream, stream->source->ring[current_position], buffer);
 
         /* push buffer */
         if (gst_app_src_push_buffer (src, gst_buffer_ref (buffer)) != GST_FLOW_OK) {
@@ -523,6 +636,7 @@ static GstPadProbeReturn encoder_appsink_event_probe (GstPad *pad, GstPadProbeIn
     if (GST_EVENT_TYPE (event) == GST_EVENT_EOS) {
         GST_ERROR ("End of Stream of encoder %s", encoder->name);
         *(encoder->output->eos) = TRUE;
+        encoder_output_post_event (encoder->output, ENCODER_EVENT_EOS, 0);
     }
 
     return GST_PAD_PROBE_OK;
@@ -622,21 +736,34 @@ static gint create_encoder_pipeline (Encoder *encoder)
 
 static gint encoder_extract_streams (Encoder *encoder, gchar **bins)
 {
-    GRegex *regex;
-    GMatchInfo *match_info;
     EncoderStream *stream, *segment_reference_stream = NULL;
-    gchar *bin, **p;
+    BinToken *tokens;
+    gchar *bin, **p, *name;
+    gint count, i;
+    gboolean has_appsrc;
 
+    tokens = g_new (BinToken, BIN_MAX_ELEMENTS);
     p = bins;
     while (*p != NULL) {
         bin = *p;
-        regex = g_regex_new ("appsrc *name=(?<name>[^ ]*)", G_REGEX_OPTIMIZE, 0, NULL);
-        g_regex_match (regex, bin, 0, &match_info);
-        g_regex_unref (regex);
-        if (g_match_info_matches (match_info)) {
+        count = bin_tokenize (bin, tokens, BIN_MAX_ELEMENTS);
+        if (count < 0) {
+            g_free (tokens);
+            return 1;
+        }
+
+        /* appsrc name=video ! queue ! x264enc ! ..., appsrc is not necessarily the first element */
+        name = NULL;
+        has_appsrc = FALSE;
+        for (i = 0; (i < count) && (name == NULL); i++) {
+            if (bin_token_is (bin, &(tokens[i]), "appsrc")) {
+                has_appsrc = TRUE;
+                name = bin_token_property (bin, &(tokens[i]), "name");
+            }
+        }
+        if (name != NULL) {
             stream = (EncoderStream *)g_malloc (sizeof (EncoderStream));
-            stream->name = g_match_info_fetch_named (match_info, "name");
-            g_match_info_free (match_info);
+            stream->name = name;
             g_array_append_val (encoder->streams, stream);
             stream->is_segment_reference = FALSE;
             if (g_str_has_prefix (stream->name, "video")) {
@@ -655,8 +782,9 @@ static gint encoder_extract_streams (Encoder *encoder, gchar **bins)
                 }
             }
 
-        } else if (g_str_has_prefix (bin, "appsrc")) {
+        } else if (has_appsrc) {
             GST_ERROR ("appsrc name property must be set");
+            g_free (tokens);
             return 1;
         }
 
@@ -669,6 +797,7 @@ static gint encoder_extract_streams (Encoder *encoder, gchar **bins)
         }
         p++;
     }
+    g_free (tokens);
 
     if (segment_reference_stream != NULL) {
         segment_reference_stream->is_segment_reference = TRUE;
@@ -677,12 +806,12 @@ static gint encoder_extract_streams (Encoder *encoder, gchar **bins)
     return 0;
 }
 
-static void udpstreaming_parse (gchar *job, Encoder *encoder)
+static void udpstreaming_parse (JobDesc *jobdesc, Encoder *encoder)
 {
     gchar *udpstreaming, **pp;
     GstElement *udpsink;
 
-    udpstreaming = jobdesc_udpstreaming (job, encoder->name);
+    udpstreaming = jobdesc_udpstreaming (jobdesc, encoder->name);
     if (udpstreaming == NULL) {
         encoder->udpstreaming = NULL;
         encoder->appsrc = NULL;
@@ -737,7 +866,26 @@ static void complete_request_element (GSList *bins)
     }
 }
 
-guint encoder_initialize (GArray *earray, gchar *job, EncoderOutput *encoders, Source *source)
+/**
+ * encoder_stream_push:
+ * @stream: (in): encoder stream of native passthrough job, there is no encoder pipeline.
+ * @ring_buffer: (in): segment of the buffer marked by source_stream_segment.
+ * @buffer: (in): buffer of source stream, into encoder output directly.
+ *
+ * Native passthrough, what need_data_callback and new_sample_callback do without appsrc and appsink.
+ */
+void encoder_stream_push (EncoderStream *stream, RingBuffer *ring_buffer, GstBuffer *buffer)
+{
+    stream->state->last_heartbeat = gst_clock_get_time (stream->system_clock);
+    if (stream->is_segment_reference) {
+        segment_reference (stream, ring_buffer, buffer, NULL);
+    }
+    ingest_record (stream, ring_buffer, buffer);
+    output_buffer (stream->encoder, buffer);
+    stream->state->current_timestamp = GST_BUFFER_PTS (buffer);
+}
+
+guint encoder_initialize (GArray *earray, JobDesc *jobdesc, EncoderOutput *encoders, Source *source)
 {
     gint i, j, k;
     gchar *job_name, *pipeline;
@@ -747,8 +895,8 @@ guint encoder_initialize (GArray *earray, gchar *job, EncoderOutput *encoders, S
     gchar **bins;
     gsize count;
 
-    job_name = jobdesc_get_name (job);
-    count = jobdesc_encoders_count (job);
+    job_name = jobdesc_get_name (jobdesc);
+    count = jobdesc_encoders_count (jobdesc);
     for (i = 0; i < count; i++) {
         pipeline = g_strdup_printf ("encoder.%d", i);
         encoder = encoder_new ("name", pipeline, NULL);
@@ -756,14 +904,14 @@ guint encoder_initialize (GArray *earray, gchar *job, EncoderOutput *encoders, S
         encoder->id = i;
         encoder->last_running_time = GST_CLOCK_TIME_NONE;
         encoder->output = &(encoders[i]);
-        encoder->segment_duration = jobdesc_m3u8streaming_segment_duration (job);
+        encoder->segment_duration = jobdesc_m3u8streaming_segment_duration (jobdesc);
         encoder->last_segment_duration = 0;
         encoder->force_key_count = 0;
         encoder->has_video = FALSE;
         encoder->has_audio_only = FALSE;
         encoder->has_tssegment = FALSE;
 
-        bins = jobdesc_bins (job, pipeline);
+        bins = jobdesc_bins (jobdesc, pipeline);
         if (encoder_extract_streams (encoder, bins) != 0) {
             GST_ERROR ("extract encoder %s streams failure", encoder->name);
             g_free (job_name);
@@ -776,7 +924,7 @@ guint encoder_initialize (GArray *earray, gchar *job, EncoderOutput *encoders, S
         for (j = 0; j < encoder->streams->len; j++) {
             estream = g_array_index (encoder->streams, gpointer, j);
             estream->state = &(encoders[i].streams[j]);
-            g_strlcpy (encoders[i].streams[j].name, estream->name, STREAM_NAME_LEN);
+            g_strlcpy (encoders[i].stream_names[j], estream->name, STREAM_NAME_LEN);
             estream->encoder = encoder;
             estream->source = NULL;
             for (k = 0; k < source->streams->len; k++) {
@@ -798,14 +946,14 @@ guint encoder_initialize (GArray *earray, gchar *job, EncoderOutput *encoders, S
         }
 
         /* mkdir for transcode job. */
-        if (!jobdesc_is_live (job)) {
+        if (!jobdesc_is_live (jobdesc)) {
             gchar *locations[] = {"%s.elements.filesink.property.location", "%s.elements.hlssink.property.location", NULL};
             gchar *p, *value, **location;
 
             location = locations;
             while (*location != NULL) {
                 p = g_strdup_printf (*location, pipeline);
-                value = jobdesc_element_property_value (job, p);
+                value = jobdesc_element_property_value (jobdesc, p);
                 g_free (p);
                 if (value != NULL) {
                     break;
@@ -826,8 +974,21 @@ guint encoder_initialize (GArray *earray, gchar *job, EncoderOutput *encoders, S
             g_free (p);
         }
 
+        /* native passthrough, no pipeline */
+        if (jobdesc_passthrough (jobdesc) != NULL) {
+            encoder->bins = NULL;
+            encoder->pipeline = NULL;
+            encoder->udpstreaming = NULL;
+            encoder->appsrc = NULL;
+            encoder->is_first_key = TRUE;
+            encoder->has_m3u8_output = jobdesc_m3u8streaming (jobdesc);
+            g_free (pipeline);
+            g_array_append_val (earray, encoder);
+            continue;
+        }
+
         /* parse bins and create pipeline. */
-        encoder->bins = bins_parse (job, pipeline);
+        encoder->bins = bins_parse (jobdesc, pipeline);
         if (encoder->bins == NULL) {
             GST_ERROR ("parse job %s bins error", job_name);
             g_free (job_name);
@@ -843,15 +1004,11 @@ guint encoder_initialize (GArray *earray, gchar *job, EncoderOutput *encoders, S
         }
 
         /* parse udpstreaming */
-        udpstreaming_parse (job, encoder);
+        udpstreaming_parse (jobdesc, encoder);
 
         /* m3u8 playlist */
         encoder->is_first_key = TRUE;
-        if (jobdesc_m3u8streaming (job)) {
-            memset (&(encoder->msg_sock_addr), 0, sizeof (struct sockaddr_un));
-            encoder->msg_sock_addr.sun_family = AF_UNIX;
-            strncpy (encoder->msg_sock_addr.sun_path, MSG_SOCK_PATH, sizeof (encoder->msg_sock_addr.sun_path) - 1);
-            encoder->msg_sock = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        if (jobdesc_m3u8streaming (jobdesc)) {
             encoder->has_m3u8_output = TRUE;
 
         } else {
@@ -894,6 +1051,31 @@ gboolean is_encoder_output_ready (EncoderOutput *encoder_output)
     return ready;
 }
 
+/*
+ * read a 8 bytes stamp of gop header at offset, header may wrap around.
+ */
+static gint64 rap_stamp (EncoderOutput *encoder_output, guint64 rap_addr, guint64 offset)
+{
+    guint64 addr;
+    gint64 stamp;
+    gint n;
+
+    addr = rap_addr + offset;
+    if (addr >= encoder_output->cache_size) {
+        addr -= encoder_output->cache_size;
+    }
+    if (addr + 8 <= encoder_output->cache_size) {
+        memcpy (&stamp, encoder_output->cache_addr + addr, 8);
+
+    } else {
+        n = encoder_output->cache_size - addr;
+        memcpy (&stamp, encoder_output->cache_addr + addr, n);
+        memcpy ((gchar *)&stamp + n, encoder_output->cache_addr, 8 - n);
+    }
+
+    return stamp;
+}
+
 /*
  * encoder_output_rap_timestamp:
  * @encoder_output: (in): the encoder output.
@@ -906,32 +1088,41 @@ gboolean is_encoder_output_ready (EncoderOutput *encoder_output)
  */
 GstClockTime encoder_output_rap_timestamp (EncoderOutput *encoder_output, guint64 rap_addr)
 {
-    GstClockTime timestamp;
-
-    if (rap_addr + 8 <= encoder_output->cache_size) {
-        memcpy (&timestamp, encoder_output->cache_addr + rap_addr, 8);
-
-    } else {
-        gint n;
-
-        n = encoder_output->cache_size - rap_addr;
-        memcpy (&timestamp, encoder_output->cache_addr + rap_addr, n);
-        memcpy (&timestamp + n, encoder_output->cache_addr, 8 - n);
-    }
+    return rap_stamp (encoder_output, rap_addr, ENCODER_GOP_TIMESTAMP_OFFSET);
+}
 
-    return timestamp;
+/**
+ * encoder_output_rap_trace:
+ * @encoder_output: (in): the encoder output.
+ * @rap_addr: (in): the rap addr to get its latency trace stamps
+ * @ingest_time: (out): wall clock the random access point left source appsink, 0 if unknown.
+ * @open_time: (out): wall clock the gop opened in cache.
+ *
+ * read latency trace stamps of the gop header at rap_addr, in us.
+ */
+void encoder_output_rap_trace (EncoderOutput *encoder_output, guint64 rap_addr, gint64 *ingest_time, gint64 *open_time)
+{
+    *ingest_time = rap_stamp (encoder_output, rap_addr, ENCODER_GOP_INGEST_TIME_OFFSET);
+    *open_time = rap_stamp (encoder_output, rap_addr, ENCODER_GOP_OPEN_TIME_OFFSET);
 }
 
-static guint64 encoder_output_rap_next (EncoderOutput *encoder_output, guint64 rap_addr)
+/**
+ * encoder_output_rap_next:
+ * @encoder_output: (in): the encoder output.
+ * @rap_addr: (in): the rap addr of a closed gop.
+ *
+ * Returns: addr of the gop next to the gop at rap_addr.
+ */
+guint64 encoder_output_rap_next (EncoderOutput *encoder_output, guint64 rap_addr)
 {
-    gint gop_size;
+    guint64 gop_size;
     guint64 next_rap_addr;
 
     /* gop size */
     gop_size = encoder_output_gop_size (encoder_output, rap_addr);
 
     /* next random access address */
-    next_rap_addr = rap_addr + gop_size + 12;
+    next_rap_addr = rap_addr + gop_size + ENCODER_GOP_HEADER_SIZE;
     if (next_rap_addr >= encoder_output->cache_size) {
         next_rap_addr -= encoder_output->cache_size;
     }
@@ -995,11 +1186,11 @@ guint64 encoder_output_gop_size (EncoderOutput *encoder_output, guint64 rap_addr
     guint64 gop_size_addr;
 
     /* gop size address */
-    if (rap_addr + 8 < encoder_output->cache_size) {
-        gop_size_addr = rap_addr + 8;
+    if (rap_addr + ENCODER_GOP_SIZE_OFFSET < encoder_output->cache_size) {
+        gop_size_addr = rap_addr + ENCODER_GOP_SIZE_OFFSET;
 
     } else {
-        gop_size_addr = rap_addr + 8 - encoder_output->cache_size;
+        gop_size_addr = rap_addr + ENCODER_GOP_SIZE_OFFSET - encoder_output->cache_size;
     }
 
     /* gop size */
@@ -1011,9 +1202,117 @@ guint64 encoder_output_gop_size (EncoderOutput *encoder_output, guint64 rap_addr
 
         n = encoder_output->cache_size - gop_size_addr;
         memcpy (&gop_size, encoder_output->cache_addr + gop_size_addr, n);
-        memcpy (&gop_size + n, encoder_output->cache_addr, 4 - n);
+        memcpy ((gchar *)&gop_size + n, encoder_output->cache_addr, 4 - n);
     }
 
     return gop_size;
 }
 
+/*
+ * encoder_output_continue:
+ * @encoder_output: (in): encoder output left by the previous worker.
+ *
+ * continue the cache of a restarted live job instead of resetting it. the gop being written when
+ * the previous worker died is closed at its last whole ts packet, and an empty gop is opened after
+ * it as the discontinuity marker, whose header is reused by the first random access point of the
+ * new worker. gops in cache and viewers reading them are kept.
+ *
+ * Returns: FALSE if the cache is not continuable, e.g. the previous worker died before any output.
+ *
+ */
+gboolean encoder_output_continue (EncoderOutput *encoder_output)
+{
+    gint64 size;
+    GstClockTime timestamp;
+
+    if ((*(encoder_output->head_addr) >= encoder_output->cache_size) ||
+            (*(encoder_output->tail_addr) >= encoder_output->cache_size) ||
+            (*(encoder_output->last_rap_addr) >= encoder_output->cache_size) ||
+            (*(encoder_output->tail_addr) == *(encoder_output->last_rap_addr))) {
+        return FALSE;
+    }
+
+    size = open_gop_size (encoder_output);
+    if (size < 0) {
+        return FALSE;
+    }
+
+    /* the worker may have died in the middle of a sample, drop the partial ts packet. */
+    size -= size % 188;
+    *(encoder_output->tail_addr) = *(encoder_output->last_rap_addr) + ENCODER_GOP_HEADER_SIZE + size;
+    if (*(encoder_output->tail_addr) >= encoder_output->cache_size) {
+        *(encoder_output->tail_addr) -= encoder_output->cache_size;
+    }
+    if (size == 0) {
+        /* an empty gop. */
+        return TRUE;
+    }
+
+    set_gop_size (encoder_output, *(encoder_output->last_rap_addr), size);
+    while (cache_free (encoder_output) <= ENCODER_GOP_HEADER_SIZE) {
+        move_head (encoder_output);
+    }
+    /* segment timestamps are multiples of segment duration, 1us later is distinct and never looked up */
+    timestamp = encoder_output_rap_timestamp (encoder_output, *(encoder_output->last_rap_addr)) + 1;
+    open_gop (encoder_output, timestamp, 0);
+
+    return TRUE;
+}
+
+/**
+ * encoder_output_post_event:
+ * @encoder_output: (in): the encoder output to post event to.
+ * @type: (in): EncoderEventType.
+ * @value: (in): value of the event, segment duration of ENCODER_EVENT_SEGMENT.
+ *
+ * Called by the encoder only, never block: event is dropped if the ring is full.
+ */
+void encoder_output_post_event (EncoderOutput *encoder_output, guint32 type, guint64 value)
+{
+    EncoderEventRing *ring = encoder_output->events;
+    EncoderEvent *event;
+    guint64 wpos, rpos, one = 1;
+
+    wpos = ring->write;
+    rpos = __atomic_load_n (&(ring->read), __ATOMIC_ACQUIRE);
+    if (wpos - rpos >= ENCODER_EVENT_RING_SIZE) {
+        ring->dropped++;
+        __atomic_add_fetch (&(encoder_output->stats->msg_failures), 1, __ATOMIC_RELAXED);
+        GST_WARNING ("%s event ring full, drop event %u", encoder_output->name, type);
+        return;
+    }
+    event = &(ring->events[wpos & (ENCODER_EVENT_RING_SIZE - 1)]);
+    event->type = type;
+    event->value = value;
+    __atomic_store_n (&(ring->write), wpos + 1, __ATOMIC_RELEASE);
+
+    /* ring the doorbell, eventfd counter never overflow here */
+    if ((encoder_output->event_fd != -1) && (write (encoder_output->event_fd, &one, sizeof (one)) == -1)) {
+        __atomic_add_fetch (&(encoder_output->stats->msg_failures), 1, __ATOMIC_RELAXED);
+        GST_WARNING ("%s write event fd error: %s", encoder_output->name, g_strerror (errno));
+    }
+}
+
+/**
+ * encoder_output_pop_event:
+ * @encoder_output: (in): the encoder output to pop event from.
+ * @event: (out): the event poped.
+ *
+ * Called by master msg thread only.
+ *
+ * Returns: FALSE if no event.
+ */
+gboolean encoder_output_pop_event (EncoderOutput *encoder_output, EncoderEvent *event)
+{
+    EncoderEventRing *ring = encoder_output->events;
+    guint64 rpos;
+
+    rpos = ring->read;
+    if (rpos == __atomic_load_n (&(ring->write), __ATOMIC_ACQUIRE)) {
+        return FALSE;
+    }
+    *event = ring->events[rpos & (ENCODER_EVENT_RING_SIZE - 1)];
+    __atomic_store_n (&(ring->read), rpos + 1, __ATOMIC_RELEASE);
+
+    return TRUE;
+}
@@ -8,18 +8,77 @@
 #define __ENCODER_H__
 
 #include <semaphore.h>
-#include <sys/un.h>
 
-#define MSG_SOCK_PATH "/tmp/millsock"
+#include "metrics.h"
+
+#define ENCODER_EVENT_RING_SIZE 64 /* power of 2 */
+
+/*
+ * gop header in front of every gop in cache, may wrap around:
+ * timestamp (8 bytes), gop size (4 bytes, 0 while the gop is being written),
+ * source ingest wall clock of the random access point (8 bytes, 0 if unknown)
+ * and wall clock the gop opened in cache (8 bytes), both in us.
+ */
+#define ENCODER_GOP_HEADER_SIZE 28
+#define ENCODER_GOP_TIMESTAMP_OFFSET 0
+#define ENCODER_GOP_SIZE_OFFSET 8
+#define ENCODER_GOP_INGEST_TIME_OFFSET 12
+#define ENCODER_GOP_OPEN_TIME_OFFSET 20
+
+#define ENCODER_INGEST_STAMPS 256 /* power of 2 */
 
 typedef struct _Encoder Encoder;
 typedef struct _EncoderClass EncoderClass;
 
+/* every stream state in its own cache line, name is in the string table of job output */
 typedef struct _EncoderStreamState {
-    gchar name[STREAM_NAME_LEN];
     GstClockTime current_timestamp;
     GstClockTime last_heartbeat;
-} EncoderStreamState;
+} __attribute__ ((aligned (CACHE_LINE_SIZE))) EncoderStreamState;
+
+typedef enum {
+    ENCODER_EVENT_SEGMENT = 1, /* value is the duration of the segment */
+    ENCODER_EVENT_EOS = 2,
+    ENCODER_EVENT_ERROR = 3
+} EncoderEventType;
+
+typedef struct _EncoderEvent {
+    guint32 type;
+    guint32 reserved;
+    guint64 value;
+} EncoderEvent;
+
+/*
+ * EncoderEventRing:
+ * single producer (encoder) single consumer (master msg thread) ring in job output share memory,
+ * write index and read index are in different cache lines, the event fd of the job is the doorbell.
+ */
+typedef struct _EncoderEventRing {
+    guint64 write;
+    guint64 dropped; /* events dropped because of ring full */
+    guint64 read __attribute__ ((aligned (CACHE_LINE_SIZE)));
+    EncoderEvent events[ENCODER_EVENT_RING_SIZE] __attribute__ ((aligned (CACHE_LINE_SIZE)));
+} __attribute__ ((aligned (CACHE_LINE_SIZE))) EncoderEventRing;
+
+#define ENCODER_SEM_WAIT_BUCKETS 24 /* bucket i counts waits below 2^i us, last one is longer */
+
+/*
+ * EncoderOutputStats:
+ * in job output share memory, written by encoder under the job semaphore except dropped and
+ * msg_failures which are atomic, read by master without the semaphore.
+ */
+typedef struct _EncoderOutputStats {
+    guint64 samples; /* samples written into cache */
+    guint64 bytes;
+    guint64 gops; /* gops opened */
+    guint64 gops_evicted; /* gops moved out of cache by head */
+    guint64 dropped; /* samples dropped on semaphore timeout */
+    guint64 msg_failures; /* events dropped on ring full or doorbell failure */
+    guint64 cache_fill; /* bytes between head and tail */
+    guint64 head_timestamp; /* timestamp of the oldest gop in cache, us */
+    guint64 sem_wait[ENCODER_SEM_WAIT_BUCKETS]; /* semaphore wait time histogram */
+    MetricsHistogram encode_latency; /* source ingest to random access point opened in cache */
+} __attribute__ ((aligned (CACHE_LINE_SIZE))) EncoderOutputStats;
 
 typedef struct _EncoderOutput {
     gchar name[STREAM_NAME_LEN];
@@ -35,6 +94,10 @@ typedef struct _EncoderOutput {
     guint64 *last_rap_addr; /* last random access point address */
     gint64 stream_count;
     EncoderStreamState *streams;
+    gchar **stream_names;
+    EncoderEventRing *events;
+    gint event_fd; /* doorbell of events, eventfd of the job */
+    EncoderOutputStats *stats;
 
     /* m3u8 streaming */
     M3U8Playlist *m3u8_playlist;
@@ -46,8 +109,20 @@ typedef struct _EncoderOutput {
     /* timeshift and dvr */
     gchar *record_path;
     guint64 dvr_duration;
+
+    /* http streaming counters of master, not in share memory */
+    guint64 bytes_sent;
+    gint viewers; /* http progressive play clients */
+    MetricsHistogram ring_dwell; /* gop opened in cache to its first byte sent */
+    MetricsHistogram first_byte; /* source ingest to first byte of gop sent */
 } EncoderOutput;
 
+/* pts of a buffer of segment reference stream and when it left source appsink */
+typedef struct _EncoderIngestStamp {
+    GstClockTime pts;
+    gint64 ingest_time; /* wall clock, us */
+} EncoderIngestStamp;
+
 typedef struct _EncoderStream {
     gchar *name;
     gboolean is_segment_reference;
@@ -87,11 +162,13 @@ struct _Encoder {
     gboolean has_tssegment;
     gboolean has_m3u8_output;
     gboolean is_first_key;
-    struct sockaddr_un msg_sock_addr;
-    gint msg_sock;
     GstClockTime last_video_buffer_pts;
     GstClockTime last_running_time;
     GstClockTime last_segment_duration;
+
+    /* latency tracing, written by appsrc of segment reference stream, read by appsink */
+    EncoderIngestStamp ingest_stamps[ENCODER_INGEST_STAMPS];
+    guint64 ingest_stamps_count;
 };
 
 struct _EncoderClass {
@@ -108,10 +185,17 @@ struct _EncoderClass {
 
 GType encoder_get_type (void);
 
-guint encoder_initialize (GArray *earray, gchar *job, EncoderOutput *encoders, Source *source);
+guint encoder_initialize (GArray *earray, JobDesc *jobdesc, EncoderOutput *encoders, Source *source);
+void encoder_stream_push (EncoderStream *stream, RingBuffer *ring_buffer, GstBuffer *buffer);
+void encoder_output_write (Encoder *encoder, GstBuffer *buffer, gboolean rap);
 gboolean is_encoder_output_ready (EncoderOutput *encoder_output);
 GstClockTime encoder_output_rap_timestamp (EncoderOutput *encoder_output, guint64 rap_addr);
+void encoder_output_rap_trace (EncoderOutput *encoder_output, guint64 rap_addr, gint64 *ingest_time, gint64 *open_time);
+guint64 encoder_output_rap_next (EncoderOutput *encoder_output, guint64 rap_addr);
 guint64 encoder_output_gop_seek (EncoderOutput *encoder_output, GstClockTime timestamp);
 guint64 encoder_output_gop_size (EncoderOutput *encoder_output, guint64 rap_addr);
+gboolean encoder_output_continue (EncoderOutput *encoder_output);
+void encoder_output_post_event (EncoderOutput *encoder_output, guint32 type, guint64 value);
+gboolean encoder_output_pop_event (EncoderOutput *encoder_output, EncoderEvent *event);
 
 #endif /* __ENCODER_H__ */
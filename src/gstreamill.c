@@ -9,10 +9,11 @@
 #include <string.h>
 #include <glob.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/wait.h>
-#include <sys/socket.h>
-#include <sys/un.h>
+#include <sys/resource.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 
@@ -21,10 +22,15 @@
 #include "parson.h"
 #include "jobdesc.h"
 #include "m3u8playlist.h"
+#include "zygote.h"
 
 GST_DEBUG_CATEGORY_EXTERN (GSTREAMILL);
 #define GST_CAT_DEFAULT GSTREAMILL
 
+/* pids of job workers with a child watch, not orphans */
+static GMutex workers_mutex;
+static GHashTable *workers = NULL;
+
 enum {
     GSTREAMILL_PROP_0,
     GSTREAMILL_PROP_LOGDIR,
@@ -93,6 +99,9 @@ static void gstreamill_init (Gstreamill *gstreamill)
     GstDateTime *start_time;
 
     gstreamill->stop = FALSE;
+    gstreamill->zygote = FALSE;
+    gstreamill->zombies = g_hash_table_new (NULL, NULL);
+    workers = g_hash_table_new (NULL, NULL);
     gstreamill->system_clock = gst_system_clock_obtain ();
     g_object_set (gstreamill->system_clock, "clock-type", GST_CLOCK_TYPE_REALTIME, NULL);
     start_time = gst_date_time_new_now_local_time ();
@@ -101,6 +110,14 @@ static void gstreamill_init (Gstreamill *gstreamill)
     gstreamill->last_dvr_clean_time = g_get_real_time ();
     g_mutex_init (&(gstreamill->job_list_mutex));
     gstreamill->job_list = NULL;
+    g_rw_lock_init (&(gstreamill->job_table_lock));
+    gstreamill->job_table = g_hash_table_new (g_str_hash, g_str_equal);
+
+    gstreamill->event_epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+    if (gstreamill->event_epoll_fd == -1) {
+        GST_ERROR ("epoll_create error %s", g_strerror (errno));
+        exit (22);
+    }
 
     g_mutex_init (&(gstreamill->record_queue_mutex));
     g_cond_init (&(gstreamill->record_queue_cond));
@@ -221,6 +238,8 @@ static void gstreamill_finalize (GObject *obj)
     GObjectClass *parent_class = g_type_class_peek (G_TYPE_OBJECT);
 
     g_slist_free (gstreamill->job_list);
+    g_hash_table_destroy (gstreamill->job_table);
+    g_rw_lock_clear (&(gstreamill->job_table_lock));
 
     G_OBJECT_CLASS (parent_class)->finalize (obj);
 }
@@ -267,10 +286,10 @@ static void rotate_log (Gstreamill *gstreamill, gchar *log_path, pid_t pid)
         GST_DEBUG ("log rotate %s, process pid %d.", log_path, pid);
 
         if (g_strcmp0 (log_path, gstreamill->log->log_path) == 0) {
-            gstreamill->log->log_hd = freopen (gstreamill->log->log_path, "w", gstreamill->log->log_hd);
+            log_reopen (gstreamill->log, LOG_TARGET_LOG);
 
         } else if (g_strcmp0 (log_path, gstreamill->log->access_path) == 0) {
-            gstreamill->log->access_hd = freopen (gstreamill->log->access_path, "w", gstreamill->log->access_hd);
+            log_reopen (gstreamill->log, LOG_TARGET_ACCESS);
 
         } else {
             kill (pid, SIGUSR1); /* reopen job's log file. */
@@ -314,6 +333,42 @@ static void log_rotate (Gstreamill *gstreamill)
     }
 }
 
+static void job_event_watch (Gstreamill *gstreamill, Job *job)
+{
+    struct epoll_event event;
+
+    event.data.ptr = job;
+    event.events = EPOLLIN;
+    if (epoll_ctl (gstreamill->event_epoll_fd, EPOLL_CTL_ADD, job->event_fd, &event) == -1) {
+        GST_ERROR ("epoll_ctl add job %s event fd error %s", job->name, g_strerror (errno));
+    }
+}
+
+static void job_event_unwatch (Gstreamill *gstreamill, Job *job)
+{
+    if (epoll_ctl (gstreamill->event_epoll_fd, EPOLL_CTL_DEL, job->event_fd, NULL) == -1) {
+        GST_ERROR ("epoll_ctl del job %s event fd error %s", job->name, g_strerror (errno));
+    }
+}
+
+/* add job to job list and job table, job_list_mutex should be held */
+static void job_list_add (Gstreamill *gstreamill, Job *job)
+{
+    gstreamill->job_list = g_slist_append (gstreamill->job_list, job);
+    g_rw_lock_writer_lock (&(gstreamill->job_table_lock));
+    g_hash_table_insert (gstreamill->job_table, job->name, job);
+    g_rw_lock_writer_unlock (&(gstreamill->job_table_lock));
+}
+
+/* remove job from job list and job table, job_list_mutex should be held */
+static void job_list_remove (Gstreamill *gstreamill, Job *job)
+{
+    gstreamill->job_list = g_slist_remove (gstreamill->job_list, job);
+    g_rw_lock_writer_lock (&(gstreamill->job_table_lock));
+    g_hash_table_remove (gstreamill->job_table, job->name);
+    g_rw_lock_writer_unlock (&(gstreamill->job_table_lock));
+}
+
 static void clean_job_list (Gstreamill *gstreamill)
 {
     gboolean done;
@@ -346,7 +401,8 @@ static void clean_job_list (Gstreamill *gstreamill)
             /* clean live job */
             if (job->is_live && (*(job->output->state) == JOB_STATE_STOPED)) {
                 GST_WARNING ("Remove live job: %s access: %d.", job->name, job->current_access);
-                gstreamill->job_list = g_slist_remove (gstreamill->job_list, job);
+                job_list_remove (gstreamill, job);
+                job_event_unwatch (gstreamill, job);
                 g_object_unref (job);
                 break;
             }
@@ -354,7 +410,8 @@ static void clean_job_list (Gstreamill *gstreamill)
             /* clean non live job */
             if (!job->is_live && job->eos) {
                 GST_WARNING ("Remove non-live job: %s.", job->name);
-                gstreamill->job_list = g_slist_remove (gstreamill->job_list, job);
+                job_list_remove (gstreamill, job);
+                job_event_unwatch (gstreamill, job);
                 g_object_unref (job);
                 break;
             }
@@ -378,15 +435,15 @@ static void source_check (Gstreamill *gstreamill, Job *job)
     /* log source timestamp. */
     for (i = 0; i < job->output->source.stream_count; i++) {
         GST_DEBUG ("%s timestamp %" GST_TIME_FORMAT,
-                job->output->source.streams[i].name,
+                job->output->source.stream_names[i],
                 GST_TIME_ARGS (job->output->source.streams[i].current_timestamp));
     }
 
     /* source heartbeat check */
     for (i = 0; i < job->output->source.stream_count; i++) {
         /* check video and audio */
-        if (!g_str_has_prefix (job->output->source.streams[i].name, "video") &&
-                !g_str_has_prefix (job->output->source.streams[i].name, "audio")) {
+        if (!g_str_has_prefix (job->output->source.stream_names[i], "video") &&
+                !g_str_has_prefix (job->output->source.stream_names[i], "audio")) {
             continue;
         }
 
@@ -396,7 +453,7 @@ static void source_check (Gstreamill *gstreamill, Job *job)
                 ((time_diff > NONLIVE_HEARTBEAT_THRESHHOLD) && (gstreamill->mode != SINGLE_JOB_MODE) && !job->is_live)) {
             GST_WARNING ("Job %s's %s heart beat error %lu, restart it.",
                     job->name,
-                    job->output->source.streams[i].name,
+                    job->output->source.stream_names[i],
                     time_diff);
             /* restart job. */
             job_stop (job, SIGKILL);
@@ -404,7 +461,7 @@ static void source_check (Gstreamill *gstreamill, Job *job)
 
         } else {
             GST_DEBUG ("%s heartbeat %" GST_TIME_FORMAT,
-                    job->output->source.streams[i].name,
+                    job->output->source.stream_names[i],
                     GST_TIME_ARGS (job->output->source.streams[i].last_heartbeat));
         }
     }
@@ -421,7 +478,7 @@ static void encoders_check (Gstreamill *gstreamill, Job *job)
         for (k = 0; k < job->output->encoders[j].stream_count; k++) {
             GST_DEBUG ("%s.%s timestamp %" GST_TIME_FORMAT,
                     job->output->encoders[j].name,
-                    job->output->encoders[j].streams[k].name,
+                    job->output->encoders[j].stream_names[k],
                     GST_TIME_ARGS (job->output->encoders[j].streams[k].current_timestamp));
         }
     }
@@ -434,8 +491,8 @@ static void encoders_check (Gstreamill *gstreamill, Job *job)
     /* encoder heartbeat check */
     for (j = 0; j < job->output->encoder_count; j++) {
         for (k = 0; k < job->output->encoders[j].stream_count; k++) {
-            if (!g_str_has_prefix (job->output->encoders[j].streams[k].name, "video") &&
-                    !g_str_has_prefix (job->output->encoders[j].streams[k].name, "audio")) {
+            if (!g_str_has_prefix (job->output->encoders[j].stream_names[k], "video") &&
+                    !g_str_has_prefix (job->output->encoders[j].stream_names[k], "audio")) {
                 continue;
             }
 
@@ -444,7 +501,7 @@ static void encoders_check (Gstreamill *gstreamill, Job *job)
             if ((time_diff > HEARTBEAT_THRESHHOLD) && (gstreamill->mode != SINGLE_JOB_MODE)) {
                 GST_WARNING ("%s.%s heartbeat error %lu, restart",
                         job->output->encoders[j].name,
-                        job->output->encoders[j].streams[k].name,
+                        job->output->encoders[j].stream_names[k],
                         time_diff);
                 /* restart job. */
                 job_stop (job, SIGKILL);
@@ -453,7 +510,7 @@ static void encoders_check (Gstreamill *gstreamill, Job *job)
             } else {
                 GST_DEBUG ("%s.%s heartbeat %" GST_TIME_FORMAT,
                         job->output->encoders[j].name,
-                        job->output->encoders[j].streams[k].name,
+                        job->output->encoders[j].stream_names[k],
                         GST_TIME_ARGS (job->output->encoders[j].streams[k].last_heartbeat));
             }
         }
@@ -488,8 +545,8 @@ static void sync_check (Gstreamill *gstreamill, Job *job)
     min = GST_CLOCK_TIME_NONE;
     max = 0;
     for (j = 0; j < job->output->source.stream_count; j++) {
-        if (!g_str_has_prefix (job->output->source.streams[j].name, "video") &&
-                !g_str_has_prefix (job->output->source.streams[j].name, "audio")) {
+        if (!g_str_has_prefix (job->output->source.stream_names[j], "video") &&
+                !g_str_has_prefix (job->output->source.stream_names[j], "audio")) {
             continue;
         }
 
@@ -517,6 +574,35 @@ static void sync_check (Gstreamill *gstreamill, Job *job)
     }
 }
 
+/*
+ * output counters and cpu time of a non live job run to end in foreground, one line per item,
+ * parsed by test/pipelinebench.py.
+ */
+static void single_job_summary (Job *job)
+{
+    EncoderOutputStats *stats;
+    struct rusage usage;
+    gint i;
+
+    for (i = 0; i < job->output->encoder_count; i++) {
+        stats = job->output->encoders[i].stats;
+        GST_INFO ("encoder %d samples %" G_GUINT64_FORMAT " bytes %" G_GUINT64_FORMAT
+                " gops %" G_GUINT64_FORMAT " dropped %" G_GUINT64_FORMAT,
+                i,
+                (guint64)__atomic_load_n (&(stats->samples), __ATOMIC_RELAXED),
+                (guint64)__atomic_load_n (&(stats->bytes), __ATOMIC_RELAXED),
+                (guint64)__atomic_load_n (&(stats->gops), __ATOMIC_RELAXED),
+                (guint64)__atomic_load_n (&(stats->dropped), __ATOMIC_RELAXED));
+    }
+    if (getrusage (RUSAGE_SELF, &usage) == 0) {
+        GST_INFO ("cpu user %ld.%06ld system %ld.%06ld",
+                usage.ru_utime.tv_sec, usage.ru_utime.tv_usec,
+                usage.ru_stime.tv_sec, usage.ru_stime.tv_usec);
+    }
+}
+
+static guint64 create_job_process (Job *job);
+
 static void job_check_func (gpointer data, gpointer user_data)
 {
     Job *job = (Job *)data;
@@ -543,6 +629,18 @@ static void job_check_func (gpointer data, gpointer user_data)
         return;
     }
 
+    /* restart of live job failed without a worker, no child watch would restart it again. */
+    if ((gstreamill->mode != SINGLE_JOB_MODE) && job->is_live && (job->worker_pid == 0) && !job->stoping &&
+            (*(job->output->state) == JOB_STATE_START_FAILURE)) {
+        GST_WARNING ("Job %s has no worker, restart it", job->name);
+        job_reset (job);
+        if (create_job_process (job) == JOB_STATE_PLAYING) {
+            GST_WARNING ("Restart job %s success", job->name);
+        }
+        g_mutex_unlock (&(job->access_mutex));
+        return;
+    }
+
     /* stat report. */
     if ((gstreamill->mode != SINGLE_JOB_MODE) && (job->worker_pid != 0)) {
         if (job_stat_update (job) != 0) {
@@ -597,7 +695,7 @@ static void job_check_func (gpointer data, gpointer user_data)
                 gchar *location, *property, *playlist1, *playlist2;
 
                 property = g_strdup_printf ("encoder.%d.elements.hlssink.property.playlist-location", i);
-                location = jobdesc_element_property_value (job->description, property);
+                location = jobdesc_element_property_value (job->jobdesc, property);
                 g_free (property);
                 if (location != NULL) {
                     g_file_get_contents (location, &playlist1, NULL, NULL);
@@ -698,6 +796,79 @@ static void dvr_clean (Gstreamill *gstreamill)
     gstreamill->last_dvr_clean_time = now;
 }
 
+static gboolean child_is_zombie (GPid pid)
+{
+    gchar *path, *stat, *p;
+    gboolean zombie;
+
+    path = g_strdup_printf ("/proc/%d/stat", pid);
+    zombie = FALSE;
+    if (g_file_get_contents (path, &stat, NULL, NULL)) {
+        /* pid (comm) state ..., comm may contain spaces and parentheses */
+        p = strrchr (stat, ')');
+        zombie = (p != NULL) && (p[1] == ' ') && (p[2] == 'Z');
+        g_free (stat);
+    }
+    g_free (path);
+
+    return zombie;
+}
+
+/*
+ * gstreamill is subreaper of job workers forked by zygote, processes left by a dead worker are
+ * reparented to gstreamill and nobody waits for them. Reap children which are neither job workers
+ * nor zygote once they have been zombies for a monitor period, g_spawn_sync reaps its own child in time.
+ */
+static void reap_orphans (Gstreamill *gstreamill)
+{
+    GDir *dir;
+    const gchar *task;
+    gchar *path, *children, **pids;
+    GHashTable *zombies;
+    GPid pid, zygote;
+    gboolean known;
+    gint i, status;
+
+    dir = g_dir_open ("/proc/self/task", 0, NULL);
+    if (dir == NULL) {
+        return;
+    }
+    zombies = g_hash_table_new (NULL, NULL);
+    zygote = zygote_get_pid ();
+    while ((task = g_dir_read_name (dir)) != NULL) {
+        path = g_strdup_printf ("/proc/self/task/%s/children", task);
+        if (!g_file_get_contents (path, &children, NULL, NULL)) {
+            g_free (path);
+            continue;
+        }
+        g_free (path);
+        pids = g_strsplit (g_strstrip (children), " ", 0);
+        g_free (children);
+        for (i = 0; pids[i] != NULL; i++) {
+            pid = atoi (pids[i]);
+            if ((pid <= 0) || (pid == zygote) || !child_is_zombie (pid)) {
+                continue;
+            }
+            g_mutex_lock (&workers_mutex);
+            known = g_hash_table_contains (workers, GINT_TO_POINTER (pid));
+            g_mutex_unlock (&workers_mutex);
+            if (known) {
+                continue;
+            }
+            if (!g_hash_table_contains (gstreamill->zombies, GINT_TO_POINTER (pid))) {
+                g_hash_table_add (zombies, GINT_TO_POINTER (pid));
+
+            } else if (waitpid (pid, &status, WNOHANG) == pid) {
+                GST_WARNING ("reap orphan process %d, status %d", pid, status);
+            }
+        }
+        g_strfreev (pids);
+    }
+    g_dir_close (dir);
+    g_hash_table_unref (gstreamill->zombies);
+    gstreamill->zombies = zombies;
+}
+
 static gboolean gstreamill_monitor (GstClock *clock, GstClockTime time, GstClockID id, gpointer user_data)
 {
     GstClockID nextid;
@@ -705,6 +876,7 @@ static gboolean gstreamill_monitor (GstClock *clock, GstClockTime time, GstClock
     GstClockTime now;
     Gstreamill *gstreamill;
     GSList *list;
+    Job *eos_job;
 
     gstreamill = (Gstreamill *)user_data;
 
@@ -725,11 +897,11 @@ static gboolean gstreamill_monitor (GstClock *clock, GstClockTime time, GstClock
 
         datetime = g_date_time_new_now_local ();
         date = g_date_time_format (datetime, "%b %d %H:%M:%S");
-        fprintf (gstreamill->log->log_hd, "\n*** %s : gstreamill stoped ***\n\n", date);
-        fflush (gstreamill->log->log_hd);
-        fflush (gstreamill->log->access_hd);
+        GST_WARNING ("\n*** %s : gstreamill stoped ***\n", date);
         g_free (date);
         g_date_time_unref (datetime);
+        g_mutex_unlock (&(gstreamill->job_list_mutex));
+        log_flush (gstreamill->log);
         g_usleep (500000);
         exit (0);
     }
@@ -742,6 +914,21 @@ static gboolean gstreamill_monitor (GstClock *clock, GstClockTime time, GstClock
         g_slist_foreach (list, job_check_func, gstreamill);
     }
 
+    /* late workers of zygote and orphans inherited as subreaper */
+    if (gstreamill->zygote) {
+        zygote_check ();
+        reap_orphans (gstreamill);
+    }
+
+    /* non live job of single job mode runs in gstreamill process, nothing left to do at eos */
+    eos_job = NULL;
+    if ((gstreamill->mode == SINGLE_JOB_MODE) && (gstreamill->job_list != NULL)) {
+        eos_job = (Job *)gstreamill->job_list->data;
+        if (!eos_job->eos) {
+            eos_job = NULL;
+        }
+    }
+
     /* log rotate. */
     if ((gstreamill->mode == DAEMON_MODE) || (gstreamill->mode == DEBUG_MODE)) {
         log_rotate (gstreamill);
@@ -750,6 +937,12 @@ static gboolean gstreamill_monitor (GstClock *clock, GstClockTime time, GstClock
 
     g_mutex_unlock (&(gstreamill->job_list_mutex));
 
+    if (eos_job != NULL) {
+        GST_WARNING ("non live job %s eos, exit", eos_job->name);
+        single_job_summary (eos_job);
+        exit (0);
+    }
+
     /* register streamill monitor */
     now = gst_clock_get_time (gstreamill->system_clock);
     nextid = gst_clock_new_single_shot_id (gstreamill->system_clock, now + 2000 * GST_MSECOND);
@@ -783,7 +976,7 @@ static gchar *segment_dir (EncoderOutput *encoder_output)
     return seg_path;
 }
 
-static void write_segment (RecordData *record_data)
+static void write_segment (Gstreamill *gstreamill, RecordData *record_data)
 {
     gchar *path;
     GError *err = NULL;
@@ -791,6 +984,7 @@ static void write_segment (RecordData *record_data)
     if (!g_file_test (record_data->dir, G_FILE_TEST_EXISTS)) {
         if (g_mkdir_with_parents (record_data->dir, 0755) != 0) {
             GST_ERROR ("Create record directory failure: %s", record_data->dir);
+            metrics_counter_add (&(gstreamill->metrics.dvr_write_errors), 1);
             free_record_data (record_data);
             return;
         }
@@ -800,11 +994,13 @@ static void write_segment (RecordData *record_data)
     if (!g_file_set_contents (path, record_data->buf, record_data->segment_size, &err)) {
         GST_ERROR ("write segment %s failure: %s", path, err->message);
         g_error_free (err);
+        metrics_counter_add (&(gstreamill->metrics.dvr_write_errors), 1);
 
     } else {
         GST_INFO ("write segment %s success", path);
     }
     g_free (path);
+    metrics_histogram_observe (&(gstreamill->metrics.dvr_write_latency), g_get_monotonic_time () - record_data->queued_time);
 
     free_record_data (record_data);
 }
@@ -822,7 +1018,7 @@ static gpointer record_thread (gpointer data)
             }
             record_data = (RecordData *)g_queue_pop_tail (gstreamill->record_queue);
             g_mutex_unlock (&(gstreamill->record_queue_mutex));
-            write_segment (record_data);
+            write_segment (gstreamill, record_data);
             g_mutex_lock (&(gstreamill->record_queue_mutex));
         }
         g_cond_wait (&(gstreamill->record_queue_cond), &(gstreamill->record_queue_mutex));
@@ -855,15 +1051,15 @@ static void dvr_record_segment (Gstreamill *gstreamill, EncoderOutput *encoder_o
     buf = g_malloc (segment_size);
 
     /* copy segment to buf */
-    if (rap_addr + segment_size + 12 < encoder_output->cache_size) {
-        memcpy (buf, encoder_output->cache_addr + rap_addr + 12, segment_size);
+    if (rap_addr + segment_size + ENCODER_GOP_HEADER_SIZE < encoder_output->cache_size) {
+        memcpy (buf, encoder_output->cache_addr + rap_addr + ENCODER_GOP_HEADER_SIZE, segment_size);
 
     } else {
         gint n;
 
-        n = encoder_output->cache_size - rap_addr - 12;
+        n = encoder_output->cache_size - rap_addr - ENCODER_GOP_HEADER_SIZE;
         if (n > 0) {
-            memcpy (buf, encoder_output->cache_addr + rap_addr + 12, n);
+            memcpy (buf, encoder_output->cache_addr + rap_addr + ENCODER_GOP_HEADER_SIZE, n);
             memcpy (buf + n, encoder_output->cache_addr, segment_size - n);
 
         } else {
@@ -898,149 +1094,118 @@ static void dvr_record_segment (Gstreamill *gstreamill, EncoderOutput *encoder_o
             ((encoder_output->last_timestamp + 500000) * 1000) / encoder_output->segment_duration);
     record_data->buf = buf;
     record_data->segment_size = segment_size;
+    record_data->queued_time = g_get_monotonic_time ();
     g_mutex_lock (&(gstreamill->record_queue_mutex));
     g_queue_push_head (gstreamill->record_queue, record_data);
     g_cond_signal (&(gstreamill->record_queue_cond));
     g_mutex_unlock (&(gstreamill->record_queue_mutex));
 }
 
-static gint get_encoder_index (gchar *uri)
+/* job of event, NULL if it has been removed from job list */
+static Job * get_event_job (Gstreamill *gstreamill, gpointer ptr)
 {
-    guint index;
-    GRegex *regex = NULL;
-    GMatchInfo *match_info = NULL;
-    gchar *e;
+    Job *job;
 
-    index = -1;
-    regex = g_regex_new ("^/.*/encoder/(?<encoder>[0-9]+).*", G_REGEX_OPTIMIZE, 0, NULL);
-    g_regex_match (regex, uri, 0, &match_info);
-    if (g_match_info_matches (match_info)) {
-        e = g_match_info_fetch_named (match_info, "encoder");
-        index = g_ascii_strtoll (e, NULL, 10);
-        g_free (e);
+    g_mutex_lock (&(gstreamill->job_list_mutex));
+    job = g_slist_find (gstreamill->job_list, ptr) != NULL ? g_object_ref (ptr) : NULL;
+    g_mutex_unlock (&(gstreamill->job_list_mutex));
+
+    return job;
+}
+
+static void segment_event_process (Gstreamill *gstreamill, Job *job, EncoderOutput *encoder_output, GstClockTime duration)
+{
+    gchar *seg_dir, *seg_path;
+    struct timespec ts;
+
+    if (*(job->output->state) != JOB_STATE_PLAYING) {
+        GST_WARNING ("FATAL: Job %s state is not playing", job->name);
+        return;
     }
 
-    return index; 
+    if (clock_gettime (CLOCK_REALTIME, &ts) == -1) {
+        GST_ERROR ("dvr_record_segment clock_gettime error: %s", g_strerror (errno));
+        return;
+    }
+    ts.tv_sec += 2;
+    while (sem_timedwait (encoder_output->semaphore, &ts) == -1) {
+        if (errno == EINTR) {
+            continue;
+        }
+        GST_ERROR ("dvr_record_segment sem_timedwait failure: %s", g_strerror (errno));
+        return;
+    }
+    /* last_timestamp==0 means it's first segment */
+    if (encoder_output->last_timestamp != 0) {
+        seg_dir = segment_dir (encoder_output);
+        seg_path = g_strdup_printf ("%s/%lu.ts",
+                seg_dir,
+                (encoder_output->last_timestamp * 1000) / encoder_output->segment_duration);
+        m3u8playlist_add_entry (encoder_output->m3u8_playlist, seg_path, duration);
+        g_free (seg_path);
+        if (encoder_output->dvr_duration != 0) {
+            dvr_record_segment (gstreamill, encoder_output, seg_dir, duration);
+        }
+        g_free (seg_dir);
+    }
+    encoder_output->last_timestamp = encoder_output_rap_timestamp (encoder_output, *(encoder_output->last_rap_addr));
+    sem_post (encoder_output->semaphore);
 }
 
 static gpointer msg_thread (gpointer data)
 {
     Gstreamill *gstreamill = (Gstreamill *)data;
     Job *job;
-    struct sockaddr_un msg_sock_addr;
-    gint msg_sock, epoll_fd, n, index;
-    struct epoll_event event, event_list[32];
-    gchar msg[1024];
-    ssize_t size;
-
-    unlink (MSG_SOCK_PATH);
-
-    /* unix domain socket */
-    msg_sock = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0);
-    if (msg_sock == -1) {
-        GST_ERROR ("msg_sock socket error: %s", g_strerror (errno));
-        exit (20);
-    }
-    memset (&msg_sock_addr, 0, sizeof (struct sockaddr_un));
-    msg_sock_addr.sun_family = AF_UNIX;
-    strncpy (msg_sock_addr.sun_path, MSG_SOCK_PATH, sizeof (msg_sock_addr.sun_path) - 1);
-    if (bind (msg_sock, (struct sockaddr *)&msg_sock_addr, sizeof (struct sockaddr_un)) == -1) {
-        GST_ERROR ("msg_thread bind error: %s", g_strerror (errno));
-        exit (21);
-    }
-
-    /* epoll */
-    epoll_fd = epoll_create1 (0);
-    if (epoll_fd == -1) {
-        GST_ERROR ("epoll_create error %s", g_strerror (errno));
-        exit (22);
-    }
-    event.data.ptr = NULL;
-    event.events = EPOLLIN | EPOLLET;
-    if (epoll_ctl (epoll_fd, EPOLL_CTL_ADD, msg_sock, &event) == -1) {
-        GST_ERROR ("epoll_ctl add msg_sock error %s", g_strerror (errno));
-        exit (23);
-    }
+    EncoderOutput *encoder_output;
+    EncoderEvent event;
+    struct epoll_event event_list[32];
+    guint64 count;
+    gint n, i, j;
 
-    /* loop waiting msg */
+    /* loop waiting doorbell of jobs */
     for (;;) {
-        gchar uri[128], *seg_dir, *seg_path;
-        EncoderOutput *encoder_output;
-        GstClockTime duration;
-        struct timespec ts;
-
-        n = epoll_wait (epoll_fd, event_list, 32, -1);
+        n = epoll_wait (gstreamill->event_epoll_fd, event_list, 32, -1);
         if (n == -1) {
-            GST_WARNING ("epoll_wait error %s", g_strerror (errno));
+            if (errno != EINTR) {
+                GST_WARNING ("epoll_wait error %s", g_strerror (errno));
+            }
             continue;
         }
-        for (;;) {
-            size = read (msg_sock, msg, 1023/* 1024-1 */);
-            if ((size == -1) && (errno == EAGAIN)) {
-                GST_DEBUG ("msg_trhead read complete");
-                break;
-
-            } else if (size == -1) {
-                GST_ERROR ("msg_thread read error: %s", g_strerror (errno));
-                break;
-            }
-            msg[size] = '\0';
-            sscanf (msg, "%[^:]:%lu$", uri, &duration);
-
-            job = gstreamill_get_job (gstreamill, uri);
+        for (i = 0; i < n; i++) {
+            job = get_event_job (gstreamill, event_list[i].data.ptr);
             if (job == NULL) {
-                GST_WARNING ("Job %s not found.", uri);
                 continue;
             }
-            g_mutex_lock (&(job->access_mutex));
 
-            if (*(job->output->state) != JOB_STATE_PLAYING) {
-                GST_WARNING ("FATAL: Job %s state is not playing", job->name);
-                g_object_unref (job);
-                g_mutex_unlock (&(job->access_mutex));
-                continue;
+            /* clear doorbell before draining, no event is missed */
+            if ((read (job->event_fd, &count, sizeof (count)) == -1) && (errno != EAGAIN)) {
+                GST_ERROR ("read job %s event fd error: %s", job->name, g_strerror (errno));
             }
-
-            index = get_encoder_index (uri);
-            if (index >= job->output->encoder_count) {
-                GST_WARNING ("Encoder %s not found.", uri);
-                g_object_unref (job);
-                g_mutex_unlock (&(job->access_mutex));
-                continue;
-            }
-            encoder_output = &job->output->encoders[index];
-
-            if (clock_gettime (CLOCK_REALTIME, &ts) == -1) {
-                GST_ERROR ("dvr_record_segment clock_gettime error: %s", g_strerror (errno));
-                goto semaphore_failure;
-            }
-            ts.tv_sec += 2;
-            while (sem_timedwait (encoder_output->semaphore, &ts) == -1) {
-                if (errno == EINTR) {
-                    continue;
-                }
-                GST_ERROR ("dvr_record_segment sem_timedwait failure: %s", g_strerror (errno));
-                goto semaphore_failure;
-            }
-            /* last_timestamp==0 means it's first segment */
-            if (encoder_output->last_timestamp != 0) {
-                seg_dir = segment_dir (encoder_output);
-                seg_path = g_strdup_printf ("%s/%lu.ts",
-                        seg_dir,
-                        (encoder_output->last_timestamp * 1000) / encoder_output->segment_duration);
-                m3u8playlist_add_entry (encoder_output->m3u8_playlist, seg_path, duration);
-                g_free (seg_path);
-                if (encoder_output->dvr_duration != 0) {
-                    dvr_record_segment (gstreamill, encoder_output, seg_dir, duration);
+            g_mutex_lock (&(job->access_mutex));
+            for (j = 0; j < job->output->encoder_count; j++) {
+                encoder_output = &(job->output->encoders[j]);
+                while (encoder_output_pop_event (encoder_output, &event)) {
+                    switch (event.type) {
+                        case ENCODER_EVENT_SEGMENT:
+                            segment_event_process (gstreamill, job, encoder_output, event.value);
+                            break;
+
+                        case ENCODER_EVENT_EOS:
+                            GST_WARNING ("Encoder %s end of stream", encoder_output->name);
+                            break;
+
+                        case ENCODER_EVENT_ERROR:
+                            GST_WARNING ("Encoder %s pipeline error", encoder_output->name);
+                            break;
+
+                        default:
+                            GST_WARNING ("Unknown event %u of encoder %s", event.type, encoder_output->name);
+                            break;
+                    }
                 }
-                g_free (seg_dir);
             }
-            encoder_output->last_timestamp = encoder_output_rap_timestamp (encoder_output, *(encoder_output->last_rap_addr));
-            sem_post (encoder_output->semaphore);
-
-semaphore_failure:
-            g_object_unref (job);
             g_mutex_unlock (&(job->access_mutex));
+            g_object_unref (job);
         }
     }
 
@@ -1061,6 +1226,16 @@ gint gstreamill_start (Gstreamill *gstreamill)
     GstClockTime t;
     GstClockReturn ret;
 
+    /* zygote, fork job workers instead of exec */
+    if (gstreamill->mode != SINGLE_JOB_MODE) {
+        if (zygote_start (gstreamill->exe_path) == 0) {
+            gstreamill->zygote = TRUE;
+
+        } else {
+            GST_WARNING ("start zygote failure, job workers would be exec'ed");
+        }
+    }
+
     /* message process thread */
     gstreamill->msg_thread = g_thread_new ("msg_thread", msg_thread, gstreamill);
 
@@ -1100,7 +1275,7 @@ void gstreamill_stop (Gstreamill *gstreamill)
 
     datetime = g_date_time_new_now_local ();
     date = g_date_time_format (datetime, "%b %d %H:%M:%S");
-    fprintf (gstreamill->log->log_hd, "\n*** %s : stoping gstreamill ***\n\n", date);
+    GST_WARNING ("\n*** %s : stoping gstreamill ***\n", date);
     g_free (date);
     g_date_time_unref (datetime);
 
@@ -1137,13 +1312,20 @@ gchar * gstreamill_get_start_time (Gstreamill *gstreamill)
 
 static void child_watch_cb (GPid pid, gint status, Job *job);
 
-static guint64 create_job_process (Job *job)
+/* make event fd inherited by worker, fds are closed on exec before this. */
+static void child_setup (gpointer user_data)
+{
+    Job *job = user_data;
+
+    fcntl (job->event_fd, F_SETFD, 0);
+}
+
+static GPid exec_job_process (Job *job)
 {
     GError *error = NULL;
     gchar *argv[16], *p;
     GPid pid;
     gint i, j;
-    gchar *stat_file, *stat, state;
 
     i = 0;
     argv[i++] = g_strdup (job->exe_path);
@@ -1154,22 +1336,22 @@ static guint64 create_job_process (Job *job)
     argv[i++] = g_strdup ("-q");
     argv[i++] = g_strdup_printf ("%ld", strlen (job->description));
     argv[i++] = g_strdup ("-t");
-    argv[i++] = g_strdup_printf ("%ld", job->output_size);
-    p = jobdesc_get_debug (job->description);
+    argv[i++] = g_strdup_printf ("%" G_GSIZE_FORMAT, job->output_size);
+    if (job->huge_pages) {
+        argv[i++] = g_strdup ("-g");
+    }
+    argv[i++] = g_strdup ("-e");
+    argv[i++] = g_strdup_printf ("%d", job->event_fd);
+    p = jobdesc_get_debug (job->jobdesc);
     if (p != NULL) {
         argv[i++] = g_strdup_printf ("--gst-debug=%s", p);
         g_free (p);
     }
     argv[i++] = NULL;
-    if (!g_spawn_async (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, &error)) {
+    if (!g_spawn_async (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, child_setup, job, &pid, &error)) {
         GST_WARNING ("Start job %s error, reason: %s.", job->name, error->message);
-        for (j = 0; j < i; j++) {
-            if (argv[j] != NULL) {
-                g_free (argv[j]);
-            }
-        }
         g_error_free (error);
-        return JOB_STATE_START_FAILURE;
+        pid = -1;
     }
 
     for (j = 0; j < i; j++) {
@@ -1178,24 +1360,88 @@ static guint64 create_job_process (Job *job)
         }
     }
 
+    return pid;
+}
+
+/* same parameters as exec_job_process, the worker skip exec, gst_init and plugins registration. */
+static GPid fork_job_process (Job *job)
+{
+    ZygoteRequest request;
+    gchar *shm_name, *debug;
+    gsize size;
+
+    memset (&request, 0, sizeof (request));
+    shm_name = unicode_file_name_2_shm_name (job->name);
+    size = g_strlcpy (request.shm_name, shm_name, sizeof (request.shm_name));
+    g_free (shm_name);
+    if (size >= sizeof (request.shm_name)) {
+        return -1;
+    }
+    if (g_strlcpy (request.log_dir, job->log_dir, sizeof (request.log_dir)) >= sizeof (request.log_dir)) {
+        return -1;
+    }
+    debug = jobdesc_get_debug (job->jobdesc);
+    if (debug != NULL) {
+        size = g_strlcpy (request.gst_debug, debug, sizeof (request.gst_debug));
+        g_free (debug);
+        if (size >= sizeof (request.gst_debug)) {
+            return -1;
+        }
+    }
+    request.job_length = strlen (job->description);
+    request.shm_length = job->output_size;
+    request.huge_pages = job->huge_pages;
+
+    return zygote_fork (&request, job->event_fd);
+}
+
+static guint64 create_job_process (Job *job)
+{
+    siginfo_t info;
+    GPid pid;
+
+    /* workers are registered before orphan reaping could see them */
+    g_mutex_lock (&workers_mutex);
+    pid = -1;
+    if (job->zygote) {
+        pid = fork_job_process (job);
+        if (pid == -1) {
+            GST_WARNING ("Fork job %s from zygote failure, exec it.", job->name);
+
+        } else if (pid == 0) {
+            /* the worker may be forked late, never run two workers on one output */
+            GST_ERROR ("Fork job %s from zygote timeout", job->name);
+            g_mutex_unlock (&workers_mutex);
+            *(job->output->state) = JOB_STATE_START_FAILURE;
+            return JOB_STATE_START_FAILURE;
+        }
+    }
+    if (pid == -1) {
+        pid = exec_job_process (job);
+        if (pid == -1) {
+            g_mutex_unlock (&workers_mutex);
+            *(job->output->state) = JOB_STATE_START_FAILURE;
+            return JOB_STATE_START_FAILURE;
+        }
+    }
+    g_hash_table_add (workers, GINT_TO_POINTER (pid));
+    g_mutex_unlock (&workers_mutex);
+
+    /* worker is not reaped before child watch added, WNOWAIT leave it waitable. */
     while ((*(job->output->state) == JOB_STATE_READY) || (*(job->output->state) == JOB_STATE_VOID_PENDING)) {
         GST_DEBUG ("waiting job process creating ... state: %s", job_state_get_name (*(job->output->state)));
-        stat_file = g_strdup_printf ("/proc/%d/stat", pid);
-        if (!g_file_get_contents (stat_file, &stat, NULL, NULL)) {
-            g_free (stat_file);
-            GST_WARNING ("Read job %s's stat failure.", job->name);
+        info.si_pid = 0;
+        if (waitid (P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == -1) {
+            GST_WARNING ("Wait job %s's process failure: %s", job->name, g_strerror (errno));
             *(job->output->state) = JOB_STATE_START_FAILURE;
             break;
         }
-        g_free (stat_file);
-        sscanf (stat, "%*[^ ]%*[ ]%*[^ ]%*[ ]%c", &state);
-        g_free (stat);
-        if (state == 'Z') {
+        if (info.si_pid == pid) {
             GST_WARNING ("Restart job %s failure, process terminated", job->name);
             *(job->output->state) = JOB_STATE_START_FAILURE;
             break;
         }
-        g_usleep (50000);
+        g_usleep (5000);
     }
 
     job->worker_pid = pid;
@@ -1214,17 +1460,25 @@ static void child_watch_cb (GPid pid, gint status, Job *job)
 
     /* Close pid */
     g_spawn_close_pid (pid);
+    g_mutex_lock (&workers_mutex);
+    g_hash_table_remove (workers, GINT_TO_POINTER (pid));
+    g_mutex_unlock (&workers_mutex);
 
     job->age += 1;
     job->worker_pid = 0;
 
-    if ((job->age == 1) && (*(job->output->state) == JOB_STATE_START_FAILURE)) {
+    if ((job->age == 1) && (*(job->output->state) == JOB_STATE_START_FAILURE) &&
+        !(job->is_live && jobdesc_attached (job->jobdesc))) {
         GST_WARNING ("Start job %s failure, don't restart it", job->name);
         g_object_unref (job);
 
     } else if (job->stoping) {
         *(job->output->state) = JOB_STATE_STOPED;
 
+    } else if ((*(job->output->state) == JOB_STATE_START_FAILURE) && job->is_live && jobdesc_attached (job->jobdesc)) {
+        /* ingest is not running, job check restarts it later rather than forking over and over */
+        GST_WARNING ("Start attached job %s failure, restart it later", job->name);
+
     } else if (WIFEXITED (status) && (WEXITSTATUS (status) == 0)) {
         GST_WARNING ("Job %s normaly exit, status is %d", job->name, WEXITSTATUS (status));
         *(job->output->state) = JOB_STATE_STOPED;
@@ -1275,33 +1529,15 @@ static void child_watch_cb (GPid pid, gint status, Job *job)
 static Job * get_job (Gstreamill *gstreamill, gchar *name)
 {
     Job *job;
-    GSList *list;
-
-    g_mutex_lock (&(gstreamill->job_list_mutex));
-    list = gstreamill->job_list;
-    if (list == NULL) {
-        g_mutex_unlock (&(gstreamill->job_list_mutex));
-        return NULL;
-    }
-
-    while (list != NULL) {
-        job = list->data;
-        if (g_strcmp0 (job->name, name) == 0) {
-            break;
-
-        } else {
-            job = NULL;
-        }
-        list = list->next;
-    }
-    g_mutex_unlock (&(gstreamill->job_list_mutex));
 
+    g_rw_lock_reader_lock (&(gstreamill->job_table_lock));
+    job = g_hash_table_lookup (gstreamill->job_table, name);
     if (job != NULL) {
-        return g_object_ref (job);
-
-    } else {
-        return NULL;
+        g_object_ref (job);
     }
+    g_rw_lock_reader_unlock (&(gstreamill->job_table_lock));
+
+    return job;
 }
 
 /**
@@ -1313,15 +1549,18 @@ static Job * get_job (Gstreamill *gstreamill, gchar *name)
 gchar * gstreamill_job_start (Gstreamill *gstreamill, gchar *job_desc)
 {
     gchar *p, *name, *name_hexstr, *semaphore_name;
+    JobDesc *jobdesc;
     Job *job;
 
-    if (!jobdesc_is_valid (job_desc)) {
+    /* parse job description once, owned by job */
+    jobdesc = jobdesc_new (job_desc);
+    if (jobdesc == NULL) {
         GST_ERROR ("invalid job descript: %s", job_desc);
         p = g_strdup_printf ("{\n    \"result\": \"failure\",\n    \"reason\": \"invalid job\"\n}");
         return p;
     }
 
-    if (jobdesc_is_live (job_desc)) {
+    if (jobdesc_is_live (jobdesc)) {
         GST_INFO ("live job arrived:\n%s", job_desc);
 
     } else {
@@ -1329,25 +1568,36 @@ gchar * gstreamill_job_start (Gstreamill *gstreamill, gchar *job_desc)
     }
 
     /* create job object */
-    name = jobdesc_get_name (job_desc);
+    name = jobdesc_get_name (jobdesc);
     job = get_job (gstreamill, name);
     if (job != NULL) {
         GST_WARNING ("start job failure, duplicated name %s.", name);
         p = g_strdup_printf ("{\n    \"result\": \"failure\",\n    \"reason\": \"duplicated name\"\n}");
         g_free (name);
         g_object_unref (job);
+        jobdesc_free (jobdesc);
         return p;
     }
-    job = job_new ("job", job_desc, "name", name, "exe_path", gstreamill->exe_path, NULL);
+    job = job_new ("jobdesc", jobdesc, "name", name, "exe_path", gstreamill->exe_path, NULL);
     g_free (name);
 
     /* job initialize */
     job->log_dir = gstreamill->log_dir;
-    job->is_live = jobdesc_is_live (job_desc);
+    job->zygote = gstreamill->zygote;
+    job->is_live = jobdesc_is_live (jobdesc);
     job->eos = FALSE;
     job->current_access = 0;
     job->age = 0;
     job->last_start_time = NULL;
+    job->huge_pages = FALSE;
+    if (job->is_live && jobdesc_huge_pages (jobdesc)) {
+        if (huge_page_size () != 0) {
+            job->huge_pages = TRUE;
+
+        } else {
+            GST_WARNING ("hugetlbfs not mounted on %s, job %s use normal pages", HUGE_PAGES_PATH, job->name);
+        }
+    }
 
     name_hexstr = unicode_file_name_2_shm_name (job->name);
     semaphore_name = g_strdup_printf ("/%s", name_hexstr);
@@ -1357,6 +1607,14 @@ gchar * gstreamill_job_start (Gstreamill *gstreamill, gchar *job_desc)
     }
     g_free (semaphore_name);
 
+    job->event_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (job->event_fd == -1) {
+        GST_ERROR ("eventfd error: %s", g_strerror (errno));
+        p = g_strdup_printf ("{\n    \"result\": \"failure\",\n    \"reason\": \"create event fd failure\"\n}");
+        g_object_unref (job);
+        return p;
+    }
+
     if (job_initialize (job, gstreamill->mode, -1, NULL) != 0) {
         p = g_strdup_printf ("{\n    \"result\": \"failure\",\n    \"reason\": \"initialize job failure\"\n}");
         g_object_unref (job);
@@ -1378,22 +1636,39 @@ gchar * gstreamill_job_start (Gstreamill *gstreamill, gchar *job_desc)
         if (stat == JOB_STATE_PLAYING) {
             GST_WARNING ("Start job %s success", job->name);
             g_mutex_lock (&(gstreamill->job_list_mutex));
-            gstreamill->job_list = g_slist_append (gstreamill->job_list, job);
+            job_list_add (gstreamill, job);
             g_mutex_unlock (&(gstreamill->job_list_mutex));
+            job_event_watch (gstreamill, job);
+            p = g_strdup_printf ("{\n    \"name\": \"%s\",\n\"result\": \"success\"\n}", job->name);
+
+        } else if (job->is_live && jobdesc_attached (jobdesc)) {
+            /* attached job may start before its ingest, it is restarted by job check until ingest is ready */
+            GST_WARNING ("Start attached job %s failure, return stat: %s, restart it later", job->name, job_state_get_name (stat));
+            g_mutex_lock (&(gstreamill->job_list_mutex));
+            job_list_add (gstreamill, job);
+            g_mutex_unlock (&(gstreamill->job_list_mutex));
+            job_event_watch (gstreamill, job);
             p = g_strdup_printf ("{\n    \"name\": \"%s\",\n\"result\": \"success\"\n}", job->name);
 
         } else {
             GST_WARNING ("Start job %s failure, return stat: %s", job->name, job_state_get_name (stat));
             p = g_strdup_printf ("{\n    \"result\": \"failure\",\n    \"reason\": \"create process failure\"\n}");
         }
-        g_child_watch_add (job->worker_pid, (GChildWatchFunc)child_watch_cb, job);
+        if (job->worker_pid != 0) {
+            g_child_watch_add (job->worker_pid, (GChildWatchFunc)child_watch_cb, job);
+
+        } else if (!(job->is_live && jobdesc_attached (jobdesc))) {
+            /* no worker, no child watch to release the job, an attached job is kept in job list */
+            g_object_unref (job);
+        }
 
     } else {
         job_encoders_output_initialize (job);
         if (job_start (job) == 0) {
             g_mutex_lock (&(gstreamill->job_list_mutex));
-            gstreamill->job_list = g_slist_append (gstreamill->job_list, job);
+            job_list_add (gstreamill, job);
             g_mutex_unlock (&(gstreamill->job_list_mutex));
+            job_event_watch (gstreamill, job);
             p = g_strdup ("{\n    \"result\": \"success\"\n}");
 
         } else {
@@ -1425,6 +1700,90 @@ gchar * gstreamill_job_stop (Gstreamill *gstreamill, gchar *name)
     }
 }
 
+/**
+ * gstreamill_uri_route:
+ * @uri: (in): access uri, e.g. /test/encoder/0/playlist.m3u8
+ * @route: (out): parse result.
+ *
+ * Parse streaming uri without memory allocation.
+ *
+ * Returns: TRUE if there is a job name in the uri.
+ */
+gboolean gstreamill_uri_route (const gchar *uri, URIRoute *route)
+{
+    const gchar *p;
+    gint index;
+
+    route->type = URI_TYPE_UNKNOWN;
+    route->job_name = NULL;
+    route->job_name_len = 0;
+    route->encoder_index = -1;
+
+    if (*uri != '/') {
+        return FALSE;
+    }
+    p = strchr (uri + 1, '/');
+    if ((p == NULL) || (p == uri + 1)) {
+        return FALSE;
+    }
+    route->job_name = uri + 1;
+    route->job_name_len = p - uri - 1;
+    p++;
+
+    if (strcmp (p, "playlist.m3u8") == 0) {
+        route->type = URI_TYPE_MASTER_PLAYLIST;
+        return TRUE;
+    }
+    if ((strncmp (p, "encoder/", 8) != 0) || !g_ascii_isdigit (p[8])) {
+        return TRUE;
+    }
+    p += 8;
+    index = 0;
+    while (g_ascii_isdigit (*p)) {
+        index = index * 10 + (*p - '0');
+        if (index > G_MAXINT16) {
+            return TRUE;
+        }
+        p++;
+    }
+    if (*p == '\0') {
+        route->type = URI_TYPE_ENCODER;
+
+    } else if (strcmp (p, "/playlist.m3u8") == 0) {
+        route->type = URI_TYPE_ENCODER_PLAYLIST;
+
+    } else if (*p == '/') {
+        route->type = URI_TYPE_ENCODER_OTHER;
+
+    } else {
+        return TRUE;
+    }
+    route->encoder_index = index;
+
+    return TRUE;
+}
+
+/**
+ * gstreamill_route_job:
+ * @route: (in): parse result of access uri.
+ *
+ * Get the Job by route, lookup job table without job_list_mutex.
+ *
+ * Returns: job, should be released by g_object_unref or gstreamill_unaccess.
+ */
+Job * gstreamill_route_job (Gstreamill *gstreamill, URIRoute *route)
+{
+    gchar name[256];
+
+    if ((route->job_name == NULL) || (route->job_name_len >= sizeof (name))) {
+        return NULL;
+    }
+    memcpy (name, route->job_name, route->job_name_len);
+    name[route->job_name_len] = '\0';
+
+    return get_job (gstreamill, name);
+}
+
 /**
  * gstreamill_get_job:
  * @uri: (in): access uri, e.g. /test/encoder/0
@@ -1435,28 +1794,13 @@ gchar * gstreamill_job_stop (Gstreamill *gstreamill, gchar *name)
  */
 Job *gstreamill_get_job (Gstreamill *gstreamill, gchar *uri)
 {
-    Job *job = NULL;
-    GRegex *regex;
-    GMatchInfo *match_info;
-    gchar *name = NULL;
+    URIRoute route;
 
-    regex = g_regex_new ("^/(?<name>[^/]*)/.*", G_REGEX_OPTIMIZE, 0, NULL);
-    match_info = NULL;
-    g_regex_match (regex, uri, 0, &match_info);
-    g_regex_unref (regex);
-    if (g_match_info_matches (match_info)) {
-        name = g_match_info_fetch_named (match_info, "name");
-    }
-
-    if (name != NULL) {
-        job = get_job (gstreamill, name);
-        g_free (name);
-    }
-    if (match_info != NULL) {
-        g_match_info_free (match_info);
+    if (!gstreamill_uri_route (uri, &route)) {
+        return NULL;
     }
 
-    return job;
+    return gstreamill_route_job (gstreamill, &route);
 }
 
 gint gstreamill_job_number (Gstreamill *gstreamill)
@@ -1472,56 +1816,24 @@ gint gstreamill_job_number (Gstreamill *gstreamill)
 
 /**
  * gstreamill_get_encoder_output:
- * @uri: (in): access uri, e.g. /test/encoder/0
+ * @job: (in): job handle of the request, from gstreamill_route_job.
+ * @index: (in): encoder index.
  *
- * Get the EncoderOutput by access uri.
+ * Get the EncoderOutput of the job, the access should be released by gstreamill_unaccess.
  *
- * Returns: the encoder output
+ * Returns: the encoder output, NULL if job not playing or no such encoder.
  */
-EncoderOutput * gstreamill_get_encoder_output (Gstreamill *gstreamill, gchar *uri)
+EncoderOutput * gstreamill_get_encoder_output (Gstreamill *gstreamill, Job *job, gint index)
 {
-    Job *job;
-    guint index;
-    GRegex *regex = NULL;
-    GMatchInfo *match_info = NULL;
-    gchar *e;
-
-    index = -1;
-    regex = g_regex_new ("^/.*/encoder/(?<encoder>[0-9]+).*", G_REGEX_OPTIMIZE, 0, NULL);
-    g_regex_match (regex, uri, 0, &match_info);
-    if (g_match_info_matches (match_info)) {
-        e = g_match_info_fetch_named (match_info, "encoder");
-        index = g_ascii_strtoll (e, NULL, 10);
-        g_free (e);
-    }
-    if (match_info != NULL) {
-        g_match_info_free (match_info);
-    }
-    if (regex != NULL) {
-        g_regex_unref (regex);
-    }
-    if (index == -1) {
-        GST_INFO ("Not a encoder uri: %s", uri);
-        return NULL;
-    }
-    job = gstreamill_get_job (gstreamill, uri);
-    if (job == NULL) {
-        GST_WARNING ("Job %s not found.", uri);
-        return NULL;
-    }
     if (*(job->output->state) != JOB_STATE_PLAYING) {
         GST_WARNING ("FATAL: Job %s state is not playing", job->name);
-        g_object_unref (job);
         return NULL;
     }
-    if (index >= job->output->encoder_count) {
-        GST_WARNING ("Encoder %s not found.", uri);
-        g_object_unref (job);
+    if ((index < 0) || (index >= job->output->encoder_count)) {
+        GST_WARNING ("Encoder %d of job %s not found.", index, job->name);
         return NULL;
     }
-    g_mutex_lock (&(job->access_mutex));
-    job->current_access += 1;
-    g_mutex_unlock (&(job->access_mutex));
+    g_atomic_int_inc (&(job->current_access));
 
     return &job->output->encoders[index];
 }
@@ -1537,22 +1849,18 @@ EncoderOutput * gstreamill_get_encoder_output (Gstreamill *gstreamill, gchar *ur
 gchar * gstreamill_get_master_m3u8playlist (Gstreamill *gstreamill, gchar *uri)
 {
     Job *job;
-    gchar *master, *playlist;
+    URIRoute route;
+    gchar *playlist;
 
-    job = gstreamill_get_job (gstreamill, uri);
-    if (job == NULL) {
-        GST_WARNING ("Job %s not found.", uri);
+    if (!gstreamill_uri_route (uri, &route) || (route.type != URI_TYPE_MASTER_PLAYLIST)) {
+        GST_WARNING ("Get master playlist uri error: %s", uri);
         return NULL;
     }
-
-    master = g_strdup_printf ("/%s/playlist.m3u8", job->name);
-    if (g_strcmp0 (master, uri) != 0) {
-        GST_WARNING ("Get master playlist uri error: %s", uri);
-        g_free (master);
-        g_object_unref (job);
+    job = gstreamill_route_job (gstreamill, &route);
+    if (job == NULL) {
+        GST_WARNING ("Job %s not found.", uri);
         return NULL;
     }
-    g_free (master);
     if (job->output->master_m3u8_playlist == NULL) {
         job_render_master_m3u8_playlist (job);
     }
@@ -1564,25 +1872,15 @@ gchar * gstreamill_get_master_m3u8playlist (Gstreamill *gstreamill, gchar *uri)
 
 /**
  * gstreamill_unaccess:
- * @uri: (in): job access uri.
+ * @job: (in): job handle of the request.
  *
- * current_access minus 1.
+ * current_access minus 1 and release the job handle.
  *
  * Returns: none
  */
-void gstreamill_unaccess (Gstreamill *gstreamill, gchar *uri)
+void gstreamill_unaccess (Gstreamill *gstreamill, Job *job)
 {
-    Job *job;
-
-    job = gstreamill_get_job (gstreamill, uri);
-    if (job == NULL) {
-        GST_WARNING ("Job %s not found.", uri);
-        return;
-    }
-    g_mutex_lock (&(job->access_mutex));
-    job->current_access -= 1;
-    g_mutex_unlock (&(job->access_mutex));
-    g_object_unref (job);
+    g_atomic_int_add (&(job->current_access), -1);
     g_object_unref (job);
 
     return;
@@ -1660,14 +1958,83 @@ gchar * gstreamill_list_jobs (Gstreamill *gstreamill)
     return jobarray;
 }
 
+/**
+ * gstreamill_render_metrics:
+ * @gstreamill: (in): the gstreamill.
+ * @out: (in): prometheus text exposition, metrics of gstreamill are appended.
+ *
+ * Request latency, dvr write queue and per encoder output counters.
+ */
+void gstreamill_render_metrics (Gstreamill *gstreamill, GString *out)
+{
+    GSList *jobs, *list;
+    Job *job;
+    EncoderOutput *encoder_output;
+    gchar labels[128];
+    gint i;
+
+    metrics_render_help (out, "gstreamill_http_request_duration_seconds", "histogram", "From accept to response header sent.");
+    for (i = 0; i < METRICS_ROUTE_NUM; i++) {
+        g_snprintf (labels, sizeof (labels), "route=\"%s\"", metrics_route_name (i));
+        metrics_render_histogram (out, "gstreamill_http_request_duration_seconds", labels, &(gstreamill->metrics.request_latency[i]));
+    }
+
+    metrics_render_help (out, "gstreamill_dvr_write_queue_length", "gauge", "Segments waiting to be written to dvr.");
+    g_mutex_lock (&(gstreamill->record_queue_mutex));
+    g_string_append_printf (out, "gstreamill_dvr_write_queue_length %u\n", g_queue_get_length (gstreamill->record_queue));
+    g_mutex_unlock (&(gstreamill->record_queue_mutex));
+    metrics_render_help (out, "gstreamill_dvr_write_duration_seconds", "histogram", "From segment queued to written.");
+    metrics_render_histogram (out, "gstreamill_dvr_write_duration_seconds", "", &(gstreamill->metrics.dvr_write_latency));
+    metrics_render_help (out, "gstreamill_dvr_write_errors_total", "counter", "Segments failed to be written.");
+    g_string_append_printf (out, "gstreamill_dvr_write_errors_total %" G_GUINT64_FORMAT "\n",
+            __atomic_load_n (&(gstreamill->metrics.dvr_write_errors), __ATOMIC_RELAXED));
+
+    metrics_render_help (out, "gstreamill_encoder_sent_bytes_total", "counter", "Bytes sent to http clients.");
+    metrics_render_help (out, "gstreamill_encoder_viewers", "gauge", "Current http progressive play clients.");
+    metrics_render_help (out, "gstreamill_encoder_encode_latency_seconds", "histogram", "From source ingest to gop opened in cache.");
+    metrics_render_help (out, "gstreamill_encoder_ring_dwell_seconds", "histogram", "From gop opened in cache to its first byte sent.");
+    metrics_render_help (out, "gstreamill_encoder_first_byte_latency_seconds", "histogram", "From source ingest to first byte of gop sent.");
+    /* rendering is not under job_list_mutex, jobs are referenced */
+    jobs = NULL;
+    g_mutex_lock (&(gstreamill->job_list_mutex));
+    for (list = gstreamill->job_list; list != NULL; list = list->next) {
+        jobs = g_slist_prepend (jobs, g_object_ref (list->data));
+    }
+    g_mutex_unlock (&(gstreamill->job_list_mutex));
+    jobs = g_slist_reverse (jobs);
+    for (list = jobs; list != NULL; list = list->next) {
+        job = list->data;
+        if (job->output == NULL) {
+            continue;
+        }
+        for (i = 0; i < job->output->encoder_count; i++) {
+            encoder_output = &(job->output->encoders[i]);
+            g_string_append_printf (out, "gstreamill_encoder_sent_bytes_total{job=\"%s\",encoder=\"%d\"} %" G_GUINT64_FORMAT "\n",
+                    job->name,
+                    i,
+                    __atomic_load_n (&(encoder_output->bytes_sent), __ATOMIC_RELAXED));
+            g_string_append_printf (out, "gstreamill_encoder_viewers{job=\"%s\",encoder=\"%d\"} %d\n",
+                    job->name,
+                    i,
+                    g_atomic_int_get (&(encoder_output->viewers)));
+            g_snprintf (labels, sizeof (labels), "job=\"%s\",encoder=\"%d\"", job->name, i);
+            metrics_render_histogram (out, "gstreamill_encoder_encode_latency_seconds", labels, &(encoder_output->stats->encode_latency));
+            metrics_render_histogram (out, "gstreamill_encoder_ring_dwell_seconds", labels, &(encoder_output->ring_dwell));
+            metrics_render_histogram (out, "gstreamill_encoder_first_byte_latency_seconds", labels, &(encoder_output->first_byte));
+        }
+    }
+    g_slist_free_full (jobs, g_object_unref);
+}
+
 static JSON_Value * source_stat (Job *job)
 {
-    JSON_Value *value_source, *value_streams, *value_stream;
-    JSON_Array *array_streams;
-    JSON_Object *object_source, *object_stream;
+    JSON_Value *value_source, *value_streams, *value_stream, *value_ingests, *value_ingest;
+    JSON_Array *array_streams, *array_ingests;
+    JSON_Object *object_source, *object_stream, *object_ingest;
     SourceStreamState *stat;
+    UdpIngestStats *ingest;
     GstDateTime *time;
-    gint i;
+    gint i, j;
     guint64 timestamp;
     gchar *heartbeat;
 
@@ -1692,10 +2059,35 @@ static JSON_Value * source_stat (Job *job)
             timestamp = 0;
             heartbeat = g_strdup ("0");
         }
-        json_object_set_string (object_stream, "name", stat->name);
+        json_object_set_string (object_stream, "name", job->output->source.stream_names[i]);
         json_object_set_number (object_stream, "timestamp", timestamp);
         json_object_set_string (object_stream, "heartbeat", heartbeat);
         g_free (heartbeat);
+        /* udpingest counters of primary and backup input, if fed by udpingest */
+        value_ingests = json_value_init_array ();
+        array_ingests = json_value_get_array (value_ingests);
+        for (j = 0; j < SOURCE_INPUTS; j++) {
+            ingest = &(stat->ingest[j]);
+            if (ingest->packets == 0) {
+                continue;
+            }
+            value_ingest = json_value_init_object ();
+            object_ingest = json_value_get_object (value_ingest);
+            json_object_set_number (object_ingest, "input", j);
+            json_object_set_number (object_ingest, "packets", ingest->packets);
+            json_object_set_number (object_ingest, "bytes", ingest->bytes);
+            json_object_set_number (object_ingest, "cc_errors", ingest->cc_errors);
+            json_object_set_number (object_ingest, "drops", ingest->drops);
+            json_object_set_number (object_ingest, "reordered", ingest->reordered);
+            json_object_set_number (object_ingest, "jitter", ingest->jitter);
+            json_array_append_value (array_ingests, value_ingest);
+        }
+        if (json_array_get_count (array_ingests) > 0) {
+            json_object_set_value (object_stream, "ingest", value_ingests);
+
+        } else {
+            json_value_free (value_ingests);
+        }
         json_array_append_value (array_streams, value_stream);
     }
     json_object_set_value (object_source, "streams", value_streams);
@@ -1703,6 +2095,66 @@ static JSON_Value * source_stat (Job *job)
     return value_source;
 }
 
+/* latency distribution summary, ms */
+static JSON_Value * latency_stat (MetricsHistogram *histogram)
+{
+    JSON_Value *value_latency;
+    JSON_Object *object_latency;
+    guint64 count;
+
+    value_latency = json_value_init_object ();
+    object_latency = json_value_get_object (value_latency);
+    count = __atomic_load_n (&(histogram->count), __ATOMIC_RELAXED);
+    json_object_set_number (object_latency, "count", count);
+    json_object_set_number (object_latency, "mean", count == 0 ? 0 : (gdouble)__atomic_load_n (&(histogram->sum), __ATOMIC_RELAXED) / count / 1000);
+    json_object_set_number (object_latency, "p50", (gdouble)metrics_histogram_quantile (histogram, 0.5) / 1000);
+    json_object_set_number (object_latency, "p99", (gdouble)metrics_histogram_quantile (histogram, 0.99) / 1000);
+
+    return value_latency;
+}
+
+/* counters of encoder output in share memory, read without job semaphore */
+static JSON_Value * encoder_output_stat (EncoderOutput *encoder_output)
+{
+    JSON_Value *value_stats, *value_wait, *value_latency;
+    JSON_Object *object_stats, *object_latency;
+    JSON_Array *array_wait;
+    EncoderOutputStats *stats = encoder_output->stats;
+    guint64 head_timestamp, now;
+    gint i;
+
+    value_stats = json_value_init_object ();
+    object_stats = json_value_get_object (value_stats);
+    json_object_set_number (object_stats, "samples", __atomic_load_n (&(stats->samples), __ATOMIC_RELAXED));
+    json_object_set_number (object_stats, "bytes", __atomic_load_n (&(stats->bytes), __ATOMIC_RELAXED));
+    json_object_set_number (object_stats, "gops", __atomic_load_n (&(stats->gops), __ATOMIC_RELAXED));
+    json_object_set_number (object_stats, "gops_evicted", __atomic_load_n (&(stats->gops_evicted), __ATOMIC_RELAXED));
+    json_object_set_number (object_stats, "dropped", __atomic_load_n (&(stats->dropped), __ATOMIC_RELAXED));
+    json_object_set_number (object_stats, "msg_failures", __atomic_load_n (&(stats->msg_failures), __ATOMIC_RELAXED));
+    json_object_set_number (object_stats, "cache_size", encoder_output->cache_size);
+    json_object_set_number (object_stats, "cache_fill", __atomic_load_n (&(stats->cache_fill), __ATOMIC_RELAXED));
+    /* gop timestamp is realtime in us */
+    head_timestamp = __atomic_load_n (&(stats->head_timestamp), __ATOMIC_RELAXED);
+    now = g_get_real_time ();
+    json_object_set_number (object_stats, "oldest_gop_age", (head_timestamp == 0) || (head_timestamp > now) ? 0 : (now - head_timestamp) / 1000);
+    /* semaphore wait histogram, element i is the count of waits below 2^i us */
+    value_wait = json_value_init_array ();
+    array_wait = json_value_get_array (value_wait);
+    for (i = 0; i < ENCODER_SEM_WAIT_BUCKETS; i++) {
+        json_array_append_number (array_wait, __atomic_load_n (&(stats->sem_wait[i]), __ATOMIC_RELAXED));
+    }
+    json_object_set_value (object_stats, "sem_wait", value_wait);
+    /* latency of gops, encode is traced by encoder, ring dwell and first byte by http streaming of master */
+    value_latency = json_value_init_object ();
+    object_latency = json_value_get_object (value_latency);
+    json_object_set_value (object_latency, "encode", latency_stat (&(stats->encode_latency)));
+    json_object_set_value (object_latency, "ring_dwell", latency_stat (&(encoder_output->ring_dwell)));
+    json_object_set_value (object_latency, "first_byte", latency_stat (&(encoder_output->first_byte)));
+    json_object_set_value (object_stats, "latency", value_latency);
+
+    return value_stats;
+}
+
 static JSON_Value * encoder_stat (EncoderOutput *encoder_output, guint64 jobstate)
 {
     JSON_Value *value_encoder, *value_streams, *value_stream;
@@ -1724,6 +2176,7 @@ static JSON_Value * encoder_stat (EncoderOutput *encoder_output, guint64 jobstat
     g_free (heartbeat);
     json_object_set_number (object_encoder, "count", *(encoder_output->total_count));
     json_object_set_number (object_encoder, "streamcount", encoder_output->stream_count);
+    json_object_set_value (object_encoder, "stats", encoder_output_stat (encoder_output));
     value_streams = json_value_init_array ();
     array_streams = json_value_get_array (value_streams);
     for (i = 0; i < encoder_output->stream_count; i++) {
@@ -1740,7 +2193,7 @@ static JSON_Value * encoder_stat (EncoderOutput *encoder_output, guint64 jobstat
             timestamp = 0;
             heartbeat = g_strdup ("0");
         }
-        json_object_set_string (object_stream, "name", stat->name);
+        json_object_set_string (object_stream, "name", encoder_output->stream_names[i]);
         json_object_set_number (object_stream, "timestamp", timestamp);
         json_object_set_string (object_stream, "heartbeat", heartbeat);
         g_free (heartbeat);
@@ -1799,6 +2252,10 @@ static JSON_Value * encoders_stat (Job *job)
  *             heartbeat:
  *             count:
  *             streamcount:
+ *             stats: {
+ *                 samples, bytes, gops, gops_evicted, dropped, msg_failures,
+ *                 cache_size, cache_fill, oldest_gop_age (ms), sem_wait: [...]
+ *             }
  *             streams: [
  *                 {
  *                     timestamps:
@@ -1887,6 +2344,107 @@ gchar * gstreamill_job_stat (Gstreamill *gstreamill, gchar *uri)
     return result;
 }
 
+static gint element_cost_compare (gconstpointer a, gconstpointer b)
+{
+    const ProfilerElement *ea = *(ProfilerElement * const *)a, *eb = *(ProfilerElement * const *)b;
+
+    return ea->cpu_time < eb->cpu_time ? 1 : (ea->cpu_time > eb->cpu_time ? -1 : 0);
+}
+
+/* per element cost of a profiled job, elements of the highest cpu time first */
+static gchar * job_profile (Gstreamill *gstreamill, gchar *name)
+{
+    JSON_Value *value_profile, *value_elements, *value_element, *value_threads, *value_thread, *value_result;
+    JSON_Array *array_elements, *array_threads;
+    JSON_Object *object_profile, *object_element, *object_thread, *object_result;
+    ProfilerOutput *profiler;
+    ProfilerElement *elements[PROFILER_ELEMENTS], *element;
+    ProfilerThread *thread;
+    gdouble duration;
+    guint count, i;
+    gchar *result;
+    Job *job;
+
+    job = get_job (gstreamill, name);
+    if (job == NULL) {
+        return g_strdup_printf ("{\n    \"result\": \"failure\",\n    \"reason\": \"not found\",\n    \"name\": \"%s\"\n}", name);
+    }
+    profiler = job->output->profiler;
+    if ((*(job->output->state) != JOB_STATE_PLAYING) || (profiler->start_time == 0)) {
+        g_object_unref (job);
+        return g_strdup_printf ("{\n    \"result\": \"failure\",\n    \"reason\": \"not profiled\",\n    \"name\": \"%s\"\n}", name);
+    }
+
+    /* counters are read without job semaphore */
+    duration = (gdouble)(g_get_real_time () - profiler->start_time) / 1000000;
+    if (duration <= 0) {
+        duration = 1;
+    }
+    value_profile = json_value_init_object ();
+    object_profile = json_value_get_object (value_profile);
+    json_object_set_string (object_profile, "name", job->name);
+    json_object_set_number (object_profile, "duration", duration);
+    json_object_set_number (object_profile, "overflow", profiler->overflow);
+    count = __atomic_load_n (&(profiler->elements_count), __ATOMIC_ACQUIRE);
+    for (i = 0; i < count; i++) {
+        elements[i] = &(profiler->elements[i]);
+    }
+    qsort (elements, count, sizeof (ProfilerElement *), element_cost_compare);
+    value_elements = json_value_init_array ();
+    array_elements = json_value_get_array (value_elements);
+    for (i = 0; i < count; i++) {
+        element = elements[i];
+        value_element = json_value_init_object ();
+        object_element = json_value_get_object (value_element);
+        json_object_set_string (object_element, "name", element->name);
+        /* cpu in percent of a core, time in ms */
+        json_object_set_number (object_element, "cpu", (gdouble)element->cpu_time / GST_SECOND / duration * 100);
+        json_object_set_number (object_element, "cpu_time", (gdouble)element->cpu_time / GST_MSECOND);
+        json_object_set_number (object_element, "cpu_per_buffer", element->buffers == 0 ? 0 : (gdouble)element->cpu_time / element->buffers / GST_MSECOND);
+        json_object_set_number (object_element, "buffers", element->buffers);
+        json_object_set_number (object_element, "buffer_rate", element->buffers / duration);
+        json_object_set_number (object_element, "bytes", element->bytes);
+        if (element->is_queue) {
+            json_object_set_number (object_element, "level_buffers", element->level_buffers);
+            json_object_set_number (object_element, "level_time", (gdouble)element->level_time / GST_MSECOND);
+            json_object_set_number (object_element, "max_level_buffers", element->max_level_buffers);
+        }
+        json_array_append_value (array_elements, value_element);
+    }
+    json_object_set_value (object_profile, "elements", value_elements);
+    value_threads = json_value_init_array ();
+    array_threads = json_value_get_array (value_threads);
+    count = __atomic_load_n (&(profiler->threads_count), __ATOMIC_ACQUIRE);
+    for (i = 0; i < count; i++) {
+        thread = &(profiler->threads[i]);
+        value_thread = json_value_init_object ();
+        object_thread = json_value_get_object (value_thread);
+        json_object_set_string (object_thread, "name", thread->name);
+        json_object_set_number (object_thread, "tid", thread->tid);
+        json_object_set_number (object_thread, "cpu", (gdouble)thread->cpu_time / GST_SECOND / duration * 100);
+        json_object_set_number (object_thread, "cpu_time", (gdouble)thread->cpu_time / GST_MSECOND);
+        json_array_append_value (array_threads, value_thread);
+    }
+    json_object_set_value (object_profile, "threads", value_threads);
+    g_object_unref (job);
+
+    value_result = json_value_init_object ();
+    object_result = json_value_get_object (value_result);
+    json_object_set_string (object_result, "result", "success");
+    json_object_set_value (object_result, "data", value_profile);
+    result = json_serialize_to_string (value_result);
+    json_value_free (value_result);
+
+    return result;
+}
+
+/**
+ * gstreamill_gstreamer_stat:
+ * @gstreamill: (in): the gstreamill.
+ * @uri: (in): /stat/gstreamer[/plugin] for gst-inspect, /stat/gstreamer/profile/job_name for per element cost of a job.
+ *
+ * Returns: gst-inspect output, or json of profile.
+ */
 gchar * gstreamill_gstreamer_stat (Gstreamill *gstreamill, gchar *uri)
 {
     gchar *std_out, *cmd;
@@ -1895,7 +2453,10 @@ gchar * gstreamill_gstreamer_stat (Gstreamill *gstreamill, gchar *uri)
 
     cmd = NULL;
     std_out = NULL;
-    if (sscanf (uri, "/stat/gstreamer/%s$", buf) != EOF) {
+    if (sscanf (uri, "/stat/gstreamer/profile/%127[^/]", buf) == 1) {
+        return job_profile (gstreamill, buf);
+
+    } else if (sscanf (uri, "/stat/gstreamer/%s$", buf) != EOF) {
         cmd = g_strdup_printf ("gst-inspect-1.0 %s", buf);
 
     } else if (g_strcmp0 (uri, "/stat/gstreamer") == 0 || g_strcmp0 (uri, "/stat/gstreamer/") == 0) {
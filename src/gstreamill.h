@@ -13,6 +13,7 @@
 #include "config.h"
 #include "job.h"
 #include "log.h"
+#include "metrics.h"
 
 #define SYNC_THRESHHOLD 3000000000 /* 1000ms */
 #define HEARTBEAT_THRESHHOLD 7000000000 /* 7000ms */
@@ -25,15 +26,38 @@
 typedef struct _Gstreamill      Gstreamill;
 typedef struct _GstreamillClass GstreamillClass;
 
+/*
+ * URIType:
+ * streaming uri, e.g. /test/encoder/0/playlist.m3u8
+ */
+typedef enum {
+    URI_TYPE_UNKNOWN = 0,
+    URI_TYPE_MASTER_PLAYLIST = 1, /* /<job>/playlist.m3u8 */
+    URI_TYPE_ENCODER = 2, /* /<job>/encoder/<n>, http progressive play or dvr download */
+    URI_TYPE_ENCODER_PLAYLIST = 3, /* /<job>/encoder/<n>/playlist.m3u8 */
+    URI_TYPE_ENCODER_OTHER = 4 /* /<job>/encoder/<n>/..., e.g. segment */
+} URIType;
+
+/* result of uri parsing, job name points into the uri and is not nul terminated */
+typedef struct _URIRoute {
+    URIType type;
+    const gchar *job_name;
+    gsize job_name_len;
+    gint encoder_index; /* -1 if not an encoder uri */
+} URIRoute;
+
 typedef struct _RecordData {
     gchar *dir, *file, *buf;
     gsize segment_size;
+    gint64 queued_time; /* monotonic time, us */
 } RecordData;
 
 struct _Gstreamill {
     GObject parent;
 
     gchar *exe_path;
+    gboolean zygote; /* job workers are forked by zygote, gstreamill is their subreaper */
+    GHashTable *zombies; /* zombie children seen by last orphan reaping */
     gboolean stop; /* gstreamill exit if stop == TURE */
     gint mode; /* running mode */
     GstClock *system_clock;
@@ -43,6 +67,7 @@ struct _Gstreamill {
     Log *log;
     gchar *log_dir;
     GThread *msg_thread;
+    gint event_epoll_fd; /* event fds of jobs, doorbell of encoders event ring */
     guint64 last_dvr_clean_time;
 
     /* segment record thread */
@@ -62,6 +87,10 @@ struct _Gstreamill {
 
     GMutex job_list_mutex;
     GSList *job_list;
+    GRWLock job_table_lock; /* job lookup never take job_list_mutex */
+    GHashTable *job_table; /* job name to job */
+
+    Metrics metrics; /* updated by http servers and record thread */
 };
 
 struct _GstreamillClass {
@@ -86,10 +115,13 @@ gchar * gstreamill_stat (Gstreamill *gstreamill);
 gchar * gstreamill_list_jobs (Gstreamill *gstreamill);
 gchar * gstreamill_job_stat (Gstreamill *gstreamill, gchar *name);
 gchar * gstreamill_gstreamer_stat (Gstreamill *gstreamill, gchar *uri);
-void gstreamill_unaccess (Gstreamill *gstreamill, gchar *uri);
+gboolean gstreamill_uri_route (const gchar *uri, URIRoute *route);
+Job * gstreamill_route_job (Gstreamill *gstreamill, URIRoute *route);
+void gstreamill_unaccess (Gstreamill *gstreamill, Job *job);
 Job * gstreamill_get_job (Gstreamill *gstreamill, gchar *uri);
 gint gstreamill_job_number (Gstreamill *gstreamill);
-EncoderOutput * gstreamill_get_encoder_output (Gstreamill *gstreamill, gchar *uri);
+EncoderOutput * gstreamill_get_encoder_output (Gstreamill *gstreamill, Job *job, gint index);
 gchar * gstreamill_get_master_m3u8playlist (Gstreamill *gstreamill, gchar *uri);
+void gstreamill_render_metrics (Gstreamill *gstreamill, GString *out);
 
 #endif /* __GSTREAMILL_H__ */
@@ -18,7 +18,6 @@
 #include <stdlib.h>
 #include <augeas.h>
 
-#define __USE_GNU
 #include <sys/mman.h>
 
 #include "parson.h"
@@ -35,6 +34,7 @@ enum {
     HTTPMGMT_PROP_0,
     HTTPMGMT_PROP_ADDRESS,
     HTTPMGMT_PROP_GSTREAMILL,
+    HTTPMGMT_PROP_HTTPSTREAMING,
 };
 
 static void httpmgmt_class_init (HTTPMgmtClass *httpmgmtclass);
@@ -68,6 +68,14 @@ static void httpmgmt_class_init (HTTPMgmtClass *httpmgmtclass)
             G_PARAM_WRITABLE | G_PARAM_READABLE
             );
     g_object_class_install_property (g_object_class, HTTPMGMT_PROP_GSTREAMILL, param);
+
+    param = g_param_spec_pointer (
+            "httpstreaming",
+            "httpstreaming",
+            NULL,
+            G_PARAM_WRITABLE | G_PARAM_READABLE
+            );
+    g_object_class_install_property (g_object_class, HTTPMGMT_PROP_HTTPSTREAMING, param);
 }
 
 static void httpmgmt_init (HTTPMgmt *httpmgmt)
@@ -99,6 +107,10 @@ static void httpmgmt_set_property (GObject *obj, guint prop_id, const GValue *va
             HTTPMGMT (obj)->gstreamill = (Gstreamill *)g_value_get_pointer (value);
             break;
 
+        case HTTPMGMT_PROP_HTTPSTREAMING:
+            HTTPMGMT (obj)->httpstreaming = (HTTPStreaming *)g_value_get_pointer (value);
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
             break;
@@ -118,6 +130,10 @@ static void httpmgmt_get_property (GObject *obj, guint prop_id, GValue *value, G
             g_value_set_pointer (value, httpmgmt->gstreamill);
             break;
 
+        case HTTPMGMT_PROP_HTTPSTREAMING:
+            g_value_set_pointer (value, httpmgmt->httpstreaming);
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
             break;
@@ -218,98 +234,83 @@ static gchar * system_stat ()
     return result;
 }
 
-static gchar * request_gstreamill_stat (HTTPMgmt *httpmgmt, RequestData *request_data)
+static void request_gstreamill_stat (HTTPMgmt *httpmgmt, RequestData *request_data, HTTPResponse *response)
 {
-    gchar *buf, *p;
+    gchar *p;
 
     if ((request_data->method == HTTP_GET) && g_strcmp0 (request_data->uri, "/stat/gstreamill") == 0) {
         GST_WARNING ("Gstreamill stat request from %s", get_address (request_data->client_addr));
         p = gstreamill_stat (httpmgmt->gstreamill);
-        buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if ((request_data->method == HTTP_GET) && g_strcmp0 (request_data->uri, "/stat/system") == 0) {
         GST_WARNING ("System stat request from %s", get_address (request_data->client_addr));
         p = system_stat ();
-        buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if ((request_data->method == HTTP_GET) && g_str_has_prefix (request_data->uri, "/stat/gstreamill/job/number")) {
         p = g_strdup_printf ("%d", gstreamill_job_number (httpmgmt->gstreamill));
-        buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "text/plain", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_TEXT, NO_CACHE, p, strlen (p), g_free);
 
     } else if ((request_data->method == HTTP_GET) && g_strcmp0 (request_data->uri, "/stat/gstreamill/listjobs") == 0) {
         GST_WARNING ("Listjobs request from %s", get_address (request_data->client_addr));
         p = gstreamill_list_jobs (httpmgmt->gstreamill);
-        buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if ((request_data->method == HTTP_GET) && g_str_has_prefix (request_data->uri, "/stat/gstreamill/job/")) {
         GST_WARNING ("Job %s stat request from %s", request_data->uri, get_address (request_data->client_addr));
         p = gstreamill_job_stat (httpmgmt->gstreamill, request_data->uri);
-        buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if ((request_data->method == HTTP_GET) && g_str_has_prefix (request_data->uri, "/stat/gstreamill/starttime")) {
         p = g_strdup_printf ("%s", gstreamill_get_start_time (httpmgmt->gstreamill));
-        buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "text/plain", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_TEXT, NO_CACHE, p, strlen (p), g_free);
 
     } else if ((request_data->method == HTTP_GET) && g_str_has_prefix (request_data->uri, "/stat/gstreamill/version")) {
-        buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "text/plain", strlen (VERSION), NO_CACHE, VERSION);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_TEXT, NO_CACHE, VERSION, sizeof (VERSION) - 1, NULL);
 
     } else if ((request_data->method == HTTP_GET) && g_str_has_prefix (request_data->uri, "/stat/gstreamill/builddate")) {
-        buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "text/plain", strlen (__DATE__), NO_CACHE, __DATE__);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_TEXT, NO_CACHE, __DATE__, sizeof (__DATE__) - 1, NULL);
 
     } else if ((request_data->method == HTTP_GET) && g_str_has_prefix (request_data->uri, "/stat/gstreamill/buildtime")) {
-        buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "text/plain", strlen (__TIME__), NO_CACHE, __TIME__);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_TEXT, NO_CACHE, __TIME__, sizeof (__TIME__) - 1, NULL);
 
     } else {
-        buf = g_strdup_printf (http_404, PACKAGE_NAME, PACKAGE_VERSION);
+        httpserver_response_status (request_data, response, 404);
     }
-
-    return buf;
 }
 
-static gchar * request_gstreamer_stat (HTTPMgmt *httpmgmt, RequestData *request_data)
+static void request_gstreamer_stat (HTTPMgmt *httpmgmt, RequestData *request_data, HTTPResponse *response)
 {
-    gchar *buf, *p;
+    gchar *p;
 
     p = gstreamill_gstreamer_stat (httpmgmt->gstreamill, request_data->uri);
-    buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "text/plain", strlen (p), NO_CACHE, p);
-    g_free (p);
-
-    return buf;
+    httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_TEXT, NO_CACHE, p, strlen (p), g_free);
 }
 
-static gchar * gen_http_header (gchar *path, gsize body_size)
+static HTTPContentType content_type (gchar *path)
 {
-    gchar *header;
-
     if (g_str_has_suffix (path, ".html")) {
-        header = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "text/html", body_size, NO_CACHE, "");
+        return HTTP_CONTENT_TYPE_HTML;
 
     } else if (g_str_has_suffix (path, ".css")) {
-        header = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "text/css", body_size, NO_CACHE, "");
+        return HTTP_CONTENT_TYPE_CSS;
 
     } else if (g_str_has_suffix (path, ".js") || g_str_has_suffix (path, ".json")) {
-        header = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/x-javascript", body_size, NO_CACHE, "");
+        return HTTP_CONTENT_TYPE_JAVASCRIPT;
 
     } else if (g_str_has_suffix (path, ".ttf")) {
-        header = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/x-font-ttf", body_size, NO_CACHE, "");
+        return HTTP_CONTENT_TYPE_TTF;
 
     } else if (g_str_has_suffix (path, ".svg")) {
-        header = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "image/svg+xml", body_size, NO_CACHE, "");
+        return HTTP_CONTENT_TYPE_SVG;
 
     } else if (g_str_has_suffix (path, ".ico")) {
-        header = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "image/x-icon", body_size, NO_CACHE, "");
+        return HTTP_CONTENT_TYPE_ICON;
 
     } else {
-        header = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/octet-stream", body_size, NO_CACHE, "");
+        return HTTP_CONTENT_TYPE_OCTET_STREAM;
     }
-
-    return header;
 }
 
 static gchar * add_header_footer (gchar *middle)
@@ -1052,9 +1053,9 @@ static gchar * dvr_directory (gchar *uri)
     return result;
 }
 
-static gsize request_gstreamill_admin (HTTPMgmt *httpmgmt, RequestData *request_data, gchar **buf)
+static void request_gstreamill_admin (HTTPMgmt *httpmgmt, RequestData *request_data, HTTPResponse *response)
 {
-    gchar *path, *http_header, *p = NULL;
+    gchar *path, *buf, *p = NULL;
     gsize buf_size;
     GError *err = NULL;
 
@@ -1064,83 +1065,68 @@ static gsize request_gstreamill_admin (HTTPMgmt *httpmgmt, RequestData *request_
 
     } else if (g_str_has_prefix (request_data->uri, "/admin/start")) {
         p = start_job (httpmgmt, request_data);
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if (g_str_has_prefix (request_data->uri, "/admin/stop")) {
         p = stop_job (httpmgmt, request_data);
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if (g_strcmp0 (request_data->uri, "/admin/getnetworkinterfaces") == 0) {
         p = get_network_interfaces ();
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if (g_strcmp0 (request_data->uri, "/admin/setnetworkinterfaces") == 0) {
         p = set_network_interfaces (request_data);
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if (g_strcmp0 (request_data->uri, "/admin/getnetworkdevices") == 0) {
         p = get_network_devices ();
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if (g_strcmp0 (request_data->uri, "/admin/audiodevices") == 0) {
         p = list_devices ("/dev/snd/pcmC*c", NULL);
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if (g_strcmp0 (request_data->uri, "/admin/videodevices") == 0) {
         p = list_devices ("/dev/video*", NULL);
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if (g_strcmp0 (request_data->uri, "/admin/getconf") == 0) {
         p = get_conf ();
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if ((request_data->method == HTTP_POST) && (g_strcmp0 (request_data->uri, "/admin/putconf") == 0)) {
         p = put_conf (request_data);
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if (g_strcmp0 (request_data->uri, "/admin/listlivejob") == 0) {
         p = list_devices (JOBS_DIR "/*.job", JOBS_DIR "/%[^.].job");
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if (g_str_has_prefix (request_data->uri, "/admin/getjob/")) {
         p = get_job_description (request_data->uri);
         if (p != NULL) {
-            *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-            g_free (p);
+            httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
         } else {
-            *buf = g_strdup_printf (http_404, PACKAGE_NAME, PACKAGE_VERSION);
+            httpserver_response_status (request_data, response, 404);
         }
 
     } else if (g_str_has_prefix (request_data->uri, "/admin/rmjob/")) {
         p = rm_job (request_data->uri);
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if ((request_data->method == HTTP_POST) && (g_str_has_prefix (request_data->uri, "/admin/putjob/"))) {
         p = put_job (request_data, TRUE);
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if ((request_data->method == HTTP_POST) && (g_str_has_prefix (request_data->uri, "/admin/setjob/"))) {
         p = put_job (request_data, FALSE);
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if (g_str_has_prefix (request_data->uri, "/admin/dvrdir/")) {
         p = dvr_directory (request_data->uri);
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else {
         /* static content, prepare file path */
@@ -1148,13 +1134,12 @@ static gsize request_gstreamill_admin (HTTPMgmt *httpmgmt, RequestData *request_
     }
 
     if (path == NULL) {
-        /* not static content */
-        buf_size = strlen (*buf);
+        /* not static content, response ready */
+        return;
 
-    } else if (!g_file_get_contents (path, buf, &buf_size, &err)) {
-        GST_ERROR ("read file %s failure: %s", p, err->message);
-        *buf = g_strdup_printf (http_404, PACKAGE_NAME, PACKAGE_VERSION);
-        buf_size = strlen (*buf);
+    } else if (!g_file_get_contents (path, &buf, &buf_size, &err)) {
+        GST_ERROR ("read file %s failure: %s", path, err->message);
+        httpserver_response_status (request_data, response, 404);
         g_error_free (err);
 
     } else {
@@ -1163,34 +1148,23 @@ static gsize request_gstreamill_admin (HTTPMgmt *httpmgmt, RequestData *request_
             gchar name[32], *temp_buf;
 
             sscanf (request_data->parameters, "name=%s", name);
-            temp_buf = g_strdup_printf (*buf, name);
-            g_free (*buf);
-            *buf = temp_buf;
+            temp_buf = g_strdup_printf (buf, name);
+            g_free (buf);
+            buf = temp_buf;
         }
         /* html file? add top and bottom */
         if (g_str_has_suffix (path, ".html")) {
             gchar *body;
 
-            body = *buf;
-            *buf = add_header_footer (body);
+            body = buf;
+            buf = add_header_footer (body);
             g_free (body);
-            buf_size = strlen (*buf);
+            buf_size = strlen (buf);
         }
-        http_header = gen_http_header (path, buf_size);
-        p = g_malloc (buf_size + strlen (http_header));
-        memcpy (p, http_header, strlen (http_header));
-        memcpy (p + strlen (http_header), *buf, buf_size);
-        g_free (*buf);
-        *buf = p;
-        buf_size += strlen (http_header);
-        g_free (http_header);
+        /* file content is body, no copy */
+        httpserver_response_ok (request_data, response, content_type (path), NO_CACHE, buf, buf_size, g_free);
     }
-
-    if (path != NULL) {
-        g_free (path);
-    }
-
-    return buf_size;
+    g_free (path);
 }
 
 static gsize get_chunknumber (gchar *parameters)
@@ -1253,87 +1227,61 @@ static gchar * get_filename (gchar *parameters)
     return p;
 }
 
-static gsize media_download (HTTPMgmt *httpmgmt, RequestData *request_data, gchar **buf)
+static void media_download (HTTPMgmt *httpmgmt, RequestData *request_data, HTTPResponse *response)
 {
     gint fd;
     struct stat st;
-    gsize buf_size;
-    gchar *p;
+    gchar *path, *p;
+    HTTPMgmtPrivateData *priv_data;
 
-    p = g_strdup_printf ("%s/%s", MEDIA_LOCATION, request_data->uri + 16);
-    GST_WARNING ("download %s", p);
-    fd = open (p, O_RDONLY);
-    g_free (p);
+    path = g_strdup_printf ("%s/%s", MEDIA_LOCATION, request_data->uri + 16);
+    GST_WARNING ("download %s", path);
+    fd = open (path, O_RDONLY);
     if (fd == -1) {
-        GST_ERROR ("open %s error: %s", p, g_strerror (errno));
+        GST_ERROR ("open %s error: %s", path, g_strerror (errno));
         p = g_strdup_printf ("{\n    \"result\": \"failure\",\n    \"reason\": \"%s\"\n}", g_strerror (errno));
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
-        return 0;
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
+        g_free (path);
+        return;
     }
+    g_free (path);
 
     if (fstat (fd, &st) == -1) {
         GST_ERROR ("fstat error: %s", g_strerror (errno));
         p = g_strdup_printf ("{\n    \"result\": \"failure\",\n    \"reason\": \"%s\"\n}", g_strerror (errno));
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
         close (fd);
-        g_free (p);
-        return 0;
+        return;
+    }
 
-    } else {
-        gchar *p1, *p2;
-        HTTPMgmtPrivateData *priv_data;
-
-        p1 = mmap (NULL, st.st_size + sysconf (_SC_PAGE_SIZE), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-        if (p1 == MAP_FAILED) {
-            GST_ERROR ("mmap anonymous error: %s", g_strerror (errno));
-            p = g_strdup_printf ("{\n    \"result\": \"failure\",\n    \"reason\": \"mmap anonymous %s\"\n}", g_strerror (errno));
-            *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-            close (fd);
-            g_free (p);
-            return 0;
-        }
-        p2 = mmap (p1 + sysconf (_SC_PAGE_SIZE), st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-        if (p2 == MAP_FAILED) {
-            GST_ERROR ("mmap file error: %s", g_strerror (errno));
-            p = g_strdup_printf ("{\n    \"result\": \"failure\",\n    \"reason\": \"mmap file %s\"\n}", g_strerror (errno));
-            *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-            close (fd);
-            g_free (p);
-            munmap (p1, st.st_size + sysconf (_SC_PAGE_SIZE));
-            return 0;
-        }
-        p = mremap (p2, st.st_size, st.st_size, MREMAP_MAYMOVE | MREMAP_FIXED, p1 + sysconf (_SC_PAGE_SIZE));
-        if (p == MAP_FAILED) {
-            GST_ERROR ("mremap file error: %s", g_strerror (errno));
-            p = g_strdup_printf ("{\n    \"result\": \"failure\",\n    \"reason\": \"mremap file %s\"\n}", g_strerror (errno));
-            *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-            close (fd);
-            g_free (p);
-            munmap (p1, st.st_size + sysconf (_SC_PAGE_SIZE));
-            munmap (p2, st.st_size);
-            return 0;
-        }
-        p = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/octet-stream", st.st_size, NO_CACHE, "");
-        memcpy (p1 + sysconf (_SC_PAGE_SIZE) - strlen (p), p, strlen (p));
-        *buf = p1 + sysconf (_SC_PAGE_SIZE) - strlen (p);
-        buf_size = strlen (p) + st.st_size;
-        g_free (p);
-        priv_data = (HTTPMgmtPrivateData *)g_malloc (sizeof (HTTPMgmtPrivateData));
-        priv_data->buf = *buf;
-        priv_data->buf_size = buf_size;
-        priv_data->send_position = 0;
-        priv_data->fd = fd;
-        priv_data->p = p1;
-        request_data->priv_data = priv_data;
-        return buf_size;
+    if (st.st_size == 0) {
+        /* can't mmap empty file */
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_OCTET_STREAM, NO_CACHE, "", 0, NULL);
+        close (fd);
+        return;
     }
+
+    /* file mapping is the body, header is sent with it by writev */
+    p = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+        GST_ERROR ("mmap file error: %s", g_strerror (errno));
+        p = g_strdup_printf ("{\n    \"result\": \"failure\",\n    \"reason\": \"mmap file %s\"\n}", g_strerror (errno));
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
+        close (fd);
+        return;
+    }
+    priv_data = g_new0 (HTTPMgmtPrivateData, 1);
+    priv_data->fd = fd;
+    priv_data->p = p;
+    priv_data->p_size = st.st_size;
+    request_data->priv_data = priv_data;
+    httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_OCTET_STREAM, NO_CACHE, p, st.st_size, NULL);
 }
 
-static gsize request_gstreamill_media (HTTPMgmt *httpmgmt, RequestData *request_data, gchar **buf)
+static void request_gstreamill_media (HTTPMgmt *httpmgmt, RequestData *request_data, HTTPResponse *response)
 {
     gchar *path, *content, *p;
-    gsize buf_size, content_size;
+    gsize content_size;
 
     if ((request_data->method == HTTP_POST) && (g_str_has_prefix (request_data->uri, "/media/upload"))) {
         p = get_filename (request_data->parameters);
@@ -1343,11 +1291,10 @@ static gsize request_gstreamill_media (HTTPMgmt *httpmgmt, RequestData *request_
         content_size = request_data->request_length - request_data->header_size;
         if (media_append (path, content, content_size)) {
             p = g_strdup_printf ("%ld", content_size);
-            *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "text/plain", strlen (p), NO_CACHE, p);
-            g_free (p);
+            httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_TEXT, NO_CACHE, p, strlen (p), g_free);
 
         } else {
-            *buf = g_strdup_printf (http_500, PACKAGE_NAME, PACKAGE_VERSION);
+            httpserver_response_status (request_data, response, 500);
         }
         g_free (path);
 
@@ -1357,68 +1304,82 @@ static gsize request_gstreamill_media (HTTPMgmt *httpmgmt, RequestData *request_
         g_free (p);
         if (get_chunksize (request_data->parameters) * get_chunknumber (request_data->parameters) <= media_size (path)) {
             p = g_strdup ("complete");
-            *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "text/plain", strlen (p), NO_CACHE, p);
-            g_free (p);
+            httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_TEXT, NO_CACHE, p, strlen (p), g_free);
 
         } else {
-            *buf = g_strdup_printf (http_204, PACKAGE_NAME, PACKAGE_VERSION);
+            httpserver_response_status (request_data, response, 204);
         }
         g_free (path);
 
     } else if ((request_data->method == HTTP_GET) && (g_str_has_prefix (request_data->uri, "/media/download"))) {
-        buf_size = media_download (httpmgmt, request_data, buf);
-        /* success? */
-        if (buf_size != 0) {
-            return buf_size;
-        }
+        media_download (httpmgmt, request_data, response);
 
     } else if ((request_data->method == HTTP_GET) && (g_strcmp0 (request_data->uri, "/media/transcodeinlist") == 0)) {
         path = g_strdup_printf ("%s/transcode/in", MEDIA_LOCATION);
         p = media_transcode_in_list (path);
         g_free (path);
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if ((request_data->method == HTTP_GET) && (g_str_has_prefix (request_data->uri, "/media/rm/transcode/"))) {
         p = request_data->uri + 20;
         path = g_strdup_printf ("%s/transcode/%s", MEDIA_LOCATION, p);
         p = media_transcode_rm (path);
         g_free (path);
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if ((request_data->method == HTTP_GET) && (g_strcmp0 (request_data->uri, "/media/transcodeoutlist") == 0)) {
         path = g_strdup_printf ("%s/transcode/out", MEDIA_LOCATION);
         p = media_transcode_out_list (path);
         g_free (path);
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else if ((request_data->method == HTTP_GET) && (g_strcmp0 (request_data->uri, "/media/getmediadir") == 0)) {
         p = g_strdup_printf ("{\n    \"media_dir\": \"%s\"\n}", MEDIA_LOCATION);
-        *buf = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "application/json", strlen (p), NO_CACHE, p);
-        g_free (p);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_JSON, NO_CACHE, p, strlen (p), g_free);
 
     } else {
-        *buf = g_strdup_printf (http_404, PACKAGE_NAME, PACKAGE_VERSION);
+        httpserver_response_status (request_data, response, 404);
     }
-    buf_size = strlen (*buf);
+}
+
+static void render_queue_length (GString *out, const gchar *server, HTTPServer *httpserver)
+{
+    guint idle, block, backlog;
+
+    httpserver_queue_length (httpserver, &idle, &block, &backlog);
+    g_string_append_printf (out, "gstreamill_http_idle_queue_length{server=\"%s\"} %u\n", server, idle);
+    g_string_append_printf (out, "gstreamill_http_block_queue_length{server=\"%s\"} %u\n", server, block);
+    g_string_append_printf (out, "gstreamill_http_thread_pool_backlog{server=\"%s\"} %u\n", server, backlog);
+}
+
+/* prometheus text exposition, counters are read without lock */
+static void request_metrics (HTTPMgmt *httpmgmt, RequestData *request_data, HTTPResponse *response)
+{
+    GString *out;
+    gsize size;
 
-    return buf_size;
+    out = g_string_sized_new (65536);
+    gstreamill_render_metrics (httpmgmt->gstreamill, out);
+    metrics_render_help (out, "gstreamill_http_idle_queue_length", "gauge", "Requests waiting for wakeup time.");
+    metrics_render_help (out, "gstreamill_http_block_queue_length", "gauge", "Requests waiting for socket.");
+    metrics_render_help (out, "gstreamill_http_thread_pool_backlog", "gauge", "Requests not processed by thread pool yet.");
+    render_queue_length (out, "mgmt", httpmgmt->httpserver);
+    if ((httpmgmt->httpstreaming != NULL) && (httpmgmt->httpstreaming->httpserver != NULL)) {
+        render_queue_length (out, "streaming", httpmgmt->httpstreaming->httpserver);
+    }
+    size = out->len;
+    httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_TEXT, NO_CACHE, g_string_free (out, FALSE), size, g_free);
 }
 
 static void free_priv_data (HTTPMgmtPrivateData *priv_data)
 {
+    httpserver_response_clear (&(priv_data->response));
     /* fd != -1, media download? */
-    if (priv_data->fd == -1) {
-        g_free (priv_data->buf);
-        g_free (priv_data);
-
-    } else {
+    if (priv_data->fd != -1) {
         close (priv_data->fd);
-        munmap (priv_data->p, priv_data->buf_size);
-        munmap (priv_data->p + sysconf (_SC_PAGE_SIZE), priv_data->buf_size - sysconf (_SC_PAGE_SIZE));
-        g_free (priv_data);
+        munmap (priv_data->p, priv_data->p_size);
     }
+    g_free (priv_data);
 }
 
 static GstClockTime httpmgmt_dispatcher (gpointer data, gpointer user_data)
@@ -1426,69 +1387,71 @@ static GstClockTime httpmgmt_dispatcher (gpointer data, gpointer user_data)
     RequestData *request_data = data;
     HTTPMgmt *httpmgmt = user_data;
     HTTPMgmtPrivateData *priv_data;
-    gchar *buf;
-    gsize buf_size;
-    gint ret;
+    HTTPResponse response;
+    MetricsRoute route;
+    gssize ret;
 
     switch (request_data->status) {
         case HTTP_REQUEST:
             GST_WARNING ("Request from %s, uri is %s", get_address (request_data->client_addr), request_data->uri);
 
             if (g_str_has_prefix (request_data->uri, "/stat/gstreamer")) {
-                buf = request_gstreamer_stat (httpmgmt, request_data);
-                buf_size = strlen (buf);
+                route = METRICS_ROUTE_STAT;
+                request_gstreamer_stat (httpmgmt, request_data, &response);
 
             } else if (g_str_has_prefix (request_data->uri, "/stat")) {
-                buf = request_gstreamill_stat (httpmgmt, request_data);
-                buf_size = strlen (buf);
+                route = METRICS_ROUTE_STAT;
+                request_gstreamill_stat (httpmgmt, request_data, &response);
 
             } else if (g_str_has_prefix (request_data->uri, "/admin")) {
-                buf_size = request_gstreamill_admin (httpmgmt, request_data, &buf);
+                route = METRICS_ROUTE_ADMIN;
+                request_gstreamill_admin (httpmgmt, request_data, &response);
 
             } else if (g_str_has_prefix (request_data->uri, "/media")) {
-                buf_size = request_gstreamill_media (httpmgmt, request_data, &buf);
+                route = METRICS_ROUTE_MEDIA;
+                request_gstreamill_media (httpmgmt, request_data, &response);
+
+            } else if ((request_data->method == HTTP_GET) && (g_strcmp0 (request_data->uri, "/metrics") == 0)) {
+                route = METRICS_ROUTE_METRICS;
+                request_metrics (httpmgmt, request_data, &response);
 
             } else {
-                buf = g_strdup_printf (http_404, PACKAGE_NAME, PACKAGE_VERSION);
-                buf_size = strlen (buf);
+                route = METRICS_ROUTE_OTHER;
+                httpserver_response_status (request_data, &response, 404);
             }
 
-            ret = write (request_data->sock, buf, buf_size);
+            ret = httpserver_response_send (request_data->sock, &response);
+            metrics_histogram_observe (&(httpmgmt->gstreamill->metrics.request_latency[route]),
+                    (gst_clock_get_time (httpmgmt->httpserver->system_clock) - request_data->birth_time) / GST_USECOND);
             /* send not completed or socket block? */
-            if (((ret > 0) && (ret != buf_size)) || ((ret == -1) && (errno == EAGAIN))) {
-                /* media download? */
-                if (request_data->priv_data != NULL) {
-                    priv_data = request_data->priv_data;
-                    priv_data->send_position += ret;
-                    return ret > 0? 10 * GST_MSECOND + g_random_int_range (1, 1000000) : GST_CLOCK_TIME_NONE;
+            if (((ret > 0) && !httpserver_response_sent (&response)) || ((ret == -1) && (errno == EAGAIN))) {
+                /* media download have private data already */
+                if (request_data->priv_data == NULL) {
+                    priv_data = g_new0 (HTTPMgmtPrivateData, 1);
+                    priv_data->fd = -1;
+                    request_data->priv_data = priv_data;
                 }
-                priv_data = (HTTPMgmtPrivateData *)g_malloc (sizeof (HTTPMgmtPrivateData));
-                priv_data->fd = -1;
-                priv_data->buf = buf;
-                priv_data->buf_size = buf_size;
-                priv_data->send_position = ret > 0? ret : 0;
-                request_data->priv_data = priv_data;
+                priv_data = request_data->priv_data;
+                priv_data->response = response;
                 return ret > 0? 10 * GST_MSECOND + g_random_int_range (1, 1000000) : GST_CLOCK_TIME_NONE;
 
             } else if (ret == -1) {
                 GST_ERROR ("Write sock error: %s", g_strerror (errno));
             }
             /* send complete or socket error */
+            httpserver_response_clear (&response);
             if (request_data->priv_data != NULL) {
                 free_priv_data (request_data->priv_data);
                 request_data->priv_data = NULL;
-
-            } else {
-                g_free (buf);
             }
             return 0;
 
         case HTTP_CONTINUE:
             priv_data = request_data->priv_data;
-            ret = write (request_data->sock, priv_data->buf + priv_data->send_position, priv_data->buf_size - priv_data->send_position);
-            if ((ret + priv_data->send_position == priv_data->buf_size) || ((ret == -1) && (errno != EAGAIN))) {
+            ret = httpserver_response_send (request_data->sock, &(priv_data->response));
+            if (httpserver_response_sent (&(priv_data->response)) || ((ret == -1) && (errno != EAGAIN))) {
                 /* send complete or send error, finish the request */
-                if ((ret == -1) && (errno != EAGAIN)) {
+                if (ret == -1) {
                     GST_ERROR ("Write sock error: %s", g_strerror (errno));
                 }
                 free_priv_data (priv_data);
@@ -1497,7 +1460,6 @@ static GstClockTime httpmgmt_dispatcher (gpointer data, gpointer user_data)
 
             } else if ((ret > 0) || ((ret == -1) && (errno == EAGAIN))) {
                 /* send not completed or socket block, resend late */
-                priv_data->send_position += ret > 0? ret : 0;
                 return ret > 0? 10 * GST_MSECOND + g_random_int_range (1, 1000000) : GST_CLOCK_TIME_NONE;
             }
 
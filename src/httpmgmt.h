@@ -13,17 +13,17 @@
 #include "config.h"
 #include "gstreamill.h"
 #include "httpserver.h"
+#include "httpstreaming.h"
 
 #define CONF_FILE "/etc/gstreamill.d/gstreamill.conf"
 #define JOBS_DIR "/etc/gstreamill.d/jobs.d/"
 #define ADMIN_LOCATION "/usr/share/gstreamill"
 
 typedef struct _HTTPMgmtPrivateData {
-    gint fd;
-    gchar *p;
-    gchar *buf;
-    gsize buf_size;
-    gint64 send_position;
+    gint fd; /* media download file, -1 if not media download */
+    gchar *p; /* mapping of media download file */
+    gsize p_size;
+    HTTPResponse response; /* response not sent completely */
 } HTTPMgmtPrivateData;
 
 typedef struct _HTTPMgmt      HTTPMgmt;
@@ -35,6 +35,7 @@ struct _HTTPMgmt {
     gchar *address;
     GstClock *system_clock;
     Gstreamill *gstreamill;
+    HTTPStreaming *httpstreaming; /* queues of streaming server are exported in metrics */
     HTTPServer *httpserver; /* management via http */
 };
 
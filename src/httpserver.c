@@ -13,6 +13,7 @@
 #include <ctype.h>
 #include <fcntl.h>
 #include <netinet/tcp.h>
+#include <sys/uio.h>
 #include <gst/gst.h>
 #include <string.h>
 #include <errno.h>
@@ -97,6 +98,9 @@ static void httpserver_init (HTTPServer *http_server)
         g_mutex_init (&(request_data->events_mutex));
         request_data->id = i;
         request_data->num_headers = 0;
+        request_data->raw_request[0] = '\0';
+        request_data->uri = request_data->raw_request;
+        request_data->parameters = request_data->raw_request;
         http_server->request_data_pointers[i] = request_data;
         g_queue_push_head (http_server->request_data_queue, &http_server->request_data_pointers[i]);
     }
@@ -261,146 +265,160 @@ static void urldecode (gchar *src)
     *dst++ = '\0';
 }
 
-static gint parse_request (RequestData *request_data)
+/*
+ * find_header_end:
+ * search "\r\n\r\n" in buf from start to end, memchr of libc is vectorized.
+ *
+ * Returns: position of "\r\n\r\n" or -1 if not found.
+ */
+static gint find_header_end (gchar *buf, gint start, gint end)
 {
-    gchar *buf = request_data->raw_request, *p1, *p2, *p3, *header;
-    gchar *uri = &(request_data->uri[0]);
-    gchar *parameters = &(request_data->parameters[0]);
-    gint i, content_length;
+    gchar *p, *last;
 
-    /* check header */
-    p1 = strstr (buf, "\r\n\r\n");
-    if (p1 == NULL) {
-        /* header not completed */
-        return 1;
-    }
-    request_data->header_size = p1 - buf + 4;
-
-    GST_LOG ("head size: %d", request_data->header_size);
-    header = g_strndup (buf, p1 - buf);
-    p1 = strstr (header, "Content-Length:");
-    if (p1 != NULL) {
-        p1 += 15;
-        while (*p1 == ' ') {
-            p1++;
-        }
-        p2 = p1;
-        while (g_ascii_isdigit (*p2)) {
-            p2++;
+    p = buf + start;
+    last = buf + end;
+    while ((p = memchr (p, '\r', last - p)) != NULL) {
+        if (last - p < 4) {
+            break;
         }
-        p3 = g_strndup (p1, p2 - p1);
-        content_length = atoi (p3);
-        GST_LOG ("Content-Length: %d, request_length: %d", content_length, request_data->request_length);
-        g_free (p3);
-        if ((request_data->header_size + content_length) > request_data->request_length) {
-            /* body not completed, read more data. */
-            g_free (header);
-            return 1;
+        if ((p[1] == '\n') && (p[2] == '\r') && (p[3] == '\n')) {
+            return p - buf;
         }
+        p++;
     }
-    g_free (header);
+
+    return -1;
+}
+
+/**
+ * httpserver_parse_request:
+ * @request_data: (in): request being read.
+ *
+ * incremental, resume where the last read left off, header slices are offsets in raw_request.
+ *
+ * Returns: 0 on complete, 1 need more data, 2 not implemented, 3 and 4 bad request.
+ */
+gint httpserver_parse_request (RequestData *request_data)
+{
+    gchar *buf = request_data->raw_request, *p, *end, *eol, *sp, *q, *name_end;
+    gint position, i;
+
+    /* header has been parsed, waiting body */
+    if (request_data->header_size != 0) {
+        return (request_data->header_size + request_data->content_length > request_data->request_length) ? 1 : 0;
+    }
+
+    /* check header */
+    position = find_header_end (buf, request_data->parse_position, request_data->request_length);
+    if (position == -1) {
+        /* header not completed, "\r\n\r" may be at the end */
+        request_data->parse_position = MAX (request_data->request_length - 3, 0);
+        return 1;
+    }
+    end = buf + position;
+    GST_LOG ("head size: %d", position + 4);
 
     if (strncmp (buf, "GET", 3) == 0) {
         request_data->method = HTTP_GET;
-        buf += 3;
+        p = buf + 3;
 
     } else if (strncmp (buf, "POST", 4) == 0) {
         request_data->method = HTTP_POST;
-        buf += 4;
+        p = buf + 4;
 
     } else {
         GST_WARNING ("Method %s not implemented", buf);
         return 2; /* Not Implemented */
     }
 
-    while (*buf == ' ') {
+    while (*p == ' ') {
         /* skip space */
-        buf++;
+        p++;
     }
 
-    i = 0;
-    while (*buf != ' ' && *buf != '?' && i++ < kMaxUriLength) {
-        *uri = *buf;
-        buf++;
-        uri++;
+    /* uri and parameters are nul terminated and url decoded in place */
+    eol = memchr (p, '\r', end - p + 1);
+    sp = memchr (p, ' ', eol - p);
+    if (sp == NULL) {
+        /* Bad request, no http version */
+        return 4;
     }
-    if (i <= kMaxUriLength) {
-        *uri = '\0';
-
-    } else {
-        /* Bad request, uri too long */
+    q = memchr (p, '?', sp - p);
+    if (((q != NULL ? q : sp) - p > kMaxUriLength) || ((q != NULL) && (sp - q - 1 > kMaxParametersLength))) {
+        /* Bad request, uri or parameters too long */
         return 3;
     }
-    urldecode (request_data->uri);
-
-    i = 0;
-    if (*buf == '?') {
-        /* have parameters */
-        buf++;
-        while (*buf != ' ' && i++ < kMaxParametersLength) {
-            *parameters = *buf;
-            buf++;
-            parameters++;
-        }
-    }
-    if (i <= kMaxParametersLength) {
-        *parameters = '\0';
-
-    } else {
-        /* Bad request, parameters too long */
-        return 3;
+    request_data->uri = p;
+    request_data->parameters = q != NULL ? q + 1 : sp;
+    if (q != NULL) {
+        *q = '\0';
     }
-    urldecode (&(request_data->parameters[0]));
+    *sp = '\0';
+    urldecode (request_data->uri);
+    urldecode (request_data->parameters);
 
-    while (*buf == ' ') {
+    p = sp + 1;
+    while (*p == ' ') {
         /* skip space */
-        buf++;
+        p++;
     }
 
-    if (strncmp (buf, "HTTP/1.1", 8) == 0) {
-        /* http version must be 1.1 */
-        request_data->version = HTTP_1_1; 
+    if (strncmp (p, "HTTP/1.1", 8) == 0) {
+        request_data->version = HTTP_1_1;
 
-    } else if (strncmp (buf, "HTTP/1.0", 8) == 0) {
+    } else if (strncmp (p, "HTTP/1.0", 8) == 0) {
         request_data->version = HTTP_1_0;
 
-    }else { /* Bad request, must be http 1.1 */
+    } else { /* Bad request, must be http 1.1 or 1.0 */
         return 4;
     }
 
-    buf += 8;
-
-    /* parse headers */
+    /* parse headers, name and value are nul terminated in place */
+    request_data->content_length = 0;
     i = 0;
-    for (;;) {
-        if ((g_ascii_strncasecmp (buf, "\n\n", 2) == 0) || (g_ascii_strncasecmp (buf, "\r\n\r\n", 4) == 0)) {
-            break;
+    for (p = eol + 2; p < end; p = eol + 2) {
+        eol = memchr (p, '\r', end - p + 1);
+        name_end = memchr (p, ':', eol - p);
+        if (name_end == NULL) {
+            /* no name value separator, ignore the line */
+            continue;
         }
-
-        while (*buf == '\r' || *buf == '\n') {
-            buf++;
+        if (i == kMaxHeaders) {
+            /* Bad request, too many headers */
+            return 3;
         }
-
-        /* parse name */
-        p1 = buf;
-        while (*buf != ':' && *buf != ' ' && *buf != '\0') {
-            buf++;
+        request_data->headers[i].name = p - buf;
+        q = name_end;
+        while ((q > p) && (q[-1] == ' ')) {
+            q--;
         }
-        request_data->headers[i].name = g_strndup (p1, buf - p1);
+        request_data->headers[i].name_size = q - p;
+        *q = '\0';
 
-        while (*buf == ':' || *buf == ' ') {
-            buf++;
+        p = name_end + 1;
+        while (*p == ' ') {
+            p++;
         }
-
-        /* parse value */
-        p1 = buf;
-        while (*buf != '\r' && *buf != '\n') {
-            buf++;
+        request_data->headers[i].value = p - buf;
+        request_data->headers[i].value_size = eol - p;
+        *eol = '\0';
+
+        if (g_ascii_strcasecmp (http_header_name (request_data, i), "Content-Length") == 0) {
+            request_data->content_length = atoi (p);
+            if ((request_data->content_length < 0) || (request_data->content_length >= kRequestBufferSize)) {
+                return 3;
+            }
         }
-        request_data->headers[i].value = g_strndup (p1, buf - p1);
         i++;
     }
     request_data->num_headers = i;
+    request_data->header_size = position + 4;
+    GST_LOG ("Content-Length: %d, request_length: %d", request_data->content_length, request_data->request_length);
+
+    /* body not completed, read more data. */
+    if (request_data->header_size + request_data->content_length > request_data->request_length) {
+        return 1;
+    }
 
     return 0;
 }
@@ -441,17 +459,12 @@ static void close_socket_gracefully (gint sock)
 
 static void request_data_release (HTTPServer *http_server, RequestData **request_data_pointer)
 {
-    gint i;
     RequestData *request_data;
     struct sockaddr in_addr;
 
     request_data = *request_data_pointer;
     in_addr = request_data->client_addr;
     GST_INFO ("release request from %s:%u, sock %d", get_address (in_addr), get_port (in_addr), request_data->sock);
-    for (i = 0; i < request_data->num_headers; i++) {
-        g_free (request_data->headers[i].name);
-        g_free (request_data->headers[i].value);
-    }
     request_data->num_headers = 0;
     request_data->status = HTTP_NONE;
     close_socket_gracefully (request_data->sock);
@@ -518,6 +531,12 @@ static gint accept_socket (HTTPServer *http_server)
         request_data->birth_time = gst_clock_get_time (http_server->system_clock);
         request_data->status = HTTP_CONNECTED;
         request_data->request_length = 0;
+        request_data->parse_position = 0;
+        request_data->header_size = 0;
+        request_data->content_length = 0;
+        request_data->raw_request[0] = '\0';
+        request_data->uri = request_data->raw_request;
+        request_data->parameters = request_data->raw_request;
         ee.events = EPOLLIN | EPOLLOUT | EPOLLET;
         ee.data.ptr = request_data_pointer;
         ret = epoll_ctl (http_server->epollfd, EPOLL_CTL_ADD, accepted_sock, &ee);
@@ -841,7 +860,7 @@ static void invoke_user_callback (HTTPServer *http_server, RequestData **request
     }
 }
 
-static gint httpserver_write (gint sock, gchar *buf, gsize count)
+static gint httpserver_write (gint sock, const gchar *buf, gsize count)
 {
     gsize sent;
     gint ret, len;
@@ -916,7 +935,7 @@ static void thread_pool_func (gpointer data, gpointer user_data)
             return;
         } 
 
-        ret = parse_request (request_data);
+        ret = httpserver_parse_request (request_data);
         if (ret == 0) {
             /* parse complete, call back user function */
             request_data->events ^= EPOLLIN;
@@ -932,21 +951,17 @@ static void thread_pool_func (gpointer data, gpointer user_data)
         } else if (ret == 2) {
             /* Not Implemented */
             GST_WARNING ("Not Implemented, return is %d, sock is %d", ret, request_data->sock);
-            gchar *buf = g_strdup_printf (http_501, PACKAGE_NAME, PACKAGE_VERSION);
-            if (httpserver_write (request_data->sock, buf, strlen (buf)) != strlen (buf)) {
+            if (httpserver_write (request_data->sock, http_501, sizeof (http_501) - 1) != sizeof (http_501) - 1) {
                 GST_ERROR ("write sock %d error.", request_data->sock);
             }
-            g_free (buf);
             request_data_release (http_server, request_data_pointer);
 
         } else {
             /* Bad Request */
             GST_WARNING ("Bad request, return is %d, sock is %d", ret, request_data->sock);
-            gchar *buf = g_strdup_printf (http_400, PACKAGE_NAME, PACKAGE_VERSION);
-            if (httpserver_write (request_data->sock, buf, strlen (buf)) != strlen (buf)) {
+            if (httpserver_write (request_data->sock, http_400, sizeof (http_400) - 1) != sizeof (http_400) - 1) {
                 GST_ERROR ("write sock %d error.", request_data->sock);
             }
-            g_free (buf);
             request_data_release (http_server, request_data_pointer);
         }
 
@@ -1022,3 +1037,205 @@ gint httpserver_report_request_data (HTTPServer *http_server)
 
     return 0;
 }
+
+/**
+ * httpserver_queue_length:
+ * @http_server: (in): the http server
+ * @idle: (out): requests waiting in idle queue for wakeup time
+ * @block: (out): requests waiting in block queue for socket writable or more data
+ * @backlog: (out): requests pushed to thread pool but not processed yet
+ */
+void httpserver_queue_length (HTTPServer *http_server, guint *idle, guint *block, guint *backlog)
+{
+    g_mutex_lock (&(http_server->idle_queue_mutex));
+    *idle = g_tree_nnodes (http_server->idle_queue);
+    g_mutex_unlock (&(http_server->idle_queue_mutex));
+    g_mutex_lock (&(http_server->block_queue_mutex));
+    *block = g_queue_get_length (http_server->block_queue);
+    g_mutex_unlock (&(http_server->block_queue_mutex));
+    *backlog = g_thread_pool_unprocessed (http_server->thread_pool);
+}
+
+#define HTTP_200_PREFIX(type) "HTTP/1.1 200 Ok\r\n" \
+                              HTTP_SERVER_HEADER \
+                              "Content-Type: " type "\r\n" \
+                              "Access-Control-Allow-Origin: *\r\n" \
+                              "Connection: Close\r\n"
+#define HTTP_200_PREFIX_ENTRY(type) {HTTP_200_PREFIX (type), sizeof (HTTP_200_PREFIX (type)) - 1}
+
+/* constant part of 200 response header, per content type */
+static const struct {
+    const gchar *prefix;
+    gsize size;
+} http_200_prefixes[HTTP_CONTENT_TYPE_NUM] = {
+    [HTTP_CONTENT_TYPE_JSON] = HTTP_200_PREFIX_ENTRY ("application/json"),
+    [HTTP_CONTENT_TYPE_TEXT] = HTTP_200_PREFIX_ENTRY ("text/plain"),
+    [HTTP_CONTENT_TYPE_HTML] = HTTP_200_PREFIX_ENTRY ("text/html"),
+    [HTTP_CONTENT_TYPE_CSS] = HTTP_200_PREFIX_ENTRY ("text/css"),
+    [HTTP_CONTENT_TYPE_JAVASCRIPT] = HTTP_200_PREFIX_ENTRY ("application/x-javascript"),
+    [HTTP_CONTENT_TYPE_TTF] = HTTP_200_PREFIX_ENTRY ("application/x-font-ttf"),
+    [HTTP_CONTENT_TYPE_SVG] = HTTP_200_PREFIX_ENTRY ("image/svg+xml"),
+    [HTTP_CONTENT_TYPE_ICON] = HTTP_200_PREFIX_ENTRY ("image/x-icon"),
+    [HTTP_CONTENT_TYPE_XML] = HTTP_200_PREFIX_ENTRY ("text/xml"),
+    [HTTP_CONTENT_TYPE_M3U8] = HTTP_200_PREFIX_ENTRY ("application/vnd.apple.mpegurl"),
+    [HTTP_CONTENT_TYPE_MPEGTS] = HTTP_200_PREFIX_ENTRY ("video/mpeg"),
+    [HTTP_CONTENT_TYPE_OCTET_STREAM] = HTTP_200_PREFIX_ENTRY ("application/octet-stream")
+};
+
+#define HTTP_STATUS_ENTRY(status, response, body_size) {status, response, sizeof (response) - 1, body_size}
+
+/* complete non 200 responses */
+static const struct {
+    guint status;
+    const gchar *response;
+    gsize size;
+    gsize body_size;
+} http_status_responses[] = {
+    HTTP_STATUS_ENTRY (204, http_204, 0),
+    HTTP_STATUS_ENTRY (400, http_400, http_400_body_size),
+    HTTP_STATUS_ENTRY (404, http_404, http_404_body_size),
+    HTTP_STATUS_ENTRY (501, http_501, http_501_body_size),
+    HTTP_STATUS_ENTRY (500, http_500, http_500_body_size) /* last, for unknown status */
+};
+
+/**
+ * httpserver_response_ok:
+ * @request_data: (in): request to response.
+ * @response: (in): response to fill.
+ * @type: (in): content type of body.
+ * @cache_control: (in): value of Cache-Control header.
+ * @body: (in): body of response, referenced by response, not copied,
+ *     NULL if only header is sent and body is sent by caller.
+ * @body_size: (in): size of body, the Content-Length.
+ * @body_free: (in): called with body when response cleared, NULL if body is not owned by response.
+ *
+ * Fill a 200 response, the constant part of header is pre-rendered, only
+ * Content-Length and Cache-Control are formatted per response.
+ */
+void httpserver_response_ok (RequestData *request_data, HTTPResponse *response, HTTPContentType type,
+                             const gchar *cache_control, gchar *body, gsize body_size, GDestroyNotify body_free)
+{
+    gsize size;
+
+    size = http_200_prefixes[type].size;
+    memcpy (response->header, http_200_prefixes[type].prefix, size);
+    size += g_snprintf (response->header + size,
+                        kMaxResponseHeaderSize - size,
+                        "Content-Length: %zu\r\nCache-Control: %s\r\n\r\n",
+                        body_size,
+                        cache_control);
+    response->header_size = size;
+    response->body = body;
+    response->body_size = body != NULL ? body_size : 0;
+    response->body_free = body_free;
+    response->send_position = 0;
+    request_data->response_status = 200;
+    request_data->response_body_size = body_size;
+}
+
+/**
+ * httpserver_response_status:
+ * @request_data: (in): request to response.
+ * @response: (in): response to fill.
+ * @status: (in): 204, 400, 404, 500 or 501, others are treated as 500.
+ *
+ * Fill a response with complete canned response of status.
+ */
+void httpserver_response_status (RequestData *request_data, HTTPResponse *response, guint status)
+{
+    gint i;
+
+    for (i = 0; i < G_N_ELEMENTS (http_status_responses) - 1; i++) {
+        if (http_status_responses[i].status == status) {
+            break;
+        }
+    }
+    response->header_size = 0;
+    response->body = (gchar *)http_status_responses[i].response;
+    response->body_size = http_status_responses[i].size;
+    response->body_free = NULL;
+    response->send_position = 0;
+    request_data->response_status = http_status_responses[i].status;
+    request_data->response_body_size = http_status_responses[i].body_size;
+}
+
+/**
+ * httpserver_response_chunked:
+ * @request_data: (in): request to response.
+ * @response: (in): response to fill.
+ *
+ * Fill a response with header of chunked transfer, chunks are sent by caller.
+ */
+void httpserver_response_chunked (RequestData *request_data, HTTPResponse *response)
+{
+    response->header_size = 0;
+    response->body = http_chunked;
+    response->body_size = sizeof (http_chunked) - 1;
+    response->body_free = NULL;
+    response->send_position = 0;
+    request_data->response_status = 200;
+    request_data->response_body_size = 0;
+}
+
+/**
+ * httpserver_response_send:
+ * @sock: (in): socket to send to.
+ * @response: (in): response to send.
+ *
+ * Send remain of header and body of response by one writev.
+ *
+ * Returns: bytes sent, -1 on error, errno is set.
+ */
+gssize httpserver_response_send (gint sock, HTTPResponse *response)
+{
+    struct iovec iov[2];
+    gint iovcnt;
+    gssize ret;
+
+    iovcnt = 0;
+    if (response->send_position < response->header_size) {
+        iov[iovcnt].iov_base = response->header + response->send_position;
+        iov[iovcnt].iov_len = response->header_size - response->send_position;
+        iovcnt++;
+        iov[iovcnt].iov_base = response->body;
+        iov[iovcnt].iov_len = response->body_size;
+        iovcnt++;
+
+    } else {
+        iov[iovcnt].iov_base = response->body + response->send_position - response->header_size;
+        iov[iovcnt].iov_len = response->header_size + response->body_size - response->send_position;
+        iovcnt++;
+    }
+    ret = writev (sock, iov, iovcnt);
+    if (ret > 0) {
+        response->send_position += ret;
+    }
+
+    return ret;
+}
+
+/**
+ * httpserver_response_sent:
+ * @response: (in): response.
+ *
+ * Returns: TRUE if header and body are all sent.
+ */
+gboolean httpserver_response_sent (HTTPResponse *response)
+{
+    return response->send_position == response->header_size + response->body_size;
+}
+
+/**
+ * httpserver_response_clear:
+ * @response: (in): response to clear.
+ *
+ * Release body if owned by response, sizes and send position are kept.
+ */
+void httpserver_response_clear (HTTPResponse *response)
+{
+    if ((response->body_free != NULL) && (response->body != NULL)) {
+        response->body_free (response->body);
+    }
+    response->body = NULL;
+    response->body_free = NULL;
+}
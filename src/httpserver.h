@@ -12,8 +12,11 @@
 
 #include "config.h"
 
+#define HTTP_SERVER_HEADER "Server: " PACKAGE_NAME "-" PACKAGE_VERSION "\r\n"
+
+/* complete responses, rendered at compile time */
 #define http_500 "HTTP/1.1 500 Internal Server Error\r\n" \
-                 "Server: %s-%s\r\n" \
+                 HTTP_SERVER_HEADER \
                  "Content-Type: text/html\r\n" \
                  "Content-Length: 30\r\n" \
                  "Connection: Close\r\n\r\n" \
@@ -21,14 +24,15 @@
 #define http_500_body_size 30
 
 #define http_501 "HTTP/1.1 501 Not Implemented\r\n" \
-                 "Server: %s-%s\r\n" \
+                 HTTP_SERVER_HEADER \
                  "Content-Type: text/html\r\n" \
                  "Content-Length: 24\r\n" \
                  "Connection: Close\r\n\r\n" \
                  "<h1>Not Implemented</h1>"
+#define http_501_body_size 24
 
 #define http_404 "HTTP/1.1 404 Not Found\r\n" \
-                 "Server: %s-%s\r\n" \
+                 HTTP_SERVER_HEADER \
                  "Content-Type: text/html\r\n" \
                  "Content-Length: 18\r\n" \
                  "Connection: Close\r\n\r\n" \
@@ -36,37 +40,61 @@
 #define http_404_body_size 18
 
 #define http_400 "HTTP/1.1 400 Bad Request\r\n" \
-                 "Server: %s-%s\r\n" \
+                 HTTP_SERVER_HEADER \
                  "Content-Type: text/html\r\n" \
                  "Content-Length: 20\r\n" \
                  "Connection: Close\r\n\r\n" \
                  "<h1>Bad Request</h1>"
-
-#define http_200 "HTTP/1.1 200 Ok\r\n" \
-                 "Server: %s-%s\r\n" \
-                 "Content-Type: %s\r\n" \
-                 "Content-Length: %zu\r\n" \
-                 "Access-Control-Allow-Origin: *\r\n" \
-                 "Cache-Control: %s\r\n" \
-                 "Connection: Close\r\n\r\n" \
-                 "%s"
+#define http_400_body_size 20
 
 #define http_204 "HTTP/1.1 204 No Content\r\n" \
-                 "Server: %s-%s\r\n" \
-                 "Content-Length: 0\r\n" \
-
-#define NO_CACHE "no-cache"
-#define CACHE_60s "max-age=60"
-#define CACHE_3600s "max-age=3600"
+                 HTTP_SERVER_HEADER \
+                 "Content-Length: 0\r\n\r\n"
 
 #define http_chunked "HTTP/1.1 200 OK\r\n" \
                      "Content-Type: video/mpeg\r\n" \
-                     "Server: %s-%s\r\n" \
+                     HTTP_SERVER_HEADER \
                      "Connection: Close\r\n" \
                      "Transfer-Encoding: chunked\r\n" \
                      "Pragma: no-cache\r\n" \
                      "Cache-Control: no-cache, no-store, must-revalidate\r\n\r\n"
 
+#define NO_CACHE "no-cache"
+#define CACHE_60s "max-age=60"
+#define CACHE_3600s "max-age=3600"
+
+/* content type of 200 response, constant part of header is pre-rendered per type */
+typedef enum {
+    HTTP_CONTENT_TYPE_JSON = 0,
+    HTTP_CONTENT_TYPE_TEXT,
+    HTTP_CONTENT_TYPE_HTML,
+    HTTP_CONTENT_TYPE_CSS,
+    HTTP_CONTENT_TYPE_JAVASCRIPT,
+    HTTP_CONTENT_TYPE_TTF,
+    HTTP_CONTENT_TYPE_SVG,
+    HTTP_CONTENT_TYPE_ICON,
+    HTTP_CONTENT_TYPE_XML,
+    HTTP_CONTENT_TYPE_M3U8,
+    HTTP_CONTENT_TYPE_MPEGTS,
+    HTTP_CONTENT_TYPE_OCTET_STREAM,
+    HTTP_CONTENT_TYPE_NUM
+} HTTPContentType;
+
+#define kMaxResponseHeaderSize 512
+
+/*
+ * HTTPResponse:
+ * header and body are sent by one writev, body is referenced, never copied into header.
+ */
+typedef struct _HTTPResponse {
+    gchar header[kMaxResponseHeaderSize];
+    gsize header_size;
+    gchar *body;
+    gsize body_size;
+    GDestroyNotify body_free; /* release body when response cleared, NULL if body not owned */
+    gsize send_position; /* bytes of header and body sent */
+} HTTPResponse;
+
 typedef struct _HTTPServer      HTTPServer;
 typedef struct _HTTPServerClass HTTPServerClass;
 typedef GstClockTime (*http_callback_t) (gpointer data, gpointer user_data);
@@ -81,11 +109,17 @@ enum http_version {
     HTTP_1_1
 };
 
+/* header slice in raw_request, name and value are nul terminated in place */
 struct http_headers {
-    gchar *name;
-    gchar *value;
+    gint name; /* offset of name in raw_request */
+    gint name_size;
+    gint value; /* offset of value in raw_request */
+    gint value_size;
 };
 
+#define http_header_name(request_data, i) (&((request_data)->raw_request[(request_data)->headers[i].name]))
+#define http_header_value(request_data, i) (&((request_data)->raw_request[(request_data)->headers[i].value]))
+
 enum session_status {
     HTTP_NONE,
     HTTP_CONNECTED,
@@ -100,6 +134,7 @@ enum session_status {
 #define kMaxRequests 128
 #define kMaxUriLength 2048
 #define kMaxParametersLength 1024
+#define kMaxHeaders 64
 
 typedef struct _RequestData {
     gint id;
@@ -113,13 +148,15 @@ typedef struct _RequestData {
     GstClockTime wakeup_time; /* used in idle queue */
     gchar raw_request[kRequestBufferSize];
     gint request_length;
+    gint parse_position; /* search of header end resume from here */
     enum request_method method;
-    gchar uri[kMaxUriLength + 1];
-    gchar parameters[kMaxParametersLength + 1];
+    gchar *uri; /* in raw_request, url decoded in place */
+    gchar *parameters; /* in raw_request, url decoded in place */
     enum http_version version;
-    gint header_size;
+    gint header_size; /* 0 if header not completed */
+    gint content_length;
     gint num_headers;
-    struct http_headers headers[64];
+    struct http_headers headers[kMaxHeaders];
     gpointer priv_data; /* private user data */
 
     guint response_status;
@@ -173,6 +210,15 @@ struct _HTTPServerClass {
 
 GType httpserver_get_type (void);
 gint httpserver_start (HTTPServer *httpserver, http_callback_t user_callback, gpointer user_data);
+gint httpserver_parse_request (RequestData *request_data);
 gint httpserver_report_request_data (HTTPServer *http_server);
+void httpserver_queue_length (HTTPServer *http_server, guint *idle, guint *block, guint *backlog);
+void httpserver_response_ok (RequestData *request_data, HTTPResponse *response, HTTPContentType type,
+                             const gchar *cache_control, gchar *body, gsize body_size, GDestroyNotify body_free);
+void httpserver_response_status (RequestData *request_data, HTTPResponse *response, guint status);
+void httpserver_response_chunked (RequestData *request_data, HTTPResponse *response);
+gssize httpserver_response_send (gint sock, HTTPResponse *response);
+gboolean httpserver_response_sent (HTTPResponse *response);
+void httpserver_response_clear (HTTPResponse *response);
 
 #endif /* __HTTPSERVER_H__ */
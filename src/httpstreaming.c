@@ -24,6 +24,11 @@ GST_DEBUG_CATEGORY_EXTERN (ACCESS);
 GST_DEBUG_CATEGORY_EXTERN (GSTREAMILL);
 #define GST_CAT_DEFAULT GSTREAMILL
 
+/* progressive viewer waits restart of a live job for this many gop durations at most */
+#define VIEWER_WAIT_GOPS 3
+/* gop duration of job without m3u8streaming */
+#define VIEWER_WAIT_GOP_DURATION (2 * GST_SECOND)
+
 enum {
     HTTPSTREAMING_PROP_0,
     HTTPSTREAMING_PROP_ADDRESS,
@@ -142,61 +147,50 @@ GType httpstreaming_get_type (void)
  */
 static gint64 get_current_gop_end (EncoderOutput *encoder_output, HTTPStreamingPrivateData *priv_data)
 {
-    gint32 current_gop_size, n;
-    gint64 current_gop_end_addr;
-
-    /* read gop size. */
-    n = encoder_output->cache_size - priv_data->rap_addr;
-    if (n >= 12) {
-        memcpy (&current_gop_size, encoder_output->cache_addr + priv_data->rap_addr + 8, 4);
-
-    } else if (n > 8) {
-        memcpy (&current_gop_size, encoder_output->cache_addr + priv_data->rap_addr + 8, n - 8);
-        memcpy (&current_gop_size + n - 8, encoder_output->cache_addr, 12 - n);
-
-    } else {
-        memcpy (&current_gop_size, encoder_output->cache_addr + 8 - n, 4);
-    }
-
-    if (current_gop_size == 0) {
+    if (encoder_output_gop_size (encoder_output, priv_data->rap_addr) == 0) {
         /* current output gop. */
         return -1;
     }
-    current_gop_end_addr = priv_data->rap_addr + current_gop_size + 12;
-    if (current_gop_end_addr > encoder_output->cache_size) {
-        current_gop_end_addr -= encoder_output->cache_size;
-    }
 
-    return current_gop_end_addr;
+    /* send position wraps to 0 at cache end, so does gop end */
+    return encoder_output_rap_next (encoder_output, priv_data->rap_addr);
 }
 
-static gsize get_mpeg2ts_segment (RequestData *request_data, EncoderOutput *encoder_output, gchar **buf)
+/* first byte of a gop on the wire, latency since it left source appsink and since it opened in cache */
+static void trace_first_byte (EncoderOutput *encoder_output, gint64 ingest_time, gint64 open_time)
+{
+    gint64 now;
+
+    now = g_get_real_time ();
+    metrics_histogram_observe (&(encoder_output->ring_dwell), now > open_time ? now - open_time : 0);
+    if (ingest_time != 0) {
+        metrics_histogram_observe (&(encoder_output->first_byte), now > ingest_time ? now - ingest_time : 0);
+    }
+}
+
+static void get_mpeg2ts_segment (RequestData *request_data, EncoderOutput *encoder_output, HTTPResponse *response)
 {
     GstClockTime timestamp;
     gint number;
     guint64 sequence, rap_addr, max_age;
-    gchar *header, *path, *file, *cache_control, dir[16];
-    gsize buf_size;
+    gchar *path, *file, cache_control[32], dir[16];
+    gsize file_size;
     GError *err = NULL;
     struct timespec ts;
 
     number = sscanf (request_data->uri, "/%*[^/]/encoder/%*[^/]/%10[^/]/%lu.ts$", dir, &sequence);
     if (number != 2) {
         GST_WARNING ("uri not found: %s", request_data->uri);
-        *buf = g_strdup_printf (http_404, PACKAGE_NAME, PACKAGE_VERSION);
-        buf_size = strlen (*buf);
-        return buf_size;
+        httpserver_response_status (request_data, response, 404);
+        return;
     }
     timestamp = sequence * encoder_output->segment_duration / 1000;
 
     /* read from memory */
     if (clock_gettime (CLOCK_REALTIME, &ts) == -1) {
         GST_ERROR ("get_mpeg2ts_segment clock_gettime error: %s", g_strerror (errno));
-        *buf = g_strdup_printf (http_500, PACKAGE_NAME, PACKAGE_VERSION);
-        request_data->response_status = 500;
-        request_data->response_body_size = http_500_body_size;
-        buf_size = strlen (*buf);
-        return buf_size;
+        httpserver_response_status (request_data, response, 500);
+        return;
     }
     ts.tv_sec += 2;
     while (sem_timedwait (encoder_output->semaphore, &ts) == -1) {
@@ -204,85 +198,57 @@ static gsize get_mpeg2ts_segment (RequestData *request_data, EncoderOutput *enco
             continue;
         }
         GST_ERROR ("get_mpeg2ts_segment sem_timedwait failure: %s", g_strerror (errno));
-        *buf = g_strdup_printf (http_500, PACKAGE_NAME, PACKAGE_VERSION);
-        request_data->response_status = 500;
-        request_data->response_body_size = http_500_body_size;
-        buf_size = strlen (*buf);
-        return buf_size;
+        httpserver_response_status (request_data, response, 500);
+        return;
     }
     /* seek gop */
     rap_addr = encoder_output_gop_seek (encoder_output, timestamp);
     if (rap_addr != G_MAXUINT64) {
-        /* segment found, send it */
+        /* segment found, copy gop out of cache, header is not copied */
         gsize gop_size;
+        gchar *gop;
+        gint64 ingest_time, open_time;
 
         gop_size = encoder_output_gop_size (encoder_output, rap_addr);
-        cache_control = g_strdup_printf ("max-age=%lu", encoder_output->dvr_duration);
-        header = g_strdup_printf (http_200, PACKAGE_NAME, PACKAGE_VERSION, "video/mpeg", gop_size, cache_control, "");
-        g_free (cache_control);
-        *buf = g_malloc (strlen (header) + gop_size);
-        memcpy (*buf, header, strlen(header));
-        if (rap_addr + gop_size + 12 < encoder_output->cache_size) {
-            memcpy (*buf + strlen (header), encoder_output->cache_addr + rap_addr + 12, gop_size);
+        gop = g_malloc (gop_size);
+        if (rap_addr + gop_size + ENCODER_GOP_HEADER_SIZE < encoder_output->cache_size) {
+            memcpy (gop, encoder_output->cache_addr + rap_addr + ENCODER_GOP_HEADER_SIZE, gop_size);
 
         } else {
             gint n;
 
-            n = encoder_output->cache_size - rap_addr - 12;
+            n = encoder_output->cache_size - rap_addr - ENCODER_GOP_HEADER_SIZE;
             if (n > 0) {
-                memcpy (*buf + strlen (header), encoder_output->cache_addr + rap_addr + 12, n);
-                memcpy (*buf + strlen (header) + n, encoder_output->cache_addr, gop_size - n);
+                memcpy (gop, encoder_output->cache_addr + rap_addr + ENCODER_GOP_HEADER_SIZE, n);
+                memcpy (gop + n, encoder_output->cache_addr, gop_size - n);
 
             } else {
                 GST_WARNING ("nnnnn: n < 0 %d", n);
-                memcpy (*buf + strlen (header), encoder_output->cache_addr - n, gop_size);
+                memcpy (gop, encoder_output->cache_addr - n, gop_size);
             }
         }
-        buf_size = strlen (header) + gop_size;
-        request_data->response_status = 200;
-        request_data->response_body_size = gop_size;
-        g_free (header);
-
-    } else {
-        buf_size = 0;
+        encoder_output_rap_trace (encoder_output, rap_addr, &ingest_time, &open_time);
+        g_snprintf (cache_control, sizeof (cache_control), "max-age=%lu", encoder_output->dvr_duration);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_MPEGTS, cache_control, gop, gop_size, g_free);
+        sem_post (encoder_output->semaphore);
+        trace_first_byte (encoder_output, ingest_time, open_time);
+        return;
     }
     sem_post (encoder_output->semaphore);
 
-    /* buf_size == 0? segment not found in memory, read frome dvr directory */
-    if (buf_size == 0) {
-        path = g_strdup_printf ("%s/%s/%lu.ts", encoder_output->record_path, dir, sequence);
-        if (!g_file_get_contents (path, &file, &buf_size, &err)) {
-            GST_WARNING ("read segment error: %s", err->message);
-            g_error_free (err);
-            *buf = g_strdup_printf (http_404, PACKAGE_NAME, PACKAGE_VERSION);
-            request_data->response_body_size = http_404_body_size;
-            request_data->response_status = 404;
-            buf_size = strlen (*buf);
+    /* segment not found in memory, read frome dvr directory */
+    path = g_strdup_printf ("%s/%s/%lu.ts", encoder_output->record_path, dir, sequence);
+    if (!g_file_get_contents (path, &file, &file_size, &err)) {
+        GST_WARNING ("read segment error: %s", err->message);
+        g_error_free (err);
+        httpserver_response_status (request_data, response, 404);
 
-        } else {
-            request_data->response_status = 200;
-            request_data->response_body_size = buf_size;
-            max_age = encoder_output->dvr_duration - (g_get_real_time () - timestamp) / 1000000;
-            cache_control = g_strdup_printf ("max-age=%lu", max_age);
-            header = g_strdup_printf (http_200,
-                    PACKAGE_NAME,
-                    PACKAGE_VERSION,
-                    "video/mpeg",
-                    buf_size,
-                    cache_control,
-                    "");
-            g_free (cache_control);
-            *buf = g_malloc (buf_size + strlen (header));
-            memcpy (*buf, header, strlen (header));
-            memcpy (*buf + strlen (header), file, buf_size);
-            buf_size += strlen (header);
-            g_free (header);
-            g_free (file);
-        }
-        g_free (path);
+    } else {
+        max_age = encoder_output->dvr_duration - (g_get_real_time () - timestamp) / 1000000;
+        g_snprintf (cache_control, sizeof (cache_control), "max-age=%lu", max_age);
+        httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_MPEGTS, cache_control, file, file_size, g_free);
     }
-
-    return buf_size;
+    g_free (path);
 }
 
 static guint64 get_gint64_parameter (gchar *parameters, gchar *parameter)
@@ -334,51 +300,26 @@ static gchar * get_str_parameter (gchar *parameters, gchar *parameter)
     return g_strdup_printf ("%s", value);
 }
 
-static gboolean is_encoder_channel_url (RequestData *request_data)
-{
-    GRegex *regex = NULL;
-    GMatchInfo *match_info = NULL;
-    gchar *e;
-    gint index;
-
-    index = -1;
-    regex = g_regex_new ("^/[^/]*/encoder/(?<encoder>[0-9]+)$", G_REGEX_OPTIMIZE, 0, NULL);
-    g_regex_match (regex, request_data->uri, 0, &match_info);
-    if (g_match_info_matches (match_info)) {
-        e = g_match_info_fetch_named (match_info, "encoder");
-        index = g_ascii_strtoll (e, NULL, 10);
-        g_free (e);
-    }
-    if (match_info != NULL) {
-        g_match_info_free (match_info);
-    }
-    if (regex != NULL) {
-        g_regex_unref (regex);
-    }
-    if (index == -1) {
-        GST_DEBUG ("not http progress play uri: %s", request_data->uri);
-        return FALSE;
-    }
-
-    return TRUE;
-}
-
-static gboolean is_http_progress_play_request (RequestData *request_data)
+static gboolean is_http_progress_play_request (RequestData *request_data, URIRoute *route)
 {
 
     if (request_data->parameters[0] != '\0') {
         return FALSE;
     }
 
-    return is_encoder_channel_url (request_data);
+    return route->type == URI_TYPE_ENCODER;
 }
 
-static void http_progress_play_priv_data_init (HTTPStreaming *httpstreaming,
-                                               RequestData *request_data,
-                                               HTTPStreamingPrivateData *priv_data)
+static void http_progress_play_priv_data_init (RequestData *request_data, HTTPStreamingPrivateData *priv_data, Job *job, EncoderOutput *encoder_output)
 {
-    priv_data->job = gstreamill_get_job (httpstreaming->gstreamill, request_data->uri);
-    priv_data->livejob_age = priv_data->job->age;
+    priv_data->job = job;
+    priv_data->encoder_output = encoder_output;
+    priv_data->viewer = TRUE;
+    g_atomic_int_inc (&(encoder_output->viewers));
+    /* gop joined is not traced, it has been in cache for a while */
+    priv_data->gop_open_time = 0;
+    priv_data->livejob_age = job->age;
+    priv_data->not_playing_since = 0;
     priv_data->chunk_size = 0;
     priv_data->send_count = 2;
     priv_data->chunk_size_str = g_strdup ("");
@@ -387,7 +328,26 @@ static void http_progress_play_priv_data_init (HTTPStreaming *httpstreaming,
     request_data->bytes_send = 0;
 }
 
-static gboolean is_dvr_download_request (RequestData *request_data, EncoderOutput *encoder_output)
+/* progressive play client leaves */
+static void viewer_leave (HTTPStreamingPrivateData *priv_data)
+{
+    EncoderOutput *encoder_output = priv_data->encoder_output;
+
+    if (priv_data->viewer) {
+        g_atomic_int_add (&(encoder_output->viewers), -1);
+        priv_data->viewer = FALSE;
+    }
+}
+
+/* bytes sent to clients of encoder output */
+static void count_sent_bytes (EncoderOutput *encoder_output, gssize sent)
+{
+    if ((encoder_output != NULL) && (sent > 0)) {
+        metrics_counter_add (&(encoder_output->bytes_sent), sent);
+    }
+}
+
+static gboolean is_dvr_download_request (RequestData *request_data, URIRoute *route, EncoderOutput *encoder_output)
 {
     gchar start_dir[11], end_dir[11], *start, *end, *segments_dir, *path, *p;
     gint number;
@@ -396,7 +356,7 @@ static gboolean is_dvr_download_request (RequestData *request_data, EncoderOutpu
     HTTPStreamingPrivateData *priv_data;
     GStatBuf stat;
 
-    if (!is_encoder_channel_url (request_data)) {
+    if (route->type != URI_TYPE_ENCODER) {
         return FALSE;
     }
 
@@ -441,8 +401,9 @@ static gboolean is_dvr_download_request (RequestData *request_data, EncoderOutpu
             end_time += end_min * 60 + end_sec;
 
             priv_data = (HTTPStreamingPrivateData *)g_malloc (sizeof (HTTPStreamingPrivateData));
-            priv_data->buf = NULL;
+            priv_data->response = NULL;
             priv_data->job = NULL;
+            priv_data->viewer = FALSE;
             priv_data->segment_list = NULL;
             priv_data->dvr_download_size = 0;
             priv_data->list_index = 0;
@@ -489,30 +450,22 @@ bad_request:
     return FALSE;
 }
 
-static gchar * request_crossdomain (RequestData *request_data)
+static gboolean request_crossdomain (RequestData *request_data, HTTPResponse *response)
 {
-    gchar *buf;
-    gchar *crossdomain = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+    static gchar crossdomain[] = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
         "<cross-domain-policy>\n"
         "    <allow-access-from domain=\"*\"/>\n"
         "</cross-domain-policy>\n";
 
-    if (g_str_has_suffix (request_data->uri, "crossdomain.xml")) {
-        buf = g_strdup_printf (http_200,
-                PACKAGE_NAME,
-                PACKAGE_VERSION,
-                "text/xml",
-                strlen (crossdomain),
-                NO_CACHE,
-                crossdomain);
-    } else {
-        buf = NULL;
+    if (!g_str_has_suffix (request_data->uri, "crossdomain.xml")) {
+        return FALSE;
     }
+    httpserver_response_ok (request_data, response, HTTP_CONTENT_TYPE_XML, NO_CACHE, crossdomain, sizeof (crossdomain) - 1, NULL);
 
-    return buf;
+    return TRUE;
 }
 
-static gchar * request_master_m3u8_playlist (HTTPStreaming *httpstreaming, RequestData *request_data)
+static gboolean request_master_m3u8_playlist (HTTPStreaming *httpstreaming, RequestData *request_data, HTTPResponse *response)
 {
     gchar *master_m3u8_playlist, *buf, *replace;
     GRegex *regex;
@@ -520,7 +473,7 @@ static gchar * request_master_m3u8_playlist (HTTPStreaming *httpstreaming, Reque
     /* master m3u8 request? */
     buf = gstreamill_get_master_m3u8playlist (httpstreaming->gstreamill, request_data->uri);
     if (buf == NULL) {
-        return buf;
+        return FALSE;
     }
 
     /* channel request uri should inherit parameters of master request uri */
@@ -536,48 +489,27 @@ static gchar * request_master_m3u8_playlist (HTTPStreaming *httpstreaming, Reque
     g_free (buf);
     g_regex_unref (regex);
 
-    if (master_m3u8_playlist != NULL) {
-        request_data->response_body_size = strlen (master_m3u8_playlist);
-        buf = g_strdup_printf (http_200,
-                PACKAGE_NAME,
-                PACKAGE_VERSION,
-                "application/vnd.apple.mpegurl",
-                strlen (master_m3u8_playlist),
-                CACHE_3600s,
-                master_m3u8_playlist);
-        g_free (master_m3u8_playlist);
-
-    } else {
-        buf = NULL;
-    }
-
-    return buf;
-}
-
-static gboolean is_channel_playlist_url_valid (RequestData *request_data)
-{
-    GRegex *regex;
-    gboolean result;
-
-    regex = g_regex_new ("^/[^/]*/encoder/[0-9]/playlist.m3u8$", G_REGEX_OPTIMIZE, 0, NULL);
-    if (g_regex_match (regex, request_data->uri, 0, NULL)) {
-        result = TRUE;
-
-    } else {
-        result = FALSE;
+    if (master_m3u8_playlist == NULL) {
+        return FALSE;
     }
-    g_regex_unref (regex);
+    httpserver_response_ok (request_data,
+                            response,
+                            HTTP_CONTENT_TYPE_M3U8,
+                            CACHE_3600s,
+                            master_m3u8_playlist,
+                            strlen (master_m3u8_playlist),
+                            g_free);
 
-    return result;
+    return TRUE;
 }
 
-static gchar * get_m3u8playlist (RequestData *request_data, EncoderOutput *encoder_output)
+static gchar * get_m3u8playlist (RequestData *request_data, URIRoute *route, EncoderOutput *encoder_output)
 {
     gchar *m3u8playlist = NULL;
     gchar *start, *end;
     gint64 now;
 
-    if (!is_channel_playlist_url_valid (request_data)) {
+    if (route->type != URI_TYPE_ENCODER_PLAYLIST) {
         GST_WARNING ("bad request url: %s", request_data->uri);
         return NULL;
     }
@@ -648,8 +580,8 @@ static void access_log (RequestData *request_data)
 
     user_agent = "-";
     for (i = 0; i < request_data->num_headers; i++) {
-        if (g_strcmp0 (request_data->headers[i].name, "User-Agent") == 0) {
-            user_agent = request_data->headers[i].value;
+        if (g_ascii_strcasecmp (http_header_name (request_data, i), "User-Agent") == 0) {
+            user_agent = http_header_value (request_data, i);
             break;
         }
     }
@@ -678,52 +610,48 @@ static GstClockTime http_request_process (HTTPStreaming *httpstreaming, RequestD
     EncoderOutput *encoder_output;
     GstClock *system_clock = httpstreaming->httpserver->system_clock;
     HTTPStreamingPrivateData *priv_data;
-    gchar *buf = NULL;
-    gsize buf_size;
-    gint ret;
+    HTTPResponse response;
+    gssize ret;
     gboolean http_progress_play_request = FALSE, dvr_download_request = FALSE;
+    URIRoute route;
+    Job *job = NULL;
 
-    encoder_output = gstreamill_get_encoder_output (httpstreaming->gstreamill, request_data->uri);
-    if (encoder_output == NULL) {
-        /* crossdomain request? */
-        buf = request_crossdomain (request_data);
-
-        /* master m3u8 playlist request? */
-        if ((buf == NULL) && g_str_has_suffix (request_data->uri, "playlist.m3u8")) {
-            buf = request_master_m3u8_playlist (httpstreaming, request_data);
-            request_data->response_status = 200;
+    /* resolve job handle once, it is carried by the request until finished */
+    encoder_output = NULL;
+    if (gstreamill_uri_route (request_data->uri, &route) && (route.encoder_index != -1)) {
+        job = gstreamill_route_job (httpstreaming->gstreamill, &route);
+    }
+    if (job != NULL) {
+        encoder_output = gstreamill_get_encoder_output (httpstreaming->gstreamill, job, route.encoder_index);
+        if (encoder_output == NULL) {
+            g_object_unref (job);
+            job = NULL;
         }
-
-        /* 404 not found */
-        if (buf == NULL) {
-            buf = g_strdup_printf (http_404, PACKAGE_NAME, PACKAGE_VERSION);
-            request_data->response_status = 404;
-            request_data->response_body_size = http_404_body_size;
+    }
+    if (encoder_output == NULL) {
+        /* crossdomain request or master m3u8 playlist request? otherwise 404 not found */
+        if (!request_crossdomain (request_data, &response) &&
+            !(g_str_has_suffix (request_data->uri, "playlist.m3u8") &&
+              request_master_m3u8_playlist (httpstreaming, request_data, &response))) {
+            httpserver_response_status (request_data, &response, 404);
         }
 
-        buf_size = strlen (buf);
-
     } else if (!is_encoder_output_ready (encoder_output)) {
         /* not ready */
         GST_WARNING ("%s not ready.", request_data->uri);
-        buf = g_strdup_printf (http_404, PACKAGE_NAME, PACKAGE_VERSION);
-        request_data->response_status = 404;
-        request_data->response_body_size = http_404_body_size;
-        buf_size = strlen (buf);
+        httpserver_response_status (request_data, &response, 404);
 
     } else if (g_str_has_suffix (request_data->uri, ".ts")) {
         /* get mpeg2 transport stream segment */
-        buf_size = get_mpeg2ts_segment (request_data, encoder_output, &buf);
+        get_mpeg2ts_segment (request_data, encoder_output, &response);
 
     } else if (g_str_has_suffix (request_data->uri, "playlist.m3u8")) {
         /* get m3u8 playlist */
-        gchar *m3u8playlist, *cache_control;
+        gchar *m3u8playlist, cache_control[32];
 
-        m3u8playlist = get_m3u8playlist (request_data, encoder_output);
+        m3u8playlist = get_m3u8playlist (request_data, &route, encoder_output);
         if (m3u8playlist == NULL) {
-            buf = g_strdup_printf (http_404, PACKAGE_NAME, PACKAGE_VERSION);
-            request_data->response_status = 404;
-            request_data->response_body_size = http_404_body_size;
+            httpserver_response_status (request_data, &response, 404);
 
         } else {
             if ((g_strrstr (request_data->parameters, "position") != NULL) &&
@@ -734,69 +662,60 @@ static GstClockTime http_request_process (HTTPStreaming *httpstreaming, RequestD
                     encoder_output->dvr_duration +
                     3600 - /* remove an hour record */
                     g_get_real_time () / 1000000;
-                cache_control = g_strdup_printf ("max-age=%lu", age);
+                g_snprintf (cache_control, sizeof (cache_control), "max-age=%lu", age);
 
             } else {
-                cache_control = g_strdup_printf ("max-age=%lu", encoder_output->segment_duration / GST_SECOND);
+                g_snprintf (cache_control, sizeof (cache_control), "max-age=%lu", encoder_output->segment_duration / GST_SECOND);
             }
-            buf = g_strdup_printf (http_200,
-                    PACKAGE_NAME,
-                    PACKAGE_VERSION,
-                    "application/vnd.apple.mpegurl",
-                    strlen (m3u8playlist),
-                    cache_control,
-                    m3u8playlist);
-            request_data->response_status = 200;
-            request_data->response_body_size = strlen (m3u8playlist);
-            g_free (cache_control);
-            g_free (m3u8playlist);
+            httpserver_response_ok (request_data,
+                                    &response,
+                                    HTTP_CONTENT_TYPE_M3U8,
+                                    cache_control,
+                                    m3u8playlist,
+                                    strlen (m3u8playlist),
+                                    g_free);
         }
-        buf_size = strlen (buf);
 
     /* http progressive streaming request? */
-    } else if (is_http_progress_play_request (request_data)) {
-        buf = g_strdup_printf (http_chunked, PACKAGE_NAME, PACKAGE_VERSION);
-        buf_size = strlen (buf);
+    } else if (is_http_progress_play_request (request_data, &route)) {
+        httpserver_response_chunked (request_data, &response);
         http_progress_play_request = TRUE;
-        request_data->response_status = 200;
-        request_data->response_body_size = 0;
 
     /* is dvr download request? */
-    } else if ((buf == NULL) && is_dvr_download_request (request_data, encoder_output)) {
+    } else if (is_dvr_download_request (request_data, &route, encoder_output)) {
         priv_data = request_data->priv_data;
-        buf = g_strdup_printf (http_200,
-                PACKAGE_NAME,
-                PACKAGE_VERSION,
-                "video/mpeg",
-                priv_data->dvr_download_size,
-                "private",
-                "");
-        request_data->response_status = 200;
-        request_data->response_body_size = priv_data->dvr_download_size;
+        priv_data->job = job;
+        priv_data->route = route;
+        priv_data->encoder_output = encoder_output;
+        /* header only, segments are sent by dvr_download */
+        httpserver_response_ok (request_data, &response, HTTP_CONTENT_TYPE_MPEGTS, "private", NULL, priv_data->dvr_download_size, NULL);
         dvr_download_request = TRUE;
-        buf_size = strlen (buf);
 
     } else {
-        buf = g_strdup_printf (http_404, PACKAGE_NAME, PACKAGE_VERSION);
-        request_data->response_status = 404;
-        request_data->response_body_size = http_404_body_size;
-        buf_size = strlen (buf);
+        httpserver_response_status (request_data, &response, 404);
     }
 
-    /* write out buf */
-    ret = write (request_data->sock, buf, buf_size);
-    if (((ret > 0) && (ret != buf_size)) || ((ret == -1) && (errno == EAGAIN))) {
+    /* write out header and body */
+    ret = httpserver_response_send (request_data->sock, &response);
+    count_sent_bytes (encoder_output, ret);
+    if (((ret > 0) && !httpserver_response_sent (&response)) || ((ret == -1) && (errno == EAGAIN))) {
         /* send not completed or socket block, resend late */
-        priv_data = (HTTPStreamingPrivateData *)g_malloc (sizeof (HTTPStreamingPrivateData));
-        priv_data->buf = buf;
-        priv_data->buf_size = buf_size;
-        priv_data->job = NULL;
-        priv_data->send_position = ret > 0? ret : 0;
+        if (dvr_download_request) {
+            priv_data = request_data->priv_data;
+
+        } else {
+            priv_data = (HTTPStreamingPrivateData *)g_malloc (sizeof (HTTPStreamingPrivateData));
+            priv_data->segment_list = NULL;
+            priv_data->viewer = FALSE;
+        }
+        priv_data->response = g_new (HTTPResponse, 1);
+        *(priv_data->response) = response;
+        priv_data->job = job;
+        priv_data->route = route;
         priv_data->encoder_output = encoder_output;
-        priv_data->segment_list = NULL;
         request_data->priv_data = priv_data;
         if (http_progress_play_request) {
-            http_progress_play_priv_data_init (httpstreaming, request_data, priv_data);
+            http_progress_play_priv_data_init (request_data, priv_data, job, encoder_output);
             priv_data->rap_addr = *(encoder_output->last_rap_addr);
         }
         return ret > 0? 10 * GST_MSECOND + g_random_int_range (1, 1000000) : GST_CLOCK_TIME_NONE;
@@ -806,30 +725,38 @@ static GstClockTime http_request_process (HTTPStreaming *httpstreaming, RequestD
     }
 
     /* send complete or socket error */
-    g_free (buf);
+    httpserver_response_clear (&response);
 
     /* http progress play request and send complete? */
-    if ((http_progress_play_request) && (ret == buf_size)) {
+    if ((http_progress_play_request) && httpserver_response_sent (&response)) {
         priv_data = (HTTPStreamingPrivateData *)g_malloc (sizeof (HTTPStreamingPrivateData));
-        http_progress_play_priv_data_init (httpstreaming, request_data, priv_data);
-        priv_data->encoder_output = encoder_output;
+        http_progress_play_priv_data_init (request_data, priv_data, job, encoder_output);
+        priv_data->route = route;
         priv_data->rap_addr = *(encoder_output->last_rap_addr);
-        priv_data->send_position = *(encoder_output->last_rap_addr) + 12;
-        priv_data->buf = NULL;
+        priv_data->send_position = *(encoder_output->last_rap_addr) + ENCODER_GOP_HEADER_SIZE;
+        priv_data->response = NULL;
         priv_data->segment_list = NULL;
         request_data->priv_data = priv_data;
         return gst_clock_get_time (system_clock);
     }
 
     /* dvr download request? */
-    if ((dvr_download_request) && (ret == buf_size)) {
+    if ((dvr_download_request) && httpserver_response_sent (&response)) {
         return gst_clock_get_time (system_clock);
     }
 
     access_log (request_data);
 
-    if (encoder_output != NULL) {
-        gstreamill_unaccess (httpstreaming->gstreamill, request_data->uri);
+    /* dvr download request and send error */
+    if (dvr_download_request) {
+        priv_data = request_data->priv_data;
+        g_slist_free_full (priv_data->segment_list, g_free);
+        g_free (priv_data);
+        request_data->priv_data = NULL;
+    }
+
+    if (job != NULL) {
+        gstreamill_unaccess (httpstreaming->gstreamill, job);
     }
 
     return 0;
@@ -872,6 +799,23 @@ static gint send_data (EncoderOutput *encoder_output, RequestData *request_data)
     return ret;
 }
 
+/*
+ * position between head and tail of cache, still valid after the cache is continued by a restarted worker.
+ */
+static gboolean is_cache_position (EncoderOutput *encoder_output, guint64 position)
+{
+    guint64 head, tail;
+
+    head = *(encoder_output->head_addr);
+    tail = *(encoder_output->tail_addr);
+    if (head <= tail) {
+        return (position >= head) && (position <= tail);
+
+    } else {
+        return (position >= head) || (position <= tail);
+    }
+}
+
 static GstClockTime send_chunk (EncoderOutput *encoder_output, RequestData *request_data)
 {
     HTTPStreamingPrivateData *priv_data;
@@ -910,11 +854,12 @@ static GstClockTime send_chunk (EncoderOutput *encoder_output, RequestData *requ
     if (priv_data->send_position == current_gop_end_addr) {
         /* next gop. */
         priv_data->rap_addr = current_gop_end_addr;
-        if (priv_data->send_position + 12 < encoder_output->cache_size) {
-            priv_data->send_position += 12;
+        encoder_output_rap_trace (encoder_output, priv_data->rap_addr, &(priv_data->gop_ingest_time), &(priv_data->gop_open_time));
+        if (priv_data->send_position + ENCODER_GOP_HEADER_SIZE < encoder_output->cache_size) {
+            priv_data->send_position += ENCODER_GOP_HEADER_SIZE;
 
         } else {
-            priv_data->send_position = priv_data->send_position + 12 - encoder_output->cache_size;
+            priv_data->send_position = priv_data->send_position + ENCODER_GOP_HEADER_SIZE - encoder_output->cache_size;
         }
         current_gop_end_addr = get_current_gop_end (encoder_output, priv_data);
     }
@@ -972,6 +917,11 @@ static GstClockTime send_chunk (EncoderOutput *encoder_output, RequestData *requ
     } else {
         priv_data->send_count += ret;
         request_data->bytes_send += ret;
+        count_sent_bytes (encoder_output, ret);
+        if ((ret > 0) && (priv_data->gop_open_time != 0)) {
+            trace_first_byte (encoder_output, priv_data->gop_ingest_time, priv_data->gop_open_time);
+            priv_data->gop_open_time = 0;
+        }
     }
     if (priv_data->send_count == priv_data->chunk_size + priv_data->chunk_size_str_len + 2) {
         /* send complete, wait 10 ms. */
@@ -986,7 +936,7 @@ static GstClockTime send_chunk (EncoderOutput *encoder_output, RequestData *requ
     }
 }
 
-static GstClockTime dvr_download (RequestData *request_data, GstClock *system_clock)
+static GstClockTime dvr_download (HTTPStreaming *httpstreaming, RequestData *request_data, GstClock *system_clock)
 {
     HTTPStreamingPrivateData *priv_data;
     gchar *path;
@@ -1012,6 +962,7 @@ static GstClockTime dvr_download (RequestData *request_data, GstClock *system_cl
             priv_data->segment_size - priv_data->segment_position);
     if (ret >= 0) {
         priv_data->segment_position += ret;
+        count_sent_bytes (priv_data->encoder_output, ret);
         /* sent segment complete? */
         if (priv_data->segment_position == priv_data->segment_size) {
             g_free (priv_data->segment);
@@ -1037,6 +988,9 @@ static GstClockTime dvr_download (RequestData *request_data, GstClock *system_cl
 
 download_finish:
     access_log (request_data);
+    if (priv_data->job != NULL) {
+        gstreamill_unaccess (httpstreaming->gstreamill, priv_data->job);
+    }
     g_slist_free_full (priv_data->segment_list, g_free);
     g_free (priv_data);
     request_data->priv_data = NULL;
@@ -1049,37 +1003,39 @@ static GstClockTime http_continue_process (HTTPStreaming *httpstreaming, Request
     HTTPStreamingPrivateData *priv_data;
     EncoderOutput *encoder_output;
     GstClock *system_clock = httpstreaming->httpserver->system_clock;
-    gint ret;
+    gssize ret;
 
     priv_data = request_data->priv_data;
     encoder_output = priv_data->encoder_output;
 
-    if (priv_data->buf != NULL) {
-        ret = write (request_data->sock,
-                priv_data->buf + priv_data->send_position,
-                priv_data->buf_size - priv_data->send_position);
+    if (priv_data->response != NULL) {
+        ret = httpserver_response_send (request_data->sock, priv_data->response);
+        count_sent_bytes (encoder_output, ret);
         /* send complete or send error */
-        if ((ret + priv_data->send_position == priv_data->buf_size) ||
-                ((ret == -1) && (errno != EAGAIN))) {
-            if ((ret == -1) && (errno != EAGAIN)) {
+        if (httpserver_response_sent (priv_data->response) || ((ret == -1) && (errno != EAGAIN))) {
+            if (ret == -1) {
                 GST_ERROR ("Write sock error: %s", g_strerror (errno));
             }
-            g_free (priv_data->buf);
-            priv_data->buf = NULL;
+            httpserver_response_clear (priv_data->response);
+            g_free (priv_data->response);
+            priv_data->response = NULL;
 
             /* progressive play? continue */
-            if (is_http_progress_play_request (request_data)) {
-                priv_data->send_position = *(encoder_output->last_rap_addr) + 12;
-                priv_data->buf = NULL;
+            if (is_http_progress_play_request (request_data, &(priv_data->route))) {
+                priv_data->send_position = *(encoder_output->last_rap_addr) + ENCODER_GOP_HEADER_SIZE;
                 return gst_clock_get_time (system_clock);
             }
 
-            if (encoder_output != NULL) {
-                gstreamill_unaccess (httpstreaming->gstreamill, request_data->uri);
+            /* dvr download? continue */
+            if ((ret != -1) && (priv_data->segment_list != NULL)) {
+                return gst_clock_get_time (system_clock);
             }
 
             if (priv_data->job != NULL) {
-                g_object_unref (priv_data->job);
+                gstreamill_unaccess (httpstreaming->gstreamill, priv_data->job);
+            }
+            if (priv_data->segment_list != NULL) {
+                g_slist_free_full (priv_data->segment_list, g_free);
             }
             g_free (priv_data);
             request_data->priv_data = NULL;
@@ -1088,28 +1044,48 @@ static GstClockTime http_continue_process (HTTPStreaming *httpstreaming, Request
 
         } else if ((ret > 0) || ((ret == -1) && (errno == EAGAIN))) {
             /* send not completed or socket block, resend late */
-            priv_data->send_position += ret > 0? ret : 0;
             return ret > 0? 10 * GST_MSECOND + g_random_int_range (1, 1000000) : GST_CLOCK_TIME_NONE;
         }
     }
 
     if (priv_data->segment_list != NULL) {
-        return dvr_download (request_data, system_clock);
+        return dvr_download (httpstreaming, request_data, system_clock);
     }
 
-    if ((priv_data->livejob_age != priv_data->job->age) ||
-            (*(priv_data->job->output->state) != JOB_STATE_PLAYING)) {
-        if (priv_data->encoder_output != NULL) {
-            gstreamill_unaccess (httpstreaming->gstreamill, request_data->uri);
-        }
+    if ((*(priv_data->job->output->state) == JOB_STATE_STOPED) ||
+            ((priv_data->livejob_age != priv_data->job->age) && !is_cache_position (encoder_output, priv_data->send_position))) {
+        viewer_leave (priv_data);
         if (priv_data->job != NULL) {
-            g_object_unref (priv_data->job);
+            gstreamill_unaccess (httpstreaming->gstreamill, priv_data->job);
         }
         g_free (request_data->priv_data);
         request_data->priv_data = NULL;
         return 0;
     }
 
+    if (*(priv_data->job->output->state) != JOB_STATE_PLAYING) {
+        GstClockTime now, gop_duration;
+
+        /* live job is restarting, cache is continued by new worker, keep the viewer for a while. */
+        now = gst_clock_get_time (system_clock);
+        gop_duration = encoder_output->segment_duration != 0 ? encoder_output->segment_duration : VIEWER_WAIT_GOP_DURATION;
+        if (priv_data->not_playing_since == 0) {
+            priv_data->not_playing_since = now;
+
+        } else if (now - priv_data->not_playing_since > VIEWER_WAIT_GOPS * gop_duration) {
+            GST_WARNING ("job %s not playing for %" GST_TIME_FORMAT ", drop viewer",
+                    priv_data->job->name, GST_TIME_ARGS (now - priv_data->not_playing_since));
+            viewer_leave (priv_data);
+            gstreamill_unaccess (httpstreaming->gstreamill, priv_data->job);
+            g_free (request_data->priv_data);
+            request_data->priv_data = NULL;
+            return 0;
+        }
+        return now + 500 * GST_MSECOND + g_random_int_range (1, 1000000);
+    }
+    priv_data->not_playing_since = 0;
+    priv_data->livejob_age = priv_data->job->age;
+
     if (priv_data->send_position == *(encoder_output->tail_addr)) {
         /* no more stream, wait 10ms */
         GST_DEBUG ("current:%lu == tail:%lu", priv_data->send_position, *(encoder_output->tail_addr));
@@ -1119,15 +1095,45 @@ static GstClockTime http_continue_process (HTTPStreaming *httpstreaming, Request
     return send_chunk (encoder_output, request_data) + gst_clock_get_time (system_clock);
 }
 
+/* route of request for latency metrics */
+static MetricsRoute request_route (RequestData *request_data)
+{
+    URIRoute route;
+
+    if (!gstreamill_uri_route (request_data->uri, &route)) {
+        return METRICS_ROUTE_OTHER;
+    }
+    switch (route.type) {
+        case URI_TYPE_MASTER_PLAYLIST:
+            return METRICS_ROUTE_MASTER_PLAYLIST;
+
+        case URI_TYPE_ENCODER_PLAYLIST:
+            return METRICS_ROUTE_PLAYLIST;
+
+        case URI_TYPE_ENCODER:
+            return is_http_progress_play_request (request_data, &route) ? METRICS_ROUTE_PROGRESSIVE : METRICS_ROUTE_DVR_DOWNLOAD;
+
+        case URI_TYPE_ENCODER_OTHER:
+            return g_str_has_suffix (request_data->uri, ".ts") ? METRICS_ROUTE_SEGMENT : METRICS_ROUTE_OTHER;
+
+        default:
+            return METRICS_ROUTE_OTHER;
+    }
+}
+
 static GstClockTime httpstreaming_dispatcher (gpointer data, gpointer user_data)
 {
     RequestData *request_data = data;
     HTTPStreaming *httpstreaming = (HTTPStreaming *)user_data;
     HTTPStreamingPrivateData *priv_data;
+    GstClockTime ret;
 
     switch (request_data->status) {
         case HTTP_REQUEST:
-            return http_request_process (httpstreaming, request_data);
+            ret = http_request_process (httpstreaming, request_data);
+            metrics_histogram_observe (&(httpstreaming->gstreamill->metrics.request_latency[request_route (request_data)]),
+                    (gst_clock_get_time (httpstreaming->httpserver->system_clock) - request_data->birth_time) / GST_USECOND);
+            return ret;
 
         case HTTP_CONTINUE:
             return http_continue_process (httpstreaming, request_data);
@@ -1135,14 +1141,13 @@ static GstClockTime httpstreaming_dispatcher (gpointer data, gpointer user_data)
         case HTTP_FINISH:
             if (request_data->priv_data != NULL) {
                 priv_data = request_data->priv_data;
-                if (priv_data->encoder_output != NULL) {
-                    gstreamill_unaccess (httpstreaming->gstreamill, request_data->uri);
-                }
+                viewer_leave (priv_data);
                 if (priv_data->job != NULL) {
-                    g_object_unref (priv_data->job);
+                    gstreamill_unaccess (httpstreaming->gstreamill, priv_data->job);
                 }
-                if (priv_data->buf != NULL) {
-                    g_free (priv_data->buf);
+                if (priv_data->response != NULL) {
+                    httpserver_response_clear (priv_data->response);
+                    g_free (priv_data->response);
                 }
                 if (priv_data->segment_list != NULL) {
                     g_slist_free_full (priv_data->segment_list, g_free);
@@ -15,8 +15,10 @@
 #include "gstreamill.h"
 
 typedef struct _HTTPStreamingPrivateData {
-    Job *job;
+    Job *job; /* job handle of the request, released by gstreamill_unaccess */
+    URIRoute route;
     gint64 livejob_age;
+    GstClockTime not_playing_since; /* progressive viewer waiting for job restart, 0 if playing */
     gint64 rap_addr;
     gint64 send_position;
     gint chunk_size;
@@ -24,8 +26,10 @@ typedef struct _HTTPStreamingPrivateData {
     gint chunk_size_str_len;
     gint send_count;
     gpointer encoder_output;
-    gchar *buf;
-    gsize buf_size;
+    gboolean viewer; /* counted in viewers of encoder output */
+    gint64 gop_ingest_time; /* latency trace stamps of gop at rap_addr */
+    gint64 gop_open_time; /* 0 if first byte of the gop traced */
+    HTTPResponse *response; /* response not sent completely, NULL if none */
     GSList *segment_list;
     gint64 dvr_download_size;
     guint list_index;
@@ -21,6 +21,7 @@
 #include "utils.h"
 #include "jobdesc.h"
 #include "job.h"
+#include "passthrough.h"
 
 GST_DEBUG_CATEGORY_EXTERN (GSTREAMILL);
 #define GST_CAT_DEFAULT GSTREAMILL
@@ -56,11 +57,10 @@ static void job_class_init (JobClass *jobclass)
             );
     g_object_class_install_property (g_object_class, JOB_PROP_NAME, param);
 
-    param = g_param_spec_string (
-            "job",
-            "job",
-            "job description of json type",
-            NULL,
+    param = g_param_spec_pointer (
+            "jobdesc",
+            "jobdesc",
+            "parsed job description, owned by job",
             G_PARAM_WRITABLE | G_PARAM_READABLE
             );
     g_object_class_install_property (g_object_class, JOB_PROP_DESCRIPTION, param);
@@ -81,6 +81,8 @@ static void job_init (Job *job)
     g_object_set (job->system_clock, "clock-type", GST_CLOCK_TYPE_REALTIME, NULL);
     job->encoder_array = g_array_new (FALSE, FALSE, sizeof (gpointer));
     g_mutex_init (&(job->access_mutex));
+    job->event_fd = -1;
+    job->zygote = FALSE;
 }
 
 static void job_set_property (GObject *obj, guint prop_id, const GValue *value, GParamSpec *pspec)
@@ -93,7 +95,8 @@ static void job_set_property (GObject *obj, guint prop_id, const GValue *value,
             break;
 
         case JOB_PROP_DESCRIPTION:
-            JOB (obj)->description = (gchar *)g_value_dup_string (value);
+            JOB (obj)->jobdesc = (JobDesc *)g_value_get_pointer (value);
+            JOB (obj)->description = JOB (obj)->jobdesc->description;
             break;
 
         case JOB_PROP_EXEPATH:
@@ -116,7 +119,7 @@ static void job_get_property (GObject *obj, guint prop_id, GValue *value, GParam
             break;
 
         case JOB_PROP_DESCRIPTION:
-            g_value_set_string (value, job->description);
+            g_value_set_pointer (value, job->jobdesc);
             break;
 
         case JOB_PROP_EXEPATH:
@@ -137,6 +140,11 @@ static void job_dispose (GObject *obj)
     gint i;
     gchar *name_hexstr;
 
+    if (job->event_fd != -1) {
+        g_close (job->event_fd, NULL);
+        job->event_fd = -1;
+    }
+
     if (job->output == NULL) {
         return;
     }
@@ -167,26 +175,31 @@ static void job_dispose (GObject *obj)
             }
         }
     }
+    g_free (output->source.stream_names);
+    for (i = 0; i < output->encoder_count; i++) {
+        g_free (output->encoders[i].stream_names);
+    }
     g_free (output->encoders);
 
     /* free share memory */
     if (job->output_fd != -1) {
         g_close (job->output_fd, NULL);
         GST_WARNING ("munmap job %s's shm", job->name);
-        if (munmap (output->job_description, job->output_size) == -1) {
+        if (munmap (output->header, job->output_size) == -1) {
             GST_ERROR ("munmap %s error: %s", job->name, g_strerror (errno));
         }
         name_hexstr = unicode_file_name_2_shm_name (job->name);
         GST_WARNING ("shm_unlink job %s's shm", job->name);
-        if (shm_unlink (name_hexstr) == -1) {
+        if (output_shm_unlink (name_hexstr, job->huge_pages) == -1) {
             GST_ERROR ("shm_unlink %s error: %s", job->name, g_strerror (errno));
         }
         g_free (name_hexstr);
     }
     g_free (output);
 
-    if (job->description != NULL) {
-        g_free (job->description);
+    if (job->jobdesc != NULL) {
+        jobdesc_free (job->jobdesc);
+        job->jobdesc = NULL;
         job->description = NULL;
     }
 
@@ -245,38 +258,178 @@ GType job_get_type (void)
     return type;
 }
 
-static gsize status_output_size (gchar *job)
+static guint encoder_bitrate (JobDesc *jobdesc, gint index)
+{
+    gchar *value, *pipeline, **bins, *p, **pp;
+    guint v_bitrate, a_bitrate, ts_bitrate, a_count;
+
+    v_bitrate = a_bitrate = ts_bitrate = 0;
+    pipeline = g_strdup_printf ("encoder.%d", index);
+    pp = bins = jobdesc_bins (jobdesc, pipeline);
+    while (*pp != NULL) {
+       if (g_strrstr (*pp, "x264enc") != NULL) {
+           /* default bitrate of x264enc is 2048kbps */
+           v_bitrate = 2048;
+
+       } else if (g_strrstr (*pp, "voaacenc") != NULL) {
+           /* default bitrate of voaacenc is 128kbps */
+           a_bitrate = 128;
+       }
+       pp++;
+    }
+    g_free (pipeline);
+    g_strfreev (bins);
+
+    p = g_strdup_printf ("encoder.%d.elements.x264enc.property.bitrate", index);
+    value = jobdesc_element_property_value (jobdesc, p);
+    g_free (p);
+    if (value != NULL) {
+        v_bitrate = g_strtod (value, NULL);
+        g_free (value);
+    }
+
+    p = g_strdup_printf ("encoder.%d.elements.voaacenc.property.bitrate", index);
+    value = jobdesc_element_property_value (jobdesc, p);
+    g_free (p);
+    if (value != NULL) {
+        a_bitrate = g_strtod (value, NULL) / 1000;
+        g_free (value);
+    }
+
+    p = g_strdup_printf ("encoder.%d.elements.tssegment.property.bitrate", index);
+    value = jobdesc_element_property_value (jobdesc, p);
+    g_free (p);
+    if (value != NULL) {
+        ts_bitrate = g_strtod (value, NULL);
+        g_free (value);
+    }
+
+    if ((v_bitrate != 0) || (a_bitrate != 0)) {
+        a_count = jobdesc_astreams_count (jobdesc, index);
+        if (v_bitrate != 0) {
+            ts_bitrate = v_bitrate + a_bitrate * a_count;
+
+        } else if ((ts_bitrate == 0) && (a_bitrate != 0)) {
+            ts_bitrate = a_bitrate * a_count;
+        }
+    }
+
+    return ts_bitrate;
+}
+
+/*
+ * encoder_cache_size:
+ * @jobdesc: (in): job description
+ * @index: (in): encoder index
+ *
+ * cache size of encoder output, cache-size of the encoder in MB, or bitrate x cache-duration of the job,
+ * otherwise SHM_SIZE, clamped to [SHM_MIN_SIZE, SHM_MAX_SIZE].
+ *
+ * Returns: cache size in bytes, page aligned.
+ */
+static guint64 encoder_cache_size (JobDesc *jobdesc, gint index)
+{
+    guint64 size, duration;
+    guint bitrate;
+
+    size = jobdesc_encoder_cache_size (jobdesc, index) * 1024 * 1024;
+    if (size == 0) {
+        duration = jobdesc_cache_duration (jobdesc);
+        bitrate = encoder_bitrate (jobdesc, index);
+        if ((duration != 0) && (bitrate != 0)) {
+            /* kbps to bytes, plus 25% for mpegts overhead and bitrate fluctuation */
+            size = (guint64)bitrate * 1000 / 8 * duration * 5 / 4;
+
+        } else {
+            size = SHM_SIZE;
+        }
+    }
+    if (size < SHM_MIN_SIZE) {
+        size = SHM_MIN_SIZE;
+
+    } else if (size > SHM_MAX_SIZE) {
+        GST_WARNING ("encoder %d cache size %" G_GUINT64_FORMAT " too large, clamped to %" G_GUINT64_FORMAT,
+                index, size, SHM_MAX_SIZE);
+        size = SHM_MAX_SIZE;
+    }
+
+    return (size + 4095) & ~((guint64)4095);
+}
+
+/*
+ * status_output_size:
+ * @jobdesc: (in): job description
+ *
+ * layout of job output share memory, every part is cache line aligned, cache is page aligned:
+ * header, job description, job state, source streams state, profiler, encoders output, string table.
+ *
+ * Returns: size of job output.
+ */
+static gsize status_output_size (JobDesc *jobdesc)
 {
     gsize size;
     gint i;
+    gint64 stream_count;
     gchar *pipeline;
 
-    size = (strlen (job) / 8 + 1) * 8; /* job description, 64 bit alignment */
-    size += sizeof (guint64); /* state */
-    size += sizeof (gint64); /* duration for transcode */
-    size += jobdesc_streams_count (job, "source") * sizeof (struct _SourceStreamState);
-    for (i = 0; i < jobdesc_encoders_count (job); i++) {
-        size += 64; /* encoder codec */
-        size += sizeof (GstClockTime); /* encoder output heartbeat */
-        size += sizeof (gboolean); /* end of stream */
+    size = sizeof (JobOutputHeader);
+    size += CACHE_LINE_ALIGN (strlen (jobdesc->description) + 1); /* job description */
+    size += CACHE_LINE_SIZE; /* state and duration for transcode, written by master and worker */
+    stream_count = jobdesc_streams_count (jobdesc, "source");
+    size += stream_count * sizeof (SourceStreamState);
+    size += sizeof (ProfilerOutput); /* per element cost, written by worker if the job is profiled */
+    for (i = 0; i < jobdesc_encoders_count (jobdesc); i++) {
+        size += CACHE_LINE_SIZE; /* encoder codec */
+        size += CACHE_LINE_SIZE; /* encoder output heartbeat, end of stream and total count */
+        size += CACHE_LINE_SIZE; /* cache head, cache tail and last rap (random access point) */
+        size += sizeof (EncoderEventRing); /* events to master */
+        size += sizeof (EncoderOutputStats); /* encoder counters */
         pipeline = g_strdup_printf ("encoder.%d", i);
-        size += jobdesc_streams_count (job, pipeline) * sizeof (struct _EncoderStreamState); /* encoder state */
+        stream_count += jobdesc_streams_count (jobdesc, pipeline);
+        size += jobdesc_streams_count (jobdesc, pipeline) * sizeof (EncoderStreamState); /* encoder state */
         g_free (pipeline);
-        size += sizeof (guint64); /* cache head */
-        size += sizeof (guint64); /* cache tail */
-        size += sizeof (guint64); /* last rap (random access point) */
-        size += sizeof (guint64); /* total count */
         /* nonlive job has no output */
-        if (!jobdesc_is_live (job)) {
+        if (!jobdesc_is_live (jobdesc)) {
             continue;
         }
         /* output share memory */
-        size += SHM_SIZE;
+        size = (size + 4095) & ~((gsize)4095);
+        size += encoder_cache_size (jobdesc, i);
     }
+    size += stream_count * STREAM_NAME_LEN; /* string table of stream names */
 
     return size;
 }
 
+/**
+ * job_output_check:
+ * @shm_p: (in): job output share memory.
+ * @size: (in): size of the share memory.
+ *
+ * check compatibility of job output layout, called when a worker attach to the share memory.
+ *
+ * Returns: 0 if compatible.
+ */
+gint job_output_check (gchar *shm_p, gsize size)
+{
+    JobOutputHeader *header = (JobOutputHeader *)shm_p;
+
+    if (header->magic != JOB_OUTPUT_MAGIC) {
+        GST_ERROR ("job output magic mismatch: %x", header->magic);
+        return 1;
+    }
+    if (header->version != JOB_OUTPUT_VERSION) {
+        GST_ERROR ("job output layout version %u, expect %u", header->version, JOB_OUTPUT_VERSION);
+        return 2;
+    }
+    if (header->size != size) {
+        GST_ERROR ("job output size %" G_GUINT64_FORMAT ", expect %" G_GSIZE_FORMAT, header->size, size);
+        return 3;
+    }
+
+    return 0;
+}
+
 gchar * job_state_get_name (guint64 state)
 {
     switch (state) {
@@ -307,13 +460,21 @@ gchar * job_state_get_name (guint64 state)
  */
 gint job_initialize (Job *job, gint mode, gint shm_fd, gchar *shm_p)
 {
-    gint i, fd;
+    gint i, j, fd;
     JobOutput *output;
-    gchar *name, *p, *name_hexstr, *semaphore_name;
+    gchar *name, *p, *base, *name_hexstr, *semaphore_name;
+    guint64 string_table;
     struct timespec ts;
     sem_t *semaphore;
 
-    job->output_size = status_output_size (job->description);
+    job->output_size = status_output_size (job->jobdesc);
+    if (job->huge_pages) {
+        gsize page_size;
+
+        /* hugetlbfs file size must be multiple of huge page size */
+        page_size = huge_page_size ();
+        job->output_size = (job->output_size + page_size - 1) / page_size * page_size;
+    }
     name_hexstr = unicode_file_name_2_shm_name (job->name);
     semaphore_name = g_strdup_printf ("/%s", name_hexstr);
     semaphore = sem_open (semaphore_name, O_CREAT, 0644, 1);
@@ -341,59 +502,65 @@ gint job_initialize (Job *job, gint mode, gint shm_fd, gchar *shm_p)
     }
 
     /* subprocess? */
+    fd = -1;
     if (shm_p != NULL) {
+        if (job_output_check (shm_p, job->output_size) != 0) {
+            GST_ERROR ("job %s output incompatible", job->name);
+            goto failure;
+        }
         p = shm_p;
-        fd = shm_fd;
+        job->output_fd = shm_fd;
 
-    } if (mode != SINGLE_JOB_MODE) {
+    } else if (mode != SINGLE_JOB_MODE) {
         /* not single job mode, use share memory */
-        fd = shm_open (name_hexstr, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+        fd = output_shm_open (name_hexstr, job->huge_pages);
         if (fd == -1) {
             GST_ERROR ("shm_open %s failure: %s", name_hexstr, g_strerror (errno));
-            job->output = NULL;
-            g_free (name_hexstr);
-            g_free (semaphore_name);
-            sem_post (semaphore);
-            return 1;
+            goto failure;
         }
         if (ftruncate (fd, job->output_size) == -1) {
             GST_ERROR ("ftruncate error: %s", g_strerror (errno));
-            job->output = NULL;
-            g_free (name_hexstr);
-            g_free (semaphore_name);
-            sem_post (semaphore);
-            return 1;
+            goto failure;
         }
         p = mmap (NULL, job->output_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
         if (p == MAP_FAILED) {
             GST_ERROR ("mmap error: %s", g_strerror (errno));
-            return 1;
+            goto failure;
         }
         job->output_fd = fd;
 
     } else {
-        p = g_malloc (job->output_size);
+        /* page aligned */
+        p = mmap (NULL, job->output_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            GST_ERROR ("mmap error: %s", g_strerror (errno));
+            goto failure;
+        }
         job->output_fd = -1;
     }
     g_free (name_hexstr);
     output = (JobOutput *)g_malloc (sizeof (JobOutput));
+    output->header = (JobOutputHeader *)p;
+    base = p;
+    p += sizeof (JobOutputHeader);
     output->job_description = (gchar *)p;
     output->semaphore = semaphore;
     output->semaphore_name = semaphore_name;
     g_stpcpy (output->job_description, job->description);
-    p += (strlen (job->description) / 8 + 1) * 8;
+    p += CACHE_LINE_ALIGN (strlen (job->description) + 1);
     output->state = (guint64 *)p;
-    p += sizeof (guint64); /* state */
-    output->source.duration = (gint64 *)p;
-    p += sizeof (gint64); /* duration for transcode */
+    output->source.duration = (gint64 *)(p + sizeof (guint64));
+    p += CACHE_LINE_SIZE; /* state and duration for transcode */
     output->source.sync_error_times = 0;
-    output->source.stream_count = jobdesc_streams_count (job->description, "source");
-    output->source.streams = (struct _SourceStreamState *)p;
+    output->source.stream_count = jobdesc_streams_count (job->jobdesc, "source");
+    output->source.streams = (SourceStreamState *)p;
     for (i = 0; i < output->source.stream_count; i++) {
         output->source.streams[i].last_heartbeat = gst_clock_get_time (job->system_clock);
     }
-    p += output->source.stream_count * sizeof (struct _SourceStreamState);
-    output->encoder_count = jobdesc_encoders_count (job->description);
+    p += output->source.stream_count * sizeof (SourceStreamState);
+    output->profiler = (ProfilerOutput *)p;
+    p += sizeof (ProfilerOutput);
+    output->encoder_count = jobdesc_encoders_count (job->jobdesc);
     if (output->encoder_count == 0) {
         GST_ERROR ("Invalid job without encoders, initialize job failure");
         sem_post (semaphore);
@@ -405,98 +572,93 @@ gint job_initialize (Job *job, gint mode, gint shm_fd, gchar *shm_p)
         g_strlcpy (output->encoders[i].name, name, STREAM_NAME_LEN);
         g_free (name);
         name = g_strdup_printf ("encoder.%d", i);
-        output->encoders[i].stream_count = jobdesc_streams_count (job->description, name);
+        output->encoders[i].stream_count = jobdesc_streams_count (job->jobdesc, name);
         g_free (name);
         output->encoders[i].semaphore = output->semaphore;
+        output->encoders[i].bytes_sent = 0;
+        output->encoders[i].viewers = 0;
         output->encoders[i].codec = (gchar *)p;
-        p += 64; /* string codec size */
+        p += CACHE_LINE_SIZE; /* string codec size */
+        /* written by encoder on every sample, read by master monitor */
         output->encoders[i].heartbeat = (GstClockTime *)p;
-        p += sizeof (GstClockTime); /* encoder heartbeat */
-        output->encoders[i].eos = (gboolean *)p;
-        p += sizeof (gboolean);
-        output->encoders[i].streams = (struct _EncoderStreamState *)p;
-        p += output->encoders[i].stream_count * sizeof (struct _EncoderStreamState); /* encoder state */
-        output->encoders[i].total_count = (guint64 *)p;
-        p += sizeof (guint64); /* total count size */
+        output->encoders[i].total_count = (guint64 *)(p + sizeof (GstClockTime));
+        output->encoders[i].eos = (gboolean *)(p + sizeof (GstClockTime) + sizeof (guint64));
+        p += CACHE_LINE_SIZE;
+        /* written by encoder on every sample, read by master on every request */
+        output->encoders[i].head_addr = (guint64 *)p;
+        output->encoders[i].tail_addr = (guint64 *)(p + sizeof (guint64));
+        output->encoders[i].last_rap_addr = (guint64 *)(p + 2 * sizeof (guint64));
+        p += CACHE_LINE_SIZE;
+        /* written by encoder on segment, eos and error, read by master msg thread */
+        output->encoders[i].events = (EncoderEventRing *)p;
+        output->encoders[i].event_fd = job->event_fd;
+        p += sizeof (EncoderEventRing);
+        /* written by encoder on every sample, read by master on stat request */
+        output->encoders[i].stats = (EncoderOutputStats *)p;
+        p += sizeof (EncoderOutputStats);
+        output->encoders[i].streams = (EncoderStreamState *)p;
+        p += output->encoders[i].stream_count * sizeof (EncoderStreamState); /* encoder state */
 
         /* non live job has no output */
+        output->encoders[i].cache_addr = NULL;
+        output->encoders[i].cache_size = 0;
         if (!job->is_live) {
             continue;
         }
 
+        p = base + (((p - base) + 4095) & ~((gsize)4095));
         output->encoders[i].cache_addr = p;
-        p += SHM_SIZE;
-        output->encoders[i].cache_size = SHM_SIZE;
-        output->encoders[i].head_addr = (guint64 *)p;
-        p += sizeof (guint64); /* cache head */
-        output->encoders[i].tail_addr = (guint64 *)p;
-        p += sizeof (guint64); /* cache tail */
-        output->encoders[i].last_rap_addr = (guint64 *)p;
-        p += sizeof (guint64); /* last rap addr */
-    }
-    job->output = output;
-    sem_post (semaphore);
-
-    return 0;
-}
-
-static gchar * get_bitrate (Job *job, gint index)
-{
-    gchar *value, *pipeline, **bins, *p, **pp;
-    guint v_bitrate, a_bitrate, ts_bitrate, a_count;
-
-    v_bitrate = a_bitrate = ts_bitrate = 0;
-    pipeline = g_strdup_printf ("encoder.%d", index);
-    pp = bins = jobdesc_bins (job->description, pipeline);
-    while (*pp != NULL) {
-       if (g_strrstr (*pp, "x264enc") != NULL) {
-           /* default bitrate of x264enc is 2048kbps */
-           v_bitrate = 2048;
-
-       } else if (g_strrstr (*pp, "voaacenc") != NULL) {
-           /* default bitrate of voaacenc is 128kbps */
-           a_bitrate = 128;
-       }
-       pp++;
+        output->encoders[i].cache_size = encoder_cache_size (job->jobdesc, i);
+        p += output->encoders[i].cache_size;
     }
-    g_free (pipeline);
-    g_strfreev (bins);
 
-    p = g_strdup_printf ("encoder.%d.elements.x264enc.property.bitrate", index);
-    value = jobdesc_element_property_value (job->description, p);
-    g_free (p);
-    if (value != NULL) {
-        v_bitrate = g_strtod (value, NULL);
-        g_free (value);
+    /* string table of stream names */
+    string_table = p - base;
+    output->source.stream_names = g_malloc (output->source.stream_count * sizeof (gchar *));
+    for (i = 0; i < output->source.stream_count; i++) {
+        output->source.stream_names[i] = p;
+        p += STREAM_NAME_LEN;
     }
-
-    p = g_strdup_printf ("encoder.%d.elements.voaacenc.property.bitrate", index);
-    value = jobdesc_element_property_value (job->description, p);
-    g_free (p);
-    if (value != NULL) {
-        a_bitrate = g_strtod (value, NULL) / 1000;
-        g_free (value);
+    for (i = 0; i < output->encoder_count; i++) {
+        output->encoders[i].stream_names = g_malloc (output->encoders[i].stream_count * sizeof (gchar *));
+        for (j = 0; j < output->encoders[i].stream_count; j++) {
+            output->encoders[i].stream_names[j] = p;
+            p += STREAM_NAME_LEN;
+        }
     }
 
-    p = g_strdup_printf ("encoder.%d.elements.tssegment.property.bitrate", index);
-    value = jobdesc_element_property_value (job->description, p);
-    g_free (p);
-    if (value != NULL) {
-        ts_bitrate = g_strtod (value, NULL);
-        g_free (value);
+    /* header is written by master */
+    if (shm_p == NULL) {
+        output->header->magic = JOB_OUTPUT_MAGIC;
+        output->header->version = JOB_OUTPUT_VERSION;
+        output->header->size = job->output_size;
+        output->header->description_size = strlen (job->description) + 1;
+        output->header->string_table = string_table;
+        output->header->source_stream_count = output->source.stream_count;
+        output->header->encoder_count = output->encoder_count;
     }
+    job->output = output;
+    sem_post (semaphore);
 
-    if ((v_bitrate != 0) || (a_bitrate != 0)) {
-        a_count = jobdesc_astreams_count (job->description, index);
-        if (v_bitrate != 0) {
-            ts_bitrate = v_bitrate + a_bitrate * a_count;
+    return 0;
 
-        } else if ((ts_bitrate == 0) && (a_bitrate != 0)) {
-            ts_bitrate = a_bitrate * a_count;
-        }
+failure:
+    /* share memory of subprocess is opened by caller */
+    if (fd != -1) {
+        close (fd);
     }
+    job->output = NULL;
+    g_free (name_hexstr);
+    g_free (semaphore_name);
+    sem_post (semaphore);
+    sem_close (semaphore);
 
-    return g_strdup_printf ("%u", ts_bitrate);
+    return 1;
+}
+
+static gchar * get_bitrate (Job *job, gint index)
+{
+    return g_strdup_printf ("%u", encoder_bitrate (job->jobdesc, index));
 }
 
 void job_render_master_m3u8_playlist (Job *job)
@@ -507,11 +669,11 @@ void job_render_master_m3u8_playlist (Job *job)
 
     master_m3u8_playlist = g_string_new ("");
     g_string_append_printf (master_m3u8_playlist, M3U8_HEADER_TAG);
-    if (jobdesc_m3u8streaming_version (job->description) == 0) {
+    if (jobdesc_m3u8streaming_version (job->jobdesc) == 0) {
         g_string_append_printf (master_m3u8_playlist, M3U8_VERSION_TAG, 3);
 
     } else {
-        g_string_append_printf (master_m3u8_playlist, M3U8_VERSION_TAG, jobdesc_m3u8streaming_version (job->description));
+        g_string_append_printf (master_m3u8_playlist, M3U8_VERSION_TAG, jobdesc_m3u8streaming_version (job->jobdesc));
     }
 
     for (i = 0; i < job->output->encoder_count; i++) {
@@ -551,13 +713,13 @@ gint job_output_initialize (Job *job)
     /* initialize m3u8 and dvr parameters */
     for (i = 0; i < output->encoder_count; i++) {
         output->encoders[i].m3u8_playlist = NULL;
-        output->encoders[i].version = jobdesc_m3u8streaming_version (job->description);
-        output->encoders[i].segment_duration = jobdesc_m3u8streaming_segment_duration (job->description);
-        output->encoders[i].playlist_window_size = jobdesc_m3u8streaming_window_size (job->description);
+        output->encoders[i].version = jobdesc_m3u8streaming_version (job->jobdesc);
+        output->encoders[i].segment_duration = jobdesc_m3u8streaming_segment_duration (job->jobdesc);
+        output->encoders[i].playlist_window_size = jobdesc_m3u8streaming_window_size (job->jobdesc);
         output->encoders[i].system_clock = job->system_clock;
         /* timeshift and dvr */
         output->encoders[i].record_path = NULL;
-        output->encoders[i].dvr_duration = jobdesc_dvr_duration (job->description);
+        output->encoders[i].dvr_duration = jobdesc_dvr_duration (job->jobdesc);
         if (output->encoders[i].dvr_duration == 0) {
             continue;
         }
@@ -607,13 +769,16 @@ gint job_encoders_output_initialize (Job *job)
             continue;
         }
 
-        /* initialize gop size = 0. */
-        *(gint32 *)(job->output->encoders[i].cache_addr + 8) = 0;
-        /* first gop timestamp is 0 */
-        *(GstClockTime *)(job->output->encoders[i].cache_addr) = 0;
+        /* restarted, continue output of previous worker, viewers keep attached. */
+        if ((job->output->header->age > 0) && encoder_output_continue (&(job->output->encoders[i]))) {
+            GST_WARNING ("%s continue output, tail %lu", job->output->encoders[i].name, *(job->output->encoders[i].tail_addr));
+            continue;
+        }
+
+        /* first gop timestamp is 0, gop size = 0, no trace stamps. */
+        memset (job->output->encoders[i].cache_addr, 0, ENCODER_GOP_HEADER_SIZE);
         *(job->output->encoders[i].head_addr) = 0;
-        /* timestamp + gop size = 12 */
-        *(job->output->encoders[i].tail_addr) = 12;
+        *(job->output->encoders[i].tail_addr) = ENCODER_GOP_HEADER_SIZE;
         *(job->output->encoders[i].last_rap_addr) = 0;
     }
     sem_post (job->output->semaphore);
@@ -688,6 +853,7 @@ void job_reset (Job *job)
     GST_WARNING ("reset job %s", job->name);
     job->stoping = FALSE;
     *(job->output->state) = JOB_STATE_VOID_PENDING;
+    job->output->header->age = job->age;
     g_file_get_contents ("/proc/stat", &stat, NULL, NULL);
     stats = g_strsplit (stat, "\n", 10);
     cpustats = g_strsplit (stats[0], " ", 10);
@@ -715,20 +881,32 @@ void job_reset (Job *job)
         sem_post (job->output->semaphore);
     }
 
+    /* drop events of the crashed subprocess */
+    for (i = 0; i < job->output->encoder_count; i++) {
+        job->output->encoders[i].events->write = 0;
+        job->output->encoders[i].events->read = 0;
+        job->output->encoders[i].events->dropped = 0;
+    }
+
     /* is live job with m3u8streaming? */
-    if (!(job->is_live) || !(jobdesc_m3u8streaming (job->description))) {
+    if (!(job->is_live) || !(jobdesc_m3u8streaming (job->jobdesc))) {
         return;
     }
 
     for (i = 0; i < job->output->encoder_count; i++) {
         encoder = &(job->output->encoders[i]);
 
-        /* reset m3u8 playlist */
-        if (encoder->m3u8_playlist != NULL) {
-            m3u8playlist_free (encoder->m3u8_playlist);
+        /* restart, output is continued, so is m3u8 playlist */
+        if ((job->age > 0) && (encoder->m3u8_playlist != NULL)) {
+            m3u8playlist_add_discontinuity (encoder->m3u8_playlist);
+
+        } else {
+            if (encoder->m3u8_playlist != NULL) {
+                m3u8playlist_free (encoder->m3u8_playlist);
+            }
+            encoder->m3u8_playlist = m3u8playlist_new (encoder->version, encoder->playlist_window_size, 0);
         }
-        encoder->m3u8_playlist = m3u8playlist_new (encoder->version, encoder->playlist_window_size, 0);
-        /* reset last segment timestamp 0 */
+        /* reset last segment timestamp 0, partial segment of previous worker is not in playlist */
         encoder->last_timestamp = 0;
     }
 }
@@ -745,23 +923,42 @@ void job_reset (Job *job)
 gint job_start (Job *job)
 {
     Encoder *encoder;
+    SourceStream *stream;
     GstStateChangeReturn ret;
     gint i;
     gint64 duration;
 
-    job->source = source_initialize (job->description, &(job->output->source));
+    /* per element cpu cost, hooks of the profiler are process wide, installed before pipelines built */
+    if (jobdesc_profile (job->jobdesc)) {
+        profiler_install (job->output->profiler);
+    }
+
+    job->source = source_initialize (job->jobdesc, &(job->output->source));
     if (job->source == NULL) {
         GST_WARNING ("Initialize job source error.");
         *(job->output->state) = JOB_STATE_START_FAILURE;
         return 1;
     }
 
-    if (encoder_initialize (job->encoder_array, job->description, job->output->encoders, job->source) != 0) {
+    if (encoder_initialize (job->encoder_array, job->jobdesc, job->output->encoders, job->source) != 0) {
         GST_WARNING ("Initialize job encoder error.");
         *(job->output->state) = JOB_STATE_START_FAILURE;
         return 2;
     }
 
+    /* native passthrough, no pipeline */
+    if (jobdesc_passthrough (job->jobdesc) != NULL) {
+        *(job->output->source.duration) = 0;
+        if (passthrough_start (job->jobdesc, job->source) == NULL) {
+            GST_WARNING ("Start %s native passthrough error.", job->name);
+            *(job->output->state) = JOB_STATE_START_FAILURE;
+            return 8;
+        }
+        *(job->output->state) = JOB_STATE_PLAYING;
+        GST_INFO ("Set job %s to play state ok", job->name);
+        return 0;
+    }
+
     /* set pipelines as PLAYING state */
     gst_element_set_state (job->source->pipeline, GST_STATE_PLAYING);
     ret = gst_element_get_state (job->source->pipeline, NULL, NULL, 5 * GST_SECOND);
@@ -776,6 +973,22 @@ gint job_start (Job *job)
         return 4;
     }
     GST_INFO ("Set source pipeline to play state ok");
+    for (i = 0; i < job->source->streams->len; i++) {
+        stream = g_array_index (job->source->streams, gpointer, i);
+        if ((stream->ingest != NULL) &&
+            (gst_element_set_state (stream->ingest, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)) {
+            GST_WARNING ("Set %s ingest stream %s to play error.", job->name, stream->name);
+            *(job->output->state) = JOB_STATE_START_FAILURE;
+            return 7;
+        }
+    }
+    for (i = 1; i < job->source->inputs_count; i++) {
+        /* hot standby input, primary is playing, failure of backup is not fatal */
+        if (gst_element_set_state (job->source->inputs[i].pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+            GST_WARNING ("Set %s source input %d to play error.", job->name, i);
+            source_input_failure (&(job->source->inputs[i]));
+        }
+    }
     *(job->output->source.duration) = 0;
     if (!job->is_live && gst_element_query_duration (job->source->pipeline, GST_FORMAT_TIME, &duration)) {
         *(job->output->source.duration) = duration;
@@ -835,6 +1048,10 @@ gint job_stop (Job *job, gint sig)
 
     } else {
         GST_WARNING ("job %s's state is not playing", job->name); 
+        if (sig == SIGTERM) {
+            /* waiting restart, nothing to stop, job is removed from job list */
+            *(job->output->state) = JOB_STATE_STOPED;
+        }
     }
 
     return 0;
@@ -8,10 +8,17 @@
 #define __JOB_H__
 
 #include "config.h"
+#include "jobdesc.h"
 #include "source.h"
 #include "encoder.h"
+#include "profiler.h"
 
+/* default cache size of encoder output */
 #define SHM_SIZE 64*1024*1024
+/* minimum cache size of encoder output */
+#define SHM_MIN_SIZE 4*1024*1024
+/* maximum cache size of encoder output */
+#define SHM_MAX_SIZE ((guint64)JOBDESC_CACHE_SIZE_MAX * 1024 * 1024)
 
 #define MEDIA_LOCATION "/var/lib/gstreamill"
 
@@ -39,12 +46,35 @@ typedef enum {
     JOB_STATE_STOPED = 4
 } JobState;
 
+/* job output share memory layout */
+#define JOB_OUTPUT_MAGIC 0x4c4c494d /* "MILL" */
+#define JOB_OUTPUT_VERSION 8
+
+/*
+ * JobOutputHeader:
+ * at the beginning of job output share memory, followed by job description, job state, source
+ * stream states, profiler output, encoders output and the string table of stream names. fields written by
+ * different threads or processes are in different cache lines.
+ */
+typedef struct _JobOutputHeader {
+    guint32 magic;
+    guint32 version;
+    guint64 size; /* size of share memory */
+    guint64 description_size;
+    guint64 string_table; /* offset of string table */
+    gint64 source_stream_count;
+    gint64 encoder_count;
+    gint64 age; /* (re)start times, written by master before starting worker, cache is continued if not 0 */
+} __attribute__ ((aligned (CACHE_LINE_SIZE))) JobOutputHeader;
+
 typedef struct _JobOutput {
+    JobOutputHeader *header;
     gchar *job_description;
     gchar *semaphore_name;
     sem_t *semaphore; /* access of job output should be exclusive */
     guint64 *state;
     SourceState source;
+    ProfilerOutput *profiler;
     gint64 encoder_count;
     EncoderOutput *encoders;
 
@@ -54,8 +84,10 @@ typedef struct _JobOutput {
 struct _Job {
     GObject parent;
 
-    gchar *description;
+    JobDesc *jobdesc; /* parsed once at job creation */
+    gchar *description; /* text of jobdesc */
     gchar *exe_path;
+    gboolean zygote; /* fork worker from zygote */
     gchar *name; /* same as the name in job config file */
     gboolean is_live;
     gboolean stoping;
@@ -65,6 +97,8 @@ struct _Job {
     GstClock *system_clock;
     gsize output_size;
     gint output_fd;
+    gint event_fd; /* eventfd, doorbell of encoders event ring, inherited by worker */
+    gboolean huge_pages; /* output share memory in hugetlbfs */
     JobOutput *output; /* Interface for producing */
     gint64 age; /* (re)start times of the job */
     gchar *last_start_time; /* last start up time */
@@ -101,6 +135,7 @@ GType job_get_type (void);
 
 gchar * job_state_get_name (guint64 state);
 gint job_initialize (Job *job, gint mode, gint shm_fd, gchar *shm_p);
+gint job_output_check (gchar *shm_p, gsize size);
 gint job_output_initialize (Job *job);
 gint job_encoders_output_initialize (Job *job);
 void job_reset (Job *job);
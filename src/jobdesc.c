@@ -14,263 +14,404 @@
 GST_DEBUG_CATEGORY_EXTERN (GSTREAMILL);
 #define GST_CAT_DEFAULT GSTREAMILL
 
-gboolean jobdesc_is_valid (gchar *job)
-{
-    JSON_Value *val;
-    JSON_Object *obj;
-    GRegex *regex;
-    GMatchInfo *match_info;
-    gchar *name;
+#define FAILOVER_TIMEOUT 500 /* ms, default of source.failover-timeout */
 
-    val = json_parse_string_with_comments(job);
-    if (val == NULL) {
-        GST_ERROR ("parse job error.");
-        return FALSE;
+static gint count_bins (JSON_Object *obj, gchar *element)
+{
+    JSON_Array *array;
+    gsize size, i;
+    gint count;
+    const gchar *bin;
 
-    } else if (json_value_get_type (val) != JSONObject){
-        GST_ERROR ("job is not a json object.");
-        json_value_free (val);
-        return FALSE;
+    array = json_object_dotget_array (obj, "bins");
+    size = json_array_get_count (array);
+    count = 0;
+    for (i = 0; i < size; i++) {
+        bin = json_array_get_string (array, i);
+        if ((bin != NULL) && (g_strrstr (bin, element) != NULL)) {
+            count += 1;
+        }
     }
-    obj = json_value_get_object (val);
 
-    name = (gchar *)json_object_get_string (obj, "name");
+    return count;
+}
+
+static gchar * dup_string (JSON_Object *obj, const gchar *name)
+{
+    const gchar *p;
+
+    p = json_object_get_string (obj, name);
+
+    return p == NULL ? NULL : g_strdup (p);
+}
+
+static gboolean is_valid_name (const gchar *name)
+{
+    GRegex *regex;
+    GMatchInfo *match_info;
+    gboolean matches;
+
     if ((name == NULL) || (strlen (name) < 1)) {
         GST_ERROR ("invalid job with name property invalid");
-        json_value_free (val);
         return FALSE;
     }
 
     regex = g_regex_new ("[`~!@$%^&*()+=|\\{[\\]}:\"\'<>?/ ]", G_REGEX_OPTIMIZE, 0, NULL);
     g_regex_match (regex, name, 0, &match_info);
     g_regex_unref (regex);
-    if (g_match_info_matches (match_info)) {
+    matches = g_match_info_matches (match_info);
+    g_match_info_free (match_info);
+    if (matches) {
         GST_ERROR ("invalid job name: %s", name);
-        g_match_info_free (match_info);
-        json_value_free (val);
         return FALSE;
     }
-    json_value_free (val);
 
     return TRUE;
 }
 
-gchar * jobdesc_get_name (gchar *job)
+/*
+ * ingest_bins:
+ * source of a job attached to an ingest, "source" : {"ingest" : "name", "streams" : ["video", "audio"]},
+ * every stream is read from the shared memory of the ingest job.
+ */
+static gboolean ingest_bins (JSON_Object *source)
 {
-    JSON_Value *val;
-    JSON_Object *obj;
-    gchar *name, *ret;
+    JSON_Value *value;
+    JSON_Array *streams, *bins;
+    const gchar *ingest, *stream;
+    gchar *path, *bin;
+    gsize i;
+
+    ingest = json_object_get_string (source, "ingest");
+    streams = json_object_get_array (source, "streams");
+    if (!is_valid_name (ingest) || (json_array_get_count (streams) == 0)) {
+        GST_ERROR ("invalid ingest source, ingest name and streams must be set.");
+        return FALSE;
+    }
+    value = json_value_init_array ();
+    bins = json_value_get_array (value);
+    for (i = 0; i < json_array_get_count (streams); i++) {
+        stream = json_array_get_string (streams, i);
+        if (!is_valid_name (stream)) {
+            json_value_free (value);
+            return FALSE;
+        }
+        path = jobdesc_ingest_socket_path (ingest, stream);
+        bin = g_strdup_printf ("shmsrc socket-path=%s is-live=true ! gdpdepay ! appsink name=%s sync=false", path, stream);
+        json_array_append_string (bins, bin);
+        g_free (bin);
+        g_free (path);
+    }
+    json_object_set_value (source, "bins", value);
 
-    val = json_parse_string_with_comments (job);
-    obj = json_value_get_object (val);
-    name = (gchar *)json_object_get_string (obj, "name");
-    ret = g_strdup (name);
-    json_value_free (val);
+    return TRUE;
+}
 
-    return ret;
+/*
+ * passthrough_bins:
+ * native passthrough, "source" : {"passthrough" : "udp://238.123.45.21:8080"}, no pipeline is created,
+ * bins describe one tssegment stream of source and of the only encoder, as tssegment.job does.
+ * with "programs" : [101, 102] of a mpts, every program is a tssegment stream and an encoder.
+ */
+static void passthrough_bins (JSON_Object *obj, JSON_Object *source)
+{
+    JSON_Value *value, *bins, *encoder, *encoders;
+    JSON_Array *programs;
+    gchar *p, *name;
+    gsize i, count;
+
+    programs = json_object_get_array (source, "programs");
+    count = json_array_get_count (programs);
+    bins = json_value_init_array ();
+    encoders = json_value_init_array ();
+    for (i = 0; i < (count == 0 ? 1 : count); i++) {
+        if (count == 0) {
+            name = g_strdup ("tssegment");
+
+        } else {
+            name = g_strdup_printf ("tssegment%.0f", json_array_get_number (programs, i));
+        }
+        p = g_strdup_printf ("udpsrc ! tssegment ! appsink name=%s", name);
+        json_array_append_string (json_value_get_array (bins), p);
+        g_free (p);
+
+        value = json_value_init_array ();
+        p = g_strdup_printf ("appsrc name=%s ! appsink", name);
+        json_array_append_string (json_value_get_array (value), p);
+        g_free (p);
+        encoder = json_value_init_object ();
+        json_object_set_value (json_value_get_object (encoder), "bins", value);
+        json_array_append_value (json_value_get_array (encoders), encoder);
+        g_free (name);
+    }
+    json_object_set_value (source, "bins", bins);
+    json_object_set_value (obj, "encoders", encoders);
 }
 
-gint jobdesc_streams_count (gchar *job, gchar *pipeline)
+/**
+ * jobdesc_new:
+ * @description: (in): job description of json type.
+ *
+ * Parse job description and precompute settings used by job, source and encoders.
+ *
+ * Returns: JobDesc, free by jobdesc_free, NULL if description is invalid.
+ */
+JobDesc * jobdesc_new (const gchar *description)
 {
+    JobDesc *jobdesc;
     JSON_Value *val;
-    JSON_Object *obj;
-    JSON_Array *array;
-    gsize size, i;
-    gint count, index;
-    gchar *bin, *ptype = NULL;
+    JSON_Object *obj, *encoder;
+    JSON_Array *encoders;
+    gdouble number;
+    gint i;
 
-    val = json_parse_string_with_comments (job);
+    val = json_parse_string_with_comments (description);
+    if (val == NULL) {
+        GST_ERROR ("parse job error.");
+        return NULL;
+
+    } else if (json_value_get_type (val) != JSONObject){
+        GST_ERROR ("job is not a json object.");
+        json_value_free (val);
+        return NULL;
+    }
     obj = json_value_get_object (val);
-    if (g_str_has_prefix (pipeline, "encoder")) {
-        ptype = "appsrc";
-        array = json_object_dotget_array (obj, "encoders");
-        sscanf (pipeline, "encoder.%d", &index);
-        obj = json_array_get_object (array, index);
+    if (!is_valid_name (json_object_get_string (obj, "name"))) {
+        json_value_free (val);
+        return NULL;
+    }
 
-    } else if (g_str_has_prefix (pipeline, "source")) {
-        ptype = "appsink";
-        obj = json_object_get_object (obj, "source");
+    jobdesc = g_malloc0 (sizeof (JobDesc));
+    jobdesc->description = g_strdup (description);
+    jobdesc->value = val;
+    jobdesc->object = obj;
+    jobdesc->name = dup_string (obj, "name");
+    /* without is-live configure item, default is live */
+    jobdesc->is_live = (json_object_dotget_boolean (obj, "is-live") != 0);
+    jobdesc->debug = dup_string (obj, "debug");
+    jobdesc->log_path = dup_string (obj, "log-path");
+    jobdesc->huge_pages = (json_object_get_boolean (obj, "huge-pages") == 1);
+    jobdesc->profile = (json_object_get_boolean (obj, "profile") == 1);
+    if (json_object_get_value (obj, "cache-duration") != NULL) {
+        number = json_object_get_number (obj, "cache-duration");
+        if ((number < 1) || (number > JOBDESC_CACHE_DURATION_MAX)) {
+            GST_ERROR ("invalid cache-duration %f, should be 1 to %d seconds", number, JOBDESC_CACHE_DURATION_MAX);
+            jobdesc_free (jobdesc);
+            return NULL;
+        }
+        jobdesc->cache_duration = number;
     }
-    array = json_object_dotget_array (obj, "bins");
-    size = json_array_get_count (array);
-    count = 0;
-    for (i = 0; i < size; i++) {
-        bin = (gchar *)json_array_get_string (array, i);
-        if (g_strrstr (bin, ptype) != NULL)
-            count += 1;
+    jobdesc->dvr_duration = json_object_get_number (obj, "dvr_duration");
+    jobdesc->m3u8streaming = (json_object_get_object (obj, "m3u8streaming") != NULL);
+    jobdesc->m3u8streaming_version = json_object_dotget_number (obj, "m3u8streaming.version");
+    jobdesc->m3u8streaming_window_size = json_object_dotget_number (obj, "m3u8streaming.window-size");
+    jobdesc->m3u8streaming_segment_duration = GST_SECOND * json_object_dotget_number (obj, "m3u8streaming.segment-duration");
+
+    jobdesc->ingest = (json_object_get_boolean (obj, "ingest") == 1);
+    jobdesc->source.object = json_object_get_object (obj, "source");
+    if ((json_object_get_value (jobdesc->source.object, "ingest") != NULL) && !ingest_bins (jobdesc->source.object)) {
+        jobdesc_free (jobdesc);
+        return NULL;
     }
-    json_value_free (val);
+    jobdesc->passthrough = g_strdup (json_object_get_string (jobdesc->source.object, "passthrough"));
+    if (jobdesc->passthrough != NULL) {
+        passthrough_bins (obj, jobdesc->source.object);
+    }
+    jobdesc->source.streams_count = count_bins (jobdesc->source.object, "appsink");
+    jobdesc->backup.object = json_object_dotget_object (obj, "source.backup");
+    jobdesc->backup.streams_count = count_bins (jobdesc->backup.object, "appsink");
+    if (json_object_dotget_value (obj, "source.failover-timeout") != NULL) {
+        jobdesc->failover_timeout = GST_MSECOND * json_object_dotget_number (obj, "source.failover-timeout");
 
-    return count;
+    } else {
+        jobdesc->failover_timeout = GST_MSECOND * FAILOVER_TIMEOUT;
+    }
+
+    encoders = json_object_dotget_array (obj, "encoders");
+    jobdesc->encoders_count = json_array_get_count (encoders);
+    jobdesc->encoders = g_malloc0 (jobdesc->encoders_count * sizeof (JobDescPipeline));
+    for (i = 0; i < jobdesc->encoders_count; i++) {
+        encoder = json_array_get_object (encoders, i);
+        jobdesc->encoders[i].object = encoder;
+        jobdesc->encoders[i].streams_count = count_bins (encoder, "appsrc");
+        jobdesc->encoders[i].astreams_count = count_bins (encoder, "voaacenc");
+        jobdesc->encoders[i].udpstreaming = dup_string (encoder, "udpstreaming");
+        if (json_object_get_value (encoder, "cache-size") != NULL) {
+            number = json_object_get_number (encoder, "cache-size");
+            if ((number < 1) || (number > JOBDESC_CACHE_SIZE_MAX)) {
+                GST_ERROR ("invalid cache-size %f of encoder %d, should be 1 to %d MB", number, i, JOBDESC_CACHE_SIZE_MAX);
+                jobdesc_free (jobdesc);
+                return NULL;
+            }
+            jobdesc->encoders[i].cache_size = number;
+        }
+    }
+
+    return jobdesc;
 }
 
-gint jobdesc_astreams_count (gchar *job, gint index)
+void jobdesc_free (JobDesc *jobdesc)
 {
-    JSON_Value *val;
-    JSON_Object *obj;
-    JSON_Array *array;
-    gsize size, i;
-    gint count;
-    gchar *bin;
+    gint i;
 
-    val = json_parse_string_with_comments (job);
-    obj = json_value_get_object (val);
-    array = json_object_dotget_array (obj, "encoders");
-    obj = json_array_get_object (array, index);
-    array = json_object_dotget_array (obj, "bins");
-    size = json_array_get_count (array);
-    count = 0;
-    for (i = 0; i < size; i++) {
-        bin = (gchar *)json_array_get_string (array, i);
-        if (g_strrstr (bin, "voaacenc") != NULL) {
-            count += 1;
+    for (i = 0; i < jobdesc->encoders_count; i++) {
+        g_free (jobdesc->encoders[i].udpstreaming);
+    }
+    g_free (jobdesc->encoders);
+    g_free (jobdesc->name);
+    g_free (jobdesc->debug);
+    g_free (jobdesc->log_path);
+    g_free (jobdesc->passthrough);
+    json_value_free (jobdesc->value);
+    g_free (jobdesc->description);
+    g_free (jobdesc);
+}
+
+/*
+ * pipeline: source, source.backup or encoder.x
+ */
+static JobDescPipeline * get_pipeline (JobDesc *jobdesc, gchar *pipeline)
+{
+    gint index;
+
+    if (g_str_has_prefix (pipeline, "encoder")) {
+        if ((sscanf (pipeline, "encoder.%d", &index) != 1) || (index < 0) || (index >= jobdesc->encoders_count)) {
+            return NULL;
         }
+        return &(jobdesc->encoders[index]);
+
+    } else if (g_str_has_prefix (pipeline, "source.backup")) {
+        return jobdesc->backup.object == NULL ? NULL : &(jobdesc->backup);
+
+    } else if (g_str_has_prefix (pipeline, "source")) {
+        return &(jobdesc->source);
     }
-    json_value_free (val);
 
-    return count;
+    return NULL;
 }
 
-gint jobdesc_encoders_count (gchar *job)
+gboolean jobdesc_is_valid (gchar *job)
 {
-    JSON_Value *val;
-    JSON_Object *obj;
-    JSON_Array *encoders;
-    gint count;
+    JobDesc *jobdesc;
 
-    val = json_parse_string_with_comments (job);
-    obj = json_value_get_object (val);
-    encoders = json_object_dotget_array (obj, "encoders");
-    count = json_array_get_count (encoders);
-    json_value_free (val);
+    jobdesc = jobdesc_new (job);
+    if (jobdesc == NULL) {
+        return FALSE;
+    }
+    jobdesc_free (jobdesc);
 
-    return count;
+    return TRUE;
 }
 
-gboolean jobdesc_is_live (gchar *job)
+gchar * jobdesc_get_name (JobDesc *jobdesc)
 {
-    JSON_Value *val;
-    JSON_Object *obj;
+    return g_strdup (jobdesc->name);
+}
 
-    val = json_parse_string_with_comments (job);
-    obj = json_value_get_object (val);
+gint jobdesc_streams_count (JobDesc *jobdesc, gchar *pipeline)
+{
+    JobDescPipeline *p;
 
-    /* without is-live configure item, default is live */
-    if (json_object_dotget_boolean (obj, "is-live")) {
-        json_value_free (val);
-        return TRUE;
-    }
-    json_value_free (val);
+    p = get_pipeline (jobdesc, pipeline);
 
-    return FALSE;
+    return p == NULL ? 0 : p->streams_count;
 }
 
-gchar * jobdesc_get_debug (gchar *job)
+/**
+ * jobdesc_source_backup:
+ * @jobdesc: (in): job description.
+ *
+ * source.backup is a hot standby input with the same appsink names as source.
+ *
+ * Returns: TRUE if source has a backup input.
+ */
+gboolean jobdesc_source_backup (JobDesc *jobdesc)
 {
-    JSON_Value *val;
-    JSON_Object *obj;
-    gchar *debug, *p;
+    return jobdesc->backup.object != NULL;
+}
 
-    val = json_parse_string_with_comments (job);
-    obj = json_value_get_object (val);
-    p = (gchar *)json_object_get_string (obj, "debug");
-    if (p == NULL) {
-        debug = NULL;
+GstClockTime jobdesc_source_failover_timeout (JobDesc *jobdesc)
+{
+    return jobdesc->failover_timeout;
+}
 
-    } else {
-        debug = g_strdup (p);
+gint jobdesc_astreams_count (JobDesc *jobdesc, gint index)
+{
+    if ((index < 0) || (index >= jobdesc->encoders_count)) {
+        return 0;
     }
-    json_value_free (val);
 
-    return debug;
+    return jobdesc->encoders[index].astreams_count;
 }
 
-gchar * jobdesc_get_log_path (gchar *job)
+gint jobdesc_encoders_count (JobDesc *jobdesc)
 {
-    JSON_Value *val;
-    JSON_Object *obj;
-    gchar *log_path, *p;
+    return jobdesc->encoders_count;
+}
 
-    val = json_parse_string_with_comments (job);
-    obj = json_value_get_object (val);
-    p = (gchar *)json_object_get_string (obj, "log-path");
-    if (p == NULL) {
-        log_path = NULL;
+gboolean jobdesc_is_live (JobDesc *jobdesc)
+{
+    return jobdesc->is_live;
+}
 
-    } else {
-        log_path = g_strdup (p);
-    }
-    json_value_free (val);
+gchar * jobdesc_get_debug (JobDesc *jobdesc)
+{
+    return g_strdup (jobdesc->debug);
+}
 
-    return log_path;
+gchar * jobdesc_get_log_path (JobDesc *jobdesc)
+{
+    return g_strdup (jobdesc->log_path);
 }
 
-gchar ** jobdesc_bins (gchar *job, gchar *pipeline)
+gchar ** jobdesc_bins (JobDesc *jobdesc, gchar *pipeline)
 {
-    JSON_Value *val;
-    JSON_Object *obj;
+    JobDescPipeline *pl;
     JSON_Array *array;
-    gint i, count, index;
-    gchar **p, *bin;
-
-    val = json_parse_string_with_comments (job);
-    obj = json_value_get_object (val);
-    if (g_str_has_prefix (pipeline, "encoder")) {
-        array = json_object_dotget_array (obj, "encoders");
-        sscanf (pipeline, "encoder.%d", &index);
-        obj = json_array_get_object (array, index);
+    gint i, count;
+    gchar **p;
 
-    } else if (g_str_has_prefix (pipeline, "source")) {
-        obj = json_object_get_object (obj, "source");
-    }
-    array = json_object_get_array (obj, "bins");
+    pl = get_pipeline (jobdesc, pipeline);
+    array = pl == NULL ? NULL : json_object_get_array (pl->object, "bins");
     count = json_array_get_count (array);
     p = g_malloc ((count + 1) * sizeof (gchar *));
     for (i = 0; i < count; i++) {
-        bin = (gchar *)json_array_get_string (array, i);
-        p[i] = g_strdup (bin);
+        p[i] = g_strdup (json_array_get_string (array, i));
     }
     p[i] = NULL;
-    json_value_free (val);
 
     return p;
 }
 
-gchar ** jobdesc_element_properties (gchar *job, gchar *element)
+gchar ** jobdesc_element_properties (JobDesc *jobdesc, gchar *element)
 {
-    JSON_Value *val;
     JSON_Object *obj;
-    JSON_Array *array;
-    gchar *p, **properties, **pp;
+    JobDescPipeline *pl;
+    gchar **properties, **pp;
     gsize count;
-    gint i, index;
+    gint i;
 
-    val = json_parse_string_with_comments (job);
-    obj = json_value_get_object (val);
+    obj = NULL;
     if (g_str_has_prefix (element, "encoder")) {
-        array = json_object_get_array (obj, "encoders");
-        sscanf (element, "encoder.%d", &index);
-        obj = json_array_get_object (array, index);
-        p = g_strrstr (element, "elements");
-        obj = json_object_dotget_object (obj, p);
+        pl = get_pipeline (jobdesc, element);
+        if (pl != NULL) {
+            obj = json_object_dotget_object (pl->object, g_strrstr (element, "elements"));
+        }
 
     } else if (g_str_has_prefix (element, "source")) {
-        obj = json_object_dotget_object (obj, element);
+        obj = json_object_dotget_object (jobdesc->object, element);
     }
     if (obj == NULL) {
-        json_value_free (val);
         return NULL;
     }
     count = json_object_get_count (obj);
     properties = (gchar **)g_malloc ((count + 1) * sizeof (gchar *));
     pp = properties;
     for (i = 0; i < count; i++) {
-        p = (gchar *)json_object_get_name (obj, i);
-        *pp = g_strdup (p);
+        *pp = g_strdup (json_object_get_name (obj, i));
         pp++;
     }
     *pp = NULL;
-    json_value_free (val);
 
     return properties;
 }
@@ -279,32 +420,25 @@ gchar ** jobdesc_element_properties (gchar *job, gchar *element)
  *
  * @property: (in): encoders.x.elements.element.property.name or source.elements.element.property.name
  */
-gchar * jobdesc_element_property_value (gchar *job, gchar *property)
+gchar * jobdesc_element_property_value (JobDesc *jobdesc, gchar *property)
 {
-    JSON_Value *val;
-    JSON_Object *obj;
-    JSON_Array *array;
+    JobDescPipeline *pl;
     JSON_Value_Type type;
     JSON_Value *value = NULL;
     gchar *p = NULL;
     gint64 i;
     gdouble n;
-    gint index;
 
-    val = json_parse_string_with_comments (job);
-    obj = json_value_get_object (val);
     if (g_str_has_prefix (property, "encoder")) {
-        array = json_object_dotget_array (obj, "encoders");
-        sscanf (property, "encoder.%d", &index);
-        obj = json_array_get_object (array, index);
-        p = g_strrstr (property, "elements");
-        value = json_object_dotget_value (obj, p);
+        pl = get_pipeline (jobdesc, property);
+        if (pl != NULL) {
+            value = json_object_dotget_value (pl->object, g_strrstr (property, "elements"));
+        }
 
     } else if (g_str_has_prefix (property, "source")) {
-        value = json_object_dotget_value (obj, property);
+        value = json_object_dotget_value (jobdesc->object, property);
     }
     if (value == NULL) {
-        json_value_free (val);
         return NULL;
     }
     type = json_value_get_type (value);
@@ -336,139 +470,147 @@ gchar * jobdesc_element_property_value (gchar *job, gchar *property)
         default:
             GST_ERROR ("property value invalid.");
     }
-    json_value_free (val);
 
     return p;
 }
 
-gchar * jobdesc_element_caps (gchar *job, gchar *element)
+gchar * jobdesc_element_caps (JobDesc *jobdesc, gchar *element)
 {
-    JSON_Value *val;
     JSON_Object *obj;
-    JSON_Array *array;
-    gchar *p, *caps;
-    gint index;
+    JobDescPipeline *pl;
+    const gchar *caps;
 
-    val = json_parse_string_with_comments (job);
-    obj = json_value_get_object (val);
     if (g_str_has_prefix (element, "encoder")) {
-        array = json_object_dotget_array (obj, "encoders");
-        sscanf (element, "encoder.%d", &index);
-        obj = json_array_get_object (array, index);
-
-    } else {
-        obj = json_object_get_object (obj, "source");
-    }
-    p = g_strrstr (element, "elements");
-    caps = (gchar *)json_object_dotget_string (obj, p);
-    if (caps == NULL) {
-        p = NULL;
+        pl = get_pipeline (jobdesc, element);
+        obj = pl == NULL ? NULL : pl->object;
 
     } else {
-        p = g_strdup (caps);
+        pl = get_pipeline (jobdesc, element);
+        obj = pl == NULL ? NULL : pl->object;
     }
-    json_value_free (val);
+    caps = json_object_dotget_string (obj, g_strrstr (element, "elements"));
 
-    return p;
+    return caps == NULL ? NULL : g_strdup (caps);
 }
 
-gchar * jobdesc_udpstreaming (gchar *job, gchar *pipeline)
+gchar * jobdesc_udpstreaming (JobDesc *jobdesc, gchar *pipeline)
 {
-    JSON_Value *val;
-    JSON_Object *obj;
-    JSON_Array *array;
-    gint index;
-    gchar *p, *udpstreaming;
-
-    val = json_parse_string_with_comments (job);
-    obj = json_value_get_object (val);
-    array = json_object_dotget_array (obj, "encoders");
-    sscanf (pipeline, "encoder.%d", &index);
-    obj = json_array_get_object (array, index);
-    p = (gchar *)json_object_get_string (obj, "udpstreaming");
-    if (p == NULL) {
-        udpstreaming = NULL;
+    JobDescPipeline *pl;
 
-    } else {
-        udpstreaming = g_strdup (p);
-    }
-    json_value_free (val);
+    pl = get_pipeline (jobdesc, pipeline);
 
-    return udpstreaming;
+    return pl == NULL ? NULL : g_strdup (pl->udpstreaming);
 }
 
-gboolean jobdesc_m3u8streaming (gchar *job)
+gboolean jobdesc_m3u8streaming (JobDesc *jobdesc)
 {
-    JSON_Value *val;
-    JSON_Object *obj;
-    gboolean m3u8streaming;
+    return jobdesc->m3u8streaming;
+}
 
-    val = json_parse_string_with_comments (job);
-    obj = json_value_get_object (val);
-    if (json_object_get_object (obj, "m3u8streaming") != NULL) {
-        m3u8streaming = TRUE;
+guint jobdesc_m3u8streaming_version (JobDesc *jobdesc)
+{
+    return jobdesc->m3u8streaming_version;
+}
 
-    } else {
-        m3u8streaming = FALSE;
-    }
-    json_value_free (val);
+guint jobdesc_m3u8streaming_window_size (JobDesc *jobdesc)
+{
+    return jobdesc->m3u8streaming_window_size;
+}
 
-    return m3u8streaming;
+GstClockTime jobdesc_m3u8streaming_segment_duration (JobDesc *jobdesc)
+{
+    return jobdesc->m3u8streaming_segment_duration;
 }
 
-guint jobdesc_m3u8streaming_version (gchar *job)
+guint64 jobdesc_dvr_duration (JobDesc *jobdesc)
 {
-    JSON_Value *val;
-    JSON_Object *obj;
-    guint version;
+    return jobdesc->dvr_duration;
+}
 
-    val = json_parse_string_with_comments (job);
-    obj = json_value_get_object (val);
-    version = json_object_dotget_number (obj, "m3u8streaming.version");
-    json_value_free (val);
+/**
+ * jobdesc_encoder_cache_size:
+ * @jobdesc: (in): job description.
+ * @index: (in): encoder index.
+ *
+ * Returns: cache size of the encoder in MB, 0 if not configured.
+ */
+guint64 jobdesc_encoder_cache_size (JobDesc *jobdesc, gint index)
+{
+    if ((index < 0) || (index >= jobdesc->encoders_count)) {
+        return 0;
+    }
 
-    return version;
+    return jobdesc->encoders[index].cache_size;
 }
 
-guint jobdesc_m3u8streaming_window_size (gchar *job)
+/**
+ * jobdesc_cache_duration:
+ * @jobdesc: (in): job description.
+ *
+ * Returns: seconds of stream to be cached in memory, 0 if not configured.
+ */
+guint64 jobdesc_cache_duration (JobDesc *jobdesc)
 {
-    JSON_Value *val;
-    JSON_Object *obj;
-    guint window_size;
+    return jobdesc->cache_duration;
+}
 
-    val = json_parse_string_with_comments (job);
-    obj = json_value_get_object (val);
-    window_size = json_object_dotget_number (obj, "m3u8streaming.window-size");
-    json_value_free (val);
+gboolean jobdesc_huge_pages (JobDesc *jobdesc)
+{
+    return jobdesc->huge_pages;
+}
 
-    return window_size;
+gboolean jobdesc_profile (JobDesc *jobdesc)
+{
+    return jobdesc->profile;
 }
 
-GstClockTime jobdesc_m3u8streaming_segment_duration (gchar *job)
+gboolean jobdesc_ingest (JobDesc *jobdesc)
 {
-    JSON_Value *val;
-    JSON_Object *obj;
-    GstClockTime segment_duration;
+    return jobdesc->ingest;
+}
 
-    val = json_parse_string_with_comments (job);
-    obj = json_value_get_object (val);
-    segment_duration = GST_SECOND * json_object_dotget_number (obj, "m3u8streaming.segment-duration");
-    json_value_free (val);
+/**
+ * jobdesc_attached:
+ * @jobdesc: (in): job description.
+ *
+ * Returns: TRUE if source of the job is an ingest of another job.
+ */
+gboolean jobdesc_attached (JobDesc *jobdesc)
+{
+    return json_object_get_value (jobdesc->source.object, "ingest") != NULL;
+}
 
-    return segment_duration;
+gchar * jobdesc_passthrough (JobDesc *jobdesc)
+{
+    return jobdesc->passthrough;
 }
 
-guint64 jobdesc_dvr_duration (gchar *job)
+/**
+ * jobdesc_passthrough_program:
+ * @jobdesc: (in): job description of native passthrough job.
+ * @index: (in): index of source stream, a program of mpts.
+ *
+ * Returns: program number, 0 if source is not a mpts, the first program is used.
+ */
+guint jobdesc_passthrough_program (JobDesc *jobdesc, gint index)
 {
-    JSON_Value *val;
-    JSON_Object *obj;
-    guint64 duration;
+    JSON_Array *programs;
 
-    val = json_parse_string_with_comments (job);
-    obj = json_value_get_object (val);
-    duration = json_object_get_number (obj, "dvr_duration");
-    json_value_free (val);
+    programs = json_object_get_array (jobdesc->source.object, "programs");
 
-    return duration;
+    return json_array_get_number (programs, index);
 }
 
+/**
+ * jobdesc_ingest_socket_path:
+ * @ingest: (in): name of ingest job.
+ * @stream: (in): source stream name of ingest job.
+ *
+ * shmsink of ingest job and shmsrc of attached jobs meet at this socket.
+ *
+ * Returns: socket path, should be freed.
+ */
+gchar * jobdesc_ingest_socket_path (const gchar *ingest, const gchar *stream)
+{
+    return g_strdup_printf (INGEST_SOCKET_PATH, ingest, stream);
+}
@@ -10,23 +10,84 @@
 
 #include <gst/gst.h>
 
+#include "parson.h"
+
+#define INGEST_SOCKET_DIR "/run/gstreamill/ingest" /* mode 0700, only gstreamill user reaches the sockets */
+#define INGEST_SOCKET_PATH INGEST_SOCKET_DIR "/%s.%s" /* ingest job name, stream name */
+
+/* limits of encoder output cache configuration, larger values are rejected */
+#define JOBDESC_CACHE_SIZE_MAX 16384 /* MB */
+#define JOBDESC_CACHE_DURATION_MAX 86400 /* seconds */
+
+typedef struct _JobDescPipeline {
+    JSON_Object *object; /* source or encoders.x object in description */
+    gint streams_count; /* appsink of source or appsrc of encoder */
+    gint astreams_count; /* audio streams, encoder only */
+    guint64 cache_size; /* MB, encoder only */
+    gchar *udpstreaming; /* encoder only */
+} JobDescPipeline;
+
+/*
+ * JobDesc:
+ * job description parsed once at job creation, accessors read from it.
+ */
+typedef struct _JobDesc {
+    gchar *description; /* job description text */
+    JSON_Value *value; /* parsed description */
+    JSON_Object *object;
+
+    gchar *name;
+    gboolean is_live;
+    gchar *debug;
+    gchar *log_path;
+    gboolean huge_pages;
+    gboolean profile; /* per element cpu cost of worker */
+    guint64 cache_duration;
+    guint64 dvr_duration;
+    gboolean m3u8streaming;
+    guint m3u8streaming_version;
+    guint m3u8streaming_window_size;
+    GstClockTime m3u8streaming_segment_duration;
+    gboolean ingest; /* decoded source streams are published to other jobs */
+    gchar *passthrough; /* udp uri of native passthrough source, NULL if not passthrough */
+
+    JobDescPipeline source;
+    JobDescPipeline backup; /* hot standby input of source, object is NULL if not present */
+    GstClockTime failover_timeout;
+    gint encoders_count;
+    JobDescPipeline *encoders;
+} JobDesc;
+
+JobDesc * jobdesc_new (const gchar *description);
+void jobdesc_free (JobDesc *jobdesc);
 gboolean jobdesc_is_valid (gchar *job);
-gchar * jobdesc_get_name (gchar *job);
-gint jobdesc_encoders_count (gchar *job);
-gint jobdesc_streams_count (gchar *job, gchar *pipeline);
-gint jobdesc_astreams_count (gchar *job, gint index);
-gboolean jobdesc_is_live (gchar *job);
-gchar * jobdesc_get_debug (gchar *job);
-gchar * jobdesc_get_log_path (gchar *job);
-gchar ** jobdesc_bins (gchar *job, gchar *pipeline);
-gchar ** jobdesc_element_properties (gchar *job, gchar *element);
-gchar * jobdesc_element_property_value (gchar *job, gchar *property);
-gchar * jobdesc_element_caps (gchar *job, gchar *element);
-gchar * jobdesc_udpstreaming (gchar *job, gchar *pipeline);
-gboolean jobdesc_m3u8streaming (gchar *job);
-guint jobdesc_m3u8streaming_version (gchar *job);
-guint jobdesc_m3u8streaming_window_size (gchar *job);
-GstClockTime jobdesc_m3u8streaming_segment_duration (gchar *job);
-guint64 jobdesc_dvr_duration (gchar *job);
+gchar * jobdesc_get_name (JobDesc *jobdesc);
+gint jobdesc_encoders_count (JobDesc *jobdesc);
+gint jobdesc_streams_count (JobDesc *jobdesc, gchar *pipeline);
+gboolean jobdesc_source_backup (JobDesc *jobdesc);
+GstClockTime jobdesc_source_failover_timeout (JobDesc *jobdesc);
+gint jobdesc_astreams_count (JobDesc *jobdesc, gint index);
+gboolean jobdesc_is_live (JobDesc *jobdesc);
+gchar * jobdesc_get_debug (JobDesc *jobdesc);
+gchar * jobdesc_get_log_path (JobDesc *jobdesc);
+gchar ** jobdesc_bins (JobDesc *jobdesc, gchar *pipeline);
+gchar ** jobdesc_element_properties (JobDesc *jobdesc, gchar *element);
+gchar * jobdesc_element_property_value (JobDesc *jobdesc, gchar *property);
+gchar * jobdesc_element_caps (JobDesc *jobdesc, gchar *element);
+gchar * jobdesc_udpstreaming (JobDesc *jobdesc, gchar *pipeline);
+gboolean jobdesc_m3u8streaming (JobDesc *jobdesc);
+guint jobdesc_m3u8streaming_version (JobDesc *jobdesc);
+guint jobdesc_m3u8streaming_window_size (JobDesc *jobdesc);
+GstClockTime jobdesc_m3u8streaming_segment_duration (JobDesc *jobdesc);
+guint64 jobdesc_dvr_duration (JobDesc *jobdesc);
+guint64 jobdesc_encoder_cache_size (JobDesc *jobdesc, gint index);
+guint64 jobdesc_cache_duration (JobDesc *jobdesc);
+gboolean jobdesc_huge_pages (JobDesc *jobdesc);
+gboolean jobdesc_profile (JobDesc *jobdesc);
+gboolean jobdesc_ingest (JobDesc *jobdesc);
+gboolean jobdesc_attached (JobDesc *jobdesc);
+gchar * jobdesc_passthrough (JobDesc *jobdesc);
+guint jobdesc_passthrough_program (JobDesc *jobdesc, gint index);
+gchar * jobdesc_ingest_socket_path (const gchar *ingest, const gchar *stream);
 
 #endif /* __JOBDESC_H__ */
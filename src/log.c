@@ -7,6 +7,12 @@
 
 #include <string.h>
 #include <libgen.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/uio.h>
 
 #include "log.h"
 
@@ -56,7 +62,13 @@ static void log_class_init (LogClass *logclass)
 
 static void log_init (Log *log)
 {
-    log->access_hd = NULL;
+    log->log_fd = -1;
+    log->access_fd = -1;
+    log->rings = NULL;
+    g_mutex_init (&(log->drain_mutex));
+    log->writer_started = 0;
+    log->writer = NULL;
+    log->dropped = 0;
 }
 
 GType log_get_type (void)
@@ -147,6 +159,295 @@ static void log_dispose (GObject *obj)
     G_OBJECT_CLASS (parent_class)->dispose (obj);
 }
 
+#define LOG_RECORD_SIZE(size) (((size) + sizeof (LogRecord) + 7) & ~7)
+#define LOG_IOV_MAX 64
+
+typedef struct _LogRecord {
+    guint32 size; /* message size */
+    guint32 target;
+} LogRecord;
+
+static Log *process_log = NULL; /* for atexit and atfork */
+
+static void log_ring_release (gpointer data)
+{
+    LogRing *ring = data;
+
+    /* owner thread exit, writer free it after drained */
+    __atomic_store_n (&(ring->alive), FALSE, __ATOMIC_RELEASE);
+}
+
+static GPrivate thread_ring = G_PRIVATE_INIT (log_ring_release);
+
+static LogRing * log_get_ring (Log *log)
+{
+    LogRing *ring;
+
+    ring = g_private_get (&thread_ring);
+    if (G_LIKELY (ring != NULL)) {
+        return ring;
+    }
+
+    ring = g_malloc (sizeof (LogRing));
+    ring->write = 0;
+    ring->read = 0;
+    ring->dropped = 0;
+    ring->alive = TRUE;
+    ring->second = 0;
+    ring->next = __atomic_load_n (&(log->rings), __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n (&(log->rings), &(ring->next), ring, FALSE, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    g_private_set (&thread_ring, ring);
+
+    return ring;
+}
+
+/*
+ * copy message parts into ring as one record, drop it if ring full.
+ */
+static void log_ring_push (LogRing *ring, LogTarget target, struct iovec *iov, gint iovcnt)
+{
+    guint64 wpos, rpos, pad;
+    gsize size, offset, n;
+    LogRecord *record;
+    gchar *p;
+    gint i;
+
+    size = 0;
+    for (i = 0; i < iovcnt; i++) {
+        size += iov[i].iov_len;
+    }
+    if (size > LOG_MESSAGE_MAX) {
+        size = LOG_MESSAGE_MAX;
+    }
+
+    wpos = ring->write;
+    rpos = __atomic_load_n (&(ring->read), __ATOMIC_ACQUIRE);
+    offset = wpos % LOG_RING_SIZE;
+    pad = 0;
+    if (offset + LOG_RECORD_SIZE (size) > LOG_RING_SIZE) {
+        /* no room at the end of ring, record start from ring start */
+        pad = LOG_RING_SIZE - offset;
+    }
+    if (wpos + pad + LOG_RECORD_SIZE (size) - rpos > LOG_RING_SIZE) {
+        __atomic_add_fetch (&(ring->dropped), 1, __ATOMIC_RELAXED);
+        return;
+    }
+    if (pad != 0) {
+        record = (LogRecord *)(ring->buffer + offset);
+        record->size = pad - sizeof (LogRecord);
+        record->target = LOG_TARGET_PAD;
+        offset = 0;
+    }
+
+    record = (LogRecord *)(ring->buffer + offset);
+    record->size = size;
+    record->target = target;
+    p = (gchar *)(record + 1);
+    for (i = 0; (i < iovcnt) && (size > 0); i++) {
+        n = iov[i].iov_len < size ? iov[i].iov_len : size;
+        memcpy (p, iov[i].iov_base, n);
+        p += n;
+        size -= n;
+    }
+    __atomic_store_n (&(ring->write), wpos + pad + LOG_RECORD_SIZE (record->size), __ATOMIC_RELEASE);
+}
+
+/*
+ * write all of iov, retry on partial write.
+ */
+static void log_writev (gint fd, struct iovec *iov, gint iovcnt)
+{
+    gssize ret;
+
+    while ((fd != -1) && (iovcnt > 0)) {
+        ret = writev (fd, iov, iovcnt);
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        while ((iovcnt > 0) && (ret >= iov->iov_len)) {
+            ret -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (gchar *)iov->iov_base + ret;
+            iov->iov_len -= ret;
+        }
+    }
+}
+
+/*
+ * drain one ring, messages are written by writev in batch, point to ring directly.
+ */
+static void log_ring_drain (Log *log, LogRing *ring)
+{
+    struct iovec iov[2][LOG_IOV_MAX];
+    gint iovcnt[2], fd[2], i;
+    guint64 rpos, wpos, dropped;
+    LogRecord *record;
+    gsize offset;
+    gchar buf[128];
+
+    fd[LOG_TARGET_LOG] = log->log_fd;
+    fd[LOG_TARGET_ACCESS] = log->access_fd;
+    rpos = ring->read;
+    wpos = __atomic_load_n (&(ring->write), __ATOMIC_ACQUIRE);
+    while (rpos < wpos) {
+        iovcnt[LOG_TARGET_LOG] = iovcnt[LOG_TARGET_ACCESS] = 0;
+        while ((rpos < wpos) && (iovcnt[LOG_TARGET_LOG] < LOG_IOV_MAX) && (iovcnt[LOG_TARGET_ACCESS] < LOG_IOV_MAX)) {
+            offset = rpos % LOG_RING_SIZE;
+            record = (LogRecord *)(ring->buffer + offset);
+            if (record->target != LOG_TARGET_PAD) {
+                iov[record->target][iovcnt[record->target]].iov_base = record + 1;
+                iov[record->target][iovcnt[record->target]].iov_len = record->size;
+                iovcnt[record->target]++;
+            }
+            rpos += LOG_RECORD_SIZE (record->size);
+        }
+        for (i = LOG_TARGET_LOG; i <= LOG_TARGET_ACCESS; i++) {
+            log_writev (fd[i], iov[i], iovcnt[i]);
+        }
+        /* records written, release ring space */
+        __atomic_store_n (&(ring->read), rpos, __ATOMIC_RELEASE);
+    }
+
+    dropped = __atomic_exchange_n (&(ring->dropped), 0, __ATOMIC_RELAXED);
+    if (dropped > 0) {
+        log->dropped += dropped;
+        iov[0][0].iov_base = buf;
+        iov[0][0].iov_len = g_snprintf (buf, sizeof (buf), "%s log ring full, %" G_GUINT64_FORMAT " messages dropped, total %" G_GUINT64_FORMAT "\n",
+                                        ring->date, dropped, log->dropped);
+        log_writev (log->log_fd, iov[0], 1);
+    }
+}
+
+/* drain all rings, drain_mutex held */
+static void log_drain_locked (Log *log)
+{
+    LogRing *ring, *prev, *next;
+
+    prev = NULL;
+    ring = __atomic_load_n (&(log->rings), __ATOMIC_ACQUIRE);
+    while (ring != NULL) {
+        next = ring->next;
+        if (__atomic_load_n (&(ring->alive), __ATOMIC_ACQUIRE)) {
+            log_ring_drain (log, ring);
+            prev = ring;
+
+        } else {
+            log_ring_drain (log, ring);
+            /*
+             * producers only touch head, ring of exited thread is unlinked unless it is head,
+             * no more record after owner exit, drained ring is empty.
+             */
+            if ((prev != NULL) && (ring->read == __atomic_load_n (&(ring->write), __ATOMIC_ACQUIRE))) {
+                prev->next = next;
+                g_free (ring);
+
+            } else {
+                prev = ring;
+            }
+        }
+        ring = next;
+    }
+}
+
+static void log_drain (Log *log)
+{
+    g_mutex_lock (&(log->drain_mutex));
+    log_drain_locked (log);
+    g_mutex_unlock (&(log->drain_mutex));
+}
+
+static gpointer log_writer_thread (gpointer data)
+{
+    Log *log = data;
+    sigset_t set;
+
+    /* signal handler may exit and drain in atexit, never on this thread */
+    sigfillset (&set);
+    pthread_sigmask (SIG_BLOCK, &set, NULL);
+    for (;;) {
+        log_drain (log);
+        g_usleep (LOG_FLUSH_INTERVAL);
+    }
+
+    return NULL;
+}
+
+static void log_start_writer (Log *log)
+{
+    if (g_atomic_int_compare_and_exchange (&(log->writer_started), 0, 1)) {
+        log->writer = g_thread_new ("log_writer", log_writer_thread, log);
+    }
+}
+
+/*
+ * no drain in progress while forking, so that drain_mutex and rings are consistent in child.
+ * queued records are written before fork, parent of daemon exits by _exit without atexit drain.
+ */
+static void log_atfork_prepare (void)
+{
+    if (process_log != NULL) {
+        g_mutex_lock (&(process_log->drain_mutex));
+        log_drain_locked (process_log);
+    }
+}
+
+static void log_atfork_parent (void)
+{
+    if (process_log != NULL) {
+        g_mutex_unlock (&(process_log->drain_mutex));
+    }
+}
+
+/*
+ * threads are not inherited by forked process, e.g. daemon, writer would be restarted.
+ * records queued before fork are written in prepare, rings of other threads are freed.
+ */
+static void log_atfork_child (void)
+{
+    LogRing *ring, *own;
+
+    if (process_log != NULL) {
+        own = g_private_get (&thread_ring);
+        for (ring = process_log->rings; ring != NULL; ring = ring->next) {
+            ring->read = ring->write;
+            if (ring != own) {
+                ring->alive = FALSE;
+            }
+        }
+        process_log->writer_started = 0;
+        process_log->writer = NULL;
+        g_mutex_unlock (&(process_log->drain_mutex));
+    }
+}
+
+static void log_atexit (void)
+{
+    if (process_log != NULL) {
+        log_drain (process_log);
+    }
+}
+
+/*
+ * cache formatted timestamps of current second in ring.
+ */
+static void log_ring_update_date (LogRing *ring, gint64 second)
+{
+    struct tm tm;
+    time_t t;
+
+    t = second;
+    localtime_r (&t, &tm);
+    strftime (ring->date, sizeof (ring->date), "%b %d %H:%M:%S", &tm);
+    strftime (ring->access_date, sizeof (ring->access_date), "%b/%d/%Y:%H:%M:%S %z", &tm);
+    ring->second = second;
+}
+
 #define CAT_FMT "%s %s:%d: "
 static void log_func (GstDebugCategory *category,
         GstDebugLevel level,
@@ -158,34 +459,109 @@ static void log_func (GstDebugCategory *category,
         gpointer user_data)
 {
     Log *log = (Log *)user_data;
-    GDateTime *datetime;
-    gchar *date;
-    const gchar *cat;
+    LogRing *ring;
+    const gchar *cat, *msg, *p;
+    gchar prefix[256];
+    struct iovec iov[3];
+    gint64 now;
 
     if (level > gst_debug_category_get_threshold (category)) {
         return;
     }
 
+    if (G_UNLIKELY (!g_atomic_int_get (&(log->writer_started)))) {
+        log_start_writer (log);
+    }
+    ring = log_get_ring (log);
+    now = g_get_real_time ();
+    if (G_UNLIKELY (now / 1000000 != ring->second)) {
+        log_ring_update_date (ring, now / 1000000);
+    }
+
     cat = gst_debug_category_get_name (category);
-    datetime = g_date_time_new_now_local ();
+    msg = gst_debug_message_get (message);
     if (g_strcmp0 (cat, "access") == 0) {
-        date = g_date_time_format (datetime, "%b/%d/%Y:%H:%M:%S %z");
-        fprintf (log->access_hd, gst_debug_message_get (message), date);
-        g_free (date);
-        fflush (log->access_hd);
+        /* access message have a %s placeholder for date, replace it, never used as format. */
+        p = strstr (msg, "%s");
+        if (p == NULL) {
+            iov[0].iov_base = (gchar *)msg;
+            iov[0].iov_len = strlen (msg);
+            log_ring_push (ring, LOG_TARGET_ACCESS, iov, 1);
+
+        } else {
+            iov[0].iov_base = (gchar *)msg;
+            iov[0].iov_len = p - msg;
+            iov[1].iov_base = ring->access_date;
+            iov[1].iov_len = strlen (ring->access_date);
+            iov[2].iov_base = (gchar *)p + 2;
+            iov[2].iov_len = strlen (p + 2);
+            log_ring_push (ring, LOG_TARGET_ACCESS, iov, 3);
+        }
+
+    } else {
+        iov[0].iov_base = prefix;
+        iov[0].iov_len = g_snprintf (prefix, sizeof (prefix), "%s.%d %s" CAT_FMT,
+                                     ring->date,
+                                     (gint)(now % 1000000),
+                                     gst_debug_level_get_name (level),
+                                     cat, file, line);
+        if (iov[0].iov_len >= sizeof (prefix)) {
+            iov[0].iov_len = sizeof (prefix) - 1;
+        }
+        iov[1].iov_base = (gchar *)msg;
+        iov[1].iov_len = strlen (msg);
+        iov[2].iov_base = "\n";
+        iov[2].iov_len = 1;
+        log_ring_push (ring, LOG_TARGET_LOG, iov, 3);
+    }
+}
+
+static gint log_open (const gchar *path)
+{
+    return open (path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+}
+
+/**
+ * log_reopen:
+ * @log: (in): log
+ * @target: (in): LOG_TARGET_LOG or LOG_TARGET_ACCESS
+ *
+ * Reopen log file after it is rotated, the file descriptor is kept. It is
+ * async signal safe.
+ *
+ * Returns: 0 on success, 1 on failure.
+ */
+gint log_reopen (Log *log, LogTarget target)
+{
+    gint fd, new_fd;
+
+    if (target == LOG_TARGET_LOG) {
+        fd = log->log_fd;
+        new_fd = log_open (log->log_path);
 
     } else {
-        date = g_date_time_format (datetime, "%b %d %H:%M:%S");
-        fprintf (log->log_hd, "%s.%d %s" CAT_FMT "%s\n",
-            date,
-            g_date_time_get_microsecond (datetime),
-            gst_debug_level_get_name (level),
-            cat, file, line,
-            gst_debug_message_get (message));
-        g_free (date);
-        fflush (log->log_hd);
+        fd = log->access_fd;
+        new_fd = log_open (log->access_path);
+    }
+    if (new_fd == -1) {
+        return 1;
     }
-    g_date_time_unref (datetime);
+    dup2 (new_fd, fd);
+    fcntl (fd, F_SETFD, FD_CLOEXEC);
+    close (new_fd);
+
+    return 0;
+}
+
+/**
+ * log_flush:
+ * @log: (in): log
+ *
+ * Write out messages in all rings synchronously.
+ */
+void log_flush (Log *log)
+{
+    log_drain (log);
 }
 
 gint log_set_log_handler (Log *log)
@@ -197,33 +573,30 @@ gint log_set_log_handler (Log *log)
         GST_ERROR ("Can't open or create log directory: %s.", dirname (dir));
         return 1;
     }
+    g_free (dir);
     log->func = log_func;
 
-    log->log_hd = fopen (log->log_path, "ae");
-    if (log->log_hd == NULL) {
+    log->log_fd = log_open (log->log_path);
+    if (log->log_fd == -1) {
         GST_ERROR ("open log file error: %s", g_strerror (errno));
         return 1;
     }
-    setvbuf (log->log_hd, NULL, _IOLBF, 0);
 
     if (log->access_path != NULL) {
-        log->access_hd = fopen (log->access_path, "ae");
-        if (log->log_hd == NULL) {
+        log->access_fd = log_open (log->access_path);
+        if (log->access_fd == -1) {
             GST_ERROR ("open access file error: %s", g_strerror (errno));
             return 1;
         }
-        setvbuf (log->access_hd, NULL, _IOLBF, 0);
     }
 
-    if (log->log_hd == NULL) {
-        GST_ERROR ("Error open log file %s, %s.", log->log_path, g_strerror (errno));
-        return -1;
+    /* messages are queued in per thread ring, written out by writer thread */
+    process_log = log;
+    pthread_atfork (log_atfork_prepare, log_atfork_parent, log_atfork_child);
+    atexit (log_atexit);
+    log_start_writer (log);
+    gst_debug_add_log_function (log_func, log, NULL);
 
-    } else {
-        gst_debug_add_log_function (log_func, log, NULL);
-        return 0;
-    }
-
-    g_free (dir);
+    return 0;
 }
 
@@ -11,6 +11,34 @@
 #include <stdio.h>
 #include <gst/gst.h>
 
+#define LOG_RING_SIZE (128 * 1024) /* per thread ring */
+#define LOG_MESSAGE_MAX (16 * 1024) /* longer message is truncated */
+#define LOG_FLUSH_INTERVAL 20000 /* writer thread wakeup interval, microseconds */
+
+typedef enum {
+    LOG_TARGET_LOG = 0,
+    LOG_TARGET_ACCESS,
+    LOG_TARGET_PAD /* skip to ring start */
+} LogTarget;
+
+/*
+ * LogRing:
+ * single producer, single consumer ring. The producer is the thread that
+ * owns the ring, the consumer is the log writer thread. Positions increase
+ * monotonically, record never wraps, LOG_TARGET_PAD fills the end of ring.
+ */
+typedef struct _LogRing {
+    guint64 write; /* producer position */
+    guint64 dropped; /* messages dropped for ring full */
+    gint alive; /* FALSE after owner thread exit, ring freed by writer */
+    gint64 second; /* cached timestamps of this second */
+    gchar date[32];
+    gchar access_date[32];
+    struct _LogRing *next;
+    guint64 read __attribute__ ((aligned (64))); /* consumer position */
+    gchar buffer[LOG_RING_SIZE] __attribute__ ((aligned (64)));
+} LogRing;
+
 typedef struct _Log      Log;
 typedef struct _LogClass LogClass;
 
@@ -19,9 +47,15 @@ struct _Log {
 
     gchar *log_path;
     gchar *access_path;
-    FILE *log_hd;
-    FILE *access_hd;
+    gint log_fd;
+    gint access_fd;
     GstLogFunction func;
+
+    LogRing *rings; /* rings of all threads, new ring is pushed to head */
+    GMutex drain_mutex; /* writer thread and log_flush */
+    gint writer_started;
+    GThread *writer;
+    guint64 dropped; /* total dropped messages */
 };
 
 struct _LogClass {
@@ -39,6 +73,8 @@ struct _LogClass {
 GType log_get_type (void);
 
 gint log_set_log_handler (Log *log);
+void log_flush (Log *log);
+gint log_reopen (Log *log, LogTarget target);
 gint log_set_stdout_handler ();
 
 #endif /* __LOG_H__ */
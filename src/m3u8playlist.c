@@ -33,6 +33,8 @@ M3U8Playlist * m3u8playlist_new (guint version, guint window_size, guint64 seque
     playlist->entries = g_queue_new ();
     playlist->playlist_str = NULL;
     playlist->sequence_number = sequence;
+    playlist->discontinuity_sequence = 0;
+    playlist->discontinuity = FALSE;
 
     return playlist;
 }
@@ -63,6 +65,7 @@ static M3U8Entry * m3u8entry_new (const gchar * url, GstClockTime duration)
     entry = g_new0 (M3U8Entry, 1);
     entry->url = g_strdup (url);
     entry->duration = duration;
+    entry->discontinuity = FALSE;
 
     return entry;
 }
@@ -73,6 +76,9 @@ static void render_entry (M3U8Entry * entry, GString * gstring)
 
     g_return_if_fail (entry != NULL);
 
+    if (entry->discontinuity) {
+        g_string_append_printf (gstring, M3U8_DISCONTINUITY_TAG);
+    }
     entry_str = g_strdup_printf (M3U8_INF_TAG, (float) entry->duration / GST_SECOND, entry->url);
     g_string_append_printf (gstring, "%s", entry_str);
     g_free (entry_str);
@@ -106,6 +112,9 @@ static gchar * m3u8playlist_render (M3U8Playlist * playlist)
     if (playlist->window_size != 0) {
         g_string_append_printf (gstring, M3U8_MEDIA_SEQUENCE_TAG, playlist->sequence_number - playlist->entries->length);
     }
+    if (playlist->discontinuity_sequence != 0) {
+        g_string_append_printf (gstring, M3U8_DISCONTINUITY_SEQUENCE_TAG, playlist->discontinuity_sequence);
+    }
     g_string_append_printf (gstring, M3U8_TARGETDURATION_TAG, m3u8playlist_target_duration (playlist));
     g_string_append_printf (gstring, "\n");
     g_queue_foreach (playlist->entries, (GFunc) render_entry, gstring);
@@ -129,11 +138,16 @@ gint m3u8playlist_add_entry (M3U8Playlist *playlist, const gchar *url, gfloat du
     /* Delete old entries from the playlist */
     while ((playlist->window_size != 0) && (playlist->entries->length >= playlist->window_size)) {
         entry = g_queue_pop_head (playlist->entries);
+        if (entry->discontinuity) {
+            playlist->discontinuity_sequence++;
+        }
         m3u8entry_free (entry);
     }
 
     /* add entry */
     entry = m3u8entry_new (url, duration);
+    entry->discontinuity = playlist->discontinuity;
+    playlist->discontinuity = FALSE;
     number = sscanf (url, "%*[^/]/%lu.ts$", &sequence);
     if (number == 1) {
         playlist->sequence_number = sequence;
@@ -151,6 +165,21 @@ gint m3u8playlist_add_entry (M3U8Playlist *playlist, const gchar *url, gfloat du
     return duration;
 }
 
+/*
+ * m3u8playlist_add_discontinuity:
+ * @playlist: (in): live playlist
+ *
+ * next entry would be tagged with EXT-X-DISCONTINUITY, e.g. job worker restarted.
+ */
+void m3u8playlist_add_discontinuity (M3U8Playlist *playlist)
+{
+    g_rw_lock_writer_lock (&(playlist->lock));
+    if (playlist->entries->length != 0) {
+        playlist->discontinuity = TRUE;
+    }
+    g_rw_lock_writer_unlock (&(playlist->lock));
+}
+
 gchar * m3u8playlist_live_get_playlist (M3U8Playlist *playlist)
 {
     gchar *p;
@@ -16,11 +16,14 @@
 #define M3U8_INF_TAG "#EXTINF:%.2f,\n%s\n"
 #define M3U8_STREAM_INF_TAG "#EXT-X-STREAM-INF:PROGRAM-ID=%d,BANDWIDTH=%s000"
 #define M3U8_X_ENDLIST_TAG "#EXT-X-ENDLIST\n"
+#define M3U8_DISCONTINUITY_TAG "#EXT-X-DISCONTINUITY\n"
+#define M3U8_DISCONTINUITY_SEQUENCE_TAG "#EXT-X-DISCONTINUITY-SEQUENCE:%lu\n"
 
 typedef struct _M3U8Entry
 {
     GstClockTime duration;
     gchar *url;
+    gboolean discontinuity; /* first segment after a worker restart */
 } M3U8Entry;
 
 typedef struct _M3U8Playlist
@@ -29,6 +32,8 @@ typedef struct _M3U8Playlist
     guint version;
     gint window_size;
     guint64 sequence_number;
+    guint64 discontinuity_sequence; /* discontinuities slid out of window */
+    gboolean discontinuity; /* next entry is discontinuous */
 
     GQueue *entries;
     gchar *playlist_str;
@@ -37,6 +42,7 @@ typedef struct _M3U8Playlist
 M3U8Playlist * m3u8playlist_new (guint version, guint window_size, guint64 sequence);
 void m3u8playlist_free (M3U8Playlist *playlist);
 gint m3u8playlist_add_entry (M3U8Playlist *playlist, const gchar *url, gfloat duration);
+void m3u8playlist_add_discontinuity (M3U8Playlist *playlist);
 gchar * m3u8playlist_live_get_playlist (M3U8Playlist *playlist); 
 gchar * m3u8playlist_timeshift_get_playlist (gchar *path, guint64 duration, guint version, guint window_size, time_t shift_position); 
 gchar * m3u8playlist_callback_get_playlist (gchar *path, guint64 duration, guint64 dvr_duration, gchar *start, gchar *end); 
@@ -13,6 +13,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <glib/gstdio.h>
+#include <glib-unix.h>
 #include <gst/gst.h>
 #include <string.h>
 #include <sys/time.h>
@@ -28,7 +29,10 @@
 #include "parson.h"
 #include "jobdesc.h"
 #include "tssegment.h"
+#include "udpingest.h"
 #include "log.h"
+#include "utils.h"
+#include "zygote.h"
 
 #define GSTREAMILL_USER "gstreamill"
 #define GSTREAMILL_GROUP "gstreamill"
@@ -43,14 +47,18 @@ Log *_log;
 
 static void sighandler (gint number)
 {
-    _log->log_hd = freopen (_log->log_path, "w", _log->log_hd);
+    log_reopen (_log, LOG_TARGET_LOG);
 }
 
-static void stop_job (gint number)
+/* SIGTERM of job worker, dispatched in main loop, pipelines could be stoped */
+static gboolean stop_job (gpointer user_data)
 {
+    Job *job = (Job *)user_data;
     GDateTime *datetime;
     gchar *date;
 
+    source_stop (job->source);
+
     datetime = g_date_time_new_now_local ();
     date = g_date_time_format (datetime, "%b %d %H:%M:%S");
     GST_WARNING ("\n\n*** %s : job stoped ***", date);
@@ -186,6 +194,31 @@ static gint prepare_gstreamill_run_dir ()
     return 0;
 }
 
+/* ingest sockets are private to gstreamill user, mode is enforced on every start */
+static gint prepare_ingest_socket_dir ()
+{
+    GStatBuf st;
+
+    if ((g_mkdir (INGEST_SOCKET_DIR, 0700) == -1) && (errno != EEXIST)) {
+        perror ("mkdir of ingest socket directory failure");
+        return 1;
+    }
+    if (g_lstat (INGEST_SOCKET_DIR, &st) == -1) {
+        perror ("stat of ingest socket directory failure");
+        return 2;
+    }
+    if (!S_ISDIR (st.st_mode) || (st.st_uid != geteuid ())) {
+        g_print ("%s is not a directory owned by gstreamill\n", INGEST_SOCKET_DIR);
+        return 3;
+    }
+    if (chmod (INGEST_SOCKET_DIR, 0700) == -1) {
+        perror ("chmod of ingest socket directory failure");
+        return 4;
+    }
+
+    return 0;
+}
+
 static gboolean stop = FALSE;
 static gboolean debug = FALSE;
 static gboolean version = FALSE;
@@ -195,7 +228,10 @@ static gchar *http_mgmt = "0.0.0.0:20118";
 static gchar *http_streaming = "0.0.0.0:20119";
 static gchar *shm_name = NULL;
 static gint job_length = -1;
-static gint shm_length = -1;
+static gint64 shm_length = -1;
+static gboolean huge_pages = FALSE;
+static gint event_fd = -1;
+static gint zygote_fd = -1;
 static GOptionEntry options[] = {
     {"job", 'j', 0, G_OPTION_ARG_FILENAME, &job_file, ("-j /full/path/to/job.file: Specify a job file, full path is must."), NULL},
     {"log", 'l', 0, G_OPTION_ARG_FILENAME, &log_dir, ("-l /full/path/to/log: Specify log path, full path is must."), NULL},
@@ -203,7 +239,10 @@ static GOptionEntry options[] = {
     {"httpstreaming", 'a', 0, G_OPTION_ARG_STRING, &http_streaming, ("-a http streaming address, default is 0.0.0.0:20119."), NULL},
     {"name", 'n', G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_STRING, &shm_name, NULL, NULL},
     {"joblength", 'q', G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_INT, &job_length, NULL, NULL},
-    {"shmlength", 't', G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_INT, &shm_length, NULL, NULL},
+    {"shmlength", 't', G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_INT64, &shm_length, NULL, NULL},
+    {"hugepages", 'g', G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_NONE, &huge_pages, NULL, NULL},
+    {"eventfd", 'e', G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_INT, &event_fd, NULL, NULL},
+    {"zygote", 'z', G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_INT, &zygote_fd, NULL, NULL},
     {"stop", 's', 0, G_OPTION_ARG_NONE, &stop, ("Stop gstreamill."), NULL},
     {"debug", 'd', 0, G_OPTION_ARG_NONE, &debug, ("Debug mode, run in foreground."), NULL},
     {"version", 'v', 0, G_OPTION_ARG_NONE, &version, ("display version information and exit."), NULL},
@@ -335,6 +374,10 @@ int main (int argc, char *argv[])
         g_print ("Can't create gstreamill run directory\n");
         exit (3);
     }
+    if (prepare_ingest_socket_dir () != 0) {
+        g_print ("Can't create ingest socket directory\n");
+        exit (3);
+    }
     /*
        if (set_user_and_group () != 0) {
        g_print ("set user and group failure\n");
@@ -371,10 +414,41 @@ int main (int argc, char *argv[])
         exit (17);
     }
 
+    /* initialize udp ingest static plugin */
+    if (!gst_plugin_register_static (GST_VERSION_MAJOR,
+                GST_VERSION_MINOR,
+                "udpingest",
+                "udp ingest plugin",
+                udp_ingest_plugin_init,
+                "0.1.0",
+                "GPL",
+                "GStreamer",
+                "GStreamer",
+                "http://gstreamer.net/")) {
+        GST_ERROR ("registe udpingest error");
+        exit (17);
+    }
+
+    /* zygote, return in forked job worker only, which go on as an exec'ed one */
+    if (zygote_fd != -1) {
+        ZygoteRequest request;
+
+        event_fd = zygote_run (zygote_fd, &request);
+        shm_name = g_strdup (request.shm_name);
+        job_length = request.job_length;
+        shm_length = request.shm_length;
+        huge_pages = request.huge_pages;
+        log_dir = g_strdup (request.log_dir);
+        if (request.gst_debug[0] != '\0') {
+            gst_debug_set_threshold_from_string (request.gst_debug, FALSE);
+        }
+    }
+
     /* subprocess, create_job_process */
     if (shm_name != NULL) {
         gint fd;
         gchar *job_desc, *p;
+        JobDesc *jobdesc;
         Job *job;
         gchar *log_path, *name;
         gint ret;
@@ -397,7 +471,11 @@ int main (int argc, char *argv[])
 
         /* read job description from share memory */
         job_desc = NULL;
-        fd = shm_open (shm_name, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+        if (shm_length <= 0) {
+            GST_ERROR ("invalid share memory length %" G_GINT64_FORMAT, shm_length);
+            exit (5);
+        }
+        fd = output_shm_open (shm_name, huge_pages);
         if (fd == -1) {
             GST_ERROR ("shm_open error");
             exit (5);
@@ -411,18 +489,22 @@ int main (int argc, char *argv[])
             GST_ERROR ("mmap error: %s", g_strerror (errno));
             exit (5);
         }
-        job_desc = g_strndup (p, job_length);
+        if (job_output_check (p, shm_length) != 0) {
+            exit (5);
+        }
+        job_desc = g_strndup (p + sizeof (JobOutputHeader), job_length);
 
-        if ((job_desc != NULL) && (!jobdesc_is_valid (job_desc))) {
+        jobdesc = jobdesc_new (job_desc);
+        if (jobdesc == NULL) {
             exit (6);
         }
 
         /* initialize log */
-        name = (gchar *)jobdesc_get_name (job_desc);
-        if (!jobdesc_is_live (job_desc)) {
+        name = (gchar *)jobdesc_get_name (jobdesc);
+        if (!jobdesc_is_live (jobdesc)) {
             gchar *path;
 
-            path = jobdesc_get_log_path (job_desc);
+            path = jobdesc_get_log_path (jobdesc);
             log_path = g_build_filename (path, "gstreamill.log", NULL);
             g_free (path);
 
@@ -444,12 +526,14 @@ int main (int argc, char *argv[])
         /* launch a job. */
         datetime = g_date_time_new_now_local ();
         date = g_date_time_format (datetime, "%b %d %H:%M:%S");
-        fprintf (_log->log_hd, "\n*** %s : job %s starting ***\n", date, name);
+        GST_WARNING ("\n*** %s : job %s starting ***", date, name);
         g_date_time_unref (datetime);
         g_free (date);
-        job = job_new ("name", name, "job", job_desc, NULL);
-        job->is_live = jobdesc_is_live (job_desc);
+        job = job_new ("name", name, "jobdesc", jobdesc, NULL);
+        job->is_live = jobdesc_is_live (jobdesc);
         job->eos = FALSE;
+        job->huge_pages = huge_pages;
+        job->event_fd = event_fd;
         loop = g_main_loop_new (NULL, FALSE);
 
         GST_INFO ("Initializing job ...");
@@ -473,7 +557,7 @@ int main (int argc, char *argv[])
         }
         datetime = g_date_time_new_now_local ();
         date = g_date_time_format (datetime, "%b %d %H:%M:%S");
-        fprintf (_log->log_hd, "\n*** %s : job %s started ***\n", date, name);
+        GST_WARNING ("\n*** %s : job %s started ***", date, name);
         g_date_time_unref (datetime);
         g_free (date);
         g_free (name);
@@ -481,7 +565,7 @@ int main (int argc, char *argv[])
 
         signal (SIGPIPE, SIG_IGN);
         signal (SIGUSR1, sighandler);
-        signal (SIGTERM, stop_job);
+        g_unix_signal_add (SIGTERM, stop_job, job);
 
         g_main_loop_run (loop);
 
@@ -567,7 +651,7 @@ int main (int argc, char *argv[])
         if (mode == DAEMON_MODE) {
             /* daemonize */
             if (daemon (0, 0) != 0) {
-                fprintf (log->log_hd, "Failed to daemonize");
+                GST_ERROR ("Failed to daemonize");
                 remove_pid_file ();
                 exit (1);
             }
@@ -618,7 +702,7 @@ int main (int argc, char *argv[])
 
     if (mode != SINGLE_JOB_MODE) {
         /* run in background, management via http */
-        httpmgmt = httpmgmt_new ("gstreamill", gstreamill, "address", http_mgmt, NULL);
+        httpmgmt = httpmgmt_new ("gstreamill", gstreamill, "httpstreaming", httpstreaming, "address", http_mgmt, NULL);
         if (httpmgmt_start (httpmgmt) != 0) {
             GST_ERROR ("start http mangment error, exit.");
             remove_pid_file ();
@@ -0,0 +1,133 @@
+/*
+ *  metrics, lock free counters and histograms in prometheus text exposition format
+ *
+ *  Copyright (C) Zhang Ping <dqzhangp@163.com>
+ */
+
+#include "metrics.h"
+
+static const gchar *route_names[METRICS_ROUTE_NUM] = {
+    "stat",
+    "admin",
+    "media",
+    "metrics",
+    "master_playlist",
+    "playlist",
+    "segment",
+    "progressive",
+    "dvr_download",
+    "other"
+};
+
+/**
+ * metrics_histogram_observe:
+ * @histogram: (in): the histogram
+ * @us: (in): observed value in microseconds
+ *
+ * Called on hot path, no lock.
+ */
+void metrics_histogram_observe (MetricsHistogram *histogram, guint64 us)
+{
+    guint i;
+
+    i = us == 0 ? 0 : g_bit_storage (us);
+    if (i >= METRICS_HISTOGRAM_BUCKETS) {
+        i = METRICS_HISTOGRAM_BUCKETS - 1;
+    }
+    __atomic_add_fetch (&(histogram->buckets[i]), 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch (&(histogram->count), 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch (&(histogram->sum), us, __ATOMIC_RELAXED);
+}
+
+/**
+ * metrics_counter_add:
+ * @counter: (in): the counter
+ * @value: (in): increment
+ */
+void metrics_counter_add (guint64 *counter, guint64 value)
+{
+    __atomic_add_fetch (counter, value, __ATOMIC_RELAXED);
+}
+
+/**
+ * metrics_histogram_quantile:
+ * @histogram: (in): the histogram
+ * @q: (in): quantile, 0.5 for median
+ *
+ * Returns: upper bound of the bucket the quantile falls in, us, 0 if nothing observed.
+ * values of the last bucket are reported as its lower bound.
+ */
+guint64 metrics_histogram_quantile (MetricsHistogram *histogram, gdouble q)
+{
+    guint64 buckets[METRICS_HISTOGRAM_BUCKETS], count, cumulative;
+    gint i;
+
+    count = 0;
+    for (i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+        buckets[i] = __atomic_load_n (&(histogram->buckets[i]), __ATOMIC_RELAXED);
+        count += buckets[i];
+    }
+    if (count == 0) {
+        return 0;
+    }
+    cumulative = 0;
+    for (i = 0; i < METRICS_HISTOGRAM_BUCKETS - 1; i++) {
+        cumulative += buckets[i];
+        if (cumulative >= q * count) {
+            break;
+        }
+    }
+
+    return i < METRICS_HISTOGRAM_BUCKETS - 1 ? (guint64)1 << i : (guint64)1 << (METRICS_HISTOGRAM_BUCKETS - 2);
+}
+
+const gchar * metrics_route_name (MetricsRoute route)
+{
+    return route_names[route];
+}
+
+/**
+ * metrics_render_help:
+ * @out: (in): exposition text
+ * @name: (in): metric name
+ * @type: (in): counter, gauge or histogram
+ * @help: (in): description
+ */
+void metrics_render_help (GString *out, const gchar *name, const gchar *type, const gchar *help)
+{
+    g_string_append_printf (out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/**
+ * metrics_render_histogram:
+ * @out: (in): exposition text
+ * @name: (in): metric name, in seconds
+ * @labels: (in): labels without braces, e.g. route="stat", or ""
+ * @histogram: (in): the histogram
+ *
+ * Buckets are cumulative in exposition, snapshot is not atomic as a whole, count is the sum of
+ * the buckets read to keep +Inf bucket and count consistent.
+ */
+void metrics_render_histogram (GString *out, const gchar *name, const gchar *labels, MetricsHistogram *histogram)
+{
+    guint64 cumulative;
+    gint i;
+
+    cumulative = 0;
+    for (i = 0; i < METRICS_HISTOGRAM_BUCKETS - 1; i++) {
+        cumulative += __atomic_load_n (&(histogram->buckets[i]), __ATOMIC_RELAXED);
+        g_string_append_printf (out, "%s_bucket{%s%sle=\"%g\"} %" G_GUINT64_FORMAT "\n",
+                name,
+                labels,
+                labels[0] == '\0' ? "" : ",",
+                (gdouble)((guint64)1 << i) / 1000000,
+                cumulative);
+    }
+    cumulative += __atomic_load_n (&(histogram->buckets[i]), __ATOMIC_RELAXED);
+    g_string_append_printf (out, "%s_bucket{%s%sle=\"+Inf\"} %" G_GUINT64_FORMAT "\n", name, labels, labels[0] == '\0' ? "" : ",", cumulative);
+    g_string_append_printf (out, "%s_sum{%s} %g\n",
+            name,
+            labels,
+            (gdouble)__atomic_load_n (&(histogram->sum), __ATOMIC_RELAXED) / 1000000);
+    g_string_append_printf (out, "%s_count{%s} %" G_GUINT64_FORMAT "\n", name, labels, cumulative);
+}
@@ -0,0 +1,51 @@
+/*
+ *  metrics, lock free counters and histograms in prometheus text exposition format
+ *
+ *  Copyright (C) Zhang Ping <dqzhangp@163.com>
+ */
+
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <glib.h>
+
+#define METRICS_HISTOGRAM_BUCKETS 28 /* bucket i counts values below 2^i us, i.e. up to 67s, last one is +Inf */
+
+/*
+ * MetricsHistogram:
+ * log2 buckets of microseconds, observing a value is three relaxed atomic increments.
+ */
+typedef struct _MetricsHistogram {
+    guint64 buckets[METRICS_HISTOGRAM_BUCKETS];
+    guint64 count;
+    guint64 sum; /* us */
+} MetricsHistogram;
+
+typedef enum {
+    METRICS_ROUTE_STAT = 0, /* management api */
+    METRICS_ROUTE_ADMIN,
+    METRICS_ROUTE_MEDIA,
+    METRICS_ROUTE_METRICS,
+    METRICS_ROUTE_MASTER_PLAYLIST, /* streaming */
+    METRICS_ROUTE_PLAYLIST,
+    METRICS_ROUTE_SEGMENT,
+    METRICS_ROUTE_PROGRESSIVE,
+    METRICS_ROUTE_DVR_DOWNLOAD,
+    METRICS_ROUTE_OTHER,
+    METRICS_ROUTE_NUM
+} MetricsRoute;
+
+typedef struct _Metrics {
+    MetricsHistogram request_latency[METRICS_ROUTE_NUM]; /* accept to response header sent */
+    MetricsHistogram dvr_write_latency; /* segment queued to written */
+    guint64 dvr_write_errors;
+} Metrics;
+
+void metrics_histogram_observe (MetricsHistogram *histogram, guint64 us);
+void metrics_counter_add (guint64 *counter, guint64 value);
+guint64 metrics_histogram_quantile (MetricsHistogram *histogram, gdouble q);
+const gchar * metrics_route_name (MetricsRoute route);
+void metrics_render_histogram (GString *out, const gchar *name, const gchar *labels, MetricsHistogram *histogram);
+void metrics_render_help (GString *out, const gchar *name, const gchar *type, const gchar *help);
+
+#endif /* __METRICS_H__ */
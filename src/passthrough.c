@@ -0,0 +1,297 @@
+/*
+ *  native mpegts passthrough, udp in, segmented mpegts out without gstreamer pipeline
+ *
+ *  Copyright (C) Zhang Ping <dqzhangp@163.com>
+ */
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <gst/gst.h>
+
+#include "passthrough.h"
+#include "udpingest.h"
+
+GST_DEBUG_CATEGORY_EXTERN (GSTREAMILL);
+#define GST_CAT_DEFAULT GSTREAMILL
+
+/* "video,audio" codec of tssegment as get_tssegment_codec_tag does */
+static gchar * tssegment_codec (TsSegment *tssegment)
+{
+    gchar *audio, *video, *codec;
+
+    codec = NULL;
+    if (gst_tag_list_get_string (tssegment->tag, GST_TAG_AUDIO_CODEC, &audio)) {
+        if (gst_tag_list_get_string (tssegment->tag, GST_TAG_VIDEO_CODEC, &video)) {
+            codec = g_strdup_printf ("%s,%s", video, audio);
+            GST_WARNING ("mpegts stream codec is: %s", codec);
+            g_free (video);
+        }
+        g_free (audio);
+    }
+
+    return codec;
+}
+
+/* a frame from tssegment, source stream segment and encoder output */
+static void frame_output (GstBuffer *buffer, gpointer user_data)
+{
+    PassthroughProgram *program = (PassthroughProgram *)user_data;
+    SourceStream *stream = program->source;
+    RingBuffer ring_buffer;
+
+    if (G_UNLIKELY ((stream->codec == NULL) && (stream->next_segment_timestamp == 0))) {
+        stream->codec = tssegment_codec (program->tssegment);
+    }
+    stream->state->last_heartbeat = gst_clock_get_time (stream->system_clock);
+    ring_buffer.is_rap = FALSE;
+    ring_buffer.ingest_time = stream->state->last_heartbeat / 1000;
+    ring_buffer.sample = NULL;
+    source_stream_segment (stream, buffer, &ring_buffer);
+    encoder_stream_push (program->encoder, &ring_buffer, buffer);
+    gst_buffer_unref (buffer);
+}
+
+/* block of a batch, reused unless adapter of a tssegment still holds an incomplete packet of it */
+static GstBuffer * block_map (GstBuffer *buffer, GstMapInfo *info)
+{
+    if ((buffer != NULL) && !gst_buffer_is_writable (buffer)) {
+        gst_buffer_unref (buffer);
+        buffer = NULL;
+    }
+    if (buffer == NULL) {
+        buffer = gst_buffer_new_allocate (NULL, PASSTHROUGH_BATCH * PASSTHROUGH_DATAGRAM_SIZE, NULL);
+    }
+    gst_buffer_set_size (buffer, PASSTHROUGH_BATCH * PASSTHROUGH_DATAGRAM_SIZE);
+    gst_buffer_map (buffer, info, GST_MAP_WRITE);
+
+    return buffer;
+}
+
+/* demultiplexed packets of the program so far go to its tssegment */
+static void program_flush (PassthroughProgram *program)
+{
+    if (program->size == 0) {
+        return;
+    }
+    gst_buffer_unmap (program->buffer, &(program->info));
+    gst_buffer_set_size (program->buffer, program->size);
+    ts_segment_push (program->tssegment, gst_buffer_ref (program->buffer));
+    program->size = 0;
+    program->buffer = block_map (program->buffer, &(program->info));
+}
+
+/* pat of mpts, parsed on version change, every program puts its single program pat in place of it */
+static void passthrough_pat (Passthrough *passthrough, const guint8 *packet)
+{
+    GstMpegtsSection *section;
+    GPtrArray *pat;
+    const guint8 *data;
+    guint offset, section_length;
+    guint8 version;
+    gint i;
+
+    /* payload unit start */
+    if (!(packet[1] & 0x40) || !FLAGS_HAS_PAYLOAD (packet[3])) {
+        return;
+    }
+    offset = 4;
+    if (FLAGS_HAS_AFC (packet[3])) {
+        offset += 1 + packet[4];
+    }
+    if (offset >= MPEGTS_NORMAL_PACKETSIZE) {
+        return;
+    }
+    offset += 1 + packet[offset]; /* pointer field */
+    if (offset + 8 > MPEGTS_NORMAL_PACKETSIZE) {
+        return;
+    }
+    data = packet + offset;
+    section_length = (GST_READ_UINT16_BE (data + 1) & 0xfff) + 3;
+    if (offset + section_length > MPEGTS_NORMAL_PACKETSIZE) {
+        /* pat in more than one packet, not supported as in tssegment */
+        return;
+    }
+
+    section = NULL;
+    version = (data[5] >> 1) & 0x1f;
+    if (version != passthrough->pat_version) {
+        section = gst_mpegts_section_new (0, g_memdup (data, section_length), section_length);
+        pat = (section != NULL) ? gst_mpegts_section_get_pat (section) : NULL;
+        if (pat == NULL) {
+            GST_WARNING ("passthrough %s invalid pat", passthrough->uri);
+            if (section != NULL) {
+                gst_mpegts_section_unref (section);
+            }
+            return;
+        }
+        g_ptr_array_unref (pat);
+        GST_INFO ("passthrough %s pat version %u", passthrough->uri, version);
+        passthrough->pat_version = version;
+    }
+    for (i = 0; i < passthrough->programs_count; i++) {
+        /* the pat follows packets before it */
+        program_flush (&(passthrough->programs[i]));
+        ts_segment_pat (passthrough->programs[i].tssegment, section);
+    }
+    if (section != NULL) {
+        gst_mpegts_section_unref (section);
+    }
+}
+
+/*
+ * passthrough_demux:
+ * packets of a batch to programs by pid, psi other than pat and pmt, and pids of no program are dropped.
+ * a program is flushed after its pmt, packets of a new pid of the pmt are not lost.
+ */
+static void passthrough_demux (Passthrough *passthrough, gint count)
+{
+    PassthroughProgram *program;
+    TsSegment *tssegment;
+    guint8 *datagram, *packet;
+    guint16 pid;
+    gsize offset;
+    gint i, j;
+
+    for (i = 0; i < count; i++) {
+        datagram = passthrough->iovecs[i].iov_base;
+        for (offset = 0; offset + MPEGTS_NORMAL_PACKETSIZE <= passthrough->msgs[i].msg_len; offset += MPEGTS_NORMAL_PACKETSIZE) {
+            packet = datagram + offset;
+            if (packet[0] != PACKET_SYNC_BYTE) {
+                continue;
+            }
+            pid = GST_READ_UINT16_BE (packet + 1) & 0x1fff;
+            if (pid == 0) {
+                passthrough_pat (passthrough, packet);
+                continue;
+            }
+            for (j = 0; j < passthrough->programs_count; j++) {
+                program = &(passthrough->programs[j]);
+                tssegment = program->tssegment;
+                if ((tssegment->pmt_pid != 0) && (pid == tssegment->pmt_pid)) {
+                    memcpy (program->info.data + program->size, packet, MPEGTS_NORMAL_PACKETSIZE);
+                    program->size += MPEGTS_NORMAL_PACKETSIZE;
+                    program_flush (program);
+
+                } else if (MPEGTS_BIT_IS_SET (tssegment->program_pids, pid)) {
+                    memcpy (program->info.data + program->size, packet, MPEGTS_NORMAL_PACKETSIZE);
+                    program->size += MPEGTS_NORMAL_PACKETSIZE;
+                }
+            }
+        }
+    }
+}
+
+static gpointer passthrough_thread (gpointer data)
+{
+    Passthrough *passthrough = (Passthrough *)data;
+    GstBuffer *buffer;
+    GstMapInfo info;
+    gsize size;
+    gint count, i;
+
+    buffer = NULL;
+    for (;;) {
+        /* datagrams of a batch in one block, become one buffer after compacted if not demultiplexed */
+        buffer = block_map (buffer, &info);
+        for (i = 0; i < PASSTHROUGH_BATCH; i++) {
+            passthrough->iovecs[i].iov_base = info.data + i * PASSTHROUGH_DATAGRAM_SIZE;
+            passthrough->iovecs[i].iov_len = PASSTHROUGH_DATAGRAM_SIZE;
+        }
+        count = recvmmsg (passthrough->sock, passthrough->msgs, PASSTHROUGH_BATCH, MSG_WAITFORONE, NULL);
+        if (count == -1) {
+            gst_buffer_unmap (buffer, &info);
+            if (errno == EINTR) {
+                continue;
+            }
+            GST_ERROR ("passthrough %s recvmmsg error: %s, exit", passthrough->uri, g_strerror (errno));
+            exit (101); /* exit 101 for pipeline error, job should be restarted */
+        }
+        if (passthrough->demux) {
+            /* mpts is received and read once, every tssegment parses pids of its own program only */
+            passthrough_demux (passthrough, count);
+            gst_buffer_unmap (buffer, &info);
+            for (i = 0; i < passthrough->programs_count; i++) {
+                program_flush (&(passthrough->programs[i]));
+            }
+            continue;
+        }
+        size = 0;
+        for (i = 0; i < count; i++) {
+            if (size != i * PASSTHROUGH_DATAGRAM_SIZE) {
+                memmove (info.data + size, passthrough->iovecs[i].iov_base, passthrough->msgs[i].msg_len);
+            }
+            size += passthrough->msgs[i].msg_len;
+        }
+        gst_buffer_unmap (buffer, &info);
+        if (size == 0) {
+            continue;
+        }
+        gst_buffer_set_size (buffer, size);
+        /* no program selected, the whole stream goes to the only program */
+        ts_segment_push (passthrough->programs[0].tssegment, gst_buffer_ref (buffer));
+    }
+
+    return NULL;
+}
+
+/**
+ * passthrough_start:
+ * @jobdesc: (in): job description of native passthrough job.
+ * @source: (in): initialized source without pipeline, a tssegment stream for every program.
+ *
+ * Open udp socket and start passthrough thread, encoder stream of source stream is the output of a program.
+ *
+ * Returns: Passthrough, NULL on failure.
+ */
+Passthrough * passthrough_start (JobDesc *jobdesc, Source *source)
+{
+    Passthrough *passthrough;
+    PassthroughProgram *program;
+    gint i;
+
+    passthrough = g_malloc0 (sizeof (Passthrough));
+    passthrough->uri = g_strdup (jobdesc_passthrough (jobdesc));
+    if (g_str_has_prefix (passthrough->uri, "udp://")) {
+        passthrough->sock = udp_ingest_socket_open (passthrough->uri, PASSTHROUGH_RCVBUF);
+
+    } else {
+        GST_ERROR ("invalid passthrough uri %s", passthrough->uri);
+        passthrough->sock = -1;
+    }
+    if (passthrough->sock == -1) {
+        g_free (passthrough->uri);
+        g_free (passthrough);
+        return NULL;
+    }
+    for (i = 0; i < PASSTHROUGH_BATCH; i++) {
+        passthrough->msgs[i].msg_hdr.msg_iov = &(passthrough->iovecs[i]);
+        passthrough->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    passthrough->programs_count = source->streams->len;
+    passthrough->programs = g_new0 (PassthroughProgram, passthrough->programs_count);
+    passthrough->pat_version = VERSION_NUMBER_UNSET;
+    for (i = 0; i < passthrough->programs_count; i++) {
+        program = &(passthrough->programs[i]);
+        program->source = g_array_index (source->streams, gpointer, i);
+        program->encoder = g_array_index (program->source->encoders, gpointer, 0);
+        program->tssegment = TS_SEGMENT (g_object_new (TYPE_TS_SEGMENT,
+                    "program-number", jobdesc_passthrough_program (jobdesc, i),
+                    NULL));
+        ts_segment_set_output (program->tssegment, frame_output, program);
+        GST_INFO ("passthrough %s program %u", passthrough->uri, program->tssegment->selected_program);
+    }
+    passthrough->demux = (passthrough->programs_count > 1) || (passthrough->programs[0].tssegment->selected_program != 0);
+    for (i = 0; passthrough->demux && (i < passthrough->programs_count); i++) {
+        program = &(passthrough->programs[i]);
+        program->buffer = block_map (NULL, &(program->info));
+        program->size = 0;
+    }
+    passthrough->thread = g_thread_new ("passthrough", passthrough_thread, passthrough);
+    GST_INFO ("native passthrough %s started", passthrough->uri);
+
+    return passthrough;
+}
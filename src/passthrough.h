@@ -0,0 +1,52 @@
+/*
+ *  native mpegts passthrough, udp in, segmented mpegts out without gstreamer pipeline
+ *
+ *  Copyright (C) Zhang Ping <dqzhangp@163.com>
+ */
+
+#ifndef __PASSTHROUGH_H__
+#define __PASSTHROUGH_H__
+
+#include <sys/socket.h>
+#include <gst/gst.h>
+
+#include "jobdesc.h"
+#include "source.h"
+#include "encoder.h"
+#include "tssegment.h"
+
+#define PASSTHROUGH_BATCH 64 /* datagrams per recvmmsg */
+#define PASSTHROUGH_DATAGRAM_SIZE 2048
+#define PASSTHROUGH_RCVBUF 8388608 /* 8M */
+
+/* a program of mpts, or the only program of spts */
+typedef struct _PassthroughProgram {
+    TsSegment *tssegment;
+    SourceStream *source;
+    EncoderStream *encoder;
+    GstBuffer *buffer; /* packets of the program demultiplexed from a batch, mapped in info */
+    GstMapInfo info;
+    gsize size;
+} PassthroughProgram;
+
+/*
+ * Passthrough:
+ * one thread reads udp datagrams in batch, tssegment of every program splits them to frames, frames go into
+ * encoder output, what "udpsrc ! tssegment ! appsink" and "appsrc ! appsink" do in a tssegment job.
+ * programs of mpts are demultiplexed by pid in the thread, pat is parsed there once for all programs.
+ */
+typedef struct _Passthrough {
+    gchar *uri;
+    gint sock;
+    gboolean demux; /* programs are selected, FALSE if the whole stream goes to the only program */
+    guint8 pat_version;
+    gint programs_count;
+    PassthroughProgram *programs;
+    GThread *thread;
+    struct mmsghdr msgs[PASSTHROUGH_BATCH];
+    struct iovec iovecs[PASSTHROUGH_BATCH];
+} Passthrough;
+
+Passthrough * passthrough_start (JobDesc *jobdesc, Source *source);
+
+#endif /* __PASSTHROUGH_H__ */
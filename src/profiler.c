@@ -0,0 +1,313 @@
+/*
+ *  profiler, a GstTracer measuring cpu cost of elements and threads of a job worker
+ *
+ *  Copyright (C) Zhang Ping <dqzhangp@163.com>
+ */
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+
+#include "profiler.h"
+
+GST_DEBUG_CATEGORY_EXTERN (GSTREAMILL);
+#define GST_CAT_DEFAULT GSTREAMILL
+
+G_DEFINE_TYPE (Profiler, profiler, GST_TYPE_TRACER);
+
+/*
+ * elements a thread is in, the element at top is charged the thread cpu time since mark.
+ */
+typedef struct _ProfilerThreadState {
+    ProfilerElement *stack[PROFILER_STACK_DEPTH];
+    gint depth;
+    guint64 mark; /* thread cpu time of last enter or leave */
+    ProfilerThread *thread;
+} ProfilerThreadState;
+
+static GPrivate thread_state = G_PRIVATE_INIT (g_free);
+
+/* slot of elements and threads not profiled because of table full, not in share memory */
+static ProfilerElement unprofiled_element;
+static ProfilerThread unprofiled_thread;
+
+static void profiler_class_init (ProfilerClass *klass)
+{
+}
+
+static void profiler_init (Profiler *profiler)
+{
+    g_mutex_init (&(profiler->mutex));
+    profiler->quark = g_quark_from_static_string ("gstreamill-profiler");
+    profiler->output = NULL;
+}
+
+static guint64 thread_cpu_time (void)
+{
+    struct timespec ts;
+
+    if (clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts) == -1) {
+        return 0;
+    }
+
+    return ts.tv_sec * GST_SECOND + ts.tv_nsec;
+}
+
+static ProfilerThreadState * get_thread_state (Profiler *profiler)
+{
+    ProfilerThreadState *state;
+    ProfilerOutput *output = profiler->output;
+    ProfilerThread *thread;
+
+    state = g_private_get (&thread_state);
+    if (state != NULL) {
+        return state;
+    }
+
+    state = g_new0 (ProfilerThreadState, 1);
+    g_mutex_lock (&(profiler->mutex));
+    if (output->threads_count < PROFILER_THREADS) {
+        thread = &(output->threads[output->threads_count]);
+        prctl (PR_GET_NAME, thread->name, 0, 0, 0);
+        thread->tid = syscall (SYS_gettid);
+        __atomic_store_n (&(output->threads_count), output->threads_count + 1, __ATOMIC_RELEASE);
+
+    } else {
+        thread = &unprofiled_thread;
+        output->overflow++;
+    }
+    g_mutex_unlock (&(profiler->mutex));
+    state->thread = thread;
+    g_private_set (&thread_state, state);
+
+    return state;
+}
+
+/* element of the pad, parent of a proxy pad inside a bin is the ghost pad */
+static GstElement * pad_element (GstPad *pad)
+{
+    GstObject *parent;
+
+    if (pad == NULL) {
+        return NULL;
+    }
+    parent = GST_OBJECT_PARENT (pad);
+    while ((parent != NULL) && GST_IS_PAD (parent)) {
+        parent = GST_OBJECT_PARENT (parent);
+    }
+
+    return GST_IS_ELEMENT (parent) ? GST_ELEMENT_CAST (parent) : NULL;
+}
+
+/*
+ * slot of element, allocated at first push, kept in element qdata. slot of an element with the
+ * same path is reused, e.g. source pipeline rebuilt.
+ */
+static ProfilerElement * get_element_slot (Profiler *profiler, GstElement *element)
+{
+    ProfilerOutput *output = profiler->output;
+    ProfilerElement *slot;
+    gchar *name;
+    guint i;
+
+    if (element == NULL) {
+        return NULL;
+    }
+    slot = g_object_get_qdata (G_OBJECT (element), profiler->quark);
+    if (slot != NULL) {
+        return slot;
+    }
+
+    g_mutex_lock (&(profiler->mutex));
+    slot = g_object_get_qdata (G_OBJECT (element), profiler->quark);
+    if (slot != NULL) {
+        g_mutex_unlock (&(profiler->mutex));
+        return slot;
+    }
+    name = gst_object_get_path_string (GST_OBJECT (element));
+    for (i = 0; i < output->elements_count; i++) {
+        if (strncmp (output->elements[i].name, name, PROFILER_NAME_LEN - 1) == 0) {
+            slot = &(output->elements[i]);
+            break;
+        }
+    }
+    if ((slot == NULL) && (output->elements_count < PROFILER_ELEMENTS)) {
+        slot = &(output->elements[output->elements_count]);
+        g_strlcpy (slot->name, name, PROFILER_NAME_LEN);
+        slot->is_queue = (g_strcmp0 (G_OBJECT_TYPE_NAME (element), "GstQueue") == 0);
+        __atomic_store_n (&(output->elements_count), output->elements_count + 1, __ATOMIC_RELEASE);
+
+    } else if (slot == NULL) {
+        GST_WARNING ("profiler element table full, %s not profiled", name);
+        slot = &unprofiled_element;
+        output->overflow++;
+    }
+    g_free (name);
+    g_object_set_qdata (G_OBJECT (element), profiler->quark, slot);
+    g_mutex_unlock (&(profiler->mutex));
+
+    return slot;
+}
+
+static void charge (ProfilerElement *slot, guint64 cpu_time)
+{
+    if (slot != NULL) {
+        __atomic_add_fetch (&(slot->cpu_time), cpu_time, __ATOMIC_RELAXED);
+    }
+}
+
+/* thread goes from caller into callee, a push or a pull */
+static void enter (Profiler *profiler, ProfilerElement *caller, ProfilerElement *callee)
+{
+    ProfilerThreadState *state;
+    guint64 now;
+
+    state = get_thread_state (profiler);
+    now = thread_cpu_time ();
+    if (state->depth == 0) {
+        /* loop of the task of caller */
+        charge (caller, now - state->mark);
+
+    } else if (state->depth <= PROFILER_STACK_DEPTH) {
+        charge (state->stack[state->depth - 1], now - state->mark);
+    }
+    if (state->depth < PROFILER_STACK_DEPTH) {
+        state->stack[state->depth] = callee;
+    }
+    state->depth++;
+    state->mark = now;
+    state->thread->cpu_time = now;
+}
+
+/* thread returns from callee */
+static ProfilerElement * leave (Profiler *profiler)
+{
+    ProfilerThreadState *state;
+    ProfilerElement *callee = NULL;
+    guint64 now;
+
+    state = get_thread_state (profiler);
+    if (state->depth == 0) {
+        return NULL;
+    }
+    now = thread_cpu_time ();
+    if (state->depth <= PROFILER_STACK_DEPTH) {
+        callee = state->stack[state->depth - 1];
+        charge (callee, now - state->mark);
+    }
+    state->depth--;
+    state->mark = now;
+    state->thread->cpu_time = now;
+
+    return callee;
+}
+
+static void count_buffer (ProfilerElement *slot, GstBuffer *buffer)
+{
+    if ((slot != NULL) && (buffer != NULL)) {
+        __atomic_add_fetch (&(slot->buffers), 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch (&(slot->bytes), gst_buffer_get_size (buffer), __ATOMIC_RELAXED);
+    }
+}
+
+/* fill level of queue, queue pushes with its lock released */
+static void sample_queue (GstElement *element, ProfilerElement *slot, GstClockTime ts)
+{
+    guint level_buffers;
+    guint64 level_time;
+
+    if ((slot == NULL) || !slot->is_queue || (ts < slot->last_sample + PROFILER_QUEUE_SAMPLE_INTERVAL)) {
+        return;
+    }
+    slot->last_sample = ts;
+    g_object_get (element, "current-level-buffers", &level_buffers, "current-level-time", &level_time, NULL);
+    slot->level_buffers = level_buffers;
+    slot->level_time = level_time;
+    if (level_buffers > slot->max_level_buffers) {
+        slot->max_level_buffers = level_buffers;
+    }
+}
+
+static void push_enter (Profiler *profiler, GstClockTime ts, GstPad *pad, ProfilerElement **caller)
+{
+    GstElement *element;
+
+    element = pad_element (pad);
+    *caller = get_element_slot (profiler, element);
+    sample_queue (element, *caller, ts);
+    enter (profiler, *caller, get_element_slot (profiler, pad_element (GST_PAD_PEER (pad))));
+}
+
+static void pad_push_pre (GObject *self, GstClockTime ts, GstPad *pad, GstBuffer *buffer)
+{
+    ProfilerElement *caller;
+
+    push_enter (PROFILER (self), ts, pad, &caller);
+    count_buffer (caller, buffer);
+}
+
+static void pad_push_list_pre (GObject *self, GstClockTime ts, GstPad *pad, GstBufferList *list)
+{
+    ProfilerElement *caller;
+    guint i;
+
+    push_enter (PROFILER (self), ts, pad, &caller);
+    for (i = 0; i < gst_buffer_list_length (list); i++) {
+        count_buffer (caller, gst_buffer_list_get (list, i));
+    }
+}
+
+static void pad_push_post (GObject *self, GstClockTime ts, GstPad *pad, GstFlowReturn res)
+{
+    leave (PROFILER (self));
+}
+
+static void pad_pull_range_pre (GObject *self, GstClockTime ts, GstPad *pad, guint64 offset, guint size)
+{
+    Profiler *profiler = PROFILER (self);
+
+    enter (profiler,
+            get_element_slot (profiler, pad_element (pad)),
+            get_element_slot (profiler, pad_element (GST_PAD_PEER (pad))));
+}
+
+static void pad_pull_range_post (GObject *self, GstClockTime ts, GstPad *pad, GstBuffer *buffer, GstFlowReturn res)
+{
+    ProfilerElement *callee;
+
+    callee = leave (PROFILER (self));
+    if (res == GST_FLOW_OK) {
+        count_buffer (callee, buffer);
+    }
+}
+
+/**
+ * profiler_install:
+ * @output: (in): profiler output in job output share memory.
+ *
+ * Install the profiler before pipelines of the job worker are built, pad hooks of a tracer are
+ * process wide, every pipeline of the worker is profiled.
+ *
+ * Returns: the profiler, live as long as the worker.
+ */
+Profiler * profiler_install (ProfilerOutput *output)
+{
+    Profiler *profiler;
+
+    /* counters of the last worker of the job are discarded */
+    memset (output, 0, sizeof (ProfilerOutput));
+    output->start_time = g_get_real_time ();
+    profiler = g_object_new (TYPE_PROFILER, NULL);
+    profiler->output = output;
+    gst_tracing_register_hook (GST_TRACER (profiler), "pad-push-pre", G_CALLBACK (pad_push_pre));
+    gst_tracing_register_hook (GST_TRACER (profiler), "pad-push-post", G_CALLBACK (pad_push_post));
+    gst_tracing_register_hook (GST_TRACER (profiler), "pad-push-list-pre", G_CALLBACK (pad_push_list_pre));
+    gst_tracing_register_hook (GST_TRACER (profiler), "pad-push-list-post", G_CALLBACK (pad_push_post));
+    gst_tracing_register_hook (GST_TRACER (profiler), "pad-pull-range-pre", G_CALLBACK (pad_pull_range_pre));
+    gst_tracing_register_hook (GST_TRACER (profiler), "pad-pull-range-post", G_CALLBACK (pad_pull_range_post));
+    GST_INFO ("profiler installed");
+
+    return profiler;
+}
@@ -0,0 +1,83 @@
+/*
+ *  profiler, a GstTracer measuring cpu cost of elements and threads of a job worker
+ *
+ *  Copyright (C) Zhang Ping <dqzhangp@163.com>
+ */
+
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <gst/gst.h>
+#include <gst/gsttracer.h>
+
+#include "source.h"
+
+#define PROFILER_ELEMENTS 128
+#define PROFILER_THREADS 64
+#define PROFILER_NAME_LEN 64
+#define PROFILER_STACK_DEPTH 32 /* nested pushes of a thread */
+#define PROFILER_QUEUE_SAMPLE_INTERVAL (100 * GST_MSECOND)
+
+/*
+ * ProfilerElement:
+ * counters of an element, cpu time is the thread cpu time between entering and leaving the element,
+ * time spent downstream is excluded. buffers and bytes are pushed out of the element.
+ */
+typedef struct _ProfilerElement {
+    gchar name[PROFILER_NAME_LEN]; /* path of the element, e.g. /encoder.0/x264enc0 */
+    guint64 cpu_time; /* ns */
+    guint64 buffers;
+    guint64 bytes;
+    guint64 is_queue;
+    guint64 level_buffers; /* fill level of queue, sampled on push */
+    guint64 level_time; /* ns */
+    guint64 max_level_buffers;
+    GstClockTime last_sample;
+} __attribute__ ((aligned (CACHE_LINE_SIZE))) ProfilerElement;
+
+typedef struct _ProfilerThread {
+    gchar name[16]; /* thread name, e.g. queue0:src */
+    gint64 tid;
+    guint64 cpu_time; /* ns, cpu time of the thread */
+} ProfilerThread;
+
+/*
+ * ProfilerOutput:
+ * in job output share memory, written by streaming threads of worker, read by master without the
+ * job semaphore. a slot is filled before its count is published.
+ */
+typedef struct _ProfilerOutput {
+    gint64 start_time; /* wall clock the profiler installed, us, 0 if the job is not profiled */
+    guint32 elements_count;
+    guint32 threads_count;
+    guint64 overflow; /* elements and threads not profiled because of table full */
+    ProfilerElement elements[PROFILER_ELEMENTS];
+    ProfilerThread threads[PROFILER_THREADS];
+} __attribute__ ((aligned (CACHE_LINE_SIZE))) ProfilerOutput;
+
+typedef struct _Profiler      Profiler;
+typedef struct _ProfilerClass ProfilerClass;
+
+struct _Profiler {
+    GstTracer parent;
+
+    ProfilerOutput *output;
+    GMutex mutex; /* allocation of element and thread slots */
+    GQuark quark; /* element slot in element qdata */
+};
+
+struct _ProfilerClass {
+    GstTracerClass parent_class;
+};
+
+#define TYPE_PROFILER           (profiler_get_type())
+#define PROFILER(obj)           (G_TYPE_CHECK_INSTANCE_CAST ((obj), TYPE_PROFILER, Profiler))
+#define PROFILER_CLASS(cls)     (G_TYPE_CHECK_CLASS_CAST    ((cls), TYPE_PROFILER, ProfilerClass))
+#define IS_PROFILER(obj)        (G_TYPE_CHECK_INSTANCE_TYPE ((obj), TYPE_PROFILER))
+#define IS_PROFILER_CLASS(cls)  (G_TYPE_CHECK_CLASS_TYPE    ((cls), TYPE_PROFILER))
+
+GType profiler_get_type (void);
+
+Profiler * profiler_install (ProfilerOutput *output);
+
+#endif /* __PROFILER_H__ */
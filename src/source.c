@@ -9,9 +9,11 @@
 #include <sys/wait.h>
 #include <fcntl.h>
 #include <string.h>
+#include <unistd.h>
 #include <gst/gst.h>
 #include <glib/gstdio.h>
 #include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
 
 #include "source.h"
 #include "encoder.h"
@@ -129,16 +131,30 @@ static void source_finalize (GObject *obj)
     gint i;
     SourceStream *stream;
 
+    /* no more appsink callbacks on streams */
+    source_stop (source);
     for (i = source->streams->len - 1; i >= 0; i--) {
         stream = g_array_index (source->streams, gpointer, i);
         g_free (stream->name);
         g_array_free (stream->encoders, FALSE);
+        g_mutex_clear (&(stream->input_mutex));
+        if (stream->ingest != NULL) {
+            gst_element_set_state (stream->ingest, GST_STATE_NULL);
+            gst_object_unref (stream->ingest);
+            gst_caps_replace (&(stream->ingest_caps), NULL);
+        }
         g_free (stream);
         g_array_remove_index (source->streams, i);
     }
     g_array_free (source->streams, FALSE);
 
-    g_slist_free (source->bins);
+    for (i = 0; i < source->inputs_count; i++) {
+        g_slist_free (source->inputs[i].bins);
+        if (source->inputs[i].pipeline != NULL) {
+            gst_object_unref (source->inputs[i].pipeline);
+        }
+    }
+    g_mutex_clear (&(source->switch_mutex));
 
     G_OBJECT_CLASS (parent_class)->finalize (obj);
 }
@@ -233,6 +249,13 @@ gboolean bus_callback (GstBus *bus, GstMessage *msg, gpointer user_data)
             g_free (debug);
             GST_ERROR ("%s error found: %s, exit", g_value_get_string (&name), error->message);
             g_error_free (error);
+            if (IS_ENCODER (object)) {
+                encoder_output_post_event (ENCODER (object)->output, ENCODER_EVENT_ERROR, 0);
+            }
+            /*
+             * encoder pipelines and a source without backup input have no standby to retry with,
+             * a new worker restarts source and encoders together, single job mode ends with the exit code.
+             */
             exit (101); /* exit 101 for pipeline error, job should be restarted */
             break;
 
@@ -274,62 +297,136 @@ gboolean bus_callback (GstBus *bus, GstMessage *msg, gpointer user_data)
     return TRUE;
 }
 
-static gchar** get_property_names (gchar *param)
-{
-    gchar *p1, *p2, **pp, **pp1;
-    GRegex *regex;
-
-    /* strip space at begin */
-    regex = g_regex_new ("[^ ]* *(.*)", 0, 0, NULL);
-    p1 = g_regex_replace (regex, param, -1, 0, "\\1", 0, NULL);
-    g_regex_unref (regex);
-    /* strip space beside = */
-    regex = g_regex_new ("( *= *)", 0, 0, NULL);
-    p2 = g_regex_replace (regex, p1, -1, 0, "=", 0, NULL);
-    g_free (p1);
-    g_regex_unref (regex);
-    /* strip redundant space */
-    regex = g_regex_new ("( +)", 0, 0, NULL);
-    p1 = g_regex_replace (regex, p2, -1, 0, " ", 0, NULL);
-    g_free (p2);
-    g_regex_unref (regex);
-    pp = g_strsplit (p1, " ", 0);
-    g_free (p1);
-
-    pp1 = pp;
-    while (*pp1 != NULL) {
-        if (g_strrstr (*pp1, "=") == NULL) {
-            GST_ERROR ("Configure error: %s", *pp1);
-            g_strfreev (pp);
-            return NULL;
+/**
+ * bin_tokenize:
+ * @bin: (in): bin description, like "udpsrc ! queue ! mpegtsdemux name=demuxer"
+ * @tokens: (out): elements of the bin
+ * @max: (in): size of tokens
+ *
+ * Split bin into elements and element into factory name and properties in a single pass,
+ * spaces beside ! and = are allowed.
+ *
+ * Returns: count of elements, -1 on syntax error.
+ */
+gint bin_tokenize (const gchar *bin, BinToken *tokens, gint max)
+{
+    const gchar *p;
+    BinToken *token;
+    BinProperty *property;
+    gint count;
+
+    count = 0;
+    p = bin;
+    for (;;) {
+        if (count == max) {
+            GST_ERROR ("Configure error, too many elements: %s", bin);
+            return -1;
         }
-        regex = g_regex_new ("([^=]*)=.*", 0, 0, NULL);
-        p1 = g_regex_replace (regex, *pp1, -1, 0, "\\1", 0, NULL);
-        g_free (*pp1);
-        g_regex_unref (regex);
-        *pp1 = p1;
-        pp1++;
+        token = &(tokens[count]);
+        while (g_ascii_isspace (*p)) {
+            p++;
+        }
+        token->start = p - bin;
+        token->is_pad = FALSE;
+        token->properties_count = 0;
+        while ((*p != '\0') && (*p != '!') && !g_ascii_isspace (*p)) {
+            if (*p == '.') {
+                token->is_pad = TRUE;
+            }
+            p++;
+        }
+        token->factory_size = p - bin - token->start;
+        token->size = token->factory_size;
+        if (token->factory_size == 0) {
+            GST_ERROR ("Configure error, empty element: %s", bin);
+            return -1;
+        }
+
+        for (;;) {
+            while (g_ascii_isspace (*p)) {
+                p++;
+            }
+            if ((*p == '\0') || (*p == '!')) {
+                break;
+            }
+            if (token->is_pad || (token->properties_count == ELEMENT_MAX_PROPERTIES)) {
+                GST_ERROR ("Configure error: %s", bin + token->start);
+                return -1;
+            }
+            property = &(token->properties[token->properties_count]);
+            property->key = p - bin;
+            while ((*p != '\0') && (*p != '!') && (*p != '=') && !g_ascii_isspace (*p)) {
+                p++;
+            }
+            property->key_size = p - bin - property->key;
+            while (g_ascii_isspace (*p)) {
+                p++;
+            }
+            if ((*p != '=') || (property->key_size == 0)) {
+                GST_ERROR ("Configure error: %s", bin + property->key);
+                return -1;
+            }
+            p++;
+            while (g_ascii_isspace (*p)) {
+                p++;
+            }
+            property->value = p - bin;
+            while ((*p != '\0') && (*p != '!') && !g_ascii_isspace (*p)) {
+                p++;
+            }
+            property->value_size = p - bin - property->value;
+            token->properties_count++;
+            token->size = p - bin - token->start;
+        }
+        count++;
+
+        if (*p == '\0') {
+            break;
+        }
+        p++;
     }
 
-    return pp;
+    return count;
 }
 
-static gchar* get_property_value (gchar *param, gchar *property)
+/**
+ * bin_token_is:
+ * @bin: (in): bin description that token was made of
+ * @token: (in): element token
+ * @factory: (in): factory name
+ *
+ * Returns: TRUE if element is made by factory.
+ */
+gboolean bin_token_is (const gchar *bin, BinToken *token, const gchar *factory)
+{
+    return (!token->is_pad) &&
+           (strlen (factory) == token->factory_size) &&
+           (strncmp (bin + token->start, factory, token->factory_size) == 0);
+}
+
+/**
+ * bin_token_property:
+ * @bin: (in): bin description that token was made of
+ * @token: (in): element token
+ * @key: (in): property name
+ *
+ * The last one wins if property is given more than once.
+ *
+ * Returns: property value, should be freed with g_free, or NULL if not found.
+ */
+gchar * bin_token_property (const gchar *bin, BinToken *token, const gchar *key)
 {
-    gchar *r, *v;
-    GRegex *regex;
+    BinProperty *property;
+    gint i;
 
-    r = g_strdup_printf (".* *%s *= *([^ ]*).*", property);
-    regex = g_regex_new (r, 0, 0, NULL);
-    v = g_regex_replace (regex, param, -1, 0, "\\1", 0, NULL);
-    g_regex_unref (regex);
-    g_free (r);
-    if (g_strcmp0 (param, v) == 0) {
-        g_free (v);
-        v = NULL;
+    for (i = token->properties_count - 1; i >= 0; i--) {
+        property = &(token->properties[i]);
+        if ((strlen (key) == property->key_size) && (strncmp (bin + property->key, key, property->key_size) == 0)) {
+            return g_strndup (bin + property->value, property->value_size);
+        }
     }
 
-    return v;
+    return NULL;
 }
 
 static gboolean set_element_property (GstElement *element, gchar* name, gchar* value)
@@ -350,16 +447,15 @@ static gboolean set_element_property (GstElement *element, gchar* name, gchar* v
     return TRUE;
 }
 
-static GstElement * element_create (gchar *job, gchar *pipeline, gchar *param)
+static GstElement * element_create (JobDesc *jobdesc, gchar *pipeline, const gchar *bin, BinToken *token)
 {
     GstElement *element;
-    gchar *name, *p, **pp, **pp1, **properties, *value;
-    GRegex *regex;
+    BinProperty *property;
+    gchar *name, *p, **pp, **properties, *key, *value;
+    gint i;
 
     /* create element. */
-    regex = g_regex_new (" .*", 0, 0, NULL);
-    name = g_regex_replace (regex, param, -1, 0, "", 0, NULL);
-    g_regex_unref (regex);
+    name = g_strndup (bin + token->start, token->factory_size);
     element = gst_element_factory_make (name, NULL);
     if (element == NULL) {
         GST_ERROR ("make element %s error.", name);
@@ -368,14 +464,14 @@ static GstElement * element_create (gchar *job, gchar *pipeline, gchar *param)
     }
 
     p = g_strdup_printf ("%s.elements.%s.property", pipeline, name);
-    properties = jobdesc_element_properties (job, p);
+    properties = jobdesc_element_properties (jobdesc, p);
     g_free (p);
     if (properties != NULL) {
         /* set propertys in element property. */
         pp = properties;
         while (*pp != NULL) {
             p = g_strdup_printf ("%s.elements.%s.property.%s", pipeline, name, *pp);
-            value = jobdesc_element_property_value (job, p);
+            value = jobdesc_element_property_value (jobdesc, p);
             if (value == NULL) {
                 GST_ERROR ("property %s not found", p);
 
@@ -395,33 +491,22 @@ static GstElement * element_create (gchar *job, gchar *pipeline, gchar *param)
     }
 
     /* set element propertys in bin. */
-    pp = get_property_names (param);
-    if (pp == NULL) {
-        gst_object_unref (element);
-        g_strfreev (pp);
-        g_free (name);
-        return NULL;
-    }
-    pp1 = pp;
-    while (*pp1 != NULL) {
-        p = get_property_value (param, *pp1);
-        if (p == NULL) {
-            GST_ERROR ("Create element %s failure, Configure error: %s=%s", name, *pp1, p);
+    for (i = 0; i < token->properties_count; i++) {
+        property = &(token->properties[i]);
+        key = g_strndup (bin + property->key, property->key_size);
+        value = g_strndup (bin + property->value, property->value_size);
+        if (!set_element_property (element, key, value)) {
+            GST_ERROR ("Create element %s failure, Set property error: %s=%s", name, key, value);
             gst_object_unref (element);
-            g_strfreev (pp);
-            g_free (name);
-            return NULL;
-        }
-        if (!set_element_property (element, *pp1, p)) {
-            GST_ERROR ("Create element %s failure, Set property error: %s=%s", name, *pp1, p);
+            g_free (key);
+            g_free (value);
             g_free (name);
             return NULL;
         }
-        GST_INFO ("Set property: %s=%s", *pp1, p);
-        g_free (p);
-        pp1++;
+        GST_INFO ("Set property: %s=%s", key, value);
+        g_free (key);
+        g_free (value);
     }
-    g_strfreev (pp);
     GST_INFO ("Create element %s success.", name);
     g_free (name);
 
@@ -495,31 +580,13 @@ static void free_bin (Bin *bin)
 {
 }
 
-static gboolean is_pad (gchar *element)
-{
-    gchar *p;
-
-    p = element;
-    while (*p != '\0') {
-        if (*p == '.') {
-            return TRUE;
-        }
-        if (*p == ' ') {
-            return FALSE;
-        }
-        p++;
-    }
-
-    return FALSE;
-}
-
-static void delay_sometimes_pad_link (Source *source, gchar *name)
+static void delay_sometimes_pad_link (GSList *input_bins, gchar *name)
 {
     GSList *elements, *bins;
     Bin *bin;
     GstElement *element;
 
-    bins = source->bins;
+    bins = input_bins;
     while (bins != NULL) {
         bin = bins->data;
         elements = bin->elements;
@@ -536,7 +603,7 @@ static void delay_sometimes_pad_link (Source *source, gchar *name)
             bin->signal_id = g_signal_connect_data (element,
                     "pad-added",
                     G_CALLBACK (pad_added_callback),
-                    source->bins,
+                    input_bins,
                     (GClosureNotify)free_bin,
                     (GConnectFlags) 0);
             GST_INFO ("delay sometimes pad linkage %s:%s", bin->name, gst_element_get_name (element));
@@ -546,81 +613,73 @@ static void delay_sometimes_pad_link (Source *source, gchar *name)
     }
 }
 
-static gchar * get_bin_name (gchar *bin)
+static gchar * get_bin_name (gchar *bin, BinToken *tokens, gint count)
 {
-    GRegex *regex;
-    GMatchInfo *match_info;
     gchar *name;
+    gint i;
 
     /* bin->name, value of name property of appsrc or appsink. */
-    regex = g_regex_new ("appsrc *name=(?<name>[^ ]*)", G_REGEX_OPTIMIZE, 0, NULL);
-    g_regex_match (regex, bin, 0, &match_info);
-    g_regex_unref (regex);
-    if (g_match_info_matches (match_info)) {
-        name = g_match_info_fetch_named (match_info, "name");
-        g_match_info_free (match_info);
-        return name;
+    for (i = 0; i < count; i++) {
+        if (bin_token_is (bin, &(tokens[i]), "appsrc")) {
+            name = bin_token_property (bin, &(tokens[i]), "name");
+            if (name != NULL) {
+                return name;
+            }
+        }
     }
 
     /* demuxer.video ! queue ! mpeg2dec ! queue ! appsink name = video */
-    regex = g_regex_new ("! *appsink *name *= *(?<name>[^ ]*)[^!]*$", G_REGEX_OPTIMIZE, 0, NULL);
-    g_regex_match (regex, bin, 0, &match_info);
-    g_regex_unref (regex);
-    if (g_match_info_matches (match_info)) {
-        name = g_match_info_fetch_named (match_info, "name");
-        g_match_info_free (match_info);
-        return name;
-    }
-
     /* udpsrc ! queue ! mpegtsdemux name=demuxer */
-    regex = g_regex_new ("name *= *(?<name>[^ ]*)$", G_REGEX_OPTIMIZE, 0, NULL);
-    g_regex_match (regex, bin, 0, &match_info);
-    g_regex_unref (regex);
-    if (g_match_info_matches (match_info)) {
-        name = g_match_info_fetch_named (match_info, "name");
-        g_match_info_free (match_info);
+    name = bin_token_property (bin, &(tokens[count - 1]), "name");
+    if (name != NULL) {
         return name;
     }
 
     /* mpegtsmux name=muxer ! queue ! appsink sync=FALSE */
-    regex = g_regex_new ("[^!]*name *= *(?<name>[^ ]*)", G_REGEX_OPTIMIZE, 0, NULL);
-    g_regex_match (regex, bin, 0, &match_info);
-    g_regex_unref (regex);
-    if (g_match_info_matches (match_info)) {
-        name = g_match_info_fetch_named (match_info, "name");
-        g_match_info_free (match_info);
-        return name;
+    for (i = 0; i < count; i++) {
+        name = bin_token_property (bin, &(tokens[i]), "name");
+        if (name != NULL) {
+            return name;
+        }
     }
 
     return NULL;
 }
 
-GSList * bins_parse (gchar *job, gchar *pipeline)
+GSList * bins_parse (JobDesc *jobdesc, gchar *pipeline)
 {
     GstElement *element = NULL, *src;
-    gchar *p, *p1, *src_name, *src_pad_name, **pp, **pp1, **bins, **binsp;
+    gchar *p, *p1, *src_name, *src_pad_name, **bins, **binsp;
+    BinToken *tokens;
+    gint count, i;
     Bin *bin;
     Link *link;
     GSList *list;
 
     list = NULL;
-    binsp = bins = jobdesc_bins (job, pipeline);
+    tokens = g_new (BinToken, BIN_MAX_ELEMENTS);
+    binsp = bins = jobdesc_bins (jobdesc, pipeline);
     while (*binsp != NULL) {
+        count = bin_tokenize (*binsp, tokens, BIN_MAX_ELEMENTS);
+        if (count < 0) {
+            GST_ERROR ("parse bin failure: %s", *binsp);
+            g_free (tokens);
+            g_strfreev (bins);
+            return NULL;
+        }
         bin = g_slice_new (Bin);
         bin->links = NULL;
         bin->elements = NULL;
         bin->previous = NULL;
         bin->signal_id = 0;
-        pp = pp1 = g_strsplit (*binsp, "!", 0);
         src = NULL;
         src_name = NULL;
         src_pad_name = NULL;
-        bin->name = get_bin_name (*binsp);
+        bin->name = get_bin_name (*binsp, tokens, count);
 
-        while (*pp != NULL) {
-            p1 = g_strdup (*pp);
-            p1 = g_strstrip (p1);
-            if (is_pad (p1)) {
+        for (i = 0; i < count; i++) {
+            p1 = g_strndup (*binsp + tokens[i].start, tokens[i].size);
+            if (tokens[i].is_pad) {
                 /* request pad or sometimes pad */
                 if (src == NULL) {
                     /* should be a sometimes pad */
@@ -637,14 +696,14 @@ GSList * bins_parse (gchar *job, gchar *pipeline)
                     link->sink_name = g_strndup (p1, g_strrstr (p1, ".") - p1);
                     link->sink_pad_name = g_strdup (link->sink_name);
                     p = g_strdup_printf ("%s.elements.%s.caps", pipeline, src_name);
-                    link->caps = jobdesc_element_caps (job, p);
+                    link->caps = jobdesc_element_caps (jobdesc, p);
                     g_free (p);
                     bin->links = g_slist_append (bin->links, link);
                 }
-                pp++;
+                g_free (p1);
                 continue;
             }
-            element = element_create (job, pipeline, p1);
+            element = element_create (jobdesc, pipeline, *binsp, &(tokens[i]));
             if (element != NULL) {
                 if (src_name != NULL) {
                     link = g_slice_new (Link);
@@ -655,7 +714,7 @@ GSList * bins_parse (gchar *job, gchar *pipeline)
                     link->sink_name = p1;
                     link->sink_pad_name = NULL;
                     p = g_strdup_printf ("%s.elements.%s.caps", pipeline, src_name);
-                    link->caps = jobdesc_element_caps (job, p);
+                    link->caps = jobdesc_element_caps (jobdesc, p);
                     g_free (p);
                     if (src_pad_name == NULL) {
                         bin->links = g_slist_append (bin->links, link);
@@ -675,17 +734,17 @@ GSList * bins_parse (gchar *job, gchar *pipeline)
             } else {
                 /* create element failure */
                 GST_ERROR ("create element failure: %s", p1);
-                g_free (bins);
-                g_strfreev (pp1);
+                g_free (p1);
+                g_free (tokens);
+                g_strfreev (bins);
                 return NULL;
             }
-            pp++;
         }
         bin->last = element;
         list = g_slist_append (list, bin);
-        g_strfreev (pp1);
         binsp++;
     }
+    g_free (tokens);
     g_strfreev (bins);
 
     return list;
@@ -696,64 +755,134 @@ static SourceStream * source_get_stream (Source *source, gchar *name)
     SourceStream *stream;
     gint i;
 
-    stream = NULL;
     for (i = 0; i < source->streams->len; i++) {
         stream = g_array_index (source->streams, gpointer, i);
         if (g_strcmp0 (stream->name, name) == 0) {
-            break;
+            return stream;
         }
     }
 
-    return stream;
+    return NULL;
 }
 
 static void eos_callback (GstAppSink *appsink, gpointer user_data)
 {
-    SourceStream *stream = (SourceStream *)user_data;
+    SourceStreamInput *stream_input = (SourceStreamInput *)user_data;
+    SourceStream *stream = stream_input->stream;
+    SourceInput *input = stream_input->input;
 
-    GST_INFO ("EOS of %s", stream->name);
-    stream->eos = TRUE;
+    GST_INFO ("EOS of %s, input %d", stream->name, input->index);
+    if (input->index == g_atomic_int_get (&(input->source->active_input))) {
+        stream->eos = TRUE;
+    }
 }
 
-static GstFlowReturn new_sample_callback (GstAppSink *elt, gpointer user_data)
+/*
+ * offset of input continuing the ring timeline at buffer, the first buffer of the input, called with
+ * switch_mutex held. the reference is the latest next_pts of all streams, common to all streams of
+ * the input and no stream goes back in time, the others have a gap of less than a sample.
+ */
+static GstClockTimeDiff input_offset (Source *source, GstBuffer *buffer)
 {
-    GstSample *sample;
-    GstBuffer *buffer;
-    SourceStream *stream = (SourceStream *)user_data;
-    EncoderStream *encoder;
-    RingBuffer *ring_buffer;
+    SourceStream *stream;
+    GstClockTime next_pts, latest;
     gint i;
 
-    sample = gst_app_sink_pull_sample (GST_APP_SINK (elt));
-    buffer = gst_sample_get_buffer (sample);
-    stream->state->last_heartbeat = gst_clock_get_time (stream->system_clock);
-    stream->current_position = (stream->current_position + 1) % SOURCE_RING_SIZE;
-    ring_buffer = (RingBuffer *)g_malloc (sizeof (RingBuffer));
-    ring_buffer->sample = sample;
-    ring_buffer->is_rap = FALSE;
+    latest = GST_CLOCK_TIME_NONE;
+    for (i = 0; i < source->streams->len; i++) {
+        stream = g_array_index (source->streams, gpointer, i);
+        next_pts = __atomic_load_n (&(stream->next_pts), __ATOMIC_RELAXED);
+        if (GST_CLOCK_TIME_IS_VALID (next_pts) && (!GST_CLOCK_TIME_IS_VALID (latest) || (next_pts > latest))) {
+            latest = next_pts;
+        }
+    }
+    if (!GST_CLOCK_TIME_IS_VALID (latest) || !GST_BUFFER_PTS_IS_VALID (buffer)) {
+        return 0;
+    }
 
-    /* output running status */
-    GST_DEBUG ("%s current position %d, buffer duration: %ld",
-            stream->name,
-            stream->current_position,
-            GST_BUFFER_DURATION (buffer));
-    for (i = 0; i < stream->encoders->len; i++) {
-        encoder = g_array_index (stream->encoders, gpointer, i);
-        if (stream->is_live) {
-            /* a live job, warning encoder too slow */
-            if (stream->current_position == encoder->current_position) {
-                GST_WARNING ("encoder stream %s can not catch up source output.", encoder->name);
-            }
+    return GST_CLOCK_DIFF (GST_BUFFER_PTS (buffer), latest);
+}
 
-        } else {
-            /* not a live job, avoid decoder too fast */
-            while (stream->current_position == encoder->current_position) {
-                GST_DEBUG ("waiting %s encoder", stream->name);
-                g_usleep (50000); /* wiating 50ms */
-                continue;
+/*
+ * is_active_input:
+ * switch to the input when the active input has been silent for failover timeout,
+ * switch back to primary when it has delivered samples continuously for SOURCE_FAILBACK_DELAY.
+ * offset of the input is computed once at the switch, or at the first sample of an active input
+ * restarted after failure. heartbeat and alive_since are shared by the streaming threads of all
+ * streams, accessed atomically.
+ */
+static gboolean is_active_input (SourceInput *input, GstBuffer *buffer, GstClockTime now)
+{
+    Source *source = input->source;
+    GstClockTime heartbeat;
+    gint index;
+
+    heartbeat = __atomic_exchange_n (&(input->heartbeat), now, __ATOMIC_ACQ_REL);
+    if (now > heartbeat + source->failover_timeout) {
+        /* input resumes after a gap */
+        __atomic_store_n (&(input->alive_since), now, __ATOMIC_RELEASE);
+    }
+    index = g_atomic_int_get (&(source->active_input));
+    if ((index == input->index) && G_LIKELY (!g_atomic_int_get (&(input->resync)))) {
+        return TRUE;
+    }
+
+    if ((index == input->index) ||
+        (now > __atomic_load_n (&(source->inputs[index].heartbeat), __ATOMIC_ACQUIRE) + source->failover_timeout) ||
+        ((input->index == 0) && (now > __atomic_load_n (&(input->alive_since), __ATOMIC_ACQUIRE) + SOURCE_FAILBACK_DELAY))) {
+        g_mutex_lock (&(source->switch_mutex));
+        if ((g_atomic_int_get (&(source->active_input)) == index) &&
+            ((index != input->index) || g_atomic_int_get (&(input->resync)))) {
+            /* all streams of the input share the offset, keeps audio and video in sync */
+            input->offset = input_offset (source, buffer);
+            g_atomic_int_set (&(input->resync), 0);
+            g_atomic_int_set (&(source->active_input), input->index);
+            if (index == input->index) {
+                GST_WARNING ("source %s input %d restarted, offset %" G_GINT64_FORMAT, source->name, index, input->offset);
+
+            } else {
+                GST_WARNING ("source %s switch from input %d to input %d, offset %" G_GINT64_FORMAT,
+                        source->name, index, input->index, input->offset);
             }
         }
+        g_mutex_unlock (&(source->switch_mutex));
+        return g_atomic_int_get (&(source->active_input)) == input->index;
+    }
+
+    return FALSE;
+}
+
+/* shallow copy of buffer with timestamps moved by offset, memory is shared */
+static GstSample * restamp_sample (GstSample *sample, GstClockTimeDiff offset)
+{
+    GstBuffer *buffer;
+    GstSample *restamped;
+
+    buffer = gst_buffer_copy (gst_sample_get_buffer (sample));
+    if (GST_BUFFER_PTS_IS_VALID (buffer)) {
+        GST_BUFFER_PTS (buffer) += offset;
+    }
+    if (GST_BUFFER_DTS_IS_VALID (buffer)) {
+        GST_BUFFER_DTS (buffer) += offset;
     }
+    restamped = gst_sample_new (buffer, gst_sample_get_caps (sample), gst_sample_get_segment (sample), NULL);
+    gst_buffer_unref (buffer);
+    gst_sample_unref (sample);
+
+    return restamped;
+}
+
+/**
+ * source_stream_segment:
+ * @stream: (in): source stream, last_heartbeat is the wall clock of the buffer.
+ * @buffer: (in): buffer output by source stream.
+ * @ring_buffer: (in): ring buffer of the buffer, is_rap, timestamp and duration are set.
+ *
+ * Align segments of stream to wall clock, the ring buffer starting a segment is a random access point.
+ */
+void source_stream_segment (SourceStream *stream, GstBuffer *buffer, RingBuffer *ring_buffer)
+{
+    EncoderStream *encoder;
 
     stream->state->current_timestamp = GST_BUFFER_PTS (buffer);
     if (stream->segment_duration != GST_CLOCK_TIME_NONE) {
@@ -799,6 +928,96 @@ static GstFlowReturn new_sample_callback (GstAppSink *elt, gpointer user_data)
             }
         }
     }
+    if (GST_BUFFER_DURATION_IS_VALID (buffer)) {
+        stream->current_segment_duration += GST_BUFFER_DURATION (buffer);
+
+    } else if (GST_BUFFER_PTS_IS_VALID (buffer)) {
+        stream->current_segment_duration = GST_BUFFER_PTS (buffer) - stream->last_segment_pts;
+    }
+}
+
+/* decoded sample to attached jobs, shared memory of shmsink holds its own copy */
+static void ingest_push (SourceStream *stream, GstSample *sample)
+{
+    GstCaps *caps;
+
+    caps = gst_sample_get_caps (sample);
+    if ((caps != NULL) && (caps != stream->ingest_caps) &&
+        ((stream->ingest_caps == NULL) || !gst_caps_is_equal (caps, stream->ingest_caps))) {
+        gst_app_src_set_caps (GST_APP_SRC (stream->ingest_appsrc), caps);
+        gst_caps_replace (&(stream->ingest_caps), caps);
+    }
+    gst_app_src_push_buffer (GST_APP_SRC (stream->ingest_appsrc), gst_buffer_ref (gst_sample_get_buffer (sample)));
+}
+
+static GstFlowReturn new_sample_callback (GstAppSink *elt, gpointer user_data)
+{
+    GstSample *sample;
+    GstBuffer *buffer;
+    SourceStreamInput *stream_input = (SourceStreamInput *)user_data;
+    SourceStream *stream = stream_input->stream;
+    SourceInput *input = stream_input->input;
+    EncoderStream *encoder;
+    RingBuffer *ring_buffer;
+    GstClockTime now, next_pts;
+    gint i;
+
+    sample = gst_app_sink_pull_sample (GST_APP_SINK (elt));
+    buffer = gst_sample_get_buffer (sample);
+    now = gst_clock_get_time (stream->system_clock);
+    g_mutex_lock (&(stream->input_mutex));
+    if (!is_active_input (input, buffer, now)) {
+        /* hot standby, drop */
+        g_mutex_unlock (&(stream->input_mutex));
+        gst_sample_unref (sample);
+        return GST_FLOW_OK;
+    }
+    if (stream->input != input->index) {
+        /* splice at key frame, timestamps are moved by offset of the input */
+        if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+            g_mutex_unlock (&(stream->input_mutex));
+            gst_sample_unref (sample);
+            return GST_FLOW_OK;
+        }
+        GST_WARNING ("stream %s splice input %d to input %d, offset %" G_GINT64_FORMAT,
+                stream->name, stream->input, input->index, input->offset);
+        stream->input = input->index;
+    }
+    if (input->offset != 0) {
+        sample = restamp_sample (sample, input->offset);
+        buffer = gst_sample_get_buffer (sample);
+    }
+    stream->state->last_heartbeat = now;
+    stream->current_position = (stream->current_position + 1) % SOURCE_RING_SIZE;
+    ring_buffer = (RingBuffer *)g_malloc (sizeof (RingBuffer));
+    ring_buffer->sample = sample;
+    ring_buffer->is_rap = FALSE;
+    ring_buffer->ingest_time = now / 1000;
+
+    /* output running status */
+    GST_DEBUG ("%s current position %d, buffer duration: %ld",
+            stream->name,
+            stream->current_position,
+            GST_BUFFER_DURATION (buffer));
+    for (i = 0; i < stream->encoders->len; i++) {
+        encoder = g_array_index (stream->encoders, gpointer, i);
+        if (stream->is_live) {
+            /* a live job, warning encoder too slow */
+            if (stream->current_position == encoder->current_position) {
+                GST_WARNING ("encoder stream %s can not catch up source output.", encoder->name);
+            }
+
+        } else {
+            /* not a live job, avoid decoder too fast */
+            while (stream->current_position == encoder->current_position) {
+                GST_DEBUG ("waiting %s encoder", stream->name);
+                g_usleep (50000); /* wiating 50ms */
+                continue;
+            }
+        }
+    }
+
+    source_stream_segment (stream, buffer, ring_buffer);
 
     /* out a buffer */
     if (stream->ring[stream->current_position] != NULL) {
@@ -806,17 +1025,129 @@ static GstFlowReturn new_sample_callback (GstAppSink *elt, gpointer user_data)
         g_free (stream->ring[stream->current_position]);
     }
     stream->ring[stream->current_position] = ring_buffer;
-    if (GST_BUFFER_DURATION_IS_VALID (buffer)) {
-        stream->current_segment_duration += GST_BUFFER_DURATION (buffer);
-
-    } else if (GST_BUFFER_PTS_IS_VALID (buffer)) {
-        stream->current_segment_duration = GST_BUFFER_PTS (buffer) - stream->last_segment_pts;
+    if (stream->ingest != NULL) {
+        ingest_push (stream, sample);
+    }
+    if (GST_BUFFER_PTS_IS_VALID (buffer)) {
+        next_pts = GST_BUFFER_PTS (buffer);
+        if (GST_BUFFER_DURATION_IS_VALID (buffer)) {
+            next_pts += GST_BUFFER_DURATION (buffer);
+        }
+        /* read by streaming threads of other streams at switch */
+        __atomic_store_n (&(stream->next_pts), next_pts, __ATOMIC_RELAXED);
     }
+    g_mutex_unlock (&(stream->input_mutex));
 
     return GST_FLOW_OK;
 }
 
-static GstElement * create_source_pipeline (Source *source)
+/* restart failed input, it becomes active again by failover or fail back */
+static gboolean input_retry (gpointer user_data)
+{
+    SourceInput *input = (SourceInput *)user_data;
+
+    GST_WARNING ("source %s restart input %d", input->source->name, input->index);
+    input->failed = FALSE;
+    if (gst_element_set_state (input->pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+        GST_WARNING ("source %s set input %d to play error", input->source->name, input->index);
+        gst_element_set_state (input->pipeline, GST_STATE_NULL);
+        input->failed = TRUE;
+        return TRUE;
+    }
+    input->retry = 0;
+
+    return FALSE;
+}
+
+/**
+ * source_input_failure:
+ * @input: (in): failed input
+ *
+ * Stop the input, it is restarted every SOURCE_RETRY_INTERVAL until it plays,
+ * timestamps of the restarted input are moved to continue the ring timeline.
+ */
+void source_input_failure (SourceInput *input)
+{
+    SourceStream *stream;
+    gint i;
+
+    input->failed = TRUE;
+    gst_element_set_state (input->pipeline, GST_STATE_NULL);
+    __atomic_store_n (&(input->heartbeat), 0, __ATOMIC_RELEASE);
+    g_atomic_int_set (&(input->resync), 1);
+    /* restarted input is spliced at key frame as a switched one */
+    for (i = 0; i < input->source->streams->len; i++) {
+        stream = g_array_index (input->source->streams, gpointer, i);
+        g_mutex_lock (&(stream->input_mutex));
+        if (stream->input == input->index) {
+            stream->input = -1;
+        }
+        g_mutex_unlock (&(stream->input_mutex));
+    }
+    if (input->retry == 0) {
+        input->retry = g_timeout_add_seconds (SOURCE_RETRY_INTERVAL, input_retry, input);
+    }
+}
+
+/**
+ * source_stop:
+ * @source: (in): source to be stoped
+ *
+ * Set pipelines of all inputs to NULL state, failed inputs are not restarted anymore.
+ */
+void source_stop (Source *source)
+{
+    SourceInput *input;
+    gint i;
+
+    for (i = 0; i < source->inputs_count; i++) {
+        input = &(source->inputs[i]);
+        if (input->retry != 0) {
+            g_source_remove (input->retry);
+            input->retry = 0;
+        }
+        if (input->pipeline != NULL) {
+            gst_element_set_state (input->pipeline, GST_STATE_NULL);
+        }
+    }
+}
+
+/*
+ * input_bus_callback:
+ * with a backup input, error of an input stops that input only, the other input takes over.
+ */
+static gboolean input_bus_callback (GstBus *bus, GstMessage *msg, gpointer user_data)
+{
+    SourceInput *input = (SourceInput *)user_data;
+    Source *source = input->source;
+    GError *error;
+    gchar *debug;
+    gint i;
+
+    if (GST_MESSAGE_TYPE (msg) != GST_MESSAGE_ERROR) {
+        return bus_callback (bus, msg, source);
+    }
+
+    gst_message_parse_error (msg, &error, &debug);
+    g_free (debug);
+    GST_ERROR ("source %s input %d error found: %s", source->name, input->index, error->message);
+    g_error_free (error);
+    if (input->failed) {
+        return TRUE;
+    }
+    source_input_failure (input);
+    for (i = 0; i < source->inputs_count; i++) {
+        if (!source->inputs[i].failed) {
+            return TRUE;
+        }
+    }
+    /* the input restarted first takes over, if none comes back the job is restarted on heartbeat timeout */
+    GST_ERROR ("all inputs of source %s failed, retry every %ds", source->name, SOURCE_RETRY_INTERVAL);
+
+    return TRUE;
+}
+
+static GstElement * create_source_pipeline (Source *source, SourceInput *input)
 {
     GstElement *pipeline, *element;
     Bin *bin;
@@ -832,10 +1163,11 @@ static GstElement * create_source_pipeline (Source *source)
     SourceStream *stream;
     GstCaps *caps;
     GstBus *bus;
+    gint i;
 
     pipeline = gst_pipeline_new (NULL);
 
-    bins = source->bins;
+    bins = input->bins;
     while (bins != NULL) {
         bin = bins->data;
         if (bin->previous == NULL) {
@@ -844,6 +1176,13 @@ static GstElement * create_source_pipeline (Source *source)
             while (elements != NULL) {
                 element = elements->data;
                 gst_bin_add (GST_BIN (pipeline), element);
+                /* udpingest counters go to every stream fed by this input */
+                if (IS_UDP_INGEST (element)) {
+                    for (i = 0; i < source->streams->len; i++) {
+                        stream = g_array_index (source->streams, gpointer, i);
+                        udp_ingest_publish (UDP_INGEST (element), &(stream->state->ingest[input->index]));
+                    }
+                }
                 elements = g_slist_next (elements);
             }
 
@@ -865,7 +1204,7 @@ static GstElement * create_source_pipeline (Source *source)
 
         } else {
             /* delay sometimes pad link */
-            delay_sometimes_pad_link (source, bin->previous->src_name);
+            delay_sometimes_pad_link (input->bins, bin->previous->src_name);
         }
 
         /* new stream, set appsink output callback. */
@@ -874,7 +1213,15 @@ static GstElement * create_source_pipeline (Source *source)
         type = gst_element_factory_get_element_type (element_factory);
         if (g_strcmp0 ("GstAppSink", g_type_name (type)) == 0) {
             stream = source_get_stream (source, bin->name);
-            gst_app_sink_set_callbacks (GST_APP_SINK (element), &appsink_callbacks, stream, NULL);
+            if (stream == NULL) {
+                GST_ERROR ("input %d appsink %s is not a stream of source", input->index, bin->name);
+                gst_object_unref (pipeline);
+                return NULL;
+            }
+            gst_app_sink_set_callbacks (GST_APP_SINK (element),
+                    &appsink_callbacks,
+                    &(stream->inputs[input->index]),
+                    NULL);
             GST_DEBUG ("Set callbacks for bin %s", bin->name);
         }
 
@@ -882,60 +1229,186 @@ static GstElement * create_source_pipeline (Source *source)
     }
 
     bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
-    gst_bus_add_watch (bus, bus_callback, source);
+    if (source->inputs_count > 1) {
+        gst_bus_add_watch (bus, input_bus_callback, input);
+
+    } else {
+        gst_bus_add_watch (bus, bus_callback, source);
+    }
     g_object_unref (bus);
 
     return pipeline;
 }
 
-static gint source_extract_streams (Source *source, gchar *job)
+static gint source_extract_streams (Source *source, JobDesc *jobdesc)
 {
-    GRegex *regex;
-    GMatchInfo *match_info;
     SourceStream *stream;
-    gchar **bins, **p, *bin;
+    BinToken *tokens;
+    gchar **bins, **p, *bin, *name;
+    gint count;
 
-    p = bins = jobdesc_bins (job, "source");
+    tokens = g_new (BinToken, BIN_MAX_ELEMENTS);
+    p = bins = jobdesc_bins (jobdesc, "source");
     while (*p != NULL) {
         bin = *p;
-        regex = g_regex_new ("! *appsink *name *= *(?<name>[^ ]*)[^!]*$", G_REGEX_OPTIMIZE, 0, NULL);
-        g_regex_match (regex, bin, 0, &match_info);
-        g_regex_unref (regex);
-        if (g_match_info_matches (match_info)) {
+        count = bin_tokenize (bin, tokens, BIN_MAX_ELEMENTS);
+        if (count < 0) {
+            g_free (tokens);
+            g_strfreev (bins);
+            return 1;
+        }
+
+        /* demuxer.video ! queue ! appsink name = video */
+        name = NULL;
+        if ((count > 1) && bin_token_is (bin, &(tokens[count - 1]), "appsink")) {
+            name = bin_token_property (bin, &(tokens[count - 1]), "name");
+        }
+        if (name != NULL) {
             stream = (SourceStream *)g_malloc (sizeof (SourceStream));
-            stream->name = g_match_info_fetch_named (match_info, "name");
+            stream->name = name;
             GST_DEBUG ("source stream %s found %s", stream->name, bin);
-            g_match_info_free (match_info);
             g_array_append_val (source->streams, stream);
 
         } else if (g_strrstr (bin, "appsink") != NULL) {
             GST_ERROR ("appsink name property must be set");
+            g_free (tokens);
+            g_strfreev (bins);
             return 1;
         }
         p++;
     }
+    g_free (tokens);
     g_strfreev (bins);
 
     return 0;
 }
 
-Source * source_initialize (gchar *job, SourceState *source_stat)
+/* shmsink doesn't replay stream headers, a job attached later never got them */
+static void ingest_client_connected (GstElement *shmsink, gint fd, gpointer user_data)
+{
+    SourceStream *stream = (SourceStream *)user_data;
+
+    GST_INFO ("job attached to ingest stream %s", stream->name);
+    g_atomic_int_set (&(stream->ingest_resend), TRUE);
+}
+
+/*
+ * ingest_resend_probe:
+ * serialized in streaming thread of queue, copies of sticky events go through gdppay again,
+ * jobs attached already get them twice, which is harmless.
+ */
+static GstPadProbeReturn ingest_resend_probe (GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    SourceStream *stream = (SourceStream *)user_data;
+    GstEventType types[] = {GST_EVENT_STREAM_START, GST_EVENT_CAPS, GST_EVENT_SEGMENT};
+    GstEvent *event;
+    GstPad *peer;
+    gint i;
+
+    if (!g_atomic_int_compare_and_exchange (&(stream->ingest_resend), TRUE, FALSE)) {
+        return GST_PAD_PROBE_OK;
+    }
+    peer = gst_pad_get_peer (pad);
+    if (peer == NULL) {
+        return GST_PAD_PROBE_OK;
+    }
+    for (i = 0; i < G_N_ELEMENTS (types); i++) {
+        event = gst_pad_get_sticky_event (pad, types[i], 0);
+        if (event != NULL) {
+            /* a new event object, the one stored on gdppay sink pad would not be serialized again */
+            gst_pad_send_event (peer, gst_event_copy (event));
+            gst_event_unref (event);
+        }
+    }
+    gst_object_unref (peer);
+
+    return GST_PAD_PROBE_OK;
+}
+
+/*
+ * ingest_parse:
+ * appsrc ! queue ! gdppay ! shmsink, caps and segment are serialized by gdppay, and again for every attached job,
+ * leaky queue drops old samples rather than blocking the source on a slow attached job.
+ */
+static void ingest_parse (JobDesc *jobdesc, SourceStream *stream)
+{
+    GstElement *queue, *gdppay, *shmsink;
+    GstPad *pad;
+    gchar *name, *path;
+    GStatBuf st;
+
+    if (!jobdesc_ingest (jobdesc)) {
+        stream->ingest = NULL;
+        stream->ingest_appsrc = NULL;
+        stream->ingest_caps = NULL;
+        return;
+    }
+    name = jobdesc_get_name (jobdesc);
+    path = jobdesc_ingest_socket_path (name, stream->name);
+    /* socket left by a killed worker, never remove anything else */
+    if ((g_lstat (path, &st) == 0) && S_ISSOCK (st.st_mode) && (st.st_uid == geteuid ())) {
+        g_unlink (path);
+    }
+    stream->ingest = gst_pipeline_new ("ingest");
+    stream->ingest_appsrc = gst_element_factory_make ("appsrc", "source");
+    stream->ingest_caps = NULL;
+    g_object_set (G_OBJECT (stream->ingest_appsrc), "is-live", TRUE, "format", GST_FORMAT_TIME, NULL);
+    queue = gst_element_factory_make ("queue", "queue");
+    g_object_set (G_OBJECT (queue), "leaky", 2, NULL);
+    gdppay = gst_element_factory_make ("gdppay", "gdppay");
+    shmsink = gst_element_factory_make ("shmsink", "sink");
+    g_object_set (G_OBJECT (shmsink), "socket-path", path, "wait-for-connection", FALSE, "sync", FALSE, NULL);
+    gst_bin_add_many (GST_BIN (stream->ingest), stream->ingest_appsrc, queue, gdppay, shmsink, NULL);
+    gst_element_link_many (stream->ingest_appsrc, queue, gdppay, shmsink, NULL);
+    stream->ingest_resend = FALSE;
+    g_signal_connect (shmsink, "client-connected", G_CALLBACK (ingest_client_connected), stream);
+    pad = gst_element_get_static_pad (queue, "src");
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, ingest_resend_probe, stream, NULL);
+    gst_object_unref (pad);
+    GST_INFO ("publish ingest stream %s at %s", stream->name, path);
+    g_free (path);
+    g_free (name);
+}
+
+Source * source_initialize (JobDesc *jobdesc, SourceState *source_stat)
 {
     gint i, j;
     Source *source;
     SourceStream *stream;
+    SourceInput *input;
+    GstClockTime now;
 
     source = source_new ("name", "source", NULL);
-    if (source_extract_streams (source, job) != 0) {
+    if (source_extract_streams (source, jobdesc) != 0) {
         return NULL;
     }
 
+    /* inputs are prerolling in startup timeout, no failover */
+    now = gst_clock_get_time (source->system_clock);
+    source->inputs_count = jobdesc_source_backup (jobdesc) ? 2 : 1;
+    source->active_input = 0;
+    g_mutex_init (&(source->switch_mutex));
+    source->failover_timeout = jobdesc_source_failover_timeout (jobdesc);
+    for (i = 0; i < source->inputs_count; i++) {
+        input = &(source->inputs[i]);
+        input->source = source;
+        input->index = i;
+        input->bins = NULL;
+        input->pipeline = NULL;
+        input->failed = FALSE;
+        input->retry = 0;
+        input->resync = 0;
+        input->heartbeat = now + SOURCE_STARTUP_TIMEOUT;
+        input->alive_since = now;
+        input->offset = 0;
+    }
+
     for (i = 0; i < source->streams->len; i++) {
         stream = g_array_index (source->streams, gpointer, i);
         stream->codec = NULL;
         stream->eos = FALSE;
         stream->current_position = -1;
-        if (jobdesc_is_live (job)) {
+        if (jobdesc_is_live (jobdesc)) {
             stream->is_live = TRUE;
         } else {
 
@@ -943,8 +1416,8 @@ Source * source_initialize (gchar *job, SourceState *source_stat)
         }
         stream->system_clock = source->system_clock;
         stream->segment_duration = GST_CLOCK_TIME_NONE;
-        if (jobdesc_m3u8streaming (job)) {
-            stream->segment_duration = jobdesc_m3u8streaming_segment_duration (job);
+        if (jobdesc_m3u8streaming (jobdesc)) {
+            stream->segment_duration = jobdesc_m3u8streaming_segment_duration (jobdesc);
             stream->segment_duration_minus_delta = stream->segment_duration - DELTA;
             stream->current_segment_duration = 0;
             stream->next_segment_timestamp = 0;
@@ -953,16 +1426,38 @@ Source * source_initialize (gchar *job, SourceState *source_stat)
         for (j = 0; j < SOURCE_RING_SIZE; j++) {
             stream->ring[j] = NULL;
         }
+        g_mutex_init (&(stream->input_mutex));
+        stream->input = 0;
+        stream->next_pts = GST_CLOCK_TIME_NONE;
+        ingest_parse (jobdesc, stream);
+        for (j = 0; j < SOURCE_INPUTS; j++) {
+            stream->inputs[j].stream = stream;
+            stream->inputs[j].input = &(source->inputs[j]);
+        }
         stream->state = &(source_stat->streams[i]);
-        g_strlcpy (source_stat->streams[i].name, stream->name, STREAM_NAME_LEN);
+        g_strlcpy (source_stat->stream_names[i], stream->name, STREAM_NAME_LEN);
     }
 
-    /* parse bins and create pipeline. */
-    source->bins = bins_parse (job, "source");
-    if (source->bins == NULL) {
-        return NULL;
+    /* native passthrough, no pipeline */
+    if (jobdesc_passthrough (jobdesc) != NULL) {
+        source->pipeline = NULL;
+        return source;
+    }
+
+    /* parse bins and create pipeline of every input. */
+    for (i = 0; i < source->inputs_count; i++) {
+        input = &(source->inputs[i]);
+        input->bins = bins_parse (jobdesc, i == 0 ? "source" : "source.backup");
+        if (input->bins == NULL) {
+            return NULL;
+        }
+        input->pipeline = create_source_pipeline (source, input);
+        if (input->pipeline == NULL) {
+            return NULL;
+        }
     }
-    source->pipeline = create_source_pipeline (source);
+    source->bins = source->inputs[0].bins;
+    source->pipeline = source->inputs[0].pipeline;
 
     return source;
 }
@@ -10,11 +10,19 @@
 #include <gst/gst.h>
 
 #include "log.h"
+#include "jobdesc.h"
 #include "m3u8playlist.h"
+#include "udpingest.h"
 
 #define SOURCE_RING_SIZE 512
 #define STREAM_NAME_LEN 1024
+#define CACHE_LINE_SIZE 64
+#define CACHE_LINE_ALIGN(size) (((size) + CACHE_LINE_SIZE - 1) & ~((guint64)CACHE_LINE_SIZE - 1))
 #define DELTA 30000000 /* 30ms */
+#define SOURCE_INPUTS 2 /* primary and hot standby backup input */
+#define SOURCE_FAILBACK_DELAY 10000000000 /* 10s, primary should be stable before fail back */
+#define SOURCE_STARTUP_TIMEOUT 5000000000 /* 5s, inputs prerolling, no failover */
+#define SOURCE_RETRY_INTERVAL 5 /* seconds, restart a failed input for fail back */
 
 typedef struct _Source Source;
 typedef struct _SourceClass SourceClass;
@@ -40,11 +48,35 @@ typedef struct _Bin {
     gulong signal_id;
 } Bin;
 
+#define BIN_MAX_ELEMENTS 64
+#define ELEMENT_MAX_PROPERTIES 16
+
+/*
+ * element of a bin like "appsink name=video sync=FALSE" or a pad like "demuxer.video",
+ * positions are offsets into the bin description string, nothing is copied.
+ */
+typedef struct _BinProperty {
+    gint key;
+    gint key_size;
+    gint value;
+    gint value_size;
+} BinProperty;
+
+typedef struct _BinToken {
+    gint start;
+    gint size; /* element description without leading and trailing space */
+    gint factory_size; /* factory name, or element.pad when is_pad, at start */
+    gboolean is_pad;
+    gint properties_count;
+    BinProperty properties[ELEMENT_MAX_PROPERTIES];
+} BinToken;
+
+/* every stream state in its own cache line, name is in the string table of job output */
 typedef struct _SourceStreamState {
-    gchar name[STREAM_NAME_LEN];
     GstClockTime current_timestamp;
     GstClockTime last_heartbeat;
-} SourceStreamState;
+    UdpIngestStats ingest[SOURCE_INPUTS]; /* udpingest counters of primary and backup input */
+} __attribute__ ((aligned (CACHE_LINE_SIZE))) SourceStreamState;
 
 typedef struct _SourceState {
     /*
@@ -56,15 +88,40 @@ typedef struct _SourceState {
     guint64 sync_error_times;
     gint64 stream_count;
     SourceStreamState *streams;
+    gchar **stream_names;
 } SourceState;
 
 typedef struct _RingBuffer {
     gboolean is_rap;
     GstClockTime timestamp;
     GstClockTime duration;
+    gint64 ingest_time; /* wall clock the buffer left source appsink, us */
     GstSample *sample;
 } RingBuffer;
 
+/*
+ * SourceInput:
+ * primary input or hot standby backup input, each has its own pipeline,
+ * all inputs are decoding, only samples of the active input go into the ring.
+ */
+typedef struct _SourceInput {
+    Source *source;
+    gint index; /* 0 is primary */
+    GSList *bins;
+    GstElement *pipeline;
+    gboolean failed; /* pipeline error, stoped */
+    guint retry; /* timeout source restarting the failed input, 0 if none */
+    gint resync; /* restarted after failure, offset is computed again at its first sample */
+    GstClockTime heartbeat; /* last sample of any stream of the input, atomic */
+    GstClockTime alive_since; /* first sample after a gap, atomic */
+    GstClockTimeDiff offset; /* restamp buffers of all streams of the input continuing the ring timeline */
+} SourceInput;
+
+typedef struct _SourceStreamInput {
+    struct _SourceStream *stream;
+    SourceInput *input;
+} SourceStreamInput;
+
 typedef struct _SourceStream {
     gchar *name;
     gchar *codec;
@@ -79,6 +136,14 @@ typedef struct _SourceStream {
     GstClockTime segment_duration_minus_delta;
     GstClockTime last_segment_pts;
     GArray *encoders;
+    SourceStreamInput inputs[SOURCE_INPUTS]; /* user data of appsink callbacks */
+    GMutex input_mutex;
+    gint input; /* input of last sample in the ring */
+    GstClockTime next_pts; /* pts + duration of last sample in the ring, atomic */
+    GstElement *ingest; /* publish decoded stream to attached jobs, NULL if job is not an ingest */
+    GstElement *ingest_appsrc;
+    GstCaps *ingest_caps;
+    gint ingest_resend; /* a job attached, resend stream-start, caps and segment before next buffer */
 
     SourceStreamState *state;
 } SourceStream;
@@ -88,8 +153,13 @@ struct _Source {
 
     gchar *name;
     GstClock *system_clock;
-    GSList *bins;
-    GstElement *pipeline;
+    GSList *bins; /* bins of primary input */
+    GstElement *pipeline; /* pipeline of primary input */
+    SourceInput inputs[SOURCE_INPUTS];
+    gint inputs_count;
+    gint active_input;
+    GMutex switch_mutex; /* switching active input and setting its offset */
+    GstClockTime failover_timeout;
 
     GArray *streams;
 };
@@ -109,7 +179,13 @@ struct _SourceClass {
 GType source_get_type (void);
 
 gboolean bus_callback (GstBus *bus, GstMessage *msg, gpointer user_data);
-GSList * bins_parse (gchar *job, gchar *pipeline);
-Source * source_initialize (gchar *job, SourceState *source_stat);
+void source_stream_segment (SourceStream *stream, GstBuffer *buffer, RingBuffer *ring_buffer);
+gint bin_tokenize (const gchar *bin, BinToken *tokens, gint max);
+gboolean bin_token_is (const gchar *bin, BinToken *token, const gchar *factory);
+gchar * bin_token_property (const gchar *bin, BinToken *token, const gchar *key);
+GSList * bins_parse (JobDesc *jobdesc, gchar *pipeline);
+Source * source_initialize (JobDesc *jobdesc, SourceState *source_stat);
+void source_input_failure (SourceInput *input);
+void source_stop (Source *source);
 
 #endif /* __SOURCE_H__ */
@@ -16,6 +16,7 @@ G_DEFINE_TYPE (TsSegment, ts_segment, GST_TYPE_ELEMENT);
 enum {
     TSSEGMENT_PROP_0,
     TSSEGMENT_PROP_BITRATE,
+    TSSEGMENT_PROP_PROGRAM_NUMBER,
 };
 
 static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
@@ -54,6 +55,17 @@ static void ts_segment_class_init (TsSegmentClass * klass)
             );
     g_object_class_install_property (g_object_class, TSSEGMENT_PROP_BITRATE, param);
 
+    param = g_param_spec_uint (
+            "program-number",
+            "program-number",
+            "program to segment of multi program transport stream, 0 is the first program",
+            0,
+            65535,
+            0,
+            G_PARAM_WRITABLE | G_PARAM_READABLE
+            );
+    g_object_class_install_property (g_object_class, TSSEGMENT_PROP_PROGRAM_NUMBER, param);
+
     gst_element_class_set_static_metadata (element_class,
             "MPEGTS Segment plugin",
             "TSSegment/TSSegment",
@@ -85,6 +97,12 @@ static void ts_segment_init (TsSegment *tssegment)
     MPEGTS_BIT_SET (tssegment->known_psi, 0x15);
     tssegment->seen_pat = FALSE;
     tssegment->seen_pmt = FALSE;
+    tssegment->selected_program = 0;
+    tssegment->pmt_pid = 0;
+    tssegment->pat_version = VERSION_NUMBER_UNSET;
+    tssegment->pmt_version = VERSION_NUMBER_UNSET;
+    tssegment->program_pids = g_new0 (guint8, 1024);
+    tssegment->pat_cc = 0;
 
     tssegment->video_pid = 0;
 
@@ -110,6 +128,8 @@ static void ts_segment_init (TsSegment *tssegment)
     tssegment->h265parser = gst_h265_parser_new ();
 
     tssegment->tag = gst_tag_list_new_empty ();
+    tssegment->output = NULL;
+    tssegment->output_data = NULL;
 }
 
 static void ts_segment_set_property (GObject *obj, guint prop_id, const GValue *value, GParamSpec *pspec)
@@ -121,6 +141,10 @@ static void ts_segment_set_property (GObject *obj, guint prop_id, const GValue *
             TS_SEGMENT (obj)->bitrate = g_value_get_int64 (value);
             break;
 
+        case TSSEGMENT_PROP_PROGRAM_NUMBER:
+            TS_SEGMENT (obj)->selected_program = g_value_get_uint (value);
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
             break;
@@ -136,6 +160,10 @@ static void ts_segment_get_property (GObject *obj, guint prop_id, GValue *value,
             g_value_set_int64 (value, tssegment->bitrate);
             break;
 
+        case TSSEGMENT_PROP_PROGRAM_NUMBER:
+            g_value_set_uint (value, tssegment->selected_program);
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
             break;
@@ -148,6 +176,7 @@ static void ts_segment_dispose (GObject * object)
 
     tssegment = TS_SEGMENT (object);
     g_free (tssegment->known_psi);
+    g_free (tssegment->program_pids);
     gst_tag_list_unref (tssegment->tag);
     g_object_unref (tssegment);
 }
@@ -469,16 +498,45 @@ static gboolean apply_pat (TsSegment *tssegment, GstMpegtsSection * section)
 {
     GPtrArray *pat;
     GstMpegtsPatProgram *patp;
+    gint i;
 
     pat = gst_mpegts_section_get_pat (section);
     if (G_UNLIKELY (pat == NULL)) {
         return FALSE;
     }
-    tssegment->pat = pat;
-    patp = g_ptr_array_index (pat, 0);
 
+    /* program 0 is network pid */
+    patp = NULL;
+    for (i = 0; i < pat->len; i++) {
+        patp = g_ptr_array_index (pat, i);
+        if ((patp->program_number != 0) &&
+            ((tssegment->selected_program == 0) || (patp->program_number == tssegment->selected_program))) {
+            break;
+        }
+        patp = NULL;
+    }
+    if (patp == NULL) {
+        GST_WARNING ("program %u not found in pat", tssegment->selected_program);
+        g_ptr_array_unref (pat);
+        return FALSE;
+    }
+
+    if (tssegment->pat != NULL) {
+        g_ptr_array_unref (tssegment->pat);
+    }
+    tssegment->pat = pat;
+    tssegment->transport_stream_id = section->subtable_extension;
+    tssegment->pat_version = section->version_number;
     tssegment->program_number = patp->program_number;
-    tssegment->pmt_pid = patp->network_or_program_map_PID;
+    if (tssegment->pmt_pid != patp->network_or_program_map_PID) {
+        /* new or moved pmt */
+        if (tssegment->pmt_pid != 0) {
+            MPEGTS_BIT_UNSET (tssegment->known_psi, tssegment->pmt_pid);
+        }
+        tssegment->pmt_pid = patp->network_or_program_map_PID;
+        tssegment->pmt_version = VERSION_NUMBER_UNSET;
+        tssegment->seen_pmt = FALSE;
+    }
     MPEGTS_BIT_SET (tssegment->known_psi, patp->network_or_program_map_PID);
 
     return TRUE;
@@ -504,8 +562,22 @@ static gboolean apply_pmt (TsSegment *tssegment, GstMpegtsSection * section)
     /* activate program */
     /* Ownership of pmt_info is given to the program */
     tssegment->pmt = pmt;
+    tssegment->pmt_version = section->version_number;
+    memset (tssegment->program_pids, 0, 1024);
+    MPEGTS_BIT_SET (tssegment->program_pids, tssegment->pmt_pid);
+    MPEGTS_BIT_SET (tssegment->program_pids, pmt->pcr_pid);
     for (i = 0; i < pmt->streams->len; ++i) {
         GstMpegtsPMTStream *stream = g_ptr_array_index (pmt->streams, i);
+        MPEGTS_BIT_SET (tssegment->program_pids, stream->pid);
+        if (((stream->stream_type == GST_MPEGTS_STREAM_TYPE_VIDEO_H264) ||
+            (stream->stream_type == GST_MPEGTS_STREAM_TYPE_VIDEO_HEVC)) &&
+            (tssegment->video_pid != 0) && (tssegment->video_pid != stream->pid)) {
+            /* video moved in new pmt version, start over from next idr */
+            GST_WARNING ("program %u video pid %d -> %d", tssegment->program_number, tssegment->video_pid, stream->pid);
+            tssegment->seen_idr = FALSE;
+            tssegment->current_size = 0;
+            tssegment->pes_packet_size = 0;
+        }
         if (stream->stream_type == GST_MPEGTS_STREAM_TYPE_VIDEO_H264) {
             GST_INFO ("H.264 video, pid %d", stream->pid);
             tssegment->video_stream_type = GST_MPEGTS_STREAM_TYPE_VIDEO_H264;
@@ -555,12 +627,15 @@ static void handle_psi (TsSegment *tssegment, TSPacket *packet)
         return;
     }
 
-    if ((section->section_type == GST_MPEGTS_SECTION_PAT) && tssegment->seen_pat){
+    /* pat or pmt of selected program is applied again on version change */
+    if ((section->section_type == GST_MPEGTS_SECTION_PAT) && tssegment->seen_pat &&
+        (section->version_number == tssegment->pat_version)) {
         gst_mpegts_section_unref (section);
         return;
     }
 
-    if ((section->section_type == GST_MPEGTS_SECTION_PMT) && tssegment->seen_pmt){
+    if ((section->section_type == GST_MPEGTS_SECTION_PMT) &&
+        ((section->pid != tssegment->pmt_pid) || (tssegment->seen_pmt && (section->version_number == tssegment->pmt_version)))) {
         gst_mpegts_section_unref (section);
         return;
     }
@@ -570,11 +645,11 @@ static void handle_psi (TsSegment *tssegment, TSPacket *packet)
     switch (section->section_type) {
         case GST_MPEGTS_SECTION_PAT:
             post_message = apply_pat (tssegment, section);
-            tssegment->seen_pat = TRUE;
+            tssegment->seen_pat = post_message;
             break;
         case GST_MPEGTS_SECTION_PMT:
             post_message = apply_pmt (tssegment, section);
-            tssegment->seen_pmt = TRUE;
+            tssegment->seen_pmt = post_message;
             break;
         default:
             break;
@@ -1047,14 +1122,8 @@ static NaluParsingResult h265_parse_nalu (TsSegment *tssegment)
     return type;
 }
 
-static void pending_tspacket (TsSegment *tssegment, TSPacket *packet)
+static void pending_data (TsSegment *tssegment, const guint8 *data, guint size)
 {
-    const guint8 *data;
-    guint size;
-
-    size = packet->data_end - packet->data_start;
-    data = packet->data_start;
-
     if (G_UNLIKELY (tssegment->current_size + size > tssegment->allocated_size)) {
         GST_DEBUG ("resizing buffer");
         do {
@@ -1066,6 +1135,53 @@ static void pending_tspacket (TsSegment *tssegment, TSPacket *packet)
     tssegment->current_size += size;
 }
 
+static void pending_tspacket (TsSegment *tssegment, TSPacket *packet)
+{
+    pending_data (tssegment, packet->data_start, packet->data_end - packet->data_start);
+}
+
+/* crc32 of psi section, polynomial 0x04c11db7 */
+static guint32 section_crc32 (const guint8 *data, guint size)
+{
+    guint32 crc = 0xffffffff;
+    guint i, j;
+
+    for (i = 0; i < size; i++) {
+        crc ^= (guint32)data[i] << 24;
+        for (j = 0; j < 8; j++) {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+/* single program pat of selected program in place of pat of mpts */
+static void pending_pat (TsSegment *tssegment)
+{
+    guint8 packet[MPEGTS_NORMAL_PACKETSIZE], *section;
+
+    memset (packet, 0xff, MPEGTS_NORMAL_PACKETSIZE);
+    packet[0] = PACKET_SYNC_BYTE;
+    packet[1] = 0x40; /* payload unit start, pid 0 */
+    packet[2] = 0x00;
+    packet[3] = 0x10 | tssegment->pat_cc; /* payload only */
+    tssegment->pat_cc = (tssegment->pat_cc + 1) % 16;
+    packet[4] = 0x00; /* pointer field */
+    section = packet + 5;
+    section[0] = 0x00; /* table id */
+    section[1] = 0xb0; /* section syntax indicator, section length 13 */
+    section[2] = 0x0d;
+    GST_WRITE_UINT16_BE (section + 3, tssegment->transport_stream_id);
+    section[5] = 0xc1 | ((tssegment->pat_version & 0x1f) << 1); /* current next indicator */
+    section[6] = 0x00; /* section number */
+    section[7] = 0x00; /* last section number */
+    GST_WRITE_UINT16_BE (section + 8, tssegment->program_number);
+    GST_WRITE_UINT16_BE (section + 10, 0xe000 | tssegment->pmt_pid);
+    GST_WRITE_UINT32_BE (section + 12, section_crc32 (section, 12));
+    pending_data (tssegment, packet, MPEGTS_NORMAL_PACKETSIZE);
+}
+
 /**
  * parse_pes_header:
  *
@@ -1288,11 +1404,17 @@ static GstFlowReturn ts_segment_chain (GstPad * pad, GstObject * parent, GstBuff
                     GST_DEBUG ("PTS %" GST_TIME_FORMAT ", duration: %" GST_TIME_FORMAT,
                             GST_TIME_ARGS (tssegment->PTS),
                             GST_TIME_ARGS (tssegment->pes_packet_duration));
-                    if (G_LIKELY (tssegment->seen_idr)) {
+                    if (G_LIKELY (tssegment->seen_idr) && (tssegment->output != NULL)) {
+                        tssegment->output (buffer, tssegment->output_data);
+
+                    } else if (G_LIKELY (tssegment->seen_idr)) {
                         gst_pad_push (tssegment->srcpad, buffer);
 
-                    } else if (nalu_parsing_result & NALU_IDR) {
-                        tssegment->seen_idr = TRUE;
+                    } else {
+                        if (nalu_parsing_result & NALU_IDR) {
+                            tssegment->seen_idr = TRUE;
+                        }
+                        gst_buffer_unref (buffer);
                     }
                     tssegment->current_size = 0;
                     tssegment->pes_packet_duration = 0;
@@ -1306,7 +1428,17 @@ static GstFlowReturn ts_segment_chain (GstPad * pad, GstObject * parent, GstBuff
         }
 
         if (G_LIKELY (tssegment->seen_idr)) {
-            pending_tspacket (tssegment, &packet);
+            if (tssegment->selected_program == 0) {
+                pending_tspacket (tssegment, &packet);
+
+            } else if (packet.pid == 0) {
+                if (packet.payload_unit_start_indicator) {
+                    pending_pat (tssegment);
+                }
+
+            } else if (MPEGTS_BIT_IS_SET (tssegment->program_pids, packet.pid)) {
+                pending_tspacket (tssegment, &packet);
+            }
         }
         clear_packet (tssegment, &packet);
     }
@@ -1314,6 +1446,50 @@ static GstFlowReturn ts_segment_chain (GstPad * pad, GstObject * parent, GstBuff
     return res;
 }
 
+/**
+ * ts_segment_set_output:
+ * @tssegment: (in): tssegment not in a pipeline.
+ * @output: (in): called with every frame, in place of pushing it on srcpad.
+ * @user_data: (in): data of output.
+ *
+ * Native passthrough uses tssegment without pipeline, pads are not linked.
+ */
+void ts_segment_set_output (TsSegment *tssegment, TsSegmentOutput output, gpointer user_data)
+{
+    tssegment->output = output;
+    tssegment->output_data = user_data;
+}
+
+/**
+ * ts_segment_push:
+ * @tssegment: (in): tssegment not in a pipeline.
+ * @buffer: (in): mpegts data, taken.
+ *
+ * Returns: GST_FLOW_OK.
+ */
+GstFlowReturn ts_segment_push (TsSegment *tssegment, GstBuffer *buffer)
+{
+    return ts_segment_chain (tssegment->sinkpad, GST_OBJECT (tssegment), buffer);
+}
+
+/**
+ * ts_segment_pat:
+ * @tssegment: (in): tssegment not in a pipeline, fed with pids of its program only.
+ * @section: (in): pat parsed by the feeder on version change, NULL if it is not changed.
+ *
+ * pat of mpts is parsed once by the feeder for all programs, called where a pat is in the mpts,
+ * a single program pat is put in output in its place.
+ */
+void ts_segment_pat (TsSegment *tssegment, GstMpegtsSection *section)
+{
+    if (section != NULL) {
+        tssegment->seen_pat = apply_pat (tssegment, section);
+    }
+    if (tssegment->seen_pat && tssegment->seen_idr) {
+        pending_pat (tssegment);
+    }
+}
+
 gboolean ts_segment_plugin_init (GstPlugin * plugin)
 {
     return gst_element_register (plugin, "tssegment", GST_RANK_NONE, TYPE_TS_SEGMENT);
@@ -86,6 +86,9 @@ typedef struct {
  * safe to use direct calculation (17+33 < 63) */
 #define MPEGTIME_TO_GSTTIME(t) ((t) * (guint64)100000 / 9)
 
+/* native passthrough output, takes the frame buffer */
+typedef void (*TsSegmentOutput) (GstBuffer *buffer, gpointer user_data);
+
 typedef struct _TsSegment {
     GObject parent;
 
@@ -93,8 +96,15 @@ typedef struct _TsSegment {
     GstPad *sinkpad, *srcpad;
 
     gint64 bitrate;
+    guint selected_program; /* program-number property, 0 is the first program in pat */
     guint program_number;
     guint16 pmt_pid;
+    guint8 pat_version;
+    guint8 pmt_version;
+    guint16 transport_stream_id;
+    /* pids of selected program, output of mpts is filtered by, pat is rewritten to single program */
+    guint8 *program_pids;
+    guint8 pat_cc;
     const GstMpegtsPMT *pmt;
     /* arrays that say whether a pid is a known psi pid or a pes pid */
     /* Use MPEGTS_BIT_* to set/unset/check the values */
@@ -151,6 +161,10 @@ typedef struct _TsSegment {
     gboolean seen_idr;
 
     GstTagList *tag;
+
+    /* frames go to output instead of srcpad if set */
+    TsSegmentOutput output;
+    gpointer output_data;
 } TsSegment;
 
 typedef struct _TsSegmentClass {
@@ -166,5 +180,8 @@ typedef struct _TsSegmentClass {
 GType ts_segment_get_type (void);
 
 gboolean ts_segment_plugin_init (GstPlugin * plugin);
+void ts_segment_set_output (TsSegment *tssegment, TsSegmentOutput output, gpointer user_data);
+GstFlowReturn ts_segment_push (TsSegment *tssegment, GstBuffer *buffer);
+void ts_segment_pat (TsSegment *tssegment, GstMpegtsSection *section);
 
 #endif /* __TSSEGMENT_H__ */
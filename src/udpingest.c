@@ -0,0 +1,588 @@
+/*
+ *  udp/rtp ingest element, recvmmsg batching, kernel arrival timestamps, rtp reordering
+ *
+ *  Copyright (C) Zhang Ping <dqzhangp@163.com>
+ */
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "udpingest.h"
+
+GST_DEBUG_CATEGORY_EXTERN (GSTREAMILL);
+#define GST_CAT_DEFAULT GSTREAMILL
+
+#ifndef SO_RXQ_OVFL
+#define SO_RXQ_OVFL 40
+#endif
+
+#define RTP_CLOCK_RATE 90000
+
+typedef struct _UdpIngestBatch {
+    struct mmsghdr msgs[UDP_INGEST_BATCH];
+    struct iovec iovecs[UDP_INGEST_BATCH];
+    guint8 controls[UDP_INGEST_BATCH][UDP_INGEST_CONTROL_SIZE];
+    guint8 data[UDP_INGEST_BATCH * UDP_INGEST_DATAGRAM_SIZE];
+} UdpIngestBatch;
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+        GST_PAD_SRC,
+        GST_PAD_ALWAYS,
+        GST_STATIC_CAPS ("video/mpegts"));
+
+G_DEFINE_TYPE (UdpIngest, udp_ingest, GST_TYPE_PUSH_SRC);
+
+enum {
+    UDPINGEST_PROP_0,
+    UDPINGEST_PROP_URI,
+    UDPINGEST_PROP_BUFFER_SIZE,
+};
+
+static void udp_ingest_finalize (GObject *object);
+static void udp_ingest_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec);
+static void udp_ingest_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
+static gboolean udp_ingest_start (GstBaseSrc *src);
+static gboolean udp_ingest_stop (GstBaseSrc *src);
+static gboolean udp_ingest_unlock (GstBaseSrc *src);
+static gboolean udp_ingest_unlock_stop (GstBaseSrc *src);
+static GstFlowReturn udp_ingest_create (GstPushSrc *src, GstBuffer **buffer);
+
+static void udp_ingest_class_init (UdpIngestClass *klass)
+{
+    GObjectClass *g_object_class = G_OBJECT_CLASS (klass);
+    GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+    GstBaseSrcClass *base_src_class = GST_BASE_SRC_CLASS (klass);
+    GstPushSrcClass *push_src_class = GST_PUSH_SRC_CLASS (klass);
+    GParamSpec *param;
+
+    g_object_class->set_property = udp_ingest_set_property;
+    g_object_class->get_property = udp_ingest_get_property;
+    g_object_class->finalize = udp_ingest_finalize;
+    base_src_class->start = udp_ingest_start;
+    base_src_class->stop = udp_ingest_stop;
+    base_src_class->unlock = udp_ingest_unlock;
+    base_src_class->unlock_stop = udp_ingest_unlock_stop;
+    push_src_class->create = udp_ingest_create;
+
+    param = g_param_spec_string (
+            "uri",
+            "uri",
+            "udp://host:port or rtp://host:port, multicast group is joined",
+            NULL,
+            G_PARAM_WRITABLE | G_PARAM_READABLE
+            );
+    g_object_class_install_property (g_object_class, UDPINGEST_PROP_URI, param);
+
+    param = g_param_spec_int (
+            "buffer-size",
+            "buffer-size",
+            "socket receive buffer size",
+            0,
+            G_MAXINT,
+            UDP_INGEST_RCVBUF,
+            G_PARAM_WRITABLE | G_PARAM_READABLE
+            );
+    g_object_class_install_property (g_object_class, UDPINGEST_PROP_BUFFER_SIZE, param);
+
+    gst_element_class_set_static_metadata (element_class,
+            "UDP Ingest",
+            "Source/Network",
+            "Receive mpegts over udp or rtp in batch",
+            "Zhang Ping <zhangping@163.com>");
+
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&src_template));
+}
+
+static void udp_ingest_init (UdpIngest *ingest)
+{
+    ingest->uri = NULL;
+    ingest->buffer_size = UDP_INGEST_RCVBUF;
+    ingest->sock = -1;
+    ingest->batch = NULL;
+    ingest->published = NULL;
+    gst_base_src_set_live (GST_BASE_SRC (ingest), TRUE);
+    gst_base_src_set_format (GST_BASE_SRC (ingest), GST_FORMAT_TIME);
+    gst_base_src_set_do_timestamp (GST_BASE_SRC (ingest), TRUE);
+}
+
+static void udp_ingest_finalize (GObject *object)
+{
+    UdpIngest *ingest = UDP_INGEST (object);
+
+    g_free (ingest->uri);
+    g_slist_free (ingest->published);
+
+    G_OBJECT_CLASS (udp_ingest_parent_class)->finalize (object);
+}
+
+static void udp_ingest_set_property (GObject *obj, guint prop_id, const GValue *value, GParamSpec *pspec)
+{
+    g_return_if_fail (IS_UDP_INGEST (obj));
+
+    switch (prop_id) {
+        case UDPINGEST_PROP_URI:
+            g_free (UDP_INGEST (obj)->uri);
+            UDP_INGEST (obj)->uri = g_value_dup_string (value);
+            break;
+
+        case UDPINGEST_PROP_BUFFER_SIZE:
+            UDP_INGEST (obj)->buffer_size = g_value_get_int (value);
+            break;
+
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
+            break;
+    }
+}
+
+static void udp_ingest_get_property (GObject *obj, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+    UdpIngest *ingest = UDP_INGEST (obj);
+
+    switch (prop_id) {
+        case UDPINGEST_PROP_URI:
+            g_value_set_string (value, ingest->uri);
+            break;
+
+        case UDPINGEST_PROP_BUFFER_SIZE:
+            g_value_set_int (value, ingest->buffer_size);
+            break;
+
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
+            break;
+    }
+}
+
+/**
+ * udp_ingest_socket_open:
+ * @uri: (in): udp://host:port or rtp://host:port.
+ * @buffer_size: (in): socket receive buffer size.
+ *
+ * Bind to host:port, join group if host is multicast.
+ *
+ * Returns: socket, -1 on failure.
+ */
+gint udp_ingest_socket_open (const gchar *uri, gint buffer_size)
+{
+    struct addrinfo hints, *result;
+    struct sockaddr_in *addr;
+    struct ip_mreq mreq;
+    const gchar *p;
+    gchar **pp;
+    gint sock, reuse;
+
+    p = strstr (uri, "://");
+    if (p == NULL) {
+        GST_ERROR ("invalid udp uri %s", uri);
+        return -1;
+    }
+    pp = g_strsplit (p + strlen ("://"), ":", 0);
+    if (g_strv_length (pp) != 2) {
+        GST_ERROR ("invalid udp uri %s", uri);
+        g_strfreev (pp);
+        return -1;
+    }
+    memset (&hints, 0, sizeof (hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo (pp[0], pp[1], &hints, &result) != 0) {
+        GST_ERROR ("resolve udp uri %s error", uri);
+        g_strfreev (pp);
+        return -1;
+    }
+    g_strfreev (pp);
+    addr = (struct sockaddr_in *)result->ai_addr;
+
+    sock = socket (AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock == -1) {
+        GST_ERROR ("create udp socket error: %s", g_strerror (errno));
+        freeaddrinfo (result);
+        return -1;
+    }
+    reuse = 1;
+    setsockopt (sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof (reuse));
+    if (setsockopt (sock, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof (buffer_size)) == -1) {
+        GST_WARNING ("set udp socket receive buffer error: %s", g_strerror (errno));
+    }
+    if (bind (sock, (struct sockaddr *)addr, sizeof (struct sockaddr_in)) == -1) {
+        GST_ERROR ("bind udp socket %s error: %s", uri, g_strerror (errno));
+        freeaddrinfo (result);
+        close (sock);
+        return -1;
+    }
+    if (IN_MULTICAST (ntohl (addr->sin_addr.s_addr))) {
+        mreq.imr_multiaddr = addr->sin_addr;
+        mreq.imr_interface.s_addr = htonl (INADDR_ANY);
+        if (setsockopt (sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof (mreq)) == -1) {
+            GST_ERROR ("join multicast group %s error: %s", uri, g_strerror (errno));
+            freeaddrinfo (result);
+            close (sock);
+            return -1;
+        }
+    }
+    freeaddrinfo (result);
+
+    return sock;
+}
+
+static gboolean udp_ingest_start (GstBaseSrc *src)
+{
+    UdpIngest *ingest = UDP_INGEST (src);
+    UdpIngestBatch *batch;
+    struct timeval timeout;
+    gint i, on;
+
+    if (ingest->uri == NULL) {
+        GST_ERROR ("udpingest uri is not set");
+        return FALSE;
+    }
+    ingest->is_rtp = g_str_has_prefix (ingest->uri, "rtp://");
+    ingest->sock = udp_ingest_socket_open (ingest->uri, ingest->buffer_size);
+    if (ingest->sock == -1) {
+        return FALSE;
+    }
+    on = 1;
+    if (setsockopt (ingest->sock, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof (on)) == -1) {
+        GST_WARNING ("enable arrival timestamp error: %s", g_strerror (errno));
+    }
+    if (setsockopt (ingest->sock, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof (on)) == -1) {
+        GST_WARNING ("enable drop counter error: %s", g_strerror (errno));
+    }
+    /* wake up to check flushing */
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 100000;
+    setsockopt (ingest->sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+
+    batch = g_new0 (UdpIngestBatch, 1);
+    for (i = 0; i < UDP_INGEST_BATCH; i++) {
+        batch->iovecs[i].iov_base = batch->data + i * UDP_INGEST_DATAGRAM_SIZE;
+        batch->iovecs[i].iov_len = UDP_INGEST_DATAGRAM_SIZE;
+        batch->msgs[i].msg_hdr.msg_iov = &(batch->iovecs[i]);
+        batch->msgs[i].msg_hdr.msg_iovlen = 1;
+        batch->msgs[i].msg_hdr.msg_control = batch->controls[i];
+    }
+    ingest->batch = batch;
+    ingest->flushing = FALSE;
+    ingest->overflow = 0;
+    memset (ingest->cc, UDP_INGEST_CC_UNSET, sizeof (ingest->cc));
+    ingest->seq_valid = FALSE;
+    for (i = 0; i < UDP_INGEST_REORDER; i++) {
+        ingest->reorder[i] = NULL;
+    }
+    ingest->reorder_count = 0;
+    ingest->last_arrival = GST_CLOCK_TIME_NONE;
+    ingest->jitter = 0;
+    ingest->arrival_gap = 0;
+    memset (&(ingest->stats), 0, sizeof (UdpIngestStats));
+    GST_INFO ("udpingest %s started", ingest->uri);
+
+    return TRUE;
+}
+
+static gboolean udp_ingest_stop (GstBaseSrc *src)
+{
+    UdpIngest *ingest = UDP_INGEST (src);
+    gint i;
+
+    if (ingest->sock != -1) {
+        close (ingest->sock);
+        ingest->sock = -1;
+    }
+    g_free (ingest->batch);
+    ingest->batch = NULL;
+    for (i = 0; i < UDP_INGEST_REORDER; i++) {
+        if (ingest->reorder[i] != NULL) {
+            g_byte_array_free (ingest->reorder[i], TRUE);
+            ingest->reorder[i] = NULL;
+        }
+    }
+
+    return TRUE;
+}
+
+static gboolean udp_ingest_unlock (GstBaseSrc *src)
+{
+    UDP_INGEST (src)->flushing = TRUE;
+
+    return TRUE;
+}
+
+static gboolean udp_ingest_unlock_stop (GstBaseSrc *src)
+{
+    UDP_INGEST (src)->flushing = FALSE;
+
+    return TRUE;
+}
+
+/* arrival timestamp and socket overflow drops of a datagram */
+static GstClockTime parse_control (UdpIngest *ingest, struct msghdr *msg)
+{
+    struct cmsghdr *cmsg;
+    struct timespec ts;
+    guint32 overflow;
+    GstClockTime arrival;
+
+    arrival = GST_CLOCK_TIME_NONE;
+    for (cmsg = CMSG_FIRSTHDR (msg); cmsg != NULL; cmsg = CMSG_NXTHDR (msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET) {
+            continue;
+        }
+        if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            memcpy (&ts, CMSG_DATA (cmsg), sizeof (ts));
+            arrival = GST_TIMESPEC_TO_TIME (ts);
+
+        } else if (cmsg->cmsg_type == SO_RXQ_OVFL) {
+            /* drops of socket since created */
+            memcpy (&overflow, CMSG_DATA (cmsg), sizeof (overflow));
+            ingest->stats.drops += overflow - ingest->overflow;
+            ingest->overflow = overflow;
+        }
+    }
+
+    return arrival;
+}
+
+/* continuity counter of every pid, duplicate packet and discontinuity indicator are allowed */
+static void check_cc (UdpIngest *ingest, const guint8 *data, guint size)
+{
+    guint16 pid;
+    guint8 cc;
+
+    for (; size >= 188; data += 188, size -= 188) {
+        if (data[0] != 0x47) {
+            /* not aligned mpegts */
+            return;
+        }
+        pid = GST_READ_UINT16_BE (data + 1) & 0x1fff;
+        if ((pid == 0x1fff) || !(data[3] & 0x10)) {
+            /* null packet or without payload */
+            continue;
+        }
+        cc = data[3] & 0x0f;
+        if ((data[3] & 0x20) && (data[4] > 0) && (data[5] & 0x80)) {
+            ingest->cc[pid] = cc;
+            continue;
+        }
+        if ((ingest->cc[pid] != UDP_INGEST_CC_UNSET) &&
+            (cc != ((ingest->cc[pid] + 1) & 0x0f)) &&
+            (cc != ingest->cc[pid])) {
+            ingest->stats.cc_errors++;
+        }
+        ingest->cc[pid] = cc;
+    }
+}
+
+static void output (UdpIngest *ingest, GByteArray *out, const guint8 *data, guint size)
+{
+    check_cc (ingest, data, size);
+    g_byte_array_append (out, data, size);
+}
+
+/* deviation of arrival gap from average gap, plain udp has no media clock */
+static void udp_jitter (UdpIngest *ingest, GstClockTime arrival)
+{
+    gdouble gap;
+
+    if (!GST_CLOCK_TIME_IS_VALID (arrival)) {
+        return;
+    }
+    if (GST_CLOCK_TIME_IS_VALID (ingest->last_arrival)) {
+        gap = GST_CLOCK_DIFF (ingest->last_arrival, arrival);
+        ingest->arrival_gap += (gap - ingest->arrival_gap) / 16;
+        ingest->jitter += (ABS (gap - ingest->arrival_gap) - ingest->jitter) / 16;
+        ingest->stats.jitter = ingest->jitter;
+    }
+    ingest->last_arrival = arrival;
+}
+
+/* interarrival jitter of rfc3550 */
+static void rtp_jitter (UdpIngest *ingest, guint32 timestamp, GstClockTime arrival)
+{
+    gdouble d;
+
+    if (!GST_CLOCK_TIME_IS_VALID (arrival)) {
+        return;
+    }
+    if (GST_CLOCK_TIME_IS_VALID (ingest->last_arrival)) {
+        d = GST_CLOCK_DIFF (ingest->last_arrival, arrival) -
+            (gdouble)(gint32)(timestamp - ingest->last_rtp_timestamp) * GST_SECOND / RTP_CLOCK_RATE;
+        ingest->jitter += (ABS (d) - ingest->jitter) / 16;
+        ingest->stats.jitter = ingest->jitter;
+    }
+    ingest->last_arrival = arrival;
+    ingest->last_rtp_timestamp = timestamp;
+}
+
+/* held packets in sequence to output */
+static void reorder_drain (UdpIngest *ingest, GByteArray *out)
+{
+    GByteArray *held;
+
+    for (;;) {
+        held = ingest->reorder[ingest->next_seq % UDP_INGEST_REORDER];
+        if (held == NULL) {
+            break;
+        }
+        output (ingest, out, held->data, held->len);
+        g_byte_array_free (held, TRUE);
+        ingest->reorder[ingest->next_seq % UDP_INGEST_REORDER] = NULL;
+        ingest->reorder_count--;
+        ingest->next_seq++;
+    }
+}
+
+/* give up missing packets before the first held one */
+static void reorder_skip (UdpIngest *ingest, GByteArray *out)
+{
+    if (ingest->reorder_count == 0) {
+        return;
+    }
+    while (ingest->reorder[ingest->next_seq % UDP_INGEST_REORDER] == NULL) {
+        ingest->stats.drops++;
+        ingest->next_seq++;
+    }
+    reorder_drain (ingest, out);
+}
+
+static void rtp_receive (UdpIngest *ingest, GByteArray *out, const guint8 *data, guint size, GstClockTime arrival)
+{
+    GByteArray *held;
+    guint offset;
+    guint16 seq;
+    gint16 diff;
+
+    if ((size < 12) || ((data[0] >> 6) != 2)) {
+        GST_WARNING ("%s not a rtp packet", ingest->uri);
+        return;
+    }
+    offset = 12 + (data[0] & 0x0f) * 4;
+    if ((data[0] & 0x10) && (size >= offset + 4)) {
+        /* header extension */
+        offset += 4 + GST_READ_UINT16_BE (data + offset + 2) * 4;
+    }
+    if ((data[0] & 0x20) && (data[size - 1] < size)) {
+        /* padding */
+        size -= data[size - 1];
+    }
+    if (offset >= size) {
+        return;
+    }
+    seq = GST_READ_UINT16_BE (data + 2);
+    rtp_jitter (ingest, GST_READ_UINT32_BE (data + 4), arrival);
+    data += offset;
+    size -= offset;
+
+    if (!ingest->seq_valid) {
+        ingest->seq_valid = TRUE;
+        ingest->next_seq = seq;
+    }
+    diff = (gint16)(seq - ingest->next_seq);
+    if (diff < 0) {
+        /* late or duplicate, given up already */
+        ingest->stats.reordered++;
+        return;
+    }
+    if (diff >= UDP_INGEST_REORDER) {
+        /* sequence jumps, sender restarted */
+        while (ingest->reorder_count > 0) {
+            reorder_skip (ingest, out);
+        }
+        GST_WARNING ("%s rtp sequence jumps from %u to %u", ingest->uri, ingest->next_seq, seq);
+        ingest->next_seq = seq;
+        diff = 0;
+    }
+    if (diff > 0) {
+        if (ingest->reorder[seq % UDP_INGEST_REORDER] == NULL) {
+            held = g_byte_array_sized_new (size);
+            g_byte_array_append (held, data, size);
+            ingest->reorder[seq % UDP_INGEST_REORDER] = held;
+            ingest->reorder_count++;
+            ingest->stats.reordered++;
+        }
+        /* wait for missing packets while window is less than half full */
+        if (ingest->reorder_count >= UDP_INGEST_REORDER / 2) {
+            reorder_skip (ingest, out);
+        }
+        return;
+    }
+    output (ingest, out, data, size);
+    ingest->next_seq++;
+    reorder_drain (ingest, out);
+}
+
+static GstFlowReturn udp_ingest_create (GstPushSrc *src, GstBuffer **buffer)
+{
+    UdpIngest *ingest = UDP_INGEST (src);
+    UdpIngestBatch *batch = ingest->batch;
+    GByteArray *out;
+    GstClockTime arrival;
+    GSList *published;
+    gint count, i;
+    guint size;
+
+    for (;;) {
+        if (ingest->flushing) {
+            return GST_FLOW_FLUSHING;
+        }
+        for (i = 0; i < UDP_INGEST_BATCH; i++) {
+            batch->msgs[i].msg_hdr.msg_controllen = UDP_INGEST_CONTROL_SIZE;
+        }
+        count = recvmmsg (ingest->sock, batch->msgs, UDP_INGEST_BATCH, MSG_WAITFORONE, NULL);
+        if (count == -1) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) {
+                continue;
+            }
+            GST_ELEMENT_ERROR (ingest, RESOURCE, READ, (NULL), ("recvmmsg error: %s", g_strerror (errno)));
+            return GST_FLOW_ERROR;
+        }
+
+        out = g_byte_array_sized_new (count * 1316);
+        for (i = 0; i < count; i++) {
+            arrival = parse_control (ingest, &(batch->msgs[i].msg_hdr));
+            size = batch->msgs[i].msg_len;
+            ingest->stats.packets++;
+            ingest->stats.bytes += size;
+            if (ingest->is_rtp) {
+                rtp_receive (ingest, out, batch->iovecs[i].iov_base, size, arrival);
+
+            } else {
+                udp_jitter (ingest, arrival);
+                output (ingest, out, batch->iovecs[i].iov_base, size);
+            }
+        }
+        for (published = ingest->published; published != NULL; published = published->next) {
+            *((UdpIngestStats *)published->data) = ingest->stats;
+        }
+        if (out->len > 0) {
+            break;
+        }
+        g_byte_array_free (out, TRUE);
+    }
+    size = out->len;
+    *buffer = gst_buffer_new_wrapped (g_byte_array_free (out, FALSE), size);
+
+    return GST_FLOW_OK;
+}
+
+/**
+ * udp_ingest_publish:
+ * @ingest: (in): udpingest element.
+ * @stats: (in): counters in job output, updated after every batch.
+ */
+void udp_ingest_publish (UdpIngest *ingest, UdpIngestStats *stats)
+{
+    ingest->published = g_slist_append (ingest->published, stats);
+}
+
+gboolean udp_ingest_plugin_init (GstPlugin * plugin)
+{
+    return gst_element_register (plugin, "udpingest", GST_RANK_NONE, TYPE_UDP_INGEST);
+}
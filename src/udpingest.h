@@ -0,0 +1,78 @@
+/*
+ *  udp/rtp ingest element, recvmmsg batching, kernel arrival timestamps, rtp reordering
+ *
+ *  Copyright (C) Zhang Ping <dqzhangp@163.com>
+ */
+
+#ifndef __UDPINGEST_H__
+#define __UDPINGEST_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstpushsrc.h>
+
+#define UDP_INGEST_BATCH 64 /* datagrams per recvmmsg */
+#define UDP_INGEST_DATAGRAM_SIZE 2048
+#define UDP_INGEST_CONTROL_SIZE 64 /* SCM_TIMESTAMPNS and SO_RXQ_OVFL */
+#define UDP_INGEST_REORDER 64 /* rtp reorder window, packets */
+#define UDP_INGEST_RCVBUF 8388608 /* 8M */
+#define UDP_INGEST_CC_UNSET 0xff
+
+/*
+ * UdpIngestStats:
+ * counters of an ingest, published into source stream state of job output.
+ */
+typedef struct _UdpIngestStats {
+    guint64 packets; /* datagrams received */
+    guint64 bytes;
+    guint64 cc_errors; /* mpegts continuity counter errors */
+    guint64 drops; /* socket overflow drops and lost rtp packets */
+    guint64 reordered; /* rtp packets out of order */
+    guint64 jitter; /* ns, rtp interarrival jitter of rfc3550, arrival gap deviation of plain udp */
+} UdpIngestStats;
+
+typedef struct _UdpIngest {
+    GstPushSrc parent;
+
+    gchar *uri;
+    gint buffer_size;
+    gboolean is_rtp;
+    gint sock;
+    gboolean flushing;
+
+    gpointer batch; /* recvmmsg messages and datagrams */
+    guint32 overflow; /* last SO_RXQ_OVFL counter */
+    guint8 cc[8192]; /* last continuity counter of pid */
+
+    /* rtp reorder */
+    gboolean seq_valid;
+    guint16 next_seq;
+    GByteArray *reorder[UDP_INGEST_REORDER]; /* payload of held packet at seq % UDP_INGEST_REORDER */
+    gint reorder_count;
+
+    /* jitter */
+    GstClockTime last_arrival;
+    guint32 last_rtp_timestamp;
+    gdouble jitter; /* ns */
+    gdouble arrival_gap; /* ns, average arrival gap of plain udp */
+
+    UdpIngestStats stats;
+    GSList *published; /* UdpIngestStats in job output */
+} UdpIngest;
+
+typedef struct _UdpIngestClass {
+    GstPushSrcClass parent_class;
+} UdpIngestClass;
+
+#define TYPE_UDP_INGEST            (udp_ingest_get_type())
+#define UDP_INGEST(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),TYPE_UDP_INGEST,UdpIngest))
+#define UDP_INGEST_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass),TYPE_UDP_INGEST,UdpIngestClass))
+#define IS_UDP_INGEST(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),TYPE_UDP_INGEST))
+#define IS_UDP_INGEST_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass),TYPE_UDP_INGEST))
+
+GType udp_ingest_get_type (void);
+
+gboolean udp_ingest_plugin_init (GstPlugin * plugin);
+void udp_ingest_publish (UdpIngest *ingest, UdpIngestStats *stats);
+gint udp_ingest_socket_open (const gchar *uri, gint buffer_size);
+
+#endif /* __UDPINGEST_H__ */
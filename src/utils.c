@@ -13,6 +13,10 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <glob.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/vfs.h>
+#include <sys/stat.h>
 #include <glib/gstdio.h>
 
 #include "utils.h"
@@ -142,3 +146,63 @@ gint remove_dir (gchar *dir)
 
     return ret;
 }
+
+/**
+ * huge_page_size:
+ *
+ * Returns: huge page size of hugetlbfs mounted on HUGE_PAGES_PATH, 0 if not mounted.
+ */
+gsize huge_page_size (void)
+{
+    struct statfs buf;
+
+    if (statfs (HUGE_PAGES_PATH, &buf) == -1) {
+        return 0;
+    }
+    if (buf.f_type != HUGETLBFS_MAGIC) {
+        return 0;
+    }
+
+    return buf.f_bsize;
+}
+
+/**
+ * output_shm_open:
+ * @name: (in): share memory name of job output.
+ * @huge_pages: (in): open on hugetlbfs or not.
+ *
+ * Open share memory of job output, posix share memory or file in hugetlbfs.
+ *
+ * Returns: file descriptor, -1 on failure.
+ */
+gint output_shm_open (gchar *name, gboolean huge_pages)
+{
+    gchar *path;
+    gint fd;
+
+    if (!huge_pages) {
+        return shm_open (name, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+    }
+
+    path = g_strdup_printf ("%s/%s", HUGE_PAGES_PATH, name);
+    fd = open (path, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+    g_free (path);
+
+    return fd;
+}
+
+gint output_shm_unlink (gchar *name, gboolean huge_pages)
+{
+    gchar *path;
+    gint ret;
+
+    if (!huge_pages) {
+        return shm_unlink (name);
+    }
+
+    path = g_strdup_printf ("%s/%s", HUGE_PAGES_PATH, name);
+    ret = g_unlink (path);
+    g_free (path);
+
+    return ret;
+}
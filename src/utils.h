@@ -11,11 +11,18 @@
 #include <netinet/in.h>
 #include <gst/gst.h>
 
+/* hugetlbfs mount point, job output share memory with huge pages */
+#define HUGE_PAGES_PATH "/dev/hugepages"
+#define HUGETLBFS_MAGIC 0x958458f6
+
 gchar * unicode_file_name_2_shm_name (gchar *filename);
 gchar * get_address (struct sockaddr in_addr);
 gushort get_port (struct sockaddr in_addr);
 gchar *timestamp_to_segment_dir (time_t timestamp);
 gint segment_dir_to_timestamp (gchar *dir, time_t *timestamp);
 gint remove_dir (gchar *dir);
+gsize huge_page_size (void);
+gint output_shm_open (gchar *name, gboolean huge_pages);
+gint output_shm_unlink (gchar *name, gboolean huge_pages);
 
 #endif /* __UTILS_H__ */
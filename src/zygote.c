@@ -0,0 +1,355 @@
+/*
+ *  zygote, gstreamer initialized process which forks job workers
+ *
+ *  Copyright (C) Zhang Ping <dqzhangp@163.com>
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <gst/gst.h>
+
+#include "zygote.h"
+
+GST_DEBUG_CATEGORY_EXTERN (GSTREAMILL);
+#define GST_CAT_DEFAULT GSTREAMILL
+
+/* zygote_fd, zygote_pid and zygote_seqnum are protected by zygote_mutex */
+static GMutex zygote_mutex;
+static guint64 zygote_seqnum = 0;
+static gint zygote_fd = -1; /* control socket, -1 if zygote is not running */
+static GPid zygote_pid = 0;
+static gchar *zygote_exe_path = NULL;
+
+static gint zygote_spawn (void);
+
+/* make control socket inherited by zygote, fds are closed on exec before this. */
+static void zygote_setup (gpointer user_data)
+{
+    fcntl (GPOINTER_TO_INT (user_data), F_SETFD, 0);
+}
+
+static gboolean zygote_respawn (gpointer user_data)
+{
+    gint ret;
+
+    g_mutex_lock (&zygote_mutex);
+    ret = zygote_spawn ();
+    g_mutex_unlock (&zygote_mutex);
+    if (ret != 0) {
+        GST_WARNING ("respawn zygote failure, retry in %ds", ZYGOTE_RESPAWN_INTERVAL);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void zygote_watch_cb (GPid pid, gint status, gpointer user_data)
+{
+    GST_WARNING ("zygote %d exit, status %d, job workers would be exec'ed until it is respawned", pid, status);
+    g_spawn_close_pid (pid);
+    g_mutex_lock (&zygote_mutex);
+    if (zygote_pid == pid) {
+        close (zygote_fd);
+        zygote_fd = -1;
+        zygote_pid = 0;
+    }
+    g_mutex_unlock (&zygote_mutex);
+    /* not too often if zygote keeps dying */
+    g_timeout_add_seconds (ZYGOTE_RESPAWN_INTERVAL, zygote_respawn, NULL);
+}
+
+/*
+ * spawn zygote process, called with zygote_mutex held.
+ */
+static gint zygote_spawn (void)
+{
+    GError *error = NULL;
+    gchar *argv[4];
+    gint fds[2];
+    struct timeval timeout;
+    GPid pid;
+
+    if (socketpair (AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) == -1) {
+        GST_WARNING ("zygote socketpair failure: %s", g_strerror (errno));
+        return 1;
+    }
+    timeout.tv_sec = ZYGOTE_REPLY_TIMEOUT;
+    timeout.tv_usec = 0;
+    if (setsockopt (fds[0], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout)) == -1) {
+        GST_WARNING ("set zygote socket timeout failure: %s", g_strerror (errno));
+    }
+
+    argv[0] = zygote_exe_path;
+    argv[1] = "-z";
+    argv[2] = g_strdup_printf ("%d", fds[1]);
+    argv[3] = NULL;
+    if (!g_spawn_async (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, zygote_setup, GINT_TO_POINTER (fds[1]), &pid, &error)) {
+        GST_WARNING ("spawn zygote failure: %s", error->message);
+        g_error_free (error);
+        g_free (argv[2]);
+        close (fds[0]);
+        close (fds[1]);
+        return 1;
+    }
+    g_free (argv[2]);
+    close (fds[1]);
+    zygote_fd = fds[0];
+    zygote_pid = pid;
+    g_child_watch_add (pid, zygote_watch_cb, NULL);
+    GST_INFO ("zygote %d started", pid);
+
+    return 0;
+}
+
+/**
+ * zygote_start:
+ * @exe_path: (in): gstreamill executable
+ *
+ * Spawn zygote, gstreamill become subreaper of job workers forked by zygote.
+ * zygote is respawned if it dies.
+ *
+ * Returns: 0 on success.
+ */
+gint zygote_start (gchar *exe_path)
+{
+    gint ret;
+
+    if (prctl (PR_SET_CHILD_SUBREAPER, 1) == -1) {
+        GST_WARNING ("set child subreaper failure: %s", g_strerror (errno));
+        return 1;
+    }
+
+    g_mutex_lock (&zygote_mutex);
+    zygote_exe_path = g_strdup (exe_path);
+    ret = zygote_spawn ();
+    g_mutex_unlock (&zygote_mutex);
+
+    return ret;
+}
+
+/**
+ * zygote_get_pid:
+ *
+ * Returns: pid of zygote, 0 if zygote is not running.
+ */
+GPid zygote_get_pid (void)
+{
+    GPid pid;
+
+    g_mutex_lock (&zygote_mutex);
+    pid = zygote_pid;
+    g_mutex_unlock (&zygote_mutex);
+
+    return pid;
+}
+
+/*
+ * reply of a timed out request, the job has failed, its worker must not run beside a new one.
+ * called with zygote_mutex held.
+ */
+static void zygote_late_reply (ZygoteReply *reply)
+{
+    if (reply->pid > 0) {
+        GST_WARNING ("late reply of zygote request %" G_GUINT64_FORMAT ", kill job worker %d", reply->seqnum, reply->pid);
+        kill (reply->pid, SIGKILL);
+    }
+}
+
+/**
+ * zygote_check:
+ *
+ * Called periodically, kill job workers of late replies which are not followed by a new request.
+ */
+void zygote_check (void)
+{
+    ZygoteReply reply;
+
+    if (!g_mutex_trylock (&zygote_mutex)) {
+        return;
+    }
+    while ((zygote_fd != -1) && (recv (zygote_fd, &reply, sizeof (reply), MSG_DONTWAIT) == sizeof (reply))) {
+        zygote_late_reply (&reply);
+    }
+    g_mutex_unlock (&zygote_mutex);
+}
+
+/**
+ * zygote_fork:
+ * @request: (in): job worker parameters
+ * @event_fd: (in): event fd of the job, inherited by the job worker
+ *
+ * Ask zygote for a job worker, the worker is a child of gstreamill as subreaper.
+ *
+ * Returns: pid of the job worker, -1 if no worker is forked, the worker could be exec'ed instead,
+ * 0 if zygote didn't reply in time, the worker may still be forked and is killed when the reply arrives.
+ */
+GPid zygote_fork (ZygoteRequest *request, gint event_fd)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    gchar control[CMSG_SPACE (sizeof (gint))];
+    ZygoteReply reply;
+    gssize ret;
+
+    memset (&msg, 0, sizeof (msg));
+    iov.iov_base = request;
+    iov.iov_len = sizeof (ZygoteRequest);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof (control);
+    cmsg = CMSG_FIRSTHDR (&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN (sizeof (gint));
+    memcpy (CMSG_DATA (cmsg), &event_fd, sizeof (gint));
+
+    g_mutex_lock (&zygote_mutex);
+    if (zygote_fd == -1) {
+        g_mutex_unlock (&zygote_mutex);
+        return -1;
+    }
+    request->seqnum = ++zygote_seqnum;
+    ret = sendmsg (zygote_fd, &msg, MSG_NOSIGNAL);
+    if (ret != sizeof (ZygoteRequest)) {
+        GST_WARNING ("send request to zygote failure: %s", g_strerror (errno));
+        g_mutex_unlock (&zygote_mutex);
+        return -1;
+    }
+
+    /* reply of a timed out request may arrive late, kill its worker */
+    for (;;) {
+        ret = recv (zygote_fd, &reply, sizeof (reply), 0);
+        if ((ret == -1) && (errno == EINTR)) {
+            continue;
+        }
+        if ((ret == -1) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            GST_ERROR ("zygote didn't reply request %" G_GUINT64_FORMAT " in %ds", request->seqnum, ZYGOTE_REPLY_TIMEOUT);
+            g_mutex_unlock (&zygote_mutex);
+            return 0;
+        }
+        if (ret != sizeof (reply)) {
+            /* zygote died, a worker might be forked, but never reported, don't exec another */
+            GST_ERROR ("receive reply from zygote failure: %s", ret == -1 ? g_strerror (errno) : "closed");
+            g_mutex_unlock (&zygote_mutex);
+            return 0;
+        }
+        if (reply.seqnum == request->seqnum) {
+            break;
+        }
+        zygote_late_reply (&reply);
+    }
+    g_mutex_unlock (&zygote_mutex);
+
+    return reply.pid;
+}
+
+static GPid zygote_fork_worker (void)
+{
+    GPid pid, worker;
+    gint pipefd[2];
+
+    if (pipe (pipefd) == -1) {
+        return -1;
+    }
+
+    pid = fork ();
+    if (pid == 0) {
+        /* intermediate process, exit at once to orphan the worker to gstreamill */
+        close (pipefd[0]);
+        worker = fork ();
+        if (worker == 0) {
+            close (pipefd[1]);
+            return 0;
+        }
+        if (write (pipefd[1], &worker, sizeof (worker)) != sizeof (worker)) {
+            _exit (1);
+        }
+        _exit (0);
+    }
+
+    close (pipefd[1]);
+    worker = -1;
+    if (pid != -1) {
+        if (read (pipefd[0], &worker, sizeof (worker)) != sizeof (worker)) {
+            worker = -1;
+        }
+        waitpid (pid, NULL, 0);
+    }
+    close (pipefd[0]);
+
+    return worker;
+}
+
+/**
+ * zygote_run:
+ * @fd: (in): control socket
+ * @request: (out): parameters of the forked job worker
+ *
+ * Loop of zygote process, wait for request and fork job worker.
+ * zygote is single threaded after gst_init, fork is safe.
+ * Exit when gstreamill closes control socket or dies.
+ *
+ * Returns: in forked job worker only, event fd of the job.
+ */
+gint zygote_run (gint fd, ZygoteRequest *request)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    gchar control[CMSG_SPACE (sizeof (gint))];
+    ZygoteReply reply;
+    gint event_fd;
+    gssize ret;
+
+    prctl (PR_SET_PDEATHSIG, SIGKILL);
+    for (;;) {
+        memset (&msg, 0, sizeof (msg));
+        iov.iov_base = request;
+        iov.iov_len = sizeof (ZygoteRequest);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof (control);
+        ret = recvmsg (fd, &msg, 0);
+        if ((ret == -1) && (errno == EINTR)) {
+            continue;
+        }
+        if (ret <= 0) {
+            /* gstreamill gone */
+            _exit (0);
+        }
+
+        event_fd = -1;
+        cmsg = CMSG_FIRSTHDR (&msg);
+        if ((cmsg != NULL) && (cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_RIGHTS)) {
+            memcpy (&event_fd, CMSG_DATA (cmsg), sizeof (gint));
+        }
+
+        reply.seqnum = request->seqnum;
+        reply.pid = -1;
+        if ((ret == sizeof (ZygoteRequest)) && (event_fd != -1)) {
+            reply.pid = zygote_fork_worker ();
+            if (reply.pid == 0) {
+                /* job worker, parent death signal is cleared by fork */
+                close (fd);
+                return event_fd;
+            }
+        }
+        if (event_fd != -1) {
+            close (event_fd);
+        }
+        if (send (fd, &reply, sizeof (reply), MSG_NOSIGNAL) == -1) {
+            _exit (0);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+/*
+ *  zygote, gstreamer initialized process which forks job workers
+ *
+ *  Copyright (C) Zhang Ping <dqzhangp@163.com>
+ */
+
+#ifndef __ZYGOTE_H__
+#define __ZYGOTE_H__
+
+#include <gst/gst.h>
+
+#define ZYGOTE_SHM_NAME_LEN 1024
+#define ZYGOTE_LOG_DIR_LEN 1024
+#define ZYGOTE_GST_DEBUG_LEN 1024
+#define ZYGOTE_REPLY_TIMEOUT 5 /* seconds */
+#define ZYGOTE_RESPAWN_INTERVAL 1 /* seconds */
+
+/*
+ * ZygoteRequest:
+ * what an exec'ed job worker get from command line,
+ * event fd of the job is passed along with the request as SCM_RIGHTS.
+ */
+typedef struct _ZygoteRequest {
+    guint64 seqnum;
+    gchar shm_name[ZYGOTE_SHM_NAME_LEN];
+    gint job_length;
+    guint64 shm_length;
+    gboolean huge_pages;
+    gchar log_dir[ZYGOTE_LOG_DIR_LEN];
+    gchar gst_debug[ZYGOTE_GST_DEBUG_LEN]; /* empty if no debug */
+} ZygoteRequest;
+
+typedef struct _ZygoteReply {
+    guint64 seqnum;
+    GPid pid; /* pid of job worker, -1 on failure */
+} ZygoteReply;
+
+gint zygote_start (gchar *exe_path);
+GPid zygote_fork (ZygoteRequest *request, gint event_fd);
+GPid zygote_get_pid (void);
+void zygote_check (void);
+gint zygote_run (gint fd, ZygoteRequest *request);
+
+#endif /* __ZYGOTE_H__ */
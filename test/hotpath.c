@@ -0,0 +1,549 @@
+/*
+ * hotpath, property tests and micro benchmarks of ring, playlist and parser hot functions.
+ *
+ * property tests drive the functions with randomized sizes and wrap points and check them
+ * against a model, micro benchmarks time every operation, the fastest of several rounds
+ * counts, and compare it with a baseline saved from a known good build.
+ *
+ * usage: hotpath [-s seed] [-r rounds] [-b baseline] [-w baseline] [-t tolerance] [-n]
+ *
+ * Copyright (C) Zhang Ping <dqzhangp@163.com>
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+
+#include "hotpath.h"
+#include "m3u8playlist.h"
+#include "tssegment.h"
+#include "utils.h"
+
+#define HOTPATH_BENCH_ROUNDS 7
+#define TS_PACKET_SIZE 188
+
+GST_DEBUG_CATEGORY (ACCESS);
+GST_DEBUG_CATEGORY (GSTREAMILL);
+
+static gint64 seed = 0;
+static gint rounds = 200;
+static gchar *baseline = NULL;
+static gchar *save = NULL;
+static gdouble tolerance = 0.25;
+static gboolean no_bench = FALSE;
+static GOptionEntry options[] = {
+    {"seed", 's', 0, G_OPTION_ARG_INT64, &seed, ("-s random seed, default is time, printed to reproduce a failure."), NULL},
+    {"rounds", 'r', 0, G_OPTION_ARG_INT, &rounds, ("-r rounds of every property test, default is 200."), NULL},
+    {"baseline", 'b', 0, G_OPTION_ARG_FILENAME, &baseline, ("-b baseline file, fail if an operation is slower, default is $HOTPATH_BASELINE."), NULL},
+    {"write", 'w', 0, G_OPTION_ARG_FILENAME, &save, ("-w write results as baseline file."), NULL},
+    {"tolerance", 't', 0, G_OPTION_ARG_DOUBLE, &tolerance, ("-t fraction an operation may be slower than baseline, default is 0.25."), NULL},
+    {"nobench", 'n', 0, G_OPTION_ARG_NONE, &no_bench, ("-n property tests only."), NULL},
+    {NULL}
+};
+
+static GRand *grand;
+static gchar *segment_dir; /* of playlist entries, yyyymmddhh of now */
+static gint failures = 0;
+static GHashTable *results; /* name to ns per operation */
+
+void hotpath_fail (const gchar *file, gint line, const gchar *expr, const gchar *format, ...)
+{
+    va_list args;
+    gchar *message;
+
+    va_start (args, format);
+    message = g_strdup_vprintf (format, args);
+    va_end (args);
+    /* a broken invariant breaks a lot of others, report the first ones */
+    if (failures < 20) {
+        g_printerr ("%s:%d: %s failed: %s\n", file, line, expr, message);
+    }
+    g_free (message);
+    failures++;
+}
+
+GRand * hotpath_rand (void)
+{
+    return grand;
+}
+
+gint hotpath_rounds (void)
+{
+    return rounds;
+}
+
+static gint64 now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * G_GINT64_CONSTANT (1000000000) + ts.tv_nsec;
+}
+
+/**
+ * hotpath_bench:
+ * @bench: (in): operation to time.
+ *
+ * a warm up round, then the fastest of HOTPATH_BENCH_ROUNDS rounds, which is the least disturbed
+ * by other processes and interrupts.
+ */
+void hotpath_bench (HotpathBench *bench)
+{
+    gint64 start, elapsed, fastest;
+    gdouble ns, *result;
+    gint i;
+
+    bench->run (bench->data, bench->count);
+    fastest = G_MAXINT64;
+    for (i = 0; i < HOTPATH_BENCH_ROUNDS; i++) {
+        start = now_ns ();
+        bench->run (bench->data, bench->count);
+        elapsed = now_ns () - start;
+        if (elapsed < fastest) {
+            fastest = elapsed;
+        }
+    }
+    ns = (gdouble)fastest / bench->count;
+    if (bench->bytes != 0) {
+        g_print ("%-28s %12.1f ns/op %10.1f MB/s\n", bench->name, ns, bench->bytes * 1000.0 / ns);
+
+    } else {
+        g_print ("%-28s %12.1f ns/op\n", bench->name, ns);
+    }
+    result = g_new (gdouble, 1);
+    *result = ns;
+    g_hash_table_insert (results, g_strdup (bench->name), result);
+}
+
+/**
+ * hotpath_encoder_output_new:
+ * @cache_size: (in): size of cache.
+ *
+ * encoder output in private memory, fields of job output share memory the ring functions use.
+ *
+ * Returns: encoder output, head, tail and last rap at 0, cache uninitialized.
+ */
+EncoderOutput * hotpath_encoder_output_new (guint64 cache_size)
+{
+    EncoderOutput *encoder_output;
+    gpointer stats;
+
+    encoder_output = g_new0 (EncoderOutput, 1);
+    g_strlcpy (encoder_output->name, "hotpath", STREAM_NAME_LEN);
+    encoder_output->cache_size = cache_size;
+    encoder_output->cache_addr = g_malloc (cache_size);
+    encoder_output->head_addr = g_new0 (guint64, 1);
+    encoder_output->tail_addr = g_new0 (guint64, 1);
+    encoder_output->last_rap_addr = g_new0 (guint64, 1);
+    encoder_output->total_count = g_new0 (guint64, 1);
+    encoder_output->heartbeat = g_new0 (GstClockTime, 1);
+    encoder_output->eos = g_new0 (gboolean, 1);
+    if (posix_memalign (&stats, CACHE_LINE_SIZE, sizeof (EncoderOutputStats)) != 0) {
+        g_error ("allocate encoder output stats failure");
+    }
+    memset (stats, 0, sizeof (EncoderOutputStats));
+    encoder_output->stats = stats;
+
+    return encoder_output;
+}
+
+void hotpath_encoder_output_free (EncoderOutput *encoder_output)
+{
+    g_free (encoder_output->cache_addr);
+    g_free (encoder_output->head_addr);
+    g_free (encoder_output->tail_addr);
+    g_free (encoder_output->last_rap_addr);
+    g_free (encoder_output->total_count);
+    g_free (encoder_output->heartbeat);
+    g_free (encoder_output->eos);
+    free (encoder_output->stats);
+    g_free (encoder_output);
+}
+
+/* entry of playlist model */
+typedef struct _PlaylistEntry {
+    guint64 sequence;
+    GstClockTime duration;
+    gboolean discontinuity;
+} PlaylistEntry;
+
+/* rendered playlist against model, offset of media sequence to uri sequence must not change */
+static void playlist_verify (M3U8Playlist *playlist, GQueue *model, guint64 discontinuity_sequence, gint64 *offset)
+{
+    gchar *p, **lines;
+    gint i, n, target, target_duration;
+    guint64 media_sequence, sequence, value, playlist_discontinuity_sequence;
+    gboolean media_sequence_found, discontinuity, endlist;
+    gdouble duration;
+    PlaylistEntry *entry;
+
+    p = m3u8playlist_live_get_playlist (playlist);
+    hotpath_check (p != NULL, "no playlist");
+    if (p == NULL) {
+        return;
+    }
+    hotpath_check (g_str_has_prefix (p, M3U8_HEADER_TAG), "%s", p);
+    lines = g_strsplit (p, "\n", 0);
+    n = 0;
+    target = 0;
+    media_sequence = 0;
+    media_sequence_found = FALSE;
+    discontinuity = FALSE;
+    endlist = FALSE;
+    target_duration = -1;
+    playlist_discontinuity_sequence = 0;
+    for (i = 0; lines[i] != NULL; i++) {
+        if (sscanf (lines[i], "#EXT-X-MEDIA-SEQUENCE:%lu", &value) == 1) {
+            media_sequence = value;
+            media_sequence_found = TRUE;
+
+        } else if (sscanf (lines[i], "#EXT-X-DISCONTINUITY-SEQUENCE:%lu", &value) == 1) {
+            playlist_discontinuity_sequence = value;
+
+        } else if (g_str_has_prefix (lines[i], "#EXT-X-TARGETDURATION:")) {
+            sscanf (lines[i], "#EXT-X-TARGETDURATION:%d", &target_duration);
+
+        } else if (g_strcmp0 (lines[i], "#EXT-X-DISCONTINUITY") == 0) {
+            discontinuity = TRUE;
+
+        } else if (g_strcmp0 (lines[i], "#EXT-X-ENDLIST") == 0) {
+            endlist = TRUE;
+
+        } else if (sscanf (lines[i], "#EXTINF:%lf,", &duration) == 1) {
+            entry = g_queue_peek_nth (model, n);
+            hotpath_check (entry != NULL, "entry %d not in model", n);
+            if (entry == NULL) {
+                break;
+            }
+            hotpath_check (ABS (duration - (gdouble)entry->duration / GST_SECOND) < 0.01,
+                    "duration %.2f, expect %.3f", duration, (gdouble)entry->duration / GST_SECOND);
+            hotpath_check (discontinuity == entry->discontinuity, "entry %d discontinuity %d", n, discontinuity);
+            discontinuity = FALSE;
+            target = MAX (target, (entry->duration + 500 * GST_MSECOND) / GST_SECOND);
+            sequence = G_MAXUINT64;
+            hotpath_check ((lines[i + 1] != NULL) && g_str_has_prefix (lines[i + 1], segment_dir) &&
+                    (sscanf (lines[i + 1] + strlen (segment_dir), "/%lu.ts", &sequence) == 1),
+                    "uri of entry %d", n);
+            hotpath_check (sequence == entry->sequence, "entry %d sequence %lu, expect %lu", n, sequence, entry->sequence);
+            if (media_sequence_found) {
+                if (*offset == G_MININT64) {
+                    *offset = (gint64)(sequence - n) - (gint64)media_sequence;
+                }
+                hotpath_check ((gint64)(sequence - n) - (gint64)media_sequence == *offset, "media sequence %lu moved", media_sequence);
+            }
+            n++;
+            i++;
+        }
+    }
+    hotpath_check (n == g_queue_get_length (model), "%d entries, expect %u", n, g_queue_get_length (model));
+    hotpath_check (playlist_discontinuity_sequence == discontinuity_sequence, "discontinuity sequence %lu, expect %lu",
+            playlist_discontinuity_sequence, discontinuity_sequence);
+    hotpath_check (target_duration == target, "target duration %d, expect %d", target_duration, target);
+    hotpath_check (media_sequence_found == (playlist->window_size != 0), "media sequence of window %d", playlist->window_size);
+    hotpath_check (endlist == (playlist->window_size == 0), "endlist of window %d", playlist->window_size);
+    g_strfreev (lines);
+    g_free (p);
+}
+
+/* random windows, durations and discontinuities */
+static void playlist_test (void)
+{
+    M3U8Playlist *playlist;
+    GQueue *model;
+    PlaylistEntry *entry;
+    guint64 sequence, discontinuity_sequence;
+    gboolean discontinuity;
+    gint64 offset;
+    gchar *url;
+    gint round, i, count, window;
+
+    for (round = 0; round < rounds; round++) {
+        window = g_rand_int_range (grand, 0, 13);
+        sequence = g_rand_int_range (grand, 0, 1000000);
+        playlist = m3u8playlist_new (3, window, sequence);
+        model = g_queue_new ();
+        discontinuity = FALSE;
+        discontinuity_sequence = 0;
+        offset = G_MININT64;
+        count = g_rand_int_range (grand, 1, 40);
+        for (i = 0; i < count; i++) {
+            if (g_rand_int_range (grand, 0, 8) == 0) {
+                m3u8playlist_add_discontinuity (playlist);
+                discontinuity = discontinuity || !g_queue_is_empty (model);
+            }
+            while ((window != 0) && (g_queue_get_length (model) >= window)) {
+                entry = g_queue_pop_head (model);
+                discontinuity_sequence += entry->discontinuity ? 1 : 0;
+                g_free (entry);
+            }
+            entry = g_new0 (PlaylistEntry, 1);
+            entry->sequence = sequence++;
+            /* durations of segments are multiple of frame duration, 40ms */
+            entry->duration = g_rand_int_range (grand, 25, 250) * 40 * GST_MSECOND;
+            entry->discontinuity = discontinuity;
+            discontinuity = FALSE;
+            g_queue_push_tail (model, entry);
+            url = g_strdup_printf ("%s/%lu.ts", segment_dir, entry->sequence);
+            m3u8playlist_add_entry (playlist, url, entry->duration);
+            g_free (url);
+            playlist_verify (playlist, model, discontinuity_sequence, &offset);
+        }
+        g_queue_free_full (model, g_free);
+        m3u8playlist_free (playlist);
+    }
+}
+
+static void playlist_bench_run (gpointer data, guint count)
+{
+    M3U8Playlist *playlist = data;
+    gchar url[64];
+    guint i;
+
+    for (i = 0; i < count; i++) {
+        g_snprintf (url, sizeof (url), "%s/%lu.ts", segment_dir, playlist->sequence_number + 1);
+        m3u8playlist_add_entry (playlist, url, 3 * GST_SECOND);
+    }
+}
+
+static void playlist_bench (void)
+{
+    HotpathBench bench = {"m3u8playlist_add_entry", playlist_bench_run, NULL, 10000, 0};
+
+    bench.data = m3u8playlist_new (3, 10, 0);
+    hotpath_bench (&bench);
+    m3u8playlist_free (bench.data);
+}
+
+/* frame out of tssegment */
+typedef struct _SegmentFrame {
+    gsize size;
+    GstClockTime pts;
+    gboolean delta;
+    guint32 hash;
+} SegmentFrame;
+
+static void segment_output (GstBuffer *buffer, gpointer user_data)
+{
+    GArray *frames = user_data;
+    SegmentFrame frame;
+    GstMapInfo info;
+    gsize i;
+
+    gst_buffer_map (buffer, &info, GST_MAP_READ);
+    frame.size = info.size;
+    frame.pts = GST_BUFFER_PTS (buffer);
+    frame.delta = GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+    frame.hash = 2166136261u;
+    for (i = 0; i < info.size; i++) {
+        frame.hash = (frame.hash ^ info.data[i]) * 16777619u;
+    }
+    hotpath_check (info.size % TS_PACKET_SIZE == 0, "frame size %lu", info.size);
+    for (i = 0; i < info.size; i += TS_PACKET_SIZE) {
+        hotpath_check (info.data[i] == 0x47, "sync byte of packet at %lu", i);
+    }
+    gst_buffer_unmap (buffer, &info);
+    gst_buffer_unref (buffer);
+    g_array_append_val (frames, frame);
+}
+
+/* push stream into a new tssegment in chunks, chunk size is random if chunk is 0 */
+static GArray * segment_run (GByteArray *stream, gsize chunk)
+{
+    TsSegment *tssegment;
+    GArray *frames;
+    gsize position, size;
+
+    frames = g_array_new (FALSE, FALSE, sizeof (SegmentFrame));
+    tssegment = TS_SEGMENT (g_object_new (TYPE_TS_SEGMENT, NULL));
+    ts_segment_set_output (tssegment, segment_output, frames);
+    for (position = 0; position < stream->len; position += size) {
+        size = chunk != 0 ? chunk : g_rand_int_range (grand, 1, 4 * 1316);
+        size = MIN (size, stream->len - position);
+        ts_segment_push (tssegment, gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY, stream->data + position, size, 0, size, NULL, NULL));
+    }
+    g_object_unref (tssegment);
+
+    return frames;
+}
+
+/* h.264 transport stream of test source, NULL if encoder or muxer not installed */
+static GByteArray * segment_stream (void)
+{
+    GstElement *pipeline, *sink;
+    GstSample *sample;
+    GstBuffer *buffer;
+    GstMapInfo info;
+    GByteArray *stream;
+    GError *err = NULL;
+
+    pipeline = gst_parse_launch ("videotestsrc num-buffers=250 pattern=18 ! video/x-raw,width=320,height=240,framerate=25/1 ! "
+            "x264enc key-int-max=25 byte-stream=true ! mpegtsmux ! appsink name=sink sync=false", &err);
+    if (pipeline == NULL) {
+        g_print ("tssegment skipped: %s\n", err->message);
+        g_error_free (err);
+        return NULL;
+    }
+    stream = g_byte_array_new ();
+    sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+    gst_element_set_state (pipeline, GST_STATE_PLAYING);
+    while ((sample = gst_app_sink_pull_sample (GST_APP_SINK (sink))) != NULL) {
+        buffer = gst_sample_get_buffer (sample);
+        gst_buffer_map (buffer, &info, GST_MAP_READ);
+        g_byte_array_append (stream, info.data, info.size);
+        gst_buffer_unmap (buffer, &info);
+        gst_sample_unref (sample);
+    }
+    gst_element_set_state (pipeline, GST_STATE_NULL);
+    gst_object_unref (sink);
+    gst_object_unref (pipeline);
+
+    return stream;
+}
+
+/* frames must not depend on how the stream is split into buffers */
+static void segment_test (GByteArray *stream)
+{
+    GArray *reference, *frames;
+    SegmentFrame *a, *b;
+    gint round;
+    guint i;
+
+    reference = segment_run (stream, TS_PACKET_SIZE);
+    hotpath_check (reference->len > 200, "%u frames of 250", reference->len);
+    for (round = 0; round < MAX (rounds / 10, 1); round++) {
+        frames = segment_run (stream, 0);
+        hotpath_check (frames->len == reference->len, "%u frames, expect %u", frames->len, reference->len);
+        for (i = 0; i < MIN (frames->len, reference->len); i++) {
+            a = &g_array_index (frames, SegmentFrame, i);
+            b = &g_array_index (reference, SegmentFrame, i);
+            hotpath_check ((a->size == b->size) && (a->pts == b->pts) && (a->delta == b->delta) && (a->hash == b->hash),
+                    "frame %u differs from reference", i);
+        }
+        g_array_free (frames, TRUE);
+    }
+    g_array_free (reference, TRUE);
+}
+
+static void segment_bench_run (gpointer data, guint count)
+{
+    g_array_free (segment_run (data, 1316), TRUE);
+}
+
+static void segment_bench (GByteArray *stream)
+{
+    HotpathBench bench = {"ts_segment_chain_1316", segment_bench_run, NULL, 0, 1316};
+
+    bench.data = stream;
+    bench.count = stream->len / 1316;
+    hotpath_bench (&bench);
+}
+
+/* baseline file, a line of name and ns per operation */
+static void compare_baseline (gchar *path)
+{
+    gchar *contents, **lines, name[64];
+    gdouble expect, *ns;
+    gint i;
+
+    if (!g_file_get_contents (path, &contents, NULL, NULL)) {
+        g_printerr ("read baseline %s failure\n", path);
+        failures++;
+        return;
+    }
+    lines = g_strsplit (contents, "\n", 0);
+    for (i = 0; lines[i] != NULL; i++) {
+        if (sscanf (lines[i], "%63s %lf", name, &expect) != 2) {
+            continue;
+        }
+        ns = g_hash_table_lookup (results, name);
+        if ((ns != NULL) && (*ns > expect * (1 + tolerance))) {
+            g_printerr ("regression: %s %.1f ns/op, baseline %.1f ns/op\n", name, *ns, expect);
+            failures++;
+        }
+    }
+    g_strfreev (lines);
+    g_free (contents);
+}
+
+static void write_baseline (gchar *path)
+{
+    GHashTableIter iter;
+    gpointer name, ns;
+    GString *contents;
+
+    contents = g_string_new ("");
+    g_hash_table_iter_init (&iter, results);
+    while (g_hash_table_iter_next (&iter, &name, &ns)) {
+        g_string_append_printf (contents, "%s %.1f\n", (gchar *)name, *(gdouble *)ns);
+    }
+    if (!g_file_set_contents (path, contents->str, contents->len, NULL)) {
+        g_printerr ("write baseline %s failure\n", path);
+        failures++;
+    }
+    g_string_free (contents, TRUE);
+}
+
+int main (int argc, char *argv[])
+{
+    GOptionContext *ctx;
+    GError *err = NULL;
+    GByteArray *stream;
+
+    ctx = g_option_context_new (NULL);
+    g_option_context_add_main_entries (ctx, options, NULL);
+    g_option_context_add_group (ctx, gst_init_get_option_group ());
+    if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+        g_print ("Error initializing: %s\n", err->message);
+        exit (1);
+    }
+    g_option_context_free (ctx);
+    GST_DEBUG_CATEGORY_INIT (ACCESS, "access", 0, "gstreamill access");
+    GST_DEBUG_CATEGORY_INIT (GSTREAMILL, "gstreamill", 0, "gstreamill log");
+    if (baseline == NULL) {
+        baseline = (gchar *)g_getenv ("HOTPATH_BASELINE");
+    }
+    if (seed == 0) {
+        seed = g_get_real_time ();
+    }
+    g_print ("seed %ld, %d rounds\n", seed, rounds);
+    grand = g_rand_new_with_seed (seed);
+    segment_dir = timestamp_to_segment_dir (time (NULL));
+    results = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+    ring_test ();
+    playlist_test ();
+    parser_test ();
+    stream = segment_stream ();
+    if (stream != NULL) {
+        segment_test (stream);
+    }
+    g_print ("property tests: %d failures\n", failures);
+
+    if (!no_bench && (failures == 0)) {
+        ring_bench ();
+        playlist_bench ();
+        parser_bench ();
+        if (stream != NULL) {
+            segment_bench (stream);
+        }
+        if (baseline != NULL) {
+            compare_baseline (baseline);
+        }
+        if (save != NULL) {
+            write_baseline (save);
+        }
+    }
+    if (stream != NULL) {
+        g_byte_array_free (stream, TRUE);
+    }
+    g_hash_table_destroy (results);
+    g_rand_free (grand);
+    g_free (segment_dir);
+
+    return failures == 0 ? 0 : 1;
+}
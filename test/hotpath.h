@@ -0,0 +1,49 @@
+/*
+ * hotpath, property tests and micro benchmarks of ring, playlist and parser hot functions.
+ *
+ * Copyright (C) Zhang Ping <dqzhangp@163.com>
+ *
+ */
+
+#ifndef __HOTPATH_H__
+#define __HOTPATH_H__
+
+#include <glib.h>
+
+#include "source.h"
+#include "encoder.h"
+
+/*
+ * HotpathBench:
+ * an operation timed by hotpath_bench, run count times per round, the fastest round counts.
+ */
+typedef struct _HotpathBench {
+    const gchar *name;
+    void (*run) (gpointer data, guint count);
+    gpointer data;
+    guint count; /* operations per round */
+    gsize bytes; /* bytes per operation, 0 if not a throughput */
+} HotpathBench;
+
+/* failed property, print and count it, test goes on */
+#define hotpath_check(expr, ...) G_STMT_START { \
+    if (G_UNLIKELY (!(expr))) { \
+        hotpath_fail (__FILE__, __LINE__, #expr, __VA_ARGS__); \
+    } \
+} G_STMT_END
+
+void hotpath_fail (const gchar *file, gint line, const gchar *expr, const gchar *format, ...) G_GNUC_PRINTF (4, 5);
+void hotpath_bench (HotpathBench *bench);
+GRand * hotpath_rand (void);
+gint hotpath_rounds (void);
+
+/* in memory encoder output, cache is not in share memory */
+EncoderOutput * hotpath_encoder_output_new (guint64 cache_size);
+void hotpath_encoder_output_free (EncoderOutput *encoder_output);
+
+void ring_test (void);
+void ring_bench (void);
+void parser_test (void);
+void parser_bench (void);
+
+#endif /* __HOTPATH_H__ */
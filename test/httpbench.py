@@ -0,0 +1,47 @@
+#
+# http request parsing throughput.
+#
+# concurrent clients send large requests, optionally in fragments, to a cheap
+# management api and count responses per second. run it against a gstreamill
+# built before and after a parser change to compare.
+#
+# usage: python test/httpbench.py [host] [port] [clients] [seconds] [fragments]
+#
+
+import sys
+import time
+import socket
+import threading
+
+headers = "".join(["X-Bench-%d: %s\r\n" % (i, "v" * 64) for i in range(32)])
+request = "GET /stat/gstreamill/version HTTP/1.1\r\nHost: bench\r\nUser-Agent: httpbench\r\n%s\r\n" % headers
+
+def client(host, port, seconds, fragments, result):
+    count = 0
+    size = (len(request) + fragments - 1) / fragments
+    deadline = time.time() + seconds
+    while time.time() < deadline:
+        s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        s.connect((host, port))
+        s.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        for pos in range(0, len(request), size):
+            s.sendall(request[pos:pos + size])
+        while s.recv(65536):
+            pass
+        s.close()
+        count += 1
+    result.append(count)
+
+host = sys.argv[1] if len(sys.argv) > 1 else "localhost"
+port = int(sys.argv[2]) if len(sys.argv) > 2 else 20118
+clients = int(sys.argv[3]) if len(sys.argv) > 3 else 8
+seconds = int(sys.argv[4]) if len(sys.argv) > 4 else 10
+fragments = int(sys.argv[5]) if len(sys.argv) > 5 else 1
+
+result = []
+threads = [threading.Thread(target=client, args=(host, port, seconds, fragments, result)) for i in range(clients)]
+for t in threads:
+    t.start()
+for t in threads:
+    t.join()
+print "request size %d, %d fragments, %d clients: %d requests, %.1f requests/s" % (len(request), fragments, clients, sum(result), sum(result) / float(seconds))
@@ -0,0 +1,86 @@
+#
+# feed http request parser with corpus and mutations of corpus.
+#
+# every request is sent in random fragments so that the incremental parser
+# resume in the middle of request line, headers and body. gstreamill should
+# keep answering /stat/gstreamill after each round.
+#
+# usage: python test/httpfuzz.py [host] [port] [rounds]
+#
+
+import os
+import sys
+import time
+import random
+import socket
+
+def corpus(path):
+    requests = []
+    for name in sorted(os.listdir(path)):
+        if name.endswith(".req"):
+            requests.append(open(os.path.join(path, name), "rb").read())
+    return requests
+
+def mutate(request):
+    data = bytearray(request)
+    for i in range(random.randint(1, 8)):
+        op = random.randint(0, 3)
+        pos = random.randint(0, len(data))
+        if op == 0:
+            data[pos:pos] = random.choice(["\r", "\n", "\r\n", "\r\n\r\n", " ", ":", "?", "%", "\0"])
+        elif op == 1 and pos < len(data):
+            data[pos] = random.randint(0, 255)
+        elif op == 2:
+            del data[pos:pos + random.randint(1, 16)]
+        else:
+            data[pos:pos] = data[pos:pos + random.randint(1, 64)] * random.randint(1, 32)
+    return str(data)
+
+def send(host, port, request):
+    s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    s.settimeout(1)
+    s.connect((host, port))
+    s.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    try:
+        pos = 0
+        while pos < len(request):
+            size = random.randint(1, 64)
+            s.sendall(request[pos:pos + size])
+            pos += size
+            if random.randint(0, 3) == 0:
+                time.sleep(0.001)
+        while s.recv(65536):
+            pass
+    except socket.error:
+        pass
+    s.close()
+
+def alive(host, port):
+    s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    s.settimeout(5)
+    s.connect((host, port))
+    s.sendall("GET /stat/gstreamill HTTP/1.1\r\n\r\n")
+    response = s.recv(65536)
+    s.close()
+    return response.startswith("HTTP/1.1 200")
+
+host = sys.argv[1] if len(sys.argv) > 1 else "localhost"
+port = int(sys.argv[2]) if len(sys.argv) > 2 else 20118
+rounds = int(sys.argv[3]) if len(sys.argv) > 3 else 1000
+requests = corpus(os.path.join(os.path.dirname(os.path.abspath(__file__)), "httpcorpus"))
+
+for request in requests:
+    send(host, port, request)
+if not alive(host, port):
+    print "server not alive after corpus"
+    sys.exit(1)
+
+for i in range(rounds):
+    request = mutate(random.choice(requests))
+    send(host, port, request)
+    if not alive(host, port):
+        print "server not alive after request %s" % repr(request)
+        sys.exit(1)
+    if i % 100 == 0:
+        print "round %d" % i
+print "%d corpus requests and %d mutations ok" % (len(requests), rounds)
@@ -0,0 +1,338 @@
+/*
+ * http request parser property tests and micro benchmarks of httpserver_parse_request.
+ *
+ * random requests are fed in random fragments as read_request appends them, parse result must
+ * not depend on where reads split the request.
+ *
+ * Copyright (C) Zhang Ping <dqzhangp@163.com>
+ *
+ */
+
+#include <string.h>
+
+#include "httpserver.h"
+#include "hotpath.h"
+
+#define PARSER_MAX_HEADERS 20
+
+/* request as generated, and as httpserver_parse_request should see it */
+typedef struct _ParserRequest {
+    GString *raw;
+    enum request_method method;
+    enum http_version version;
+    GString *uri; /* decoded */
+    GString *parameters; /* decoded */
+    gint num_headers;
+    gchar *names[PARSER_MAX_HEADERS];
+    gchar *values[PARSER_MAX_HEADERS];
+    gint content_length;
+    gint header_size;
+} ParserRequest;
+
+static const gchar *parser_names[] = {"Host", "User-Agent", "Accept", "Range", "Cookie", "X-Forwarded-For", "Icy-MetaData"};
+static const gchar parser_chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_./=&~";
+
+static void parser_spaces (GString *raw, gint min, gint max)
+{
+    gint i, n;
+
+    n = g_rand_int_range (hotpath_rand (), min, max + 1);
+    for (i = 0; i < n; i++) {
+        g_string_append_c (raw, ' ');
+    }
+}
+
+/* url encoded text of random length, raw and decoded, no %00 as it ends the decoded string */
+static void parser_url (GString *raw, GString *decoded, gint max)
+{
+    GRand *rand = hotpath_rand ();
+    gint i, n;
+    guint8 c;
+
+    n = g_rand_int_range (rand, 0, max + 1);
+    for (i = 0; i < n; i++) {
+        switch (g_rand_int_range (rand, 0, 8)) {
+            case 0:
+                c = g_rand_int_range (rand, 1, 256);
+                g_string_append_printf (raw, g_rand_boolean (rand) ? "%%%02X" : "%%%02x", c);
+                g_string_append_c (decoded, c);
+                break;
+            case 1:
+                /* bad escape, kept as is */
+                g_string_append (raw, "%g");
+                g_string_append (decoded, "%g");
+                break;
+            default:
+                c = parser_chars[g_rand_int_range (rand, 0, sizeof (parser_chars) - 1)];
+                g_string_append_c (raw, c);
+                g_string_append_c (decoded, c);
+                break;
+        }
+    }
+}
+
+static gchar * parser_random_case (const gchar *s)
+{
+    gchar *p, *q;
+
+    p = g_strdup (s);
+    for (q = p; *q != '\0'; q++) {
+        *q = g_rand_boolean (hotpath_rand ()) ? g_ascii_toupper (*q) : g_ascii_tolower (*q);
+    }
+
+    return p;
+}
+
+static ParserRequest * parser_request_new (void)
+{
+    GRand *rand = hotpath_rand ();
+    ParserRequest *request;
+    gchar *name, *value;
+    gint i, n, body;
+
+    request = g_new0 (ParserRequest, 1);
+    request->raw = g_string_new ("");
+    request->uri = g_string_new ("");
+    request->parameters = g_string_new ("");
+
+    request->method = g_rand_boolean (rand) ? HTTP_GET : HTTP_POST;
+    g_string_append (request->raw, request->method == HTTP_GET ? "GET" : "POST");
+    parser_spaces (request->raw, 1, 3);
+    g_string_append_c (request->raw, '/');
+    g_string_append_c (request->uri, '/');
+    parser_url (request->raw, request->uri, 64);
+    if (g_rand_boolean (rand)) {
+        g_string_append_c (request->raw, '?');
+        parser_url (request->raw, request->parameters, 64);
+    }
+    parser_spaces (request->raw, 1, 3);
+    request->version = g_rand_boolean (rand) ? HTTP_1_1 : HTTP_1_0;
+    g_string_append (request->raw, request->version == HTTP_1_1 ? "HTTP/1.1\r\n" : "HTTP/1.0\r\n");
+
+    body = request->method == HTTP_POST ? g_rand_int_range (rand, 0, 512) : 0;
+    request->content_length = 0;
+    n = g_rand_int_range (rand, 0, PARSER_MAX_HEADERS);
+    for (i = 0; i < n; i++) {
+        if (g_rand_int_range (rand, 0, 16) == 0) {
+            /* no name value separator, ignored */
+            g_string_append (request->raw, "no separator line\r\n");
+            continue;
+        }
+        if ((body != 0) && (i == n - 1)) {
+            name = parser_random_case ("Content-Length");
+            value = g_strdup_printf ("%d", body);
+            request->content_length = body;
+
+        } else {
+            name = g_strdup_printf ("%s%d", parser_names[g_rand_int_range (rand, 0, G_N_ELEMENTS (parser_names))], i);
+            value = g_strdup_printf ("%.*s", g_rand_int_range (rand, 0, 40), "value: with spaces, colon and ;q=0.9 token !!");
+        }
+        g_string_append (request->raw, name);
+        parser_spaces (request->raw, 0, 2);
+        g_string_append_c (request->raw, ':');
+        parser_spaces (request->raw, 0, 2);
+        g_string_append (request->raw, value);
+        g_string_append (request->raw, "\r\n");
+        /* leading spaces of value are skipped, value of spaces only is empty */
+        request->names[request->num_headers] = name;
+        request->values[request->num_headers] = g_strdup (value + strspn (value, " "));
+        request->num_headers++;
+        g_free (value);
+    }
+    if ((body != 0) && (request->content_length == 0)) {
+        /* no room for Content-Length, no body */
+        body = 0;
+    }
+    g_string_append (request->raw, "\r\n");
+    request->header_size = request->raw->len;
+    for (i = 0; i < body; i++) {
+        g_string_append_c (request->raw, parser_chars[i % (sizeof (parser_chars) - 1)]);
+    }
+
+    return request;
+}
+
+static void parser_request_free (ParserRequest *request)
+{
+    gint i;
+
+    for (i = 0; i < request->num_headers; i++) {
+        g_free (request->names[i]);
+        g_free (request->values[i]);
+    }
+    g_string_free (request->raw, TRUE);
+    g_string_free (request->uri, TRUE);
+    g_string_free (request->parameters, TRUE);
+    g_free (request);
+}
+
+/* as accept_socket does for a new request */
+static void parser_reset (RequestData *request_data)
+{
+    request_data->request_length = 0;
+    request_data->parse_position = 0;
+    request_data->header_size = 0;
+}
+
+/* append data as read_request does */
+static gint parser_feed (RequestData *request_data, const gchar *data, gsize size)
+{
+    memcpy (request_data->raw_request + request_data->request_length, data, size);
+    request_data->request_length += size;
+    request_data->raw_request[request_data->request_length] = '\0';
+
+    return httpserver_parse_request (request_data);
+}
+
+/* feed request in fragments, fragment size is random if fragment is 0 */
+static gint parser_parse (RequestData *request_data, GString *raw, gsize fragment)
+{
+    gsize position, size;
+    gint ret;
+
+    parser_reset (request_data);
+    ret = 1;
+    for (position = 0; position < raw->len; position += size) {
+        size = fragment != 0 ? fragment : g_rand_int_range (hotpath_rand (), 1, 64);
+        size = MIN (size, raw->len - position);
+        ret = parser_feed (request_data, raw->str + position, size);
+        if ((ret != 1) && (position + size < raw->len)) {
+            hotpath_fail (__FILE__, __LINE__, "httpserver_parse_request", "returns %d at %lu of %lu", ret, position + size, raw->len);
+            break;
+        }
+    }
+
+    return ret;
+}
+
+static void parser_verify (RequestData *request_data, ParserRequest *request)
+{
+    gint i;
+
+    hotpath_check (request_data->method == request->method, "method of %s", request->raw->str);
+    hotpath_check (request_data->version == request->version, "version of %s", request->raw->str);
+    hotpath_check (g_strcmp0 (request_data->uri, request->uri->str) == 0, "uri %s of %s", request_data->uri, request->raw->str);
+    hotpath_check (g_strcmp0 (request_data->parameters, request->parameters->str) == 0,
+            "parameters %s of %s", request_data->parameters, request->raw->str);
+    hotpath_check (request_data->num_headers == request->num_headers,
+            "%d headers, expect %d", request_data->num_headers, request->num_headers);
+    for (i = 0; i < MIN (request_data->num_headers, request->num_headers); i++) {
+        hotpath_check ((g_strcmp0 (http_header_name (request_data, i), request->names[i]) == 0) &&
+                (request_data->headers[i].name_size == strlen (request->names[i])),
+                "header name %s, expect %s", http_header_name (request_data, i), request->names[i]);
+        hotpath_check ((g_strcmp0 (http_header_value (request_data, i), request->values[i]) == 0) &&
+                (request_data->headers[i].value_size == strlen (request->values[i])),
+                "header value %s, expect %s", http_header_value (request_data, i), request->values[i]);
+    }
+    hotpath_check (request_data->content_length == request->content_length,
+            "content length %d, expect %d", request_data->content_length, request->content_length);
+    hotpath_check (request_data->header_size == request->header_size,
+            "header size %d, expect %d", request_data->header_size, request->header_size);
+}
+
+/* request parsed whole, expect result */
+static void parser_bad (RequestData *request_data, const gchar *request, gint expect)
+{
+    GString *raw;
+    gint ret;
+
+    raw = g_string_new (request);
+    ret = parser_parse (request_data, raw, raw->len);
+    hotpath_check (ret == expect, "%s returns %d, expect %d", request, ret, expect);
+    g_string_free (raw, TRUE);
+}
+
+static void parser_bad_requests (RequestData *request_data)
+{
+    GString *request;
+    gint i;
+
+    parser_bad (request_data, "PUT / HTTP/1.1\r\n\r\n", 2);
+    parser_bad (request_data, "GET /\r\n\r\n", 4);
+    parser_bad (request_data, "GET / HTTP/2.0\r\n\r\n", 4);
+    parser_bad (request_data, "POST / HTTP/1.1\r\nContent-Length: -1\r\n\r\n", 3);
+    request = g_string_new ("GET / HTTP/1.1\r\n");
+    for (i = 0; i <= kMaxHeaders; i++) {
+        g_string_append_printf (request, "X-Header%d: %d\r\n", i, i);
+    }
+    g_string_append (request, "\r\n");
+    parser_bad (request_data, request->str, 3);
+    g_string_assign (request, "GET /");
+    for (i = 0; i < kMaxUriLength; i++) {
+        g_string_append_c (request, 'a');
+    }
+    g_string_append (request, " HTTP/1.1\r\n\r\n");
+    parser_bad (request_data, request->str, 3);
+    g_string_free (request, TRUE);
+}
+
+void parser_test (void)
+{
+    RequestData *request_data;
+    ParserRequest *request;
+    gint round, i, ret;
+
+    request_data = g_new0 (RequestData, 1);
+    for (round = 0; round < hotpath_rounds (); round++) {
+        request = parser_request_new ();
+        for (i = 0; i < 4; i++) {
+            /* whole, byte by byte, random fragments */
+            ret = parser_parse (request_data, request->raw, i == 0 ? request->raw->len : (i == 1 ? 1 : 0));
+            hotpath_check (ret == 0, "returns %d on %s", ret, request->raw->str);
+            if (ret == 0) {
+                parser_verify (request_data, request);
+            }
+        }
+        parser_request_free (request);
+    }
+    parser_bad_requests (request_data);
+    g_free (request_data);
+}
+
+/* a typical player request */
+#define PARSER_BENCH_REQUEST "GET /live/encoder/0/playlist.m3u8?token=a%20b&start=20261019120000 HTTP/1.1\r\n" \
+                             "Host: 192.168.1.10:20119\r\n" \
+                             "User-Agent: AppleCoreMedia/1.0.0.16G102 (iPhone; U; CPU OS 12_4 like Mac OS X; en_us)\r\n" \
+                             "Accept: */*\r\n" \
+                             "Accept-Language: en-us\r\n" \
+                             "Accept-Encoding: identity\r\n" \
+                             "X-Playback-Session-Id: 5C8A3B2E-6F1D-4E8B-9A47-2B1C0D3E4F5A\r\n" \
+                             "Connection: keep-alive\r\n\r\n"
+
+typedef struct _ParserBench {
+    RequestData *request_data;
+    GString *raw;
+    gsize fragment;
+} ParserBench;
+
+static void parser_bench_run (gpointer data, guint count)
+{
+    ParserBench *bench = data;
+    guint i;
+
+    for (i = 0; i < count; i++) {
+        if (parser_parse (bench->request_data, bench->raw, bench->fragment) != 0) {
+            hotpath_fail (__FILE__, __LINE__, "httpserver_parse_request", "bench request not parsed");
+            return;
+        }
+    }
+}
+
+void parser_bench (void)
+{
+    HotpathBench whole = {"httpserver_parse_request", parser_bench_run, NULL, 100000, 0};
+    HotpathBench split = {"httpserver_parse_request_16", parser_bench_run, NULL, 100000, 0};
+    ParserBench bench;
+
+    bench.request_data = g_new0 (RequestData, 1);
+    bench.raw = g_string_new (PARSER_BENCH_REQUEST);
+    whole.bytes = split.bytes = bench.raw->len;
+    bench.fragment = bench.raw->len;
+    whole.data = &bench;
+    hotpath_bench (&whole);
+    bench.fragment = 16;
+    split.data = &bench;
+    hotpath_bench (&split);
+    g_string_free (bench.raw, TRUE);
+    g_free (bench.request_data);
+}
@@ -0,0 +1,265 @@
+#
+# pipeline throughput, how many channels a box can run.
+#
+# jobs are built from videotestsrc and audiotestsrc, or from a job file, with
+# the given renditions and no network output. the job count is ramped until
+# jobs can't keep up, and frames/s, ring bytes/s, cpu per job and the
+# saturation point are reported.
+#
+# single mode runs non live jobs to end in gstreamill -j processes, a job is
+# saturated when it encodes slower than its frame rate. no gstreamill daemon
+# may be running, it takes the pid file.
+#
+# daemon mode starts live jobs on a running gstreamill via management api, a
+# step is saturated when a worker is restarted for missed heartbeats, samples
+# are dropped on ring write timeout or sources fall behind real time.
+#
+# run it on a gstreamill built before and after a change of source.c or
+# encoder.c, with --expect the saturation point of the last good build. cpu
+# of daemon mode is percent of all cores as in job stat.
+#
+# usage: python test/pipelinebench.py single -r 1280x720@2500,640x360@800
+#        python test/pipelinebench.py daemon -r 1280x720@2500 --step 2 --max 64
+#
+
+import os
+import re
+import sys
+import json
+import time
+import signal
+import httplib
+import tempfile
+import optparse
+import subprocess
+
+def bench_job(name, live, options):
+    width, height = options.size.split("x")
+    video = {
+        "caps": "video/x-raw,width=%s,height=%s,framerate=%d/1" % (width, height, options.fps),
+        "property": {"is-live": live, "pattern": 18}
+    }
+    audio = {
+        "property": {"is-live": live, "wave": 8, "samplesperbuffer": 44100 / options.fps}
+    }
+    if not live:
+        video["property"]["num-buffers"] = options.frames
+        audio["property"]["num-buffers"] = options.frames
+    source = {
+        "elements": {"videotestsrc": video, "audiotestsrc": audio},
+        "bins": ["videotestsrc ! appsink name=video", "audiotestsrc ! appsink name=audio"]
+    }
+    if not live:
+        # as fast as possible
+        source["elements"]["appsink"] = {"property": {"sync": False}}
+    encoders = []
+    for rendition in options.renditions.split(","):
+        size, bitrate = rendition.split("@")
+        width, height = size.split("x")
+        encoders.append({
+            "elements": {
+                "appsrc": {"property": {"format": 3, "is-live": live}},
+                "videoscale": {"caps": "video/x-raw,width=%s,height=%s" % (width, height)},
+                "x264enc": {"property": {"bitrate": int(bitrate), "byte-stream": True, "bframes": 3}},
+                "appsink": {"property": {"sync": False}}
+            },
+            "bins": [
+                "appsrc name=video ! queue ! videoscale ! queue ! x264enc ! queue ! muxer.",
+                "appsrc name=audio ! audioconvert ! audioresample ! voaacenc ! aacparse ! muxer.",
+                "mpegtsmux name=muxer ! queue ! appsink"
+            ]
+        })
+    return {"name": name, "is-live": live, "debug": "gstreamill:1", "source": source, "encoders": encoders}
+
+def file_job(name, options):
+    # job files have /* */ comments
+    job = json.loads(re.sub(r"/\*.*?\*/", "", open(options.job).read(), flags=re.S))
+    job["name"] = name
+    return job
+
+def make_job(name, live, options):
+    if options.job:
+        return file_job(name, options)
+    return bench_job(name, live, options)
+
+def run_single(count, options):
+    directory = tempfile.mkdtemp(prefix="pipelinebench")
+    workers = []
+    for i in range(count):
+        path = os.path.join(directory, "bench%d.job" % i)
+        open(path, "w").write(json.dumps(make_job("bench%d" % i, False, options)))
+        command = [options.gstreamill, "-j", path, "-a", "127.0.0.1:%d" % (options.port + i)]
+        # the eos summary is logged at info level of the gstreamill category to stderr
+        env = dict(os.environ, GST_DEBUG="gstreamill:4", GST_DEBUG_NO_COLOR="1")
+        log = open(os.path.join(directory, "bench%d.log" % i), "w+")
+        worker = subprocess.Popen(command, stdout=open(os.devnull, "w"), stderr=log, env=env)
+        workers.append([worker, time.time(), None, log])
+    deadline = time.time() + options.timeout
+    while time.time() < deadline and [w for w in workers if w[2] is None]:
+        for w in workers:
+            if w[2] is None and w[0].poll() is not None:
+                w[2] = time.time()
+        time.sleep(0.01)
+    results = []
+    for worker, start, end, log in workers:
+        if end is None:
+            worker.send_signal(signal.SIGINT)
+        worker.wait()
+        log.seek(0)
+        output = log.read()
+        log.close()
+        result = {"wall": (end or time.time()) - start, "bytes": 0, "dropped": 0, "cpu": 0.0, "done": end is not None}
+        for line in output.splitlines():
+            m = re.search(r"encoder \d+ samples \d+ bytes (\d+) gops \d+ dropped (\d+)", line)
+            if m:
+                result["bytes"] += int(m.group(1))
+                result["dropped"] += int(m.group(2))
+            m = re.search(r"cpu user ([\d.]+) system ([\d.]+)", line)
+            if m:
+                result["cpu"] = float(m.group(1)) + float(m.group(2))
+        results.append(result)
+    for name in os.listdir(directory):
+        os.unlink(os.path.join(directory, name))
+    os.rmdir(directory)
+
+    frames = sum([options.frames for r in results if r["done"]])
+    wall = max([r["wall"] for r in results])
+    slowest = min([options.frames / r["wall"] if r["done"] else 0 for r in results])
+    saturated = slowest < options.fps * options.margin or sum([r["dropped"] for r in results]) > 0
+    print "%4d jobs %9.1f frames/s %8.2f MB/s ring %6.2f cpu s/job slowest %6.1f fps %s" % (
+            count,
+            frames / wall,
+            sum([r["bytes"] for r in results]) / wall / 1000000,
+            sum([r["cpu"] for r in results]) / count,
+            slowest,
+            "saturated" if saturated else "")
+    return saturated
+
+def request(options, method, uri, body=None):
+    conn = httplib.HTTPConnection(options.host, options.port)
+    conn.request(method, uri, body, {"Content-Type": "application/json"})
+    resp = conn.getresponse()
+    data = resp.read()
+    conn.close()
+    return resp.status, data
+
+def job_stat(options, name):
+    status, data = request(options, "GET", "/stat/gstreamill/job/%s" % name)
+    if status != 200:
+        return None
+    try:
+        return json.loads(data)["data"]
+    except (ValueError, KeyError):
+        return None
+
+def video_timestamp(stat):
+    streams = stat.get("source", {}).get("streams", [])
+    for stream in streams:
+        if stream["name"] == "video":
+            return stream["timestamp"]
+    return streams[0]["timestamp"] if streams else 0
+
+def sample(options, names):
+    samples = {}
+    for name in names:
+        stat = job_stat(options, name)
+        if stat is None or stat.get("state") != "JOB_STATE_PLAYING":
+            samples[name] = None
+            continue
+        samples[name] = {
+            "time": time.time(),
+            "age": stat["age"],
+            "timestamp": video_timestamp(stat),
+            "bytes": sum([e["stats"]["bytes"] for e in stat["encoders"]]),
+            "dropped": sum([e["stats"]["dropped"] for e in stat["encoders"]]),
+            "cpu": stat["cpu_current"]
+        }
+    return samples
+
+def run_daemon(count, names, options):
+    while len(names) < count:
+        name = "bench%d" % len(names)
+        status, data = request(options, "POST", "/admin/start", json.dumps(make_job(name, True, options)))
+        if status != 200 or "success" not in data:
+            print "start %s failure: %s" % (name, data)
+            return True
+        names.append(name)
+    time.sleep(options.settle)
+    first = sample(options, names)
+    time.sleep(options.window)
+    last = sample(options, names)
+
+    frames, size, dropped, restarts, cpu, stopped = 0.0, 0, 0, 0, 0.0, 0
+    slowest = None
+    for name in names:
+        a, b = first[name], last[name]
+        if a is None or b is None:
+            stopped += 1
+            continue
+        wall = b["time"] - a["time"]
+        realtime = (b["timestamp"] - a["timestamp"]) / 1e9 / wall
+        slowest = realtime if slowest is None else min(slowest, realtime)
+        frames += realtime * options.fps
+        size += (b["bytes"] - a["bytes"]) / wall
+        dropped += b["dropped"] - a["dropped"]
+        restarts += b["age"] - a["age"]
+        cpu += b["cpu"]
+    saturated = stopped > 0 or restarts > 0 or dropped > 0 or slowest is None or slowest < options.margin
+    print "%4d jobs %9.1f frames/s %8.2f MB/s ring %6.2f%% cpu/job realtime %5.2f dropped %d restarts %d stopped %d %s" % (
+            count,
+            frames,
+            size / 1000000,
+            cpu / max(count - stopped, 1),
+            slowest or 0,
+            dropped,
+            restarts,
+            stopped,
+            "saturated" if saturated else "")
+    return saturated
+
+def main():
+    parser = optparse.OptionParser(usage="%prog single|daemon [options]")
+    parser.add_option("-r", "--renditions", default="1280x720@2500", help="encoders, widthxheight@kbps, comma separated")
+    parser.add_option("-s", "--size", default="1920x1080", help="source size")
+    parser.add_option("-f", "--fps", type="int", default=25, help="source frame rate")
+    parser.add_option("-j", "--job", help="job file used instead of test sources")
+    parser.add_option("--frames", type="int", default=1500, help="frames of a single mode job")
+    parser.add_option("--gstreamill", default="gstreamill", help="gstreamill executable of single mode")
+    parser.add_option("--host", default="localhost", help="management host of daemon mode")
+    parser.add_option("--port", type="int", default=20118, help="management port, first http streaming port in single mode")
+    parser.add_option("--step", type="int", default=1, help="jobs added every step")
+    parser.add_option("--max", type="int", default=32, help="maximum jobs")
+    parser.add_option("--settle", type="int", default=10, help="seconds after jobs started before sampling, daemon mode")
+    parser.add_option("--window", type="int", default=20, help="seconds of sampling, daemon mode")
+    parser.add_option("--timeout", type="int", default=600, help="seconds a single mode step may take")
+    parser.add_option("--margin", type="float", default=1.0, help="fraction of real time a job must reach")
+    parser.add_option("--expect", type="int", default=0, help="fail if saturated below this job count")
+    options, args = parser.parse_args()
+    if len(args) != 1 or args[0] not in ("single", "daemon"):
+        parser.error("single or daemon mode is must")
+    if args[0] == "single" and options.port == 20118:
+        options.port = 30000
+
+    names = []
+    capacity = 0
+    count = options.step
+    try:
+        while count <= options.max:
+            if args[0] == "single":
+                saturated = run_single(count, options)
+            else:
+                saturated = run_daemon(count, names, options)
+            if saturated:
+                break
+            capacity = count
+            count += options.step
+    finally:
+        for name in names:
+            request(options, "GET", "/admin/stop/%s" % name)
+
+    print "saturation point: %d jobs" % capacity
+    if capacity < options.expect:
+        print "regression: expect %d jobs" % options.expect
+        sys.exit(1)
+
+main()
@@ -0,0 +1,363 @@
+/*
+ * ring property tests and micro benchmarks.
+ *
+ * encoder output is written by encoder_output_write as output_buffer does, without semaphore,
+ * and checked after every write against a model of gops in cache.
+ *
+ * Copyright (C) Zhang Ping <dqzhangp@163.com>
+ *
+ */
+
+#include <string.h>
+#include <gst/gst.h>
+
+#include "hotpath.h"
+
+/* gop of model */
+typedef struct _RingGop {
+    guint64 addr;
+    GstClockTime timestamp; /* us, as in gop header */
+    gint64 size; /* bytes written */
+    guint32 seed; /* content byte k of gop is ring_byte (seed + k) */
+} RingGop;
+
+typedef struct _Ring {
+    Encoder *encoder;
+    EncoderOutput *output;
+    GQueue *gops; /* head gop first, last one is open */
+    guint64 gops_evicted;
+    guint8 *sample;
+} Ring;
+
+static inline guint8 ring_byte (guint32 k)
+{
+    return (guint8)((k * 2654435761u) >> 24);
+}
+
+/* empty gop at start, as job reset does at 0, its header may wrap around */
+static Ring * ring_new (guint64 cache_size, guint64 start)
+{
+    Ring *ring;
+    RingGop *gop;
+
+    ring = g_new0 (Ring, 1);
+    ring->output = hotpath_encoder_output_new (cache_size);
+    memset (ring->output->cache_addr, 0, cache_size);
+    ring->encoder = g_new0 (Encoder, 1);
+    ring->encoder->output = ring->output;
+    ring->encoder->system_clock = gst_system_clock_obtain ();
+    ring->encoder->segment_duration = GST_SECOND;
+    ring->encoder->segment_timestamp = gst_clock_get_time (ring->encoder->system_clock);
+    *(ring->output->head_addr) = start;
+    *(ring->output->tail_addr) = (start + ENCODER_GOP_HEADER_SIZE) % cache_size;
+    *(ring->output->last_rap_addr) = start;
+    ring->gops = g_queue_new ();
+    gop = g_new0 (RingGop, 1);
+    gop->addr = start;
+    g_queue_push_tail (ring->gops, gop);
+    ring->sample = g_malloc (cache_size);
+
+    return ring;
+}
+
+static void ring_free (Ring *ring)
+{
+    gst_object_unref (ring->encoder->system_clock);
+    g_free (ring->encoder);
+    hotpath_encoder_output_free (ring->output);
+    g_queue_free_full (ring->gops, g_free);
+    g_free (ring->sample);
+    g_free (ring);
+}
+
+/* write buffer as output_buffer does */
+static void ring_output (Ring *ring, GstBuffer *buffer, gboolean rap)
+{
+    encoder_output_write (ring->encoder, buffer, rap);
+    if (rap) {
+        ring->encoder->segment_timestamp += ring->encoder->segment_duration;
+    }
+}
+
+/* write a sample of model content, update model */
+static void ring_write (Ring *ring, gsize size, gboolean rap)
+{
+    RingGop *gop, *open;
+    GstBuffer *buffer;
+    guint64 tail;
+    gsize i;
+
+    open = g_queue_peek_tail (ring->gops);
+    tail = *(ring->output->tail_addr);
+    if (rap && (open->size != 0)) {
+        gop = g_new0 (RingGop, 1);
+        gop->addr = tail;
+        g_queue_push_tail (ring->gops, gop);
+        open = gop;
+    }
+    if (rap) {
+        open->timestamp = ring->encoder->segment_timestamp / 1000;
+        open->seed = g_rand_int (hotpath_rand ());
+    }
+    for (i = 0; i < size; i++) {
+        ring->sample[i] = ring_byte (open->seed + open->size + i);
+    }
+    buffer = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY, ring->sample, size, 0, size, NULL, NULL);
+    ring_output (ring, buffer, rap);
+    gst_buffer_unref (buffer);
+    open->size += size;
+
+    /* head moved out of model */
+    while (ring->gops_evicted < ring->output->stats->gops_evicted) {
+        g_free (g_queue_pop_head (ring->gops));
+        ring->gops_evicted++;
+    }
+}
+
+static gboolean ring_content (Ring *ring, RingGop *gop)
+{
+    guint64 addr;
+    gint64 k;
+
+    addr = (gop->addr + ENCODER_GOP_HEADER_SIZE) % ring->output->cache_size;
+    for (k = 0; k < gop->size; k++) {
+        if ((guint8)ring->output->cache_addr[addr] != ring_byte (gop->seed + k)) {
+            return FALSE;
+        }
+        addr = addr + 1 == ring->output->cache_size ? 0 : addr + 1;
+    }
+
+    return TRUE;
+}
+
+static void ring_verify (Ring *ring, gboolean content)
+{
+    EncoderOutput *output = ring->output;
+    RingGop *gop, *next, *open;
+    guint64 used, tail, left;
+    GList *l;
+
+    hotpath_check (*(output->head_addr) < output->cache_size, "head %lu", *(output->head_addr));
+    hotpath_check (*(output->tail_addr) < output->cache_size, "tail %lu", *(output->tail_addr));
+    hotpath_check (*(output->last_rap_addr) < output->cache_size, "last rap %lu", *(output->last_rap_addr));
+    gop = g_queue_peek_head (ring->gops);
+    hotpath_check (gop->addr == *(output->head_addr), "head %lu, expect %lu", *(output->head_addr), gop->addr);
+    open = g_queue_peek_tail (ring->gops);
+    hotpath_check (open->addr == *(output->last_rap_addr), "last rap %lu, expect %lu", *(output->last_rap_addr), open->addr);
+
+    used = 0;
+    for (l = ring->gops->head; l != NULL; l = l->next) {
+        gop = l->data;
+        used += gop->size + ENCODER_GOP_HEADER_SIZE;
+        hotpath_check (encoder_output_rap_timestamp (output, gop->addr) == gop->timestamp,
+                "timestamp of gop at %lu", gop->addr);
+        if (content) {
+            hotpath_check (ring_content (ring, gop), "content of gop at %lu, size %ld", gop->addr, gop->size);
+        }
+        if (gop == open) {
+            break;
+        }
+        next = l->next->data;
+        hotpath_check (encoder_output_gop_size (output, gop->addr) == gop->size,
+                "size of gop at %lu is %lu, expect %ld", gop->addr, encoder_output_gop_size (output, gop->addr), gop->size);
+        hotpath_check (encoder_output_rap_next (output, gop->addr) == next->addr,
+                "next of gop at %lu is %lu, expect %lu", gop->addr, encoder_output_rap_next (output, gop->addr), next->addr);
+    }
+    hotpath_check (encoder_output_gop_size (output, open->addr) == 0, "open gop size at %lu", open->addr);
+    tail = (open->addr + ENCODER_GOP_HEADER_SIZE + open->size) % output->cache_size;
+    hotpath_check (*(output->tail_addr) == tail, "tail %lu, expect %lu", *(output->tail_addr), tail);
+    left = (*(output->head_addr) + output->cache_size - *(output->tail_addr)) % output->cache_size;
+    hotpath_check (left == output->cache_size - used, "free %lu, expect %lu", left, output->cache_size - used);
+    hotpath_check (output->stats->cache_fill == used, "cache fill %lu, expect %lu", output->stats->cache_fill, used);
+
+    /* seek a closed gop, the open gop and a timestamp not in cache */
+    gop = g_queue_peek_nth (ring->gops, g_rand_int_range (hotpath_rand (), 0, g_queue_get_length (ring->gops)));
+    if (gop != open) {
+        hotpath_check (encoder_output_gop_seek (output, gop->timestamp) == gop->addr, "seek %lu", gop->timestamp);
+    }
+    hotpath_check (encoder_output_gop_seek (output, open->timestamp) == G_MAXUINT64, "seek open gop %lu", open->timestamp);
+    hotpath_check (encoder_output_gop_seek (output, 1) == G_MAXUINT64, "seek missing timestamp");
+}
+
+/* mostly small and ts packet aligned samples, some big ones */
+static gsize ring_sample_size (guint64 cache_size)
+{
+    GRand *rand = hotpath_rand ();
+
+    switch (g_rand_int_range (rand, 0, 10)) {
+        case 0:
+        case 1:
+        case 2:
+            return g_rand_int_range (rand, 1, 17);
+        case 3:
+        case 4:
+            return g_rand_int_range (rand, 1, cache_size / 8);
+        default:
+            return MIN (188 * g_rand_int_range (rand, 1, 8), cache_size / 8);
+    }
+}
+
+/*
+ * random cache sizes, start addresses near cache end that wrap gop headers, random sample sizes
+ * and gop lengths. a gop is closed before it grows over half of cache, head never moves into
+ * the open gop as in a sane job.
+ */
+void ring_test (void)
+{
+    GRand *rand = hotpath_rand ();
+    Ring *ring;
+    RingGop *open;
+    guint64 cache_size, start, written;
+    gboolean rap;
+    gsize size;
+    gint round, step;
+
+    for (round = 0; round < hotpath_rounds (); round++) {
+        cache_size = g_rand_int_range (rand, 1024, 65537);
+        if (g_rand_boolean (rand)) {
+            start = cache_size - g_rand_int_range (rand, 1, 2 * ENCODER_GOP_HEADER_SIZE);
+
+        } else {
+            start = g_rand_int_range (rand, 0, cache_size);
+        }
+        ring = ring_new (cache_size, start);
+        written = 0;
+        for (step = 0; written < 4 * cache_size; step++) {
+            open = g_queue_peek_tail (ring->gops);
+            size = ring_sample_size (cache_size);
+            rap = (g_rand_int_range (rand, 0, 8) == 0) || (open->size + size > cache_size / 2);
+            ring_write (ring, size, rap);
+            written += size;
+            ring_verify (ring, step % 64 == 0);
+        }
+        ring_verify (ring, TRUE);
+        ring_free (ring);
+    }
+}
+
+/* ring of a benchmark, samples of 1316 bytes, a gop of 64 samples */
+typedef struct _RingBench {
+    Ring *ring;
+    GstBuffer *buffer;
+    guint64 count;
+    guint64 *addrs; /* gops in cache */
+    GstClockTime *timestamps;
+    guint gops;
+} RingBench;
+
+static void ring_bench_write (gpointer data, guint count)
+{
+    RingBench *bench = data;
+    guint i;
+
+    for (i = 0; i < count; i++) {
+        ring_output (bench->ring, bench->buffer, bench->count % 64 == 0);
+        bench->count++;
+    }
+}
+
+static void ring_bench_seek (gpointer data, guint count)
+{
+    RingBench *bench = data;
+    guint i;
+
+    /* newest closed gop, the longest walk from head */
+    for (i = 0; i < count; i++) {
+        if (encoder_output_gop_seek (bench->ring->output, bench->timestamps[bench->gops - 2]) == G_MAXUINT64) {
+            hotpath_fail (__FILE__, __LINE__, "seek", "gop not found");
+        }
+    }
+}
+
+static void ring_bench_gop_size (gpointer data, guint count)
+{
+    RingBench *bench = data;
+    guint64 size;
+    guint i;
+
+    size = 0;
+    for (i = 0; i < count; i++) {
+        size += encoder_output_gop_size (bench->ring->output, bench->addrs[i % bench->gops]);
+    }
+    if (size == 0) {
+        hotpath_fail (__FILE__, __LINE__, "gop size", "all gops are empty");
+    }
+}
+
+/* closed gops only, the last one is open */
+static void ring_bench_rap_next (gpointer data, guint count)
+{
+    RingBench *bench = data;
+    guint64 next;
+    guint i;
+
+    next = 0;
+    for (i = 0; i < count; i++) {
+        next += encoder_output_rap_next (bench->ring->output, bench->addrs[i % (bench->gops - 1)]);
+    }
+    if (next == 0) {
+        hotpath_fail (__FILE__, __LINE__, "rap next", "all gops are at 0");
+    }
+}
+
+static RingBench * ring_bench_new (void)
+{
+    RingBench *bench;
+    guint8 *data;
+
+    bench = g_new0 (RingBench, 1);
+    bench->ring = ring_new (64 * 64 * 1316 + 4096, 0);
+    data = g_malloc (1316);
+    memset (data, 0x47, 1316);
+    bench->buffer = gst_buffer_new_wrapped (data, 1316);
+
+    return bench;
+}
+
+static void ring_bench_free (RingBench *bench)
+{
+    gst_buffer_unref (bench->buffer);
+    ring_free (bench->ring);
+    g_free (bench->addrs);
+    g_free (bench->timestamps);
+    g_free (bench);
+}
+
+void ring_bench (void)
+{
+    HotpathBench write = {"ring_write_1316", ring_bench_write, NULL, 100000, 1316};
+    HotpathBench seek = {"encoder_output_gop_seek_64", ring_bench_seek, NULL, 10000, 0};
+    HotpathBench gop_size = {"encoder_output_gop_size", ring_bench_gop_size, NULL, 1000000, 0};
+    HotpathBench rap_next = {"encoder_output_rap_next", ring_bench_rap_next, NULL, 1000000, 0};
+    RingBench *bench;
+    guint64 addr;
+
+    bench = ring_bench_new ();
+    write.data = bench;
+    hotpath_bench (&write);
+    ring_bench_free (bench);
+
+    /* cache of about 64 gops */
+    bench = ring_bench_new ();
+    ring_bench_write (bench, 2 * 64 * 64);
+    bench->addrs = g_new0 (guint64, 128);
+    bench->timestamps = g_new0 (GstClockTime, 128);
+    addr = *(bench->ring->output->head_addr);
+    while (bench->gops < 128) {
+        bench->addrs[bench->gops] = addr;
+        bench->timestamps[bench->gops] = encoder_output_rap_timestamp (bench->ring->output, addr);
+        bench->gops++;
+        if (addr == *(bench->ring->output->last_rap_addr)) {
+            break;
+        }
+        addr = encoder_output_rap_next (bench->ring->output, addr);
+    }
+    g_print ("%u gops in cache\n", bench->gops);
+    seek.data = bench;
+    hotpath_bench (&seek);
+    gop_size.data = bench;
+    hotpath_bench (&gop_size);
+    rap_next.data = bench;
+    hotpath_bench (&rap_next);
+    ring_bench_free (bench);
+}
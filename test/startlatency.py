@@ -0,0 +1,70 @@
+#
+# job start latency, from /admin/start to JOB_STATE_PLAYING.
+#
+# start and stop a job several times and report how long the worker takes to
+# parse the job, build the pipelines and reach PLAYING. run it against a
+# gstreamill built before and after a change of job start-up to compare.
+#
+# usage: python test/startlatency.py [jobfile] [host] [port] [rounds]
+#
+
+import re
+import sys
+import time
+import json
+import httplib
+
+def request(host, port, method, uri, body=None):
+    conn = httplib.HTTPConnection(host, port)
+    headers = {"Content-Type": "application/json"}
+    conn.request(method, uri, body, headers)
+    resp = conn.getresponse()
+    data = resp.read()
+    conn.close()
+    return resp.status, data
+
+def state(host, port, name):
+    status, data = request(host, port, "GET", "/stat/gstreamill/job/%s" % name)
+    if status != 200:
+        return None
+    try:
+        return json.loads(data)["data"].get("state")
+    except (ValueError, KeyError):
+        return None
+
+def start(host, port, job, name, timeout):
+    begin = time.time()
+    request(host, port, "POST", "/admin/start", job)
+    while time.time() - begin < timeout:
+        if state(host, port, name) == "JOB_STATE_PLAYING":
+            return time.time() - begin
+        time.sleep(0.005)
+    return None
+
+def stop(host, port, name):
+    request(host, port, "GET", "/admin/stop/%s" % name)
+    while state(host, port, name) is not None:
+        time.sleep(0.1)
+
+jobfile = sys.argv[1] if len(sys.argv) > 1 else "examples/test.job"
+host = sys.argv[2] if len(sys.argv) > 2 else "localhost"
+port = int(sys.argv[3]) if len(sys.argv) > 3 else 20118
+rounds = int(sys.argv[4]) if len(sys.argv) > 4 else 10
+
+job = open(jobfile).read()
+# job files may begin with a c style comment, e.g. examples/test.job
+name = json.loads(re.sub(r"/\*.*?\*/", "", job, flags=re.S))["name"]
+latencies = []
+for i in range(rounds):
+    latency = start(host, port, job, name, 30)
+    stop(host, port, name)
+    if latency is None:
+        print "round %d: job %s not playing in 30s" % (i, name)
+        continue
+    print "round %d: %.1f ms" % (i, latency * 1000)
+    latencies.append(latency)
+
+if not latencies:
+    sys.exit(1)
+latencies.sort()
+print "%d rounds, min %.1f ms, median %.1f ms, max %.1f ms" % (len(latencies), latencies[0] * 1000, latencies[len(latencies) / 2] * 1000, latencies[-1] * 1000)
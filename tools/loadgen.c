@@ -0,0 +1,815 @@
+/*
+ * loadgen, http load generator of gstreamill streaming.
+ *
+ * Thousands of epoll driven clients in a mix of progressive play, live hls, time shift hls and
+ * dvr download, report throughput, connect, first byte, playlist and segment latency
+ * percentiles and stall counts.
+ *
+ * usage: loadgen -s host:port -j job -c 10000 -m progressive=70,hls=25,timeshift=3,dvr=2
+ *
+ * Copyright (C) Zhang Ping <dqzhangp@163.com>
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <glib.h>
+
+#define HEADER_SIZE 8192
+#define READ_SIZE 65536
+#define EPOLL_EVENTS 1024
+#define HISTOGRAM_SUB 8 /* sub buckets of a power of 2, resolution is 1/8 */
+#define HISTOGRAM_BUCKETS (64 * HISTOGRAM_SUB)
+#define HLS_START_SEGMENTS 3 /* a player starts at the 3rd segment from the live edge */
+
+typedef enum {
+    CLIENT_PROGRESSIVE = 0,
+    CLIENT_HLS,
+    CLIENT_TIMESHIFT,
+    CLIENT_DVR,
+    CLIENT_KINDS
+} ClientKind;
+
+static const gchar *kind_names[CLIENT_KINDS] = {"progressive", "hls", "timeshift", "dvr"};
+
+typedef enum {
+    LATENCY_CONNECT = 0, /* connect start to connected */
+    LATENCY_FIRST_BYTE, /* request sent to first byte of response */
+    LATENCY_PLAYLIST, /* request start to playlist received */
+    LATENCY_SEGMENT, /* request start to segment received */
+    LATENCY_DVR, /* request start to dvr download complete */
+    LATENCY_KINDS
+} LatencyKind;
+
+static const gchar *latency_names[LATENCY_KINDS] = {"connect", "first_byte", "playlist", "segment", "dvr_download"};
+
+typedef enum {
+    STATE_IDLE = 0, /* waiting for next_time */
+    STATE_CONNECTING,
+    STATE_SENDING,
+    STATE_HEADER,
+    STATE_BODY
+} ClientState;
+
+typedef struct _Histogram {
+    guint64 buckets[HISTOGRAM_BUCKETS];
+    guint64 count;
+} Histogram;
+
+/* counters of a worker thread, written by the worker, read by reporter with relaxed loads */
+typedef struct _Stats {
+    guint64 bytes[CLIENT_KINDS];
+    guint64 requests[CLIENT_KINDS];
+    guint64 errors[CLIENT_KINDS];
+    guint64 stalls[CLIENT_KINDS];
+    guint64 active;
+    Histogram latency[LATENCY_KINDS];
+} Stats;
+
+typedef struct _Client {
+    ClientKind kind;
+    gint fd;
+    ClientState state;
+    gint64 next_time; /* us, monotonic, start of next request in STATE_IDLE */
+    gint64 request_start;
+    gint64 request_sent;
+    gint64 last_receive;
+    gboolean stalled;
+    gboolean fetching_segment; /* hls, segment or playlist */
+    gchar *request;
+    gsize request_size, request_offset;
+    gchar header[HEADER_SIZE];
+    gsize header_size;
+    gint status;
+    GString *body; /* hls playlist */
+
+    /* hls player */
+    gchar *last_segment; /* uri of last segment fetched */
+    GQueue *segments; /* uris of segments to fetch */
+    gdouble target_duration;
+    gint64 buffer_end; /* us, monotonic, buffered media runs out, 0 if not playing */
+} Client;
+
+typedef struct _Worker {
+    GThread *thread;
+    gint epoll_fd;
+    Client *clients;
+    gint clients_count;
+    Stats stats;
+} Worker;
+
+static gchar *server = "127.0.0.1:20119";
+static gchar *job = "test";
+static gint encoder = 0;
+static gint clients_count = 100;
+static gint threads_count = 1;
+static gint duration = 60;
+static gint ramp = 10;
+static gint interval = 5;
+static gchar *mix = "progressive=100";
+static gint timeshift = 600;
+static gint dvr_offset = 3600;
+static gint dvr_length = 60;
+static gint stall_timeout = 2000;
+static GOptionEntry options[] = {
+    {"server", 's', 0, G_OPTION_ARG_STRING, &server, ("-s host:port of http streaming, default is 127.0.0.1:20119."), NULL},
+    {"job", 'j', 0, G_OPTION_ARG_STRING, &job, ("-j job name, default is test."), NULL},
+    {"encoder", 'e', 0, G_OPTION_ARG_INT, &encoder, ("-e encoder index, default is 0."), NULL},
+    {"clients", 'c', 0, G_OPTION_ARG_INT, &clients_count, ("-c concurrent clients, default is 100."), NULL},
+    {"threads", 't', 0, G_OPTION_ARG_INT, &threads_count, ("-t worker threads, default is 1."), NULL},
+    {"duration", 'd', 0, G_OPTION_ARG_INT, &duration, ("-d seconds of the test, default is 60."), NULL},
+    {"ramp", 'r', 0, G_OPTION_ARG_INT, &ramp, ("-r seconds to start all clients, default is 10."), NULL},
+    {"interval", 'i', 0, G_OPTION_ARG_INT, &interval, ("-i seconds between reports, default is 5."), NULL},
+    {"mix", 'm', 0, G_OPTION_ARG_STRING, &mix, ("-m weights of progressive, hls, timeshift and dvr clients, default is progressive=100."), NULL},
+    {"timeshift", 'T', 0, G_OPTION_ARG_INT, &timeshift, ("-T seconds of time shift of timeshift clients, default is 600."), NULL},
+    {"dvroffset", 'o', 0, G_OPTION_ARG_INT, &dvr_offset, ("-o seconds before now dvr download ends, default is 3600."), NULL},
+    {"dvrlength", 'l', 0, G_OPTION_ARG_INT, &dvr_length, ("-l seconds of dvr download, default is 60."), NULL},
+    {"stall", 'S', 0, G_OPTION_ARG_INT, &stall_timeout, ("-S ms without data a progressive client is stalled, default is 2000."), NULL},
+    {NULL}
+};
+
+static struct addrinfo *address;
+static gchar *host;
+static volatile gboolean stop = FALSE;
+
+static void stop_test (gint number)
+{
+    stop = TRUE;
+}
+
+/* index of us, exact below HISTOGRAM_SUB, then HISTOGRAM_SUB buckets for every power of 2 */
+static guint histogram_index (guint64 us)
+{
+    guint msb;
+
+    if (us < HISTOGRAM_SUB) {
+        return us;
+    }
+    msb = g_bit_storage (us) - 1;
+
+    return (msb - 2) * HISTOGRAM_SUB + ((us >> (msb - 3)) & (HISTOGRAM_SUB - 1));
+}
+
+/* upper bound of bucket, us */
+static guint64 histogram_bound (guint index)
+{
+    guint msb, sub;
+
+    if (index < HISTOGRAM_SUB) {
+        return index + 1;
+    }
+    msb = index / HISTOGRAM_SUB + 2;
+    sub = index % HISTOGRAM_SUB;
+
+    return ((guint64)(HISTOGRAM_SUB + sub + 1)) << (msb - 3);
+}
+
+static void histogram_observe (Histogram *histogram, gint64 us)
+{
+    __atomic_add_fetch (&(histogram->buckets[histogram_index (us < 0 ? 0 : us)]), 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch (&(histogram->count), 1, __ATOMIC_RELAXED);
+}
+
+static guint64 histogram_quantile (Histogram *histogram, gdouble q)
+{
+    guint64 cumulative;
+    guint i;
+
+    if (histogram->count == 0) {
+        return 0;
+    }
+    cumulative = 0;
+    for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        cumulative += histogram->buckets[i];
+        if (cumulative >= q * histogram->count) {
+            break;
+        }
+    }
+
+    return histogram_bound (i < HISTOGRAM_BUCKETS ? i : HISTOGRAM_BUCKETS - 1);
+}
+
+static void counter_add (guint64 *counter, guint64 value)
+{
+    __atomic_add_fetch (counter, value, __ATOMIC_RELAXED);
+}
+
+static gint64 now_us (void)
+{
+    return g_get_monotonic_time ();
+}
+
+/* uri of the request of client */
+static gchar * client_uri (Client *client)
+{
+    gchar start[16], end[16];
+    struct tm tm;
+    time_t t;
+
+    switch (client->kind) {
+        case CLIENT_PROGRESSIVE:
+            return g_strdup_printf ("/%s/encoder/%d", job, encoder);
+
+        case CLIENT_HLS:
+            if (client->fetching_segment) {
+                return g_strdup_printf ("/%s/encoder/%d/%s", job, encoder, (gchar *)g_queue_peek_head (client->segments));
+            }
+            return g_strdup_printf ("/%s/encoder/%d/playlist.m3u8", job, encoder);
+
+        case CLIENT_TIMESHIFT:
+            if (client->fetching_segment) {
+                return g_strdup_printf ("/%s/encoder/%d/%s", job, encoder, (gchar *)g_queue_peek_head (client->segments));
+            }
+            return g_strdup_printf ("/%s/encoder/%d/playlist.m3u8?timeshift=%d", job, encoder, timeshift);
+
+        case CLIENT_DVR:
+            /* dvr segments are in local time directories */
+            t = time (NULL) - dvr_offset - dvr_length;
+            localtime_r (&t, &tm);
+            strftime (start, sizeof (start), "%Y%m%d%H%M%S", &tm);
+            t += dvr_length;
+            localtime_r (&t, &tm);
+            strftime (end, sizeof (end), "%Y%m%d%H%M%S", &tm);
+            return g_strdup_printf ("/%s/encoder/%d?start=%s&end=%s", job, encoder, start, end);
+
+        default:
+            return NULL;
+    }
+}
+
+static void client_close (Worker *worker, Client *client)
+{
+    if (client->fd != -1) {
+        epoll_ctl (worker->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+        close (client->fd);
+        client->fd = -1;
+        counter_add (&(worker->stats.active), -1);
+    }
+    g_free (client->request);
+    client->request = NULL;
+    client->state = STATE_IDLE;
+}
+
+/* request failed, retry a second later */
+static void client_error (Worker *worker, Client *client)
+{
+    counter_add (&(worker->stats.errors[client->kind]), 1);
+    client_close (worker, client);
+    client->fetching_segment = FALSE;
+    client->next_time = now_us () + G_USEC_PER_SEC;
+}
+
+static void client_start (Worker *worker, Client *client)
+{
+    struct epoll_event event;
+    gchar *uri;
+    gint flag;
+
+    client->fd = socket (address->ai_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (client->fd == -1) {
+        g_printerr ("socket error: %s\n", g_strerror (errno));
+        counter_add (&(worker->stats.errors[client->kind]), 1);
+        client->next_time = now_us () + G_USEC_PER_SEC;
+        return;
+    }
+    counter_add (&(worker->stats.active), 1);
+    flag = 1;
+    setsockopt (client->fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof (flag));
+    client->request_start = now_us ();
+    uri = client_uri (client);
+    client->request = g_strdup_printf ("GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: gstreamill-loadgen\r\n\r\n", uri, host);
+    g_free (uri);
+    client->request_size = strlen (client->request);
+    client->request_offset = 0;
+    client->header_size = 0;
+    client->status = 0;
+    client->stalled = FALSE;
+    if (client->body != NULL) {
+        g_string_truncate (client->body, 0);
+    }
+    counter_add (&(worker->stats.requests[client->kind]), 1);
+    if ((connect (client->fd, address->ai_addr, address->ai_addrlen) == -1) && (errno != EINPROGRESS)) {
+        client_error (worker, client);
+        return;
+    }
+    client->state = STATE_CONNECTING;
+    event.events = EPOLLOUT | EPOLLIN | EPOLLRDHUP;
+    event.data.ptr = client;
+    if (epoll_ctl (worker->epoll_fd, EPOLL_CTL_ADD, client->fd, &event) == -1) {
+        client_error (worker, client);
+    }
+}
+
+/* new segments of playlist after the last one fetched */
+static void hls_parse_playlist (Client *client)
+{
+    gchar **lines, **p, *last;
+    GPtrArray *uris;
+    gint i, start;
+
+    uris = g_ptr_array_new ();
+    lines = g_strsplit (client->body->str, "\n", 0);
+    for (p = lines; *p != NULL; p++) {
+        g_strstrip (*p);
+        if (g_str_has_prefix (*p, "#EXT-X-TARGETDURATION:")) {
+            client->target_duration = g_ascii_strtod (*p + 22, NULL);
+
+        } else if ((**p != '#') && (**p != '\0')) {
+            g_ptr_array_add (uris, *p);
+        }
+    }
+
+    start = uris->len > HLS_START_SEGMENTS ? uris->len - HLS_START_SEGMENTS : 0;
+    if (client->last_segment != NULL) {
+        for (i = uris->len - 1; i >= 0; i--) {
+            if (g_strcmp0 (g_ptr_array_index (uris, i), client->last_segment) == 0) {
+                start = i + 1;
+                break;
+            }
+        }
+    }
+    last = NULL;
+    for (i = start; i < uris->len; i++) {
+        last = g_ptr_array_index (uris, i);
+        g_queue_push_tail (client->segments, g_strdup (last));
+    }
+    if (last != NULL) {
+        g_free (client->last_segment);
+        client->last_segment = g_strdup (last);
+    }
+    g_ptr_array_free (uris, TRUE);
+    g_strfreev (lines);
+    if (client->target_duration <= 0) {
+        client->target_duration = 10;
+    }
+}
+
+/* response received completely, connection: close */
+static void client_complete (Worker *worker, Client *client)
+{
+    gint64 now = now_us ();
+
+    if (client->status != 200) {
+        client_error (worker, client);
+        return;
+    }
+    client_close (worker, client);
+    switch (client->kind) {
+        case CLIENT_PROGRESSIVE:
+            /* live stream never ends, reconnect */
+            counter_add (&(worker->stats.errors[client->kind]), 1);
+            client->next_time = now + G_USEC_PER_SEC;
+            break;
+
+        case CLIENT_HLS:
+        case CLIENT_TIMESHIFT:
+            if (client->fetching_segment) {
+                histogram_observe (&(worker->stats.latency[LATENCY_SEGMENT]), now - client->request_start);
+                g_free (g_queue_pop_head (client->segments));
+                /* playback starts on the first segment, every segment is target duration of media */
+                client->buffer_end = MAX (client->buffer_end, now) + client->target_duration * G_USEC_PER_SEC;
+
+            } else {
+                histogram_observe (&(worker->stats.latency[LATENCY_PLAYLIST]), now - client->request_start);
+                hls_parse_playlist (client);
+            }
+            if (!g_queue_is_empty (client->segments)) {
+                client->fetching_segment = TRUE;
+                client->next_time = now;
+
+            } else {
+                /* poll playlist every half of target duration */
+                client->fetching_segment = FALSE;
+                client->next_time = now + client->target_duration * G_USEC_PER_SEC / 2;
+            }
+            break;
+
+        case CLIENT_DVR:
+            histogram_observe (&(worker->stats.latency[LATENCY_DVR]), now - client->request_start);
+            client->next_time = now + G_USEC_PER_SEC;
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void client_receive (Worker *worker, Client *client, gchar *buf, gssize size)
+{
+    gchar *end;
+    gsize n, previous;
+
+    if (client->state == STATE_HEADER) {
+        if (client->header_size == 0) {
+            histogram_observe (&(worker->stats.latency[LATENCY_FIRST_BYTE]), now_us () - client->request_sent);
+        }
+        previous = client->header_size;
+        n = MIN (size, HEADER_SIZE - 1 - client->header_size);
+        memcpy (client->header + client->header_size, buf, n);
+        client->header_size += n;
+        client->header[client->header_size] = '\0';
+        end = strstr (client->header, "\r\n\r\n");
+        if (end == NULL) {
+            if (client->header_size == HEADER_SIZE - 1) {
+                client_error (worker, client);
+            }
+            return;
+        }
+        if (sscanf (client->header, "HTTP/1.%*d %d", &(client->status)) != 1) {
+            client_error (worker, client);
+            return;
+        }
+        client->state = STATE_BODY;
+        /* rest of this read is body, header buffer holds only part of it */
+        n = (end + 4 - client->header) - previous;
+        buf += n;
+        size -= n;
+    }
+
+    counter_add (&(worker->stats.bytes[client->kind]), size);
+    if ((client->body != NULL) && !client->fetching_segment) {
+        g_string_append_len (client->body, buf, size);
+    }
+}
+
+static void client_event (Worker *worker, Client *client, guint32 events)
+{
+    gchar buf[READ_SIZE];
+    gssize ret;
+    gint error;
+    socklen_t len;
+    struct epoll_event event;
+
+    if (client->state == STATE_CONNECTING) {
+        len = sizeof (error);
+        if ((getsockopt (client->fd, SOL_SOCKET, SO_ERROR, &error, &len) == -1) || (error != 0)) {
+            client_error (worker, client);
+            return;
+        }
+        histogram_observe (&(worker->stats.latency[LATENCY_CONNECT]), now_us () - client->request_start);
+        client->state = STATE_SENDING;
+    }
+
+    if (client->state == STATE_SENDING) {
+        ret = send (client->fd, client->request + client->request_offset, client->request_size - client->request_offset, MSG_NOSIGNAL);
+        if (ret == -1) {
+            if (errno != EAGAIN) {
+                client_error (worker, client);
+            }
+            return;
+        }
+        client->request_offset += ret;
+        if (client->request_offset < client->request_size) {
+            return;
+        }
+        client->request_sent = now_us ();
+        client->last_receive = client->request_sent;
+        client->state = STATE_HEADER;
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.ptr = client;
+        epoll_ctl (worker->epoll_fd, EPOLL_CTL_MOD, client->fd, &event);
+        return;
+    }
+
+    for (;;) {
+        ret = recv (client->fd, buf, sizeof (buf), 0);
+        if (ret > 0) {
+            client->last_receive = now_us ();
+            client->stalled = FALSE;
+            client_receive (worker, client, buf, ret);
+            if (client->fd == -1) {
+                /* bad response */
+                return;
+            }
+            continue;
+
+        } else if (ret == 0) {
+            if (client->state != STATE_BODY) {
+                client_error (worker, client);
+
+            } else {
+                client_complete (worker, client);
+            }
+            return;
+
+        } else if (errno == EAGAIN) {
+            return;
+
+        } else if (errno != EINTR) {
+            client_error (worker, client);
+            return;
+        }
+    }
+}
+
+/* start clients due, stalls of progressive play and of hls players */
+static void worker_timers (Worker *worker, gint64 now, gint started)
+{
+    Client *client;
+    gint i;
+
+    for (i = 0; i < started; i++) {
+        client = &(worker->clients[i]);
+        if ((client->state == STATE_IDLE) && (client->next_time <= now)) {
+            client_start (worker, client);
+        }
+        if ((client->kind == CLIENT_PROGRESSIVE) &&
+                (client->state >= STATE_HEADER) &&
+                !client->stalled &&
+                (now - client->last_receive > stall_timeout * 1000)) {
+            counter_add (&(worker->stats.stalls[client->kind]), 1);
+            client->stalled = TRUE;
+        }
+        if (((client->kind == CLIENT_HLS) || (client->kind == CLIENT_TIMESHIFT)) &&
+                (client->buffer_end != 0) &&
+                (client->buffer_end < now)) {
+            /* buffer underrun, rebuffer */
+            counter_add (&(worker->stats.stalls[client->kind]), 1);
+            client->buffer_end = 0;
+        }
+    }
+}
+
+static gpointer worker_thread (gpointer data)
+{
+    Worker *worker = data;
+    struct epoll_event events[EPOLL_EVENTS];
+    gint64 start, now, ramp_us;
+    gint i, n, started;
+
+    start = now_us ();
+    ramp_us = (gint64)ramp * G_USEC_PER_SEC;
+    while (!stop) {
+        now = now_us ();
+        /* clients are started evenly in ramp time */
+        if ((ramp_us == 0) || (now - start >= ramp_us)) {
+            started = worker->clients_count;
+
+        } else {
+            started = worker->clients_count * (now - start) / ramp_us;
+        }
+        worker_timers (worker, now, started);
+        n = epoll_wait (worker->epoll_fd, events, EPOLL_EVENTS, 10);
+        for (i = 0; i < n; i++) {
+            client_event (worker, events[i].data.ptr, events[i].events);
+        }
+    }
+    for (i = 0; i < worker->clients_count; i++) {
+        client_close (worker, &(worker->clients[i]));
+    }
+
+    return NULL;
+}
+
+/* kind of the n-th client by weights of mix, e.g. progressive=70,hls=30 */
+static gint parse_mix (gint weights[CLIENT_KINDS])
+{
+    gchar **items, **p, **pair;
+    gint i, total;
+
+    total = 0;
+    memset (weights, 0, CLIENT_KINDS * sizeof (gint));
+    items = g_strsplit (mix, ",", 0);
+    for (p = items; *p != NULL; p++) {
+        pair = g_strsplit (*p, "=", 2);
+        for (i = 0; i < CLIENT_KINDS; i++) {
+            if ((pair[0] != NULL) && (pair[1] != NULL) && (g_strcmp0 (g_strstrip (pair[0]), kind_names[i]) == 0)) {
+                weights[i] = atoi (pair[1]);
+                total += weights[i];
+                break;
+            }
+        }
+        if (i == CLIENT_KINDS) {
+            g_printerr ("bad mix item: %s\n", *p);
+            g_strfreev (pair);
+            g_strfreev (items);
+            return 0;
+        }
+        g_strfreev (pair);
+    }
+    g_strfreev (items);
+
+    return total;
+}
+
+static ClientKind client_kind (gint n, gint weights[CLIENT_KINDS], gint total)
+{
+    gint i, w;
+
+    /* spread kinds evenly, client n falls in the weight range of n % total */
+    w = n % total;
+    for (i = 0; i < CLIENT_KINDS; i++) {
+        if (w < weights[i]) {
+            return i;
+        }
+        w -= weights[i];
+    }
+
+    return CLIENT_PROGRESSIVE;
+}
+
+static void stats_sum (Worker *workers, Stats *sum)
+{
+    gint i, k, b;
+    Stats *stats;
+
+    memset (sum, 0, sizeof (Stats));
+    for (i = 0; i < threads_count; i++) {
+        stats = &(workers[i].stats);
+        sum->active += __atomic_load_n (&(stats->active), __ATOMIC_RELAXED);
+        for (k = 0; k < CLIENT_KINDS; k++) {
+            sum->bytes[k] += __atomic_load_n (&(stats->bytes[k]), __ATOMIC_RELAXED);
+            sum->requests[k] += __atomic_load_n (&(stats->requests[k]), __ATOMIC_RELAXED);
+            sum->errors[k] += __atomic_load_n (&(stats->errors[k]), __ATOMIC_RELAXED);
+            sum->stalls[k] += __atomic_load_n (&(stats->stalls[k]), __ATOMIC_RELAXED);
+        }
+        for (k = 0; k < LATENCY_KINDS; k++) {
+            for (b = 0; b < HISTOGRAM_BUCKETS; b++) {
+                sum->latency[k].buckets[b] += __atomic_load_n (&(stats->latency[k].buckets[b]), __ATOMIC_RELAXED);
+            }
+            sum->latency[k].count += __atomic_load_n (&(stats->latency[k].count), __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static guint64 total (guint64 *counters)
+{
+    guint64 sum;
+    gint k;
+
+    sum = 0;
+    for (k = 0; k < CLIENT_KINDS; k++) {
+        sum += counters[k];
+    }
+
+    return sum;
+}
+
+static void report (Stats *stats, Stats *last, gdouble elapsed, gdouble seconds)
+{
+    g_print ("%6.0fs active %5lu  %9.1f Mbit/s  %7.1f req/s  errors %lu  stalls %lu  first byte p99 %.1f ms\n",
+            elapsed,
+            stats->active,
+            (total (stats->bytes) - total (last->bytes)) * 8 / seconds / 1000000,
+            (total (stats->requests) - total (last->requests)) / seconds,
+            total (stats->errors),
+            total (stats->stalls),
+            histogram_quantile (&(stats->latency[LATENCY_FIRST_BYTE]), 0.99) / 1000.0);
+}
+
+static void summary (Stats *stats, gdouble seconds)
+{
+    gint k;
+    Histogram *histogram;
+
+    g_print ("\n%-12s %12s %10s %8s %8s %12s\n", "clients", "bytes", "requests", "errors", "stalls", "Mbit/s");
+    for (k = 0; k < CLIENT_KINDS; k++) {
+        if (stats->requests[k] == 0) {
+            continue;
+        }
+        g_print ("%-12s %12lu %10lu %8lu %8lu %12.1f\n",
+                kind_names[k],
+                stats->bytes[k],
+                stats->requests[k],
+                stats->errors[k],
+                stats->stalls[k],
+                stats->bytes[k] * 8 / seconds / 1000000);
+    }
+    g_print ("\n%-12s %10s %10s %10s %10s %10s\n", "latency", "count", "p50 ms", "p90 ms", "p99 ms", "p999 ms");
+    for (k = 0; k < LATENCY_KINDS; k++) {
+        histogram = &(stats->latency[k]);
+        if (histogram->count == 0) {
+            continue;
+        }
+        g_print ("%-12s %10lu %10.1f %10.1f %10.1f %10.1f\n",
+                latency_names[k],
+                histogram->count,
+                histogram_quantile (histogram, 0.5) / 1000.0,
+                histogram_quantile (histogram, 0.9) / 1000.0,
+                histogram_quantile (histogram, 0.99) / 1000.0,
+                histogram_quantile (histogram, 0.999) / 1000.0);
+    }
+}
+
+static gint resolve_server (void)
+{
+    struct addrinfo hints;
+    gchar *port;
+    gint ret;
+
+    port = strrchr (server, ':');
+    if (port == NULL) {
+        g_printerr ("bad server %s, host:port is must\n", server);
+        return 1;
+    }
+    host = g_strndup (server, port - server);
+    memset (&hints, 0, sizeof (hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    ret = getaddrinfo (host, port + 1, &hints, &address);
+    if (ret != 0) {
+        g_printerr ("resolve %s error: %s\n", server, gai_strerror (ret));
+        return 1;
+    }
+
+    return 0;
+}
+
+int main (int argc, char *argv[])
+{
+    GOptionContext *ctx;
+    GError *err = NULL;
+    Worker *workers;
+    Client *client;
+    Stats stats, last;
+    struct rlimit rlim;
+    gint weights[CLIENT_KINDS], weights_total, i, j, n;
+    gint64 start, last_report, now;
+
+    ctx = g_option_context_new (NULL);
+    g_option_context_add_main_entries (ctx, options, NULL);
+    if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+        g_print ("Error initializing: %s\n", err->message);
+        exit (1);
+    }
+    g_option_context_free (ctx);
+    if ((clients_count <= 0) || (threads_count <= 0) || (interval <= 0)) {
+        g_printerr ("clients, threads and interval must be positive\n");
+        exit (1);
+    }
+    weights_total = parse_mix (weights);
+    if (weights_total <= 0) {
+        g_printerr ("bad mix: %s\n", mix);
+        exit (1);
+    }
+    if (resolve_server () != 0) {
+        exit (2);
+    }
+
+    /* a socket per client */
+    rlim.rlim_cur = rlim.rlim_max = clients_count + 1024;
+    if (setrlimit (RLIMIT_NOFILE, &rlim) == -1) {
+        g_printerr ("setrlimit nofile %d error: %s, try ulimit -n\n", clients_count + 1024, g_strerror (errno));
+    }
+    signal (SIGINT, stop_test);
+    signal (SIGTERM, stop_test);
+    signal (SIGPIPE, SIG_IGN);
+
+    workers = g_new0 (Worker, threads_count);
+    n = 0;
+    for (i = 0; i < threads_count; i++) {
+        workers[i].clients_count = clients_count / threads_count + (i < clients_count % threads_count ? 1 : 0);
+        workers[i].clients = g_new0 (Client, workers[i].clients_count);
+        workers[i].epoll_fd = epoll_create1 (0);
+        for (j = 0; j < workers[i].clients_count; j++) {
+            client = &(workers[i].clients[j]);
+            client->kind = client_kind (n++, weights, weights_total);
+            client->fd = -1;
+            client->state = STATE_IDLE;
+            if ((client->kind == CLIENT_HLS) || (client->kind == CLIENT_TIMESHIFT)) {
+                client->body = g_string_new ("");
+                client->segments = g_queue_new ();
+            }
+        }
+    }
+
+    g_print ("%d clients of %s on %s, mix %s, %d threads, %d seconds\n", clients_count, job, server, mix, threads_count, duration);
+    start = last_report = now_us ();
+    for (i = 0; i < threads_count; i++) {
+        workers[i].thread = g_thread_new ("loadgen", worker_thread, &(workers[i]));
+    }
+    memset (&last, 0, sizeof (Stats));
+    while (!stop) {
+        g_usleep (100000);
+        now = now_us ();
+        if ((duration > 0) && (now - start >= (gint64)duration * G_USEC_PER_SEC)) {
+            stop = TRUE;
+        }
+        if (now - last_report >= (gint64)interval * G_USEC_PER_SEC) {
+            stats_sum (workers, &stats);
+            report (&stats, &last, (gdouble)(now - start) / G_USEC_PER_SEC, (gdouble)(now - last_report) / G_USEC_PER_SEC);
+            last = stats;
+            last_report = now;
+        }
+    }
+    for (i = 0; i < threads_count; i++) {
+        g_thread_join (workers[i].thread);
+    }
+    stats_sum (workers, &stats);
+    summary (&stats, (gdouble)(now_us () - start) / G_USEC_PER_SEC);
+    freeaddrinfo (address);
+
+    return total (stats.errors) == total (stats.requests) ? 3 : 0;
+}
@@ -0,0 +1,659 @@
+/*
+ * tsreplay, capture an udp ts feed with arrival times, replay captures at 1x, Nx or as fast as possible.
+ *
+ * capture file is a header followed by a record per datagram: arrival time since the previous
+ * datagram in us from kernel receive timestamps, datagram size and the datagram, host byte order.
+ * every capture is replayed to its own udp address by its own thread in sendmmsg batches, with
+ * optional loss and jitter injection. jobs ingesting from loopback get the same feed on every
+ * run, on a box without network.
+ *
+ * usage: tsreplay -c udp://239.1.1.1:1234 -w feed.cap -d 600
+ *        tsreplay -x 4 -n 0 -l 0.1 -J 20 feed.cap=udp://127.0.0.1:1234 feed2.cap=udp://127.0.0.1:1235
+ *
+ * Copyright (C) Zhang Ping <dqzhangp@163.com>
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <glib.h>
+
+#define CAPTURE_MAGIC "GSTMCAP1"
+#define BATCH 64
+#define DATAGRAM_SIZE 65536
+#define TS_SYNC_BYTE 0x47
+#define RTP_VERSION_2 0x80
+
+/* capture file header */
+typedef struct _CaptureHeader {
+    gchar magic[8];
+    gint64 start_time; /* wall clock of the first datagram, us */
+} CaptureHeader;
+
+/* in front of every datagram in capture file */
+typedef struct _RecordHeader {
+    guint32 delta; /* us since the previous datagram */
+    guint16 size;
+    guint16 reserved;
+} RecordHeader;
+
+typedef struct _Replay {
+    gchar *path;
+    gchar *uri;
+    GMappedFile *file;
+    gchar *data;
+    guint64 *offsets; /* of datagrams in data */
+    gint64 *times; /* arrival of datagrams since the first one, us */
+    guint count;
+    gint64 period; /* us, a loop of the capture */
+    struct sockaddr_in addr;
+    gint sock;
+    GThread *thread;
+    GRand *rand;
+    gint burst_left; /* datagrams still to lose of a loss burst */
+
+    /* written by replay thread, read by reporter with relaxed loads */
+    guint64 sent;
+    guint64 bytes;
+    guint64 lost;
+    guint64 errors;
+    gint64 late; /* us, the latest a datagram was sent after its time */
+    gboolean done;
+} Replay;
+
+static gchar *capture_uri = NULL;
+static gchar *capture_path = NULL;
+static gint duration = 0;
+static gint receive_buffer = 8 * 1024 * 1024;
+static gdouble speed = 1.0;
+static gint loops = 1;
+static gdouble loss = 0.0;
+static gint burst = 1;
+static gint jitter = 0;
+static gint64 seed = 0;
+static gint ttl = 1;
+static gint interval = 5;
+static GOptionEntry options[] = {
+    {"capture", 'c', 0, G_OPTION_ARG_STRING, &capture_uri, ("-c udp://host:port to capture, multicast group is joined."), NULL},
+    {"write", 'w', 0, G_OPTION_ARG_FILENAME, &capture_path, ("-w capture file."), NULL},
+    {"duration", 'd', 0, G_OPTION_ARG_INT, &duration, ("-d seconds of capture, default is 0, until interrupted."), NULL},
+    {"buffer", 'B', 0, G_OPTION_ARG_INT, &receive_buffer, ("-B capture socket receive buffer size, default is 8M."), NULL},
+    {"speed", 'x', 0, G_OPTION_ARG_DOUBLE, &speed, ("-x replay speed, default is 1.0, 0 is as fast as possible."), NULL},
+    {"loops", 'n', 0, G_OPTION_ARG_INT, &loops, ("-n times a capture is replayed, default is 1, 0 is until interrupted."), NULL},
+    {"loss", 'l', 0, G_OPTION_ARG_DOUBLE, &loss, ("-l percent of datagrams lost, default is 0."), NULL},
+    {"burst", 'b', 0, G_OPTION_ARG_INT, &burst, ("-b datagrams of a loss burst, default is 1."), NULL},
+    {"jitter", 'J', 0, G_OPTION_ARG_INT, &jitter, ("-J ms of random delay of datagrams, order is kept, default is 0."), NULL},
+    {"seed", 's', 0, G_OPTION_ARG_INT64, &seed, ("-s random seed of loss and jitter, default is 1."), NULL},
+    {"ttl", 't', 0, G_OPTION_ARG_INT, &ttl, ("-t multicast ttl of replay, default is 1."), NULL},
+    {"interval", 'i', 0, G_OPTION_ARG_INT, &interval, ("-i seconds between reports, default is 5."), NULL},
+    {NULL}
+};
+
+static volatile gboolean stop = FALSE;
+
+static void stop_test (gint signum)
+{
+    stop = TRUE;
+}
+
+static gint64 now_us (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * G_GINT64_CONSTANT (1000000) + ts.tv_nsec / 1000;
+}
+
+/* sleep until monotonic time in us */
+static void sleep_until (gint64 time)
+{
+    struct timespec ts;
+
+    ts.tv_sec = time / 1000000;
+    ts.tv_nsec = (time % 1000000) * 1000;
+    while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        if (stop) {
+            break;
+        }
+    }
+}
+
+/* udp://host:port to address */
+static gint resolve_uri (const gchar *uri, struct sockaddr_in *addr)
+{
+    struct addrinfo hints, *result;
+    const gchar *p;
+    gchar **pp;
+
+    p = strstr (uri, "://");
+    if ((p == NULL) || !g_str_has_prefix (uri, "udp")) {
+        g_printerr ("invalid udp uri %s\n", uri);
+        return -1;
+    }
+    pp = g_strsplit (p + strlen ("://"), ":", 0);
+    if (g_strv_length (pp) != 2) {
+        g_printerr ("invalid udp uri %s\n", uri);
+        g_strfreev (pp);
+        return -1;
+    }
+    memset (&hints, 0, sizeof (hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo (pp[0], pp[1], &hints, &result) != 0) {
+        g_printerr ("resolve udp uri %s error\n", uri);
+        g_strfreev (pp);
+        return -1;
+    }
+    g_strfreev (pp);
+    memcpy (addr, result->ai_addr, sizeof (struct sockaddr_in));
+    freeaddrinfo (result);
+
+    return 0;
+}
+
+/* bind, join group if multicast, kernel receive timestamps */
+static gint capture_socket_open (const gchar *uri)
+{
+    struct sockaddr_in addr;
+    struct ip_mreq mreq;
+    struct timeval timeout;
+    gint sock, on;
+
+    if (resolve_uri (uri, &addr) != 0) {
+        return -1;
+    }
+    sock = socket (AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock == -1) {
+        g_printerr ("create udp socket error: %s\n", g_strerror (errno));
+        return -1;
+    }
+    on = 1;
+    setsockopt (sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on));
+    if (setsockopt (sock, SOL_SOCKET, SO_RCVBUF, &receive_buffer, sizeof (receive_buffer)) == -1) {
+        g_printerr ("set receive buffer error: %s\n", g_strerror (errno));
+    }
+    if (setsockopt (sock, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof (on)) == -1) {
+        g_printerr ("set receive timestamp error: %s, arrival time is read after receive\n", g_strerror (errno));
+    }
+    /* wake up to check stop and duration */
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 100000;
+    setsockopt (sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+    if (bind (sock, (struct sockaddr *)&addr, sizeof (addr)) == -1) {
+        g_printerr ("bind %s error: %s\n", uri, g_strerror (errno));
+        close (sock);
+        return -1;
+    }
+    if (IN_MULTICAST (ntohl (addr.sin_addr.s_addr))) {
+        mreq.imr_multiaddr = addr.sin_addr;
+        mreq.imr_interface.s_addr = htonl (INADDR_ANY);
+        if (setsockopt (sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof (mreq)) == -1) {
+            g_printerr ("join multicast group %s error: %s\n", uri, g_strerror (errno));
+            close (sock);
+            return -1;
+        }
+    }
+
+    return sock;
+}
+
+/* kernel receive time of a datagram, wall clock in us, 0 if not found */
+static gint64 arrival_time (struct msghdr *msg)
+{
+    struct cmsghdr *cmsg;
+    struct timespec ts;
+
+    for (cmsg = CMSG_FIRSTHDR (msg); cmsg != NULL; cmsg = CMSG_NXTHDR (msg, cmsg)) {
+        if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_TIMESTAMPNS)) {
+            memcpy (&ts, CMSG_DATA (cmsg), sizeof (ts));
+            return ts.tv_sec * G_GINT64_CONSTANT (1000000) + ts.tv_nsec / 1000;
+        }
+    }
+
+    return 0;
+}
+
+static gint capture (void)
+{
+    struct mmsghdr msgs[BATCH];
+    struct iovec iovecs[BATCH];
+    gchar *buffers, *controls;
+    CaptureHeader header;
+    RecordHeader record;
+    FILE *file;
+    gint sock, count, i;
+    gint64 start, last_report, now, time, last_time, delta;
+    guint64 datagrams, bytes, last_bytes, truncated, foreign;
+
+    sock = capture_socket_open (capture_uri);
+    if (sock == -1) {
+        return 2;
+    }
+    file = fopen (capture_path, "wb");
+    if (file == NULL) {
+        g_printerr ("open %s error: %s\n", capture_path, g_strerror (errno));
+        close (sock);
+        return 2;
+    }
+    setvbuf (file, NULL, _IOFBF, 1024 * 1024);
+    buffers = g_malloc (BATCH * DATAGRAM_SIZE);
+    controls = g_malloc0 (BATCH * CMSG_SPACE (sizeof (struct timespec)));
+    memset (msgs, 0, sizeof (msgs));
+
+    g_print ("capture %s into %s\n", capture_uri, capture_path);
+    datagrams = bytes = last_bytes = truncated = foreign = 0;
+    last_time = 0;
+    start = last_report = now_us ();
+    while (!stop) {
+        now = now_us ();
+        if ((duration > 0) && (now - start >= (gint64)duration * G_USEC_PER_SEC)) {
+            break;
+        }
+        if (now - last_report >= (gint64)interval * G_USEC_PER_SEC) {
+            g_print ("%8.1fs %10lu datagrams %8.2f Mbps\n", (gdouble)(now - start) / G_USEC_PER_SEC, datagrams,
+                    (bytes - last_bytes) * 8.0 / (now - last_report));
+            last_bytes = bytes;
+            last_report = now;
+        }
+
+        for (i = 0; i < BATCH; i++) {
+            iovecs[i].iov_base = buffers + i * DATAGRAM_SIZE;
+            iovecs[i].iov_len = DATAGRAM_SIZE;
+            msgs[i].msg_hdr.msg_iov = &(iovecs[i]);
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_control = controls + i * CMSG_SPACE (sizeof (struct timespec));
+            msgs[i].msg_hdr.msg_controllen = CMSG_SPACE (sizeof (struct timespec));
+        }
+        count = recvmmsg (sock, msgs, BATCH, MSG_WAITFORONE, NULL);
+        if (count == -1) {
+            if ((errno == EAGAIN) || (errno == EINTR)) {
+                continue;
+            }
+            g_printerr ("recvmmsg error: %s\n", g_strerror (errno));
+            break;
+        }
+        for (i = 0; i < count; i++) {
+            time = arrival_time (&(msgs[i].msg_hdr));
+            if (time == 0) {
+                time = g_get_real_time ();
+            }
+            if (datagrams == 0) {
+                memcpy (header.magic, CAPTURE_MAGIC, 8);
+                header.start_time = time;
+                fwrite (&header, sizeof (header), 1, file);
+                last_time = time;
+            }
+            /* kernel timestamps of a batch may be not monotonic after wall clock adjusted */
+            delta = CLAMP (time - last_time, 0, G_MAXUINT32);
+            last_time = time;
+            if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                truncated++;
+            }
+            if ((msgs[i].msg_len == 0) || ((((guint8 *)iovecs[i].iov_base)[0] != TS_SYNC_BYTE) &&
+                    ((((guint8 *)iovecs[i].iov_base)[0] & 0xc0) != RTP_VERSION_2))) {
+                foreign++;
+            }
+            record.delta = delta;
+            record.size = msgs[i].msg_len;
+            record.reserved = 0;
+            fwrite (&record, sizeof (record), 1, file);
+            fwrite (iovecs[i].iov_base, msgs[i].msg_len, 1, file);
+            datagrams++;
+            bytes += msgs[i].msg_len;
+        }
+    }
+
+    now = now_us ();
+    g_print ("captured %lu datagrams, %lu bytes in %.1fs, %lu truncated, %lu neither ts nor rtp\n",
+            datagrams, bytes, (gdouble)(now - start) / G_USEC_PER_SEC, truncated, foreign);
+    if (fclose (file) != 0) {
+        g_printerr ("write %s error: %s\n", capture_path, g_strerror (errno));
+    }
+    close (sock);
+    g_free (buffers);
+    g_free (controls);
+
+    return datagrams == 0 ? 3 : 0;
+}
+
+static void replay_free (Replay *replay)
+{
+    if (replay->sock != -1) {
+        close (replay->sock);
+    }
+    if (replay->file != NULL) {
+        g_mapped_file_unref (replay->file);
+    }
+    if (replay->rand != NULL) {
+        g_rand_free (replay->rand);
+    }
+    g_free (replay->offsets);
+    g_free (replay->times);
+    g_free (replay->path);
+    g_free (replay->uri);
+    g_free (replay);
+}
+
+/* path=udp://host:port, map capture and index its datagrams */
+static Replay * replay_new (const gchar *spec, gint index)
+{
+    Replay *replay;
+    GError *err = NULL;
+    const gchar *p;
+    RecordHeader record;
+    gsize size, offset;
+    GArray *offsets, *times;
+    gint64 time;
+    gint on;
+
+    p = strchr (spec, '=');
+    if (p == NULL) {
+        g_printerr ("replay %s is not path=udp://host:port\n", spec);
+        return NULL;
+    }
+    replay = g_new0 (Replay, 1);
+    replay->path = g_strndup (spec, p - spec);
+    replay->uri = g_strdup (p + 1);
+    replay->sock = -1;
+    if (resolve_uri (replay->uri, &(replay->addr)) != 0) {
+        replay_free (replay);
+        return NULL;
+    }
+    replay->file = g_mapped_file_new (replay->path, FALSE, &err);
+    if (replay->file == NULL) {
+        g_printerr ("open %s error: %s\n", replay->path, err->message);
+        g_error_free (err);
+        replay_free (replay);
+        return NULL;
+    }
+    replay->data = g_mapped_file_get_contents (replay->file);
+    size = g_mapped_file_get_length (replay->file);
+    if ((size < sizeof (CaptureHeader)) || (memcmp (replay->data, CAPTURE_MAGIC, 8) != 0)) {
+        g_printerr ("%s is not a capture file\n", replay->path);
+        replay_free (replay);
+        return NULL;
+    }
+
+    offsets = g_array_new (FALSE, FALSE, sizeof (guint64));
+    times = g_array_new (FALSE, FALSE, sizeof (gint64));
+    time = 0;
+    for (offset = sizeof (CaptureHeader); offset + sizeof (RecordHeader) <= size; offset += sizeof (RecordHeader) + record.size) {
+        memcpy (&record, replay->data + offset, sizeof (RecordHeader));
+        if (offset + sizeof (RecordHeader) + record.size > size) {
+            g_printerr ("%s is truncated, %u datagrams\n", replay->path, offsets->len);
+            break;
+        }
+        time += record.delta;
+        g_array_append_val (offsets, offset);
+        g_array_append_val (times, time);
+    }
+    replay->count = offsets->len;
+    replay->offsets = (guint64 *)g_array_free (offsets, FALSE);
+    replay->times = (gint64 *)g_array_free (times, FALSE);
+    if (replay->count == 0) {
+        g_printerr ("%s has no datagram\n", replay->path);
+        replay_free (replay);
+        return NULL;
+    }
+    /* next loop starts a mean gap after the last datagram, 1ms at least */
+    replay->period = replay->times[replay->count - 1] + replay->times[replay->count - 1] / MAX (replay->count - 1, 1);
+    replay->period = MAX (replay->period, 1000);
+
+    replay->sock = socket (AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (replay->sock == -1) {
+        g_printerr ("create udp socket error: %s\n", g_strerror (errno));
+        replay_free (replay);
+        return NULL;
+    }
+    on = 4 * 1024 * 1024;
+    setsockopt (replay->sock, SOL_SOCKET, SO_SNDBUF, &on, sizeof (on));
+    if (IN_MULTICAST (ntohl (replay->addr.sin_addr.s_addr))) {
+        setsockopt (replay->sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof (ttl));
+        on = 1;
+        setsockopt (replay->sock, IPPROTO_IP, IP_MULTICAST_LOOP, &on, sizeof (on));
+    }
+    replay->rand = g_rand_new_with_seed (seed + index);
+    g_print ("%s: %u datagrams, %.1fs, to %s\n", replay->path, replay->count, (gdouble)replay->period / G_USEC_PER_SEC, replay->uri);
+
+    return replay;
+}
+
+/* loss burst starts with probability of loss, or goes on */
+static gboolean replay_lose (Replay *replay)
+{
+    if (replay->burst_left > 0) {
+        replay->burst_left--;
+        return TRUE;
+    }
+    if ((loss > 0) && (g_rand_double (replay->rand) * 100 < loss / MAX (burst, 1))) {
+        replay->burst_left = MAX (burst, 1) - 1;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* send n datagrams of batch, resume after a partial send */
+static void replay_send (Replay *replay, struct mmsghdr *msgs, gint n)
+{
+    gint sent, count, i;
+
+    sent = 0;
+    while (sent < n) {
+        count = sendmmsg (replay->sock, msgs + sent, n - sent, 0);
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            __atomic_add_fetch (&(replay->errors), n - sent, __ATOMIC_RELAXED);
+            return;
+        }
+        for (i = sent; i < sent + count; i++) {
+            __atomic_add_fetch (&(replay->bytes), msgs[i].msg_len, __ATOMIC_RELAXED);
+        }
+        __atomic_add_fetch (&(replay->sent), count, __ATOMIC_RELAXED);
+        sent += count;
+    }
+}
+
+/*
+ * datagrams due are sent in a batch, the thread sleeps until the next one is due. a datagram is
+ * due at its arrival time in capture divided by speed, plus its jitter, a late datagram holds the
+ * following ones as a congested link does.
+ */
+static gpointer replay_thread (gpointer data)
+{
+    Replay *replay = data;
+    struct mmsghdr msgs[BATCH];
+    struct iovec iovecs[BATCH];
+    RecordHeader record;
+    gint64 start, base, due, now, late;
+    guint i, due_index;
+    gint n, loop;
+
+    memset (msgs, 0, sizeof (msgs));
+    for (n = 0; n < BATCH; n++) {
+        msgs[n].msg_hdr.msg_name = &(replay->addr);
+        msgs[n].msg_hdr.msg_namelen = sizeof (replay->addr);
+        msgs[n].msg_hdr.msg_iov = &(iovecs[n]);
+        msgs[n].msg_hdr.msg_iovlen = 1;
+    }
+    start = now_us ();
+    base = 0;
+    due = 0;
+    for (loop = 0; !stop && ((loops == 0) || (loop < loops)); loop++) {
+        i = 0;
+        due_index = G_MAXUINT;
+        while (!stop && (i < replay->count)) {
+            now = now_us ();
+            n = 0;
+            while ((n < BATCH) && (i < replay->count)) {
+                if ((speed > 0) && (due_index != i)) {
+                    /* jitter of a datagram is drawn once, it may wait for the next batch */
+                    due = start + (base + replay->times[i]) / speed;
+                    if (jitter > 0) {
+                        due += g_rand_int_range (replay->rand, 0, jitter * 1000);
+                    }
+                    due_index = i;
+                }
+                if (speed > 0) {
+                    if ((due > now) && (n > 0)) {
+                        /* next batch */
+                        break;
+                    }
+                    if (due > now) {
+                        sleep_until (due);
+                        now = now_us ();
+                    }
+                    late = now - due;
+                    if (late > replay->late) {
+                        __atomic_store_n (&(replay->late), late, __ATOMIC_RELAXED);
+                    }
+                }
+                if (replay_lose (replay)) {
+                    __atomic_add_fetch (&(replay->lost), 1, __ATOMIC_RELAXED);
+                    i++;
+                    continue;
+                }
+                memcpy (&record, replay->data + replay->offsets[i], sizeof (RecordHeader));
+                iovecs[n].iov_base = replay->data + replay->offsets[i] + sizeof (RecordHeader);
+                iovecs[n].iov_len = record.size;
+                n++;
+                i++;
+            }
+            if (n > 0) {
+                replay_send (replay, msgs, n);
+            }
+        }
+        base += replay->period;
+    }
+    __atomic_store_n (&(replay->done), TRUE, __ATOMIC_RELEASE);
+
+    return NULL;
+}
+
+static void report (GPtrArray *replays, guint64 *last_bytes, gdouble seconds, gdouble elapsed)
+{
+    Replay *replay;
+    guint64 bytes;
+    guint i;
+
+    for (i = 0; i < replays->len; i++) {
+        replay = g_ptr_array_index (replays, i);
+        bytes = __atomic_load_n (&(replay->bytes), __ATOMIC_RELAXED);
+        g_print ("%8.1fs %s %10lu sent %8.2f Mbps %8lu lost %6lu errors late %6.1fms\n",
+                seconds,
+                replay->path,
+                __atomic_load_n (&(replay->sent), __ATOMIC_RELAXED),
+                elapsed > 0 ? (bytes - last_bytes[i]) * 8 / elapsed / 1000000 : 0,
+                __atomic_load_n (&(replay->lost), __ATOMIC_RELAXED),
+                __atomic_load_n (&(replay->errors), __ATOMIC_RELAXED),
+                __atomic_load_n (&(replay->late), __ATOMIC_RELAXED) / 1000.0);
+        last_bytes[i] = bytes;
+    }
+}
+
+static gint replay_captures (gint argc, gchar *argv[])
+{
+    GPtrArray *replays;
+    Replay *replay;
+    guint64 *last_bytes, *zero;
+    gint64 start, last_report, now;
+    gboolean done;
+    gint i, ret;
+
+    replays = g_ptr_array_new ();
+    for (i = 1; i < argc; i++) {
+        replay = replay_new (argv[i], i);
+        if (replay == NULL) {
+            return 2;
+        }
+        g_ptr_array_add (replays, replay);
+    }
+    last_bytes = g_new0 (guint64, replays->len);
+    zero = g_new0 (guint64, replays->len);
+    start = last_report = now_us ();
+    for (i = 0; i < replays->len; i++) {
+        replay = g_ptr_array_index (replays, i);
+        replay->thread = g_thread_new ("tsreplay", replay_thread, replay);
+    }
+    done = FALSE;
+    while (!done) {
+        g_usleep (100000);
+        done = TRUE;
+        for (i = 0; i < replays->len; i++) {
+            replay = g_ptr_array_index (replays, i);
+            done = done && __atomic_load_n (&(replay->done), __ATOMIC_ACQUIRE);
+        }
+        now = now_us ();
+        if (now - last_report >= (gint64)interval * G_USEC_PER_SEC) {
+            report (replays, last_bytes, (gdouble)(now - start) / G_USEC_PER_SEC, (gdouble)(now - last_report) / G_USEC_PER_SEC);
+            last_report = now;
+        }
+    }
+
+    g_print ("summary:\n");
+    report (replays, zero, (gdouble)(now_us () - start) / G_USEC_PER_SEC, (gdouble)(now_us () - start) / G_USEC_PER_SEC);
+    ret = 0;
+    for (i = 0; i < replays->len; i++) {
+        replay = g_ptr_array_index (replays, i);
+        g_thread_join (replay->thread);
+        if (replay->errors != 0) {
+            ret = 3;
+        }
+        replay_free (replay);
+    }
+    g_ptr_array_free (replays, TRUE);
+    g_free (last_bytes);
+    g_free (zero);
+
+    return ret;
+}
+
+int main (int argc, char *argv[])
+{
+    GOptionContext *ctx;
+    GError *err = NULL;
+
+    ctx = g_option_context_new ("[capture=udp://host:port ...]");
+    g_option_context_add_main_entries (ctx, options, NULL);
+    if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+        g_print ("Error initializing: %s\n", err->message);
+        exit (1);
+    }
+    g_option_context_free (ctx);
+    if ((speed < 0) || (loops < 0) || (loss < 0) || (loss > 100) || (jitter < 0) || (interval <= 0)) {
+        g_printerr ("speed, loops, loss, jitter and interval must not be negative, loss is percent\n");
+        exit (1);
+    }
+    if (seed == 0) {
+        seed = 1;
+    }
+    signal (SIGINT, stop_test);
+    signal (SIGTERM, stop_test);
+
+    if (capture_uri != NULL) {
+        if (capture_path == NULL) {
+            g_printerr ("capture file is must, -w\n");
+            exit (1);
+        }
+        return capture ();
+    }
+    if (argc < 2) {
+        g_printerr ("capture=udp://host:port to replay or -c udp://host:port to capture is must\n");
+        exit (1);
+    }
+
+    return replay_captures (argc, argv);
+}